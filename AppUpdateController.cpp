@@ -11,12 +11,18 @@ AppUpdateController::AppUpdateController(QObject *parent) : QObject(parent),
     m_downloadEnabled  (true),
     m_useCustomInstall (false),
     m_useCustomAppcast (false),
-    m_mandatoryUpdate  (false)
+    m_mandatoryUpdate  (false),
+    m_progress         (new DownloadProgress(this))
 {
 
     m_updater = QSimpleUpdater::getInstance();
 
+    /* Keep the network and disk I/O away from the QML scene graph */
+    m_updater->setUseWorkerThread(true);
+
     connect(m_updater, &QSimpleUpdater::checkingFinished,  this, &AppUpdateController::updateChangelog);
+    connect(m_updater, &QSimpleUpdater::downloadStateChanged, this, &AppUpdateController::updateDownloadState);
+    connect(m_updater, &QSimpleUpdater::downloadProgress,  this, &AppUpdateController::updateDownloadProgress);
 }
 
 AppUpdateController::~AppUpdateController() {
@@ -81,3 +87,13 @@ void AppUpdateController::updateChangelog(const QString &url) {
     emit changeLogChanged(log);
 
 }
+
+void AppUpdateController::updateDownloadState(const QString &url, int state) {
+    if (url == DEFS_URL)
+        m_progress->setState(state);
+}
+
+void AppUpdateController::updateDownloadProgress(const QString &url, qint64 received, qint64 total, qreal rate, qint64 eta) {
+    if (url == DEFS_URL)
+        m_progress->setProgress(received, total, rate, eta);
+}
@@ -5,6 +5,8 @@
 #include <QSimpleUpdater.h>
 #include <QSimpleUpdater/src/Downloader.h>
 
+#include "DownloadProgress.h"
+
 namespace Ui {
 class AppUpdateController;
 }
@@ -23,6 +25,7 @@ class AppUpdateController : public QObject {
     Q_PROPERTY(bool mandatoryUpdate  READ mandatoryUpdate   WRITE setMandatoryUpdate       NOTIFY mandatoryUpdateChanged  FINAL)
 
     Q_PROPERTY(QString  changeLog READ changeLog  NOTIFY changeLogChanged )
+    Q_PROPERTY(DownloadProgress* progress READ progress CONSTANT FINAL)
 public:
     explicit AppUpdateController(QObject *parent = nullptr);
     ~AppUpdateController();
@@ -37,6 +40,7 @@ public:
     bool useCustomAppcast   ()           { return m_useCustomAppcast; }
     bool mandatoryUpdate    ()           { return m_mandatoryUpdate;  }
     QString changeLog       ()           { return m_changeLog;}
+    DownloadProgress *progress()         { return m_progress; }
 
     void setNotifyFinish     (bool _notifyFinish);
     void setDownloadEnabled  (bool _downloadEnable);
@@ -58,6 +62,8 @@ signals:
 private slots:
 
     void updateChangelog(const QString &url);
+    void updateDownloadState(const QString &url, int state);
+    void updateDownloadProgress(const QString &url, qint64 received, qint64 total, qreal rate, qint64 eta);
 
 private:
     QString DEFS_URL = "https://raw.githubusercontent.com/lebronkey/testUpdate/main/definitions/updates3.json";
@@ -71,6 +77,7 @@ private:
     bool m_useCustomAppcast;
     bool m_mandatoryUpdate;
     QString m_changeLog;
+    DownloadProgress *m_progress;
 };
 
 
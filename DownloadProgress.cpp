@@ -0,0 +1,73 @@
+#include "DownloadProgress.h"
+
+/* 最小发布间隔（毫秒），即最多每秒10次 */
+static const int PUBLISH_INTERVAL = 100;
+
+DownloadProgress::DownloadProgress(QObject *parent) : QObject(parent),
+    m_dirty        (false),
+    m_bytes        (0),
+    m_total        (-1),
+    m_rate         (0),
+    m_eta          (-1),
+    m_state        (Idle),
+    m_pendingBytes (0),
+    m_pendingTotal (-1),
+    m_pendingRate  (0),
+    m_pendingEta   (-1),
+    m_pendingState (Idle)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(PUBLISH_INTERVAL);
+    connect(&m_timer, &QTimer::timeout, this, &DownloadProgress::publish);
+}
+
+void DownloadProgress::setProgress(qint64 bytes, qint64 total, qreal rate, qint64 eta)
+{
+    m_pendingBytes = bytes;
+    m_pendingTotal = total;
+    m_pendingRate  = rate;
+    m_pendingEta   = eta;
+    schedule();
+}
+
+void DownloadProgress::setState(int state)
+{
+    m_pendingState = State(state);
+
+    /* 新的下载从零开始 */
+    if (m_pendingState == Waiting) {
+        m_pendingBytes = 0;
+        m_pendingTotal = -1;
+        m_pendingRate  = 0;
+        m_pendingEta   = -1;
+    }
+
+    schedule();
+}
+
+/*
+ * The first change is published immediately, the following changes are
+ * collected until the interval has elapsed.
+ */
+void DownloadProgress::schedule()
+{
+    m_dirty = true;
+    if (!m_timer.isActive())
+        publish();
+}
+
+void DownloadProgress::publish()
+{
+    if (!m_dirty)
+        return;
+
+    m_dirty = false;
+    m_bytes = m_pendingBytes;
+    m_total = m_pendingTotal;
+    m_rate  = m_pendingRate;
+    m_eta   = m_pendingEta;
+    m_state = m_pendingState;
+    emit changed();
+
+    m_timer.start();
+}
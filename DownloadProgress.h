@@ -0,0 +1,76 @@
+#ifndef DOWNLOADPROGRESS_H
+#define DOWNLOADPROGRESS_H
+
+#include <QObject>
+#include <QTimer>
+#include <QSimpleUpdater.h>
+
+/*
+ * 下载进度模型，供QML绑定使用
+ * Holds the progress of the download for QML. The values are published (and
+ * the bindings re-evaluated) at most ten times per second, no matter how
+ * often the downloader reports its progress.
+ */
+class DownloadProgress : public QObject {
+
+    Q_OBJECT
+
+    Q_PROPERTY(qint64 bytes  READ bytes  NOTIFY changed FINAL)
+    Q_PROPERTY(qint64 total  READ total  NOTIFY changed FINAL)
+    Q_PROPERTY(qreal  rate   READ rate   NOTIFY changed FINAL)
+    Q_PROPERTY(qint64 eta    READ eta    NOTIFY changed FINAL)
+    Q_PROPERTY(State  state  READ state  NOTIFY changed FINAL)
+    Q_PROPERTY(qreal  value  READ value  NOTIFY changed FINAL)
+public:
+    enum State {
+        Idle        = QSimpleUpdater::Idle,
+        Waiting     = QSimpleUpdater::Waiting,
+        Downloading = QSimpleUpdater::Downloading,
+        Patching    = QSimpleUpdater::Patching,
+        Completed   = QSimpleUpdater::Completed,
+        Failed      = QSimpleUpdater::Failed,
+        Canceled    = QSimpleUpdater::Canceled,
+        Paused      = QSimpleUpdater::Paused
+    };
+    Q_ENUM(State)
+
+    explicit DownloadProgress(QObject *parent = nullptr);
+
+    qint64 bytes () const { return m_bytes; }
+    qint64 total () const { return m_total; }
+    qreal  rate  () const { return m_rate;  }
+    qint64 eta   () const { return m_eta;   }
+    State  state () const { return m_state; }
+    qreal  value () const { return m_total > 0 ? qreal(m_bytes) / m_total : 0; }
+
+public slots:
+    void setProgress (qint64 bytes, qint64 total, qreal rate, qint64 eta);
+    void setState    (int state);
+
+signals:
+    void changed();
+
+private slots:
+    void publish();
+
+private:
+    void schedule();
+
+private:
+    QTimer m_timer;
+    bool   m_dirty;
+
+    qint64 m_bytes;
+    qint64 m_total;
+    qreal  m_rate;
+    qint64 m_eta;
+    State  m_state;
+
+    qint64 m_pendingBytes;
+    qint64 m_pendingTotal;
+    qreal  m_pendingRate;
+    qint64 m_pendingEta;
+    State  m_pendingState;
+};
+
+#endif // DOWNLOADPROGRESS_H
@@ -28,15 +28,59 @@ QT += widgets
 DEFINES += QSU_INCLUDE_MOC=1
 INCLUDEPATH += $$PWD/include
 
+# gzip support: use the system zlib, or the copy bundled with Qt
+unix:!android: LIBS += -lz
+else: INCLUDEPATH += $$[QT_INSTALL_HEADERS]/QtZlib
+
+# zstd support is optional (CONFIG += qsu_zstd), it needs libzstd
+qsu_zstd {
+    DEFINES += QSU_ENABLE_ZSTD
+    LIBS += -lzstd
+}
+
 SOURCES += \
     $$PWD/src/Updater.cpp \
+    $$PWD/src/AppcastCatalog.cpp \
+    $$PWD/src/AppcastParser.cpp \
+    $$PWD/src/AppcastReader.cpp \
+    $$PWD/src/ArchiveExtractor.cpp \
+    $$PWD/src/ChunkSync.cpp \
     $$PWD/src/Downloader.cpp \
-    $$PWD/src/QSimpleUpdater.cpp
+    $$PWD/src/DownloadCache.cpp \
+    $$PWD/src/DownloadScheduler.cpp \
+    $$PWD/src/DownloadTask.cpp \
+    $$PWD/src/DownloadWriter.cpp \
+    $$PWD/src/MirrorSelector.cpp \
+    $$PWD/src/NetworkManager.cpp \
+    $$PWD/src/PatchEngine.cpp \
+    $$PWD/src/RateLimiter.cpp \
+    $$PWD/src/QSimpleUpdater.cpp \
+    $$PWD/src/SegmentedDownload.cpp \
+    $$PWD/src/SlotInstaller.cpp \
+    $$PWD/src/StreamDecoder.cpp \
+    $$PWD/src/ThroughputEstimator.cpp
 
 HEADERS += \
     $$PWD/include/QSimpleUpdater.h \
     $$PWD/src/Updater.h \
-    $$PWD/src/Downloader.h
+    $$PWD/src/AppcastCatalog.h \
+    $$PWD/src/AppcastParser.h \
+    $$PWD/src/AppcastReader.h \
+    $$PWD/src/ArchiveExtractor.h \
+    $$PWD/src/ChunkSync.h \
+    $$PWD/src/Downloader.h \
+    $$PWD/src/DownloadCache.h \
+    $$PWD/src/DownloadScheduler.h \
+    $$PWD/src/DownloadTask.h \
+    $$PWD/src/DownloadWriter.h \
+    $$PWD/src/MirrorSelector.h \
+    $$PWD/src/NetworkManager.h \
+    $$PWD/src/PatchEngine.h \
+    $$PWD/src/RateLimiter.h \
+    $$PWD/src/SegmentedDownload.h \
+    $$PWD/src/SlotInstaller.h \
+    $$PWD/src/StreamDecoder.h \
+    $$PWD/src/ThroughputEstimator.h
 
 FORMS += $$PWD/src/Downloader.ui
 RESOURCES += $$PWD/etc/resources/qsimpleupdater.qrc
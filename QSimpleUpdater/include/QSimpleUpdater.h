@@ -26,6 +26,9 @@
 #include <QUrl>
 #include <QList>
 #include <QObject>
+#include <QPointer>
+#include <QMetaType>
+#include <QStringList>
 
 #if defined(QSU_SHARED)
 #   define QSU_DECL Q_DECL_EXPORT
@@ -36,6 +39,31 @@
 #endif
 
 class Updater;
+class QNetworkAccessManager;
+
+/**
+ * \brief Result of the check of one module, reported by
+ *        \c QSimpleUpdater::batchCheckFinished()
+ */
+struct UpdateSummary
+{
+   UpdateSummary()
+      : updateAvailable(false)
+      , mandatoryUpdate(false)
+      , downloadSize(0)
+   {
+   }
+
+   QString url;
+   QString moduleName;
+   QString moduleVersion;
+   QString latestVersion;
+   bool updateAvailable;
+   bool mandatoryUpdate;
+   qint64 downloadSize;
+};
+
+Q_DECLARE_METATYPE(UpdateSummary)
 
 /**
  * \brief Manages the updater instances
@@ -55,15 +83,59 @@ class Updater;
  *
  * By default, the downloader will try to open the file as if you opened it
  * from a file manager or a web browser (with the "file:*" url).
+ *
+ * Applications with their own user interface can follow the downloads with
+ * the \c downloadStateChanged() signal (a \c QSimpleUpdater::DownloadState)
+ * and the \c downloadProgress() signal, which is emitted at most ten times
+ * per second with the received bytes, the total size (\c -1 if unknown), the
+ * rate in bytes per second and the remaining time in seconds (\c -1 if
+ * unknown).
+ *
+ * Many modules can be checked at once with \c checkForUpdates(QStringList):
+ * the checks run concurrently (within the limits of
+ * \c setMaxConcurrentDownloads() and \c setMaxHostConnections()) and a
+ * single \c batchCheckFinished() signal reports the results of all of them.
+ *
+ * The updaters are registered in a hash table indexed by their URL, and the
+ * functions may be called from worker threads: the setters and the checks
+ * are then queued to the thread of the \c QSimpleUpdater (the GUI thread),
+ * while the getters and the creation of new updaters run in that thread as
+ * the caller waits (so that thread must not be waiting for the caller).
+ * Once the application is closing down, calls from other threads no longer
+ * wait: the getters return default values. The updaters are only ever read
+ * and modified in their own thread. Updaters that are no
+ * longer needed can be removed with \c removeUpdater().
  */
 class QSU_DECL QSimpleUpdater : public QObject
 {
    Q_OBJECT
 
+public:
+   /**
+    * 下载状态
+    * The states reported by \c downloadStateChanged()
+    */
+   enum DownloadState
+   {
+      Idle,
+      Waiting,
+      Downloading,
+      Patching,
+      Completed,
+      Failed,
+      Canceled,
+      Paused
+   };
+   Q_ENUM(DownloadState)
+
 signals:
    void checkingFinished(const QString &url);
+   void batchCheckFinished(const QList<UpdateSummary> &results);
    void appcastDownloaded(const QString &url, const QByteArray &data);
    void downloadFinished(const QString &url, const QString &filepath);
+   void archiveExtracted(const QString &url, const QString &directory);
+   void downloadStateChanged(const QString &url, const int state);
+   void downloadProgress(const QString &url, qint64 received, qint64 total, qreal rate, qint64 remainingTime);
 
 public:
    static QSimpleUpdater *getInstance();
@@ -74,6 +146,14 @@ public:
    bool getUpdateAvailable(const QString &url) const;
    bool getDownloaderEnabled(const QString &url) const;
    bool usesCustomInstallProcedures(const QString &url) const;
+   bool getResumeDownloads(const QString &url) const;
+   int getDownloadSegments(const QString &url) const;
+   bool getAdaptiveThrottling(const QString &url) const;
+   bool getBackgroundDownload(const QString &url) const;
+   bool getPrefetchUpdates(const QString &url) const;
+   bool getExtractArchives(const QString &url) const;
+   QString getInstallDirectory(const QString &url) const;
+   bool rollbackUpdate(const QString &url);
 
    QString getOpenUrl(const QString &url) const;
    QString getChangelog(const QString &url) const;
@@ -83,9 +163,28 @@ public:
    QString getLatestVersion(const QString &url) const;
    QString getModuleVersion(const QString &url) const;
    QString getUserAgentString(const QString &url) const;
+   QString getDownloadChecksum(const QString &url) const;
+   qint64 getDownloadSize(const QString &url) const;
+   qint64 getMaxDownloadRate(const QString &url) const;
+
+   int getMaxConcurrentDownloads() const;
+   int getMaxHostConnections() const;
+   qint64 getMaxTotalDownloadRate() const;
+   bool getUseWorkerThread() const;
+   bool getUseDownloadCache() const;
+   QString getDownloadCacheDir() const;
+   qint64 getMaxDownloadCacheSize() const;
+   qint64 getPrefetchBudget() const;
+   bool getUseHttp2() const;
+   QString getTlsSessionCacheFile() const;
+   QString getAppcastCacheDir() const;
+
+   bool removeUpdater(const QString &url);
 
 public slots:
    void checkForUpdates(const QString &url);
+   void checkForUpdates(const QStringList &urls);
+   void startDownload(const QString &url);
    void setDownloadDir(const QString &url, const QString &dir);
    void setModuleName(const QString &url, const QString &name);
    void setNotifyOnUpdate(const QString &url, const bool notify);
@@ -97,12 +196,44 @@ public slots:
    void setUseCustomAppcast(const QString &url, const bool customAppcast);
    void setUseCustomInstallProcedures(const QString &url, const bool custom);
    void setMandatoryUpdate(const QString &url, const bool mandatory_update);
+   void setResumeDownloads(const QString &url, const bool resume);
+   void setDownloadSegments(const QString &url, const int segments);
+   void setMaxDownloadRate(const QString &url, const qint64 bytesPerSecond);
+   void setAdaptiveThrottling(const QString &url, const bool adaptive);
+   void setBackgroundDownload(const QString &url, const bool background);
+   void setPrefetchUpdates(const QString &url, const bool prefetch);
+   void setExtractArchives(const QString &url, const bool extract);
+   void setInstallDirectory(const QString &url, const QString &directory);
+
+   void setMaxConcurrentDownloads(const int downloads);
+   void setMaxHostConnections(const int connections);
+   void setMaxTotalDownloadRate(const qint64 bytesPerSecond);
+   void setUseWorkerThread(const bool enabled);
+   void setUseDownloadCache(const bool enabled);
+   void setDownloadCacheDir(const QString &dir);
+   void setMaxDownloadCacheSize(const qint64 bytes);
+   void setPrefetchBudget(const qint64 bytes);
+   void setUseHttp2(const bool enabled);
+   void setTlsSessionCacheFile(const QString &path);
+   void setAppcastCacheDir(const QString &dir);
+   void setNetworkAccessManager(QNetworkAccessManager *manager);
 
 protected:
+   QSimpleUpdater();
    ~QSimpleUpdater();
 
+private slots:
+   void onCheckingFinished(const QString &url);
+   void onUpdaterDestroyed(QObject *updater);
+   QObject *createUpdater(const QString &url);
+
 private:
-   Updater *getUpdater(const QString &url) const;
+   void finishBatches(Updater *updater);
+   void invoke(const QString &url, const char *member, QGenericArgument argument = QGenericArgument(0)) const;
+   QPointer<Updater> getUpdater(const QString &url) const;
+
+   template <typename T, typename Getter>
+   T read(const QString &url, Getter getter) const;
 };
 
 #endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QMutexLocker>
+#include <QCryptographicHash>
+
+#include "AppcastCatalog.h"
+
+AppcastCatalog::AppcastCatalog() {}
+
+AppcastCatalog::~AppcastCatalog() {}
+
+/**
+ * Returns the only instance of the class
+ */
+AppcastCatalog *AppcastCatalog::getInstance()
+{
+   static AppcastCatalog catalog;
+   return &catalog;
+}
+
+/**
+ * Registers a \a reader that wants to download the document at \a url.
+ * Returns \c false if nobody is downloading it yet (the \a reader must then
+ * download it and call \c release()), or \c true if another reader is
+ * downloading it already (the \a reader is then notified by that reader).
+ * 如果其他读取器正在下载同一文档，则等待其结果
+ */
+bool AppcastCatalog::join(const QString &url, QObject *reader)
+{
+   QMutexLocker locker(&m_mutex);
+   if (m_waiting.contains(url))
+   {
+      m_waiting[url].append(reader);
+      return true;
+   }
+
+   m_waiting.insert(url, QList<QPointer<QObject>>());
+   return false;
+}
+
+/**
+ * Called by the reader that downloaded the document at \a url, returns the
+ * readers that waited for it
+ */
+QList<QPointer<QObject>> AppcastCatalog::release(const QString &url)
+{
+   QMutexLocker locker(&m_mutex);
+   return m_waiting.take(url);
+}
+
+/**
+ * Finds the position of the appcast of the given \a module in the document
+ * \a data that was downloaded from \a url. The document is only indexed if
+ * it changed since the last lookup, the modules of catalogs are then indexed
+ * by their name (without parsing them). Returns \c false if the document is
+ * not valid or the catalog does not describe the \a module.
+ * 在共享的目录中查找模块的更新信息
+ */
+bool AppcastCatalog::lookup(const QString &url, const QByteArray &data, const QString &module,
+                            AppcastParser::Span *appcast)
+{
+   QByteArray digest = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+
+   QMutexLocker locker(&m_mutex);
+   if (!m_documents.contains(url) || m_documents.value(url).digest != digest)
+   {
+      Document document;
+      document.digest = digest;
+
+      AppcastParser::Span modules;
+      document.catalog = AppcastParser::findValue(data, AppcastParser::document(data), "modules", &modules)
+                         && AppcastParser::isObject(data, modules);
+      if (document.catalog && !AppcastParser::members(data, modules, &document.modules))
+      {
+         m_documents.remove(url);
+         return false;
+      }
+
+      m_documents.insert(url, document);
+   }
+
+   const Document &document = m_documents[url];
+   if (!document.catalog)
+   {
+      *appcast = AppcastParser::document(data);
+      return true;
+   }
+
+   if (!document.modules.contains(module))
+      return false;
+
+   *appcast = document.modules.value(module);
+   return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_APPCAST_CATALOG_H
+#define _QSIMPLEUPDATER_APPCAST_CATALOG_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QByteArray>
+
+#include "AppcastParser.h"
+
+/**
+ * \brief Appcasts shared by all the readers that point at the same URL
+ *
+ * A catalog is an appcast that describes many modules at once:
+ *
+ * \code
+ * { "modules": { "<module name>": { "updates": { "<platform>": { ... } } } } }
+ * \endcode
+ *
+ * Every module entry has the format of a regular appcast. The \c Updater
+ * instances of all the modules point at the catalog (with the module name in
+ * the URL fragment if it differs from \c moduleName()), and their readers
+ * share a single download: the first reader fetches the document while the
+ * others wait for it (\c join() and \c release()).
+ *
+ * Downloaded documents are indexed once per URL: the position of every
+ * module of a catalog is kept in a hash table, so every reader finds its
+ * module in constant time (\c lookup()) and only parses that part of the
+ * document. Regular appcasts are returned as a whole, whatever the module.
+ *
+ * The catalog is shared by all the \c Updater instances and may be used from
+ * several threads at once.
+ */
+class AppcastCatalog
+{
+public:
+   static AppcastCatalog *getInstance();
+
+   bool join(const QString &url, QObject *reader);
+   QList<QPointer<QObject>> release(const QString &url);
+   bool lookup(const QString &url, const QByteArray &data, const QString &module, AppcastParser::Span *appcast);
+
+private:
+   explicit AppcastCatalog();
+   ~AppcastCatalog();
+
+   struct Document
+   {
+      QByteArray digest;
+      bool catalog;
+      QHash<QString, AppcastParser::Span> modules;
+   };
+
+private:
+   QMutex m_mutex;
+   QHash<QString, Document> m_documents;
+   QHash<QString, QList<QPointer<QObject>>> m_waiting;
+};
+
+#endif
@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QCborStreamReader>
+
+#include "AppcastParser.h"
+
+/* Deepest nesting of objects and arrays that we accept */
+static const int MAX_DEPTH = 256;
+
+/* Optional tag that marks CBOR documents (self-described CBOR) */
+static const QByteArray CBOR_SIGNATURE("\xd9\xd9\xf7");
+
+static bool isSpace(const char c)
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+AppcastParser::AppcastParser()
+{
+   reset(0);
+}
+
+/**
+ * Prepares the parser for a new document of up to \a maxSize bytes. If
+ * \a checkStructure is \c false, the document is not expected to be JSON.
+ */
+void AppcastParser::reset(const qint64 maxSize, const bool checkStructure)
+{
+   m_maxSize = maxSize;
+   m_checkStructure = checkStructure;
+   m_data.clear();
+   m_stack.clear();
+   m_errorString.clear();
+
+   m_complete = false;
+   m_inString = false;
+   m_escape = false;
+}
+
+/**
+ * Appends the next block of the document. Returns \c false if the document
+ * is too large or malformed, in which case the rest of the download is
+ * useless.
+ * 逐块接收appcast并检查其结构和大小
+ */
+bool AppcastParser::addData(const QByteArray &data)
+{
+   if (!m_errorString.isEmpty())
+      return false;
+
+   if (m_data.size() + data.size() > m_maxSize)
+   {
+      m_errorString = "The appcast is too large";
+      return false;
+   }
+
+   /* CBOR appcasts are checked when they are read */
+   if (m_data.isEmpty() && isCbor(data))
+      m_checkStructure = false;
+
+   const char *input = data.constData();
+   for (int i = 0; m_checkStructure && i < data.size(); ++i)
+   {
+      const char c = input[i];
+
+      /* Strings may contain anything but unescaped quotes */
+      if (m_inString)
+      {
+         if (m_escape)
+            m_escape = false;
+         else if (c == '\\')
+            m_escape = true;
+         else if (c == '"')
+            m_inString = false;
+
+         continue;
+      }
+
+      if (isSpace(c))
+         continue;
+
+      /* The document is a single object or array */
+      if (m_complete || (m_stack.isEmpty() && c != '{' && c != '['))
+      {
+         m_errorString = "The appcast is not a valid JSON document";
+         return false;
+      }
+
+      if (c == '"')
+         m_inString = true;
+
+      else if (c == '{' || c == '[')
+      {
+         if (m_stack.size() >= MAX_DEPTH)
+         {
+            m_errorString = "The appcast is nested too deeply";
+            return false;
+         }
+
+         m_stack.append(c);
+      }
+
+      else if (c == '}' || c == ']')
+      {
+         if (m_stack.at(m_stack.size() - 1) != (c == '}' ? '{' : '['))
+         {
+            m_errorString = "The appcast is not a valid JSON document";
+            return false;
+         }
+
+         m_stack.chop(1);
+         m_complete = m_stack.isEmpty();
+      }
+   }
+
+   m_data.append(data);
+   return true;
+}
+
+/**
+ * Returns \c true once the whole document has been received (documents
+ * that are not checked are complete when the download is)
+ */
+bool AppcastParser::isComplete() const
+{
+   return (m_complete || !m_checkStructure) && m_errorString.isEmpty();
+}
+
+/**
+ * Returns the reason why the document was rejected
+ */
+QString AppcastParser::errorString() const
+{
+   return m_errorString;
+}
+
+/**
+ * Returns the document received so far
+ */
+QByteArray AppcastParser::data() const
+{
+   return m_data;
+}
+
+/**
+ * Returns \c true if the appcast \a data is encoded in CBOR, which is the
+ * case if it starts with a map or with the CBOR signature
+ */
+bool AppcastParser::isCbor(const QByteArray &data)
+{
+   if (data.isEmpty())
+      return false;
+
+   const uchar first = uchar(data.at(0));
+   return (first >= 0xa0 && first <= 0xbf) || data.startsWith(CBOR_SIGNATURE);
+}
+
+/**
+ * Returns the position of the root value of the appcast \a data
+ */
+AppcastParser::Span AppcastParser::document(const QByteArray &data)
+{
+   if (data.startsWith(CBOR_SIGNATURE))
+      return Span(CBOR_SIGNATURE.size(), data.size());
+
+   return Span(0, data.size());
+}
+
+/**
+ * Returns \c true if the \a value located in \a data is an object (a map in
+ * CBOR documents)
+ */
+bool AppcastParser::isObject(const QByteArray &data, const Span &value)
+{
+   const int end = qMin(value.second, data.size());
+   if (isCbor(data))
+      return value.first < end && (uchar(data.at(value.first)) & 0xe0) == 0xa0;
+
+   const int pos = skipSpace(data.constData(), value.first, end);
+   return pos < end && data.at(pos) == '{';
+}
+
+/**
+ * Parses the \a object located in \a data, which should be small
+ * 只解析所需的对象
+ */
+bool AppcastParser::toObject(const QByteArray &data, const Span &value, QJsonObject *object)
+{
+   if (!isObject(data, value))
+      return false;
+
+   const QByteArray bytes = data.mid(value.first, value.second - value.first);
+   if (isCbor(data))
+   {
+      QCborParserError error;
+      QCborValue cbor = QCborValue::fromCbor(bytes, &error);
+      if (error.error != QCborError::NoError || !cbor.isMap())
+         return false;
+
+      *object = cbor.toMap().toJsonObject();
+      return true;
+   }
+
+   QJsonDocument document = QJsonDocument::fromJson(bytes);
+   if (!document.isObject())
+      return false;
+
+   *object = document.object();
+   return true;
+}
+
+/**
+ * Finds the member \a key of the \a object located in \a data, and returns
+ * the position of its \a value. The other members are skipped without being
+ * parsed.
+ * 在对象中查找成员，跳过其他成员而不解析
+ */
+bool AppcastParser::findValue(const QByteArray &data, const Span &object, const QString &key, Span *value)
+{
+   if (isCbor(data))
+      return readCborMap(data, object, key, value, 0);
+
+   const char *input = data.constData();
+   const int end = qMin(object.second, data.size());
+   const QByteArray name = key.toUtf8();
+
+   int pos = skipSpace(input, object.first, end);
+   if (pos >= end || input[pos] != '{')
+      return false;
+
+   pos = skipSpace(input, pos + 1, end);
+
+   Span member;
+   Span current;
+   while (readMember(input, &pos, end, &member, &current))
+   {
+      /* Keys with escape sequences are rare, only decode those */
+      const char *raw = input + member.first + 1;
+      const int length = member.second - member.first - 2;
+      bool match;
+      if (memchr(raw, '\\', length))
+         match = decodeKey(input, member.first, member.second) == key;
+      else
+         match = length == name.size() && memcmp(raw, name.constData(), length) == 0;
+
+      if (match)
+      {
+         *value = current;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/**
+ * Indexes the \a members of the \a object located in \a data by their key.
+ * Returns \c false if the object is malformed.
+ */
+bool AppcastParser::members(const QByteArray &data, const Span &object, QHash<QString, Span> *members)
+{
+   if (isCbor(data))
+      return readCborMap(data, object, QString(), 0, members);
+
+   const char *input = data.constData();
+   const int end = qMin(object.second, data.size());
+
+   int pos = skipSpace(input, object.first, end);
+   if (pos >= end || input[pos] != '{')
+      return false;
+
+   pos = skipSpace(input, pos + 1, end);
+
+   Span key;
+   Span value;
+   while (readMember(input, &pos, end, &key, &value))
+      members->insert(decodeKey(input, key.first, key.second), value);
+
+   return pos >= 0;
+}
+
+/**
+ * Walks the CBOR map \a object located in \a data. If \a members is set,
+ * all the members are indexed, otherwise the walk stops at the member \a key
+ * and returns its \a value. The values are skipped without being decoded.
+ * 遍历CBOR映射而不解码其值
+ */
+bool AppcastParser::readCborMap(const QByteArray &data, const Span &object, const QString &key, Span *value,
+                                QHash<QString, Span> *members)
+{
+   const int end = qMin(object.second, data.size());
+   if (object.first < 0 || object.first >= end)
+      return false;
+
+   QCborStreamReader reader(data.constData() + object.first, end - object.first);
+   if (!reader.isMap() || !reader.enterContainer())
+      return false;
+
+   while (reader.lastError() == QCborError::NoError && reader.hasNext())
+   {
+      /* Appcasts only use text keys */
+      if (!reader.isString())
+         return false;
+
+      QString name;
+      QCborStreamReader::StringResult<QString> chunk = reader.readString();
+      while (chunk.status == QCborStreamReader::Ok)
+      {
+         name.append(chunk.data);
+         chunk = reader.readString();
+      }
+
+      if (chunk.status == QCborStreamReader::Error)
+         return false;
+
+      const int begin = object.first + int(reader.currentOffset());
+      if (!reader.next())
+         return false;
+
+      const Span current(begin, object.first + int(reader.currentOffset()));
+      if (members)
+         members->insert(name, current);
+
+      else if (name == key)
+      {
+         *value = current;
+         return true;
+      }
+   }
+
+   return members && reader.lastError() == QCborError::NoError;
+}
+
+/**
+ * Reads the member of an object that starts at \a pos, and moves \a pos to
+ * the next member. Returns \c false at the end of the object, and sets
+ * \a pos to -1 if the object is malformed.
+ */
+bool AppcastParser::readMember(const char *data, int *pos, const int end, Span *key, Span *value)
+{
+   if (*pos < 0 || *pos >= end || data[*pos] != '"')
+   {
+      if (*pos < 0 || *pos >= end || data[*pos] != '}')
+         *pos = -1;
+
+      return false;
+   }
+
+   int next = skipString(data, *pos, end);
+   if (next < 0)
+   {
+      *pos = -1;
+      return false;
+   }
+
+   *key = Span(*pos, next);
+
+   next = skipSpace(data, next, end);
+   if (next >= end || data[next] != ':')
+   {
+      *pos = -1;
+      return false;
+   }
+
+   next = skipSpace(data, next + 1, end);
+   const int valueEnd = skipValue(data, next, end);
+   if (valueEnd < 0)
+   {
+      *pos = -1;
+      return false;
+   }
+
+   *value = Span(next, valueEnd);
+
+   /* Move to the next member, or to the end of the object */
+   next = skipSpace(data, valueEnd, end);
+   if (next < end && data[next] == ',')
+      next = skipSpace(data, next + 1, end);
+   else if (next >= end || data[next] != '}')
+      next = -1;
+
+   *pos = next;
+   return true;
+}
+
+/**
+ * Returns the position of the first character after \a pos that is not a
+ * white space
+ */
+int AppcastParser::skipSpace(const char *data, int pos, const int end)
+{
+   while (pos < end && isSpace(data[pos]))
+      ++pos;
+
+   return pos;
+}
+
+/**
+ * Returns the position that follows the string that starts at \a pos, or -1
+ * if the string does not end
+ */
+int AppcastParser::skipString(const char *data, int pos, const int end)
+{
+   for (++pos; pos < end; ++pos)
+   {
+      if (data[pos] == '\\')
+         ++pos;
+      else if (data[pos] == '"')
+         return pos + 1;
+   }
+
+   return -1;
+}
+
+/**
+ * Returns the position that follows the value that starts at \a pos, or -1
+ * if the value does not end. Objects and arrays are skipped by counting
+ * brackets, their contents are not parsed.
+ */
+int AppcastParser::skipValue(const char *data, int pos, const int end)
+{
+   if (pos >= end)
+      return -1;
+
+   if (data[pos] == '"')
+      return skipString(data, pos, end);
+
+   if (data[pos] == '{' || data[pos] == '[')
+   {
+      int depth = 0;
+      while (pos < end)
+      {
+         const char c = data[pos];
+         if (c == '"')
+         {
+            pos = skipString(data, pos, end);
+            if (pos < 0)
+               return -1;
+
+            continue;
+         }
+
+         if (c == '{' || c == '[')
+            ++depth;
+
+         else if (c == '}' || c == ']')
+         {
+            if (--depth == 0)
+               return pos + 1;
+         }
+
+         ++pos;
+      }
+
+      return -1;
+   }
+
+   /* Numbers, booleans and null */
+   while (pos < end && !isSpace(data[pos]) && data[pos] != ',' && data[pos] != '}' && data[pos] != ']')
+      ++pos;
+
+   return pos;
+}
+
+/**
+ * Decodes the key located between \a begin and \a end (including quotes)
+ */
+QString AppcastParser::decodeKey(const char *data, const int begin, const int end)
+{
+   QByteArray raw = QByteArray::fromRawData(data + begin, end - begin);
+   if (!raw.contains('\\'))
+      return QString::fromUtf8(data + begin + 1, end - begin - 2);
+
+   QJsonDocument document = QJsonDocument::fromJson("[" + raw + "]");
+   return document.array().at(0).toString();
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_APPCAST_PARSER_H
+#define _QSIMPLEUPDATER_APPCAST_PARSER_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+
+/**
+ * \brief Receives appcasts as they are downloaded and locates values in them
+ *        without building a document
+ *
+ * Appcasts are JSON documents, or the CBOR encoding of the same schema
+ * (RFC 8949), which is smaller and faster to read on slow devices. The
+ * format is detected from the first byte of the document.
+ *
+ * The parser is fed with the (decompressed) appcast block by block with
+ * \c addData(). It checks the structure of the document as it streams in and
+ * gives up as soon as the document grows beyond the maximum size, so that a
+ * bad server cannot exhaust the memory of the client. Custom appcasts, which
+ * may use any format, and CBOR appcasts are only checked for their size.
+ *
+ * The static functions locate values in a complete document by skipping over
+ * everything else, without allocating memory: \c findValue() returns the
+ * position of the value of a member, and \c members() indexes the members of
+ * an object. CBOR documents are walked with a \c QCborStreamReader. Only the
+ * small subtree that is actually needed (the platform of the module) is then
+ * converted to a \c QJsonObject by \c toObject().
+ */
+class AppcastParser
+{
+public:
+   typedef QPair<int, int> Span;
+
+   AppcastParser();
+
+   void reset(const qint64 maxSize, const bool checkStructure = true);
+   bool addData(const QByteArray &data);
+
+   bool isComplete() const;
+   QString errorString() const;
+   QByteArray data() const;
+
+   static bool isCbor(const QByteArray &data);
+   static Span document(const QByteArray &data);
+   static bool isObject(const QByteArray &data, const Span &value);
+   static bool toObject(const QByteArray &data, const Span &value, QJsonObject *object);
+   static bool findValue(const QByteArray &data, const Span &object, const QString &key, Span *value);
+   static bool members(const QByteArray &data, const Span &object, QHash<QString, Span> *members);
+
+private:
+   static bool readCborMap(const QByteArray &data, const Span &object, const QString &key, Span *value,
+                           QHash<QString, Span> *members);
+   static bool readMember(const char *data, int *pos, const int end, Span *key, Span *value);
+   static int skipSpace(const char *data, int pos, const int end);
+   static int skipString(const char *data, int pos, const int end);
+   static int skipValue(const char *data, int pos, const int end);
+   static QString decodeKey(const char *data, const int begin, const int end);
+
+private:
+   qint64 m_maxSize;
+   QByteArray m_data;
+   QByteArray m_stack;
+   QString m_errorString;
+
+   bool m_checkStructure;
+   bool m_complete;
+   bool m_inString;
+   bool m_escape;
+};
+
+#endif
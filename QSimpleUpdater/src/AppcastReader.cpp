@@ -0,0 +1,559 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QDir>
+#include <QUrl>
+#include <QFile>
+#include <QMutex>
+#include <QSettings>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QNetworkAccessManager>
+
+#include "AppcastReader.h"
+#include "AppcastCatalog.h"
+#include "DownloadScheduler.h"
+
+/* Largest decompressed appcast that we accept */
+static const qint64 MAX_APPCAST_SIZE = 16 * 1024 * 1024;
+
+/* Suffixes of the cached appcasts and of their validators */
+static const QString CACHED_APPCAST(".appcast");
+static const QString CACHED_INFO(".info");
+
+/* Directory of the cached appcasts, shared by the readers of all threads */
+static QMutex CACHE_MUTEX;
+static bool CACHE_DIR_SET = false;
+static QString CACHE_DIR;
+
+UpdateInfo::UpdateInfo()
+{
+   valid = false;
+   downloadSize = 0;
+   patchSize = 0;
+   hasMandatoryUpdate = false;
+   mandatoryUpdate = false;
+}
+
+AppcastReader::AppcastReader(QNetworkAccessManager *manager, QObject *parent)
+   : QObject(parent)
+{
+   qRegisterMetaType<UpdateInfo>("UpdateInfo");
+
+   m_customAppcast = false;
+   m_background = false;
+   m_decoderReady = false;
+   m_manager = manager;
+}
+
+AppcastReader::~AppcastReader() {}
+
+/**
+ * Extracts the update information for the given \a platformKey from the
+ * appcast \a data (JSON or CBOR). The patch is only returned if it applies
+ * to the installed \a moduleVersion.
+ * 解析更新定义文件
+ */
+UpdateInfo AppcastReader::parse(const QByteArray &data, const QString &platformKey, const QString &moduleVersion)
+{
+   return parse(data, AppcastParser::document(data), platformKey, moduleVersion);
+}
+
+/**
+ * Extracts the update information for the given \a platformKey from the
+ * \a appcast located in \a data (a regular appcast, or a module entry of a
+ * catalog). Only the object of the platform is parsed, the other platforms
+ * are skipped.
+ * 只解析当前平台的更新信息，跳过其他平台
+ */
+UpdateInfo AppcastReader::parse(const QByteArray &data, const AppcastParser::Span &appcast, const QString &platformKey,
+                                const QString &moduleVersion)
+{
+   if (!AppcastParser::isObject(data, appcast))
+      return UpdateInfo();
+
+   /* Get the platform information  获取平台信息和更新信息 */
+   QJsonObject platform;
+   AppcastParser::Span updates;
+   AppcastParser::Span value;
+   if (AppcastParser::findValue(data, appcast, "updates", &updates)
+       && AppcastParser::findValue(data, updates, platformKey, &value))
+   {
+      /* Try to create a JSON object from the platform data (JSON or CBOR)
+       * 尝试从平台数据中创建一个 JSON 对象 */
+      if (!AppcastParser::toObject(data, value, &platform))
+         return UpdateInfo();
+   }
+
+   return readPlatform(platform, moduleVersion);
+}
+
+/**
+ * Reads the update information from the \a platform object of an appcast
+ */
+UpdateInfo AppcastReader::readPlatform(const QJsonObject &platform, const QString &moduleVersion)
+{
+   UpdateInfo info;
+
+   /* Get update information 从 JSON 文档中提取更新信息 */
+   info.valid = true;
+   info.openUrl = platform.value("open-url").toString();
+   info.changelog = platform.value("changelog").toString();
+   info.downloadUrl = platform.value("download-url").toString();
+   info.latestVersion = platform.value("latest-version").toString();
+   info.downloadChecksum = platform.value("sha256").toString();
+   info.downloadSize = qint64(platform.value("size").toDouble());
+   info.chunkManifestUrl = platform.value("chunk-manifest").toString();
+
+   /* Other servers that host the same file 提供相同文件的其他镜像 */
+   foreach (const QJsonValue &value, platform.value("mirrors").toArray())
+      info.mirrors.append(value.toString());
+
+   /* Look for a patch that applies to the installed version
+    * 查找适用于当前版本的增量补丁 */
+   foreach (const QJsonValue &value, platform.value("patches").toArray())
+   {
+      QJsonObject patch = value.toObject();
+      if (patch.value("from-version").toString() == moduleVersion)
+      {
+         info.patchUrl = patch.value("url").toString();
+         info.patchChecksum = patch.value("sha256").toString();
+         info.patchSize = qint64(patch.value("size").toDouble());
+         break;
+      }
+   }
+
+   //"mandatory-update"强制更新
+   info.hasMandatoryUpdate = platform.contains("mandatory-update");
+   info.mandatoryUpdate = platform.value("mandatory-update").toBool();
+   return info;
+}
+
+/**
+ * Returns the directory in which the appcasts and their validators are
+ * cached, or an empty string if the cache is disabled
+ */
+QString AppcastReader::cacheDirectory()
+{
+   QMutexLocker locker(&CACHE_MUTEX);
+   if (!CACHE_DIR_SET)
+   {
+      CACHE_DIR = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/appcasts";
+      CACHE_DIR_SET = true;
+   }
+
+   return CACHE_DIR;
+}
+
+/**
+ * Changes the directory in which the appcasts are cached, pass an empty
+ * \a path to download the whole appcast on every check
+ * 设置appcast缓存目录，为空则禁用缓存
+ */
+void AppcastReader::setCacheDirectory(const QString &path)
+{
+   QMutexLocker locker(&CACHE_MUTEX);
+   CACHE_DIR = path;
+   CACHE_DIR_SET = true;
+}
+
+/**
+ * Downloads and interprets the appcast at the given \a url, once the download
+ * scheduler allows it. The module of a catalog is named by the fragment of
+ * the \a url, or by \a moduleName if there is none. The other parameters
+ * are the settings of the \c Updater at the time of the check.
+ * 检查更新（由下载调度器控制并发）
+ */
+void AppcastReader::check(const QString &url, const QString &moduleName, const QString &platformKey,
+                          const QString &moduleVersion, const QString &userAgent, const bool customAppcast,
+                          const bool background)
+{
+   m_url = url;
+   m_module = QUrl(url).fragment();
+   if (m_module.isEmpty())
+      m_module = moduleName;
+
+   m_platformKey = platformKey;
+   m_moduleVersion = moduleVersion;
+   m_userAgentString = userAgent;
+   m_customAppcast = customAppcast;
+   m_background = background;
+   enqueue();
+}
+
+/**
+ * Waits for the reader that is downloading the same document, or for a slot
+ * of the download scheduler if there is none
+ */
+void AppcastReader::enqueue()
+{
+   if (!AppcastCatalog::getInstance()->join(fetchUrl(), this))
+      schedule();
+}
+
+/**
+ * Waits for a slot of the download scheduler
+ */
+void AppcastReader::schedule()
+{
+   DownloadScheduler::Priority priority = DownloadScheduler::Foreground;
+   if (m_background)
+      priority = DownloadScheduler::Background;
+
+   DownloadScheduler::getInstance()->enqueue(this, QUrl(fetchUrl()), priority, "sendRequest");
+}
+
+/**
+ * Returns the URL of the document to download, which is the current URL
+ * without the module fragment
+ */
+QString AppcastReader::fetchUrl() const
+{
+   return QUrl(m_url).adjusted(QUrl::RemoveFragment).toString();
+}
+
+/**
+ * Hands the result of a download to the readers that waited for the same
+ * document
+ */
+void AppcastReader::notifyWaiting(const QByteArray &data, const bool ok, const QString &redirect)
+{
+   foreach (const QPointer<QObject> &reader, AppcastCatalog::getInstance()->release(fetchUrl()))
+   {
+      if (reader)
+         QMetaObject::invokeMethod(reader, "onSharedReply", Qt::QueuedConnection, Q_ARG(QByteArray, data),
+                                   Q_ARG(bool, ok), Q_ARG(QString, redirect));
+   }
+}
+
+/**
+ * Sends the request for the update definitions file
+ * 发送更新定义文件的请求
+ */
+void AppcastReader::sendRequest()
+{
+   if (!DownloadScheduler::getInstance()->isActive(this))
+      return;
+
+   QNetworkRequest request(QUrl(fetchUrl()));
+   request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+
+   if (!m_userAgentString.isEmpty())
+      request.setRawHeader("User-Agent", m_userAgentString.toUtf8());
+
+   /* Compressed appcasts are decoded in onReply() 允许服务器压缩appcast */
+   request.setRawHeader("Accept-Encoding", StreamDecoder::acceptEncoding());
+
+   /* Let the server send the CBOR version of the appcast, if it has one
+    * 优先接收CBOR格式的appcast */
+   if (!m_customAppcast)
+      request.setRawHeader("Accept", "application/cbor, application/json;q=0.9, */*;q=0.8");
+
+   /* Only download the appcast if it changed since the cached copy
+    * 如果有缓存，只在appcast改变后才下载 */
+   if (!cachePath().isEmpty() && QFile::exists(cachePath() + CACHED_APPCAST))
+   {
+      QSettings info(cachePath() + CACHED_INFO, QSettings::IniFormat);
+      QByteArray etag = info.value("etag").toByteArray();
+      QByteArray lastModified = info.value("last-modified").toByteArray();
+      if (!etag.isEmpty())
+         request.setRawHeader("If-None-Match", etag);
+      if (!lastModified.isEmpty())
+         request.setRawHeader("If-Modified-Since", lastModified);
+   }
+
+   /* The appcast is checked as it is received 边接收边检查appcast */
+   m_decoderReady = false;
+   m_decoder.init(StreamDecoder::Identity);
+   m_parser.reset(MAX_APPCAST_SIZE, !m_customAppcast);
+
+   /* The manager is shared, only listen to our own reply */
+   QNetworkReply *reply = m_manager->get(request);
+   connect(reply, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+   connect(reply, SIGNAL(finished()), this, SLOT(onReply()));
+}
+
+/**
+ * Feeds the received part of the appcast to the parser, and stops the
+ * download if the appcast is too large or malformed
+ */
+void AppcastReader::onReadyRead()
+{
+   QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+   if (reply && !readReply(reply))
+      reply->abort();
+}
+
+/**
+ * Decompresses the data available in the \a reply (if the server compressed
+ * it, or if it was published compressed (.gz/.zst)) and hands it to the
+ * parser. Redirections and other responses without an appcast are ignored.
+ * 解压并检查已接收的appcast数据
+ */
+bool AppcastReader::readReply(QNetworkReply *reply)
+{
+   QVariant status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+   if (status.isValid() && status.toInt() != 200)
+      return true;
+
+   QByteArray data = reply->readAll();
+   if (data.isEmpty())
+      return true;
+
+   if (!m_decoderReady)
+   {
+      StreamDecoder::Format format = StreamDecoder::formatFromEncoding(reply->rawHeader("Content-Encoding"));
+      if (format == StreamDecoder::Identity)
+         format = StreamDecoder::formatFromData(data);
+
+      m_decoderReady = true;
+      if (!m_decoder.init(format))
+         return false;
+   }
+
+   /* Stop inflating once the appcast would exceed its size limit, a small
+    * compressed reply may expand to any size 解压后的大小不能超过上限 */
+   QByteArray decoded;
+   if (!m_decoder.decode(data, &decoded, qMax<qint64>(0, MAX_APPCAST_SIZE - m_parser.data().size())))
+      return false;
+
+   return m_parser.addData(decoded);
+}
+
+/**
+ * Called when the download of the update definitions file is finished.
+ * 在更新定义文件下载完成时调用，处理重定向、网络错误、解压和JSON解析
+ */
+void AppcastReader::onReply()
+{
+   QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+   if (!reply)
+      return;
+
+   reply->deleteLater();
+
+   /* Let the next transfer start 释放调度器槽位 */
+   DownloadScheduler::getInstance()->release(this);
+
+   /* Check if we need to redirect 检查是否需要重定向 */
+   QUrl redirect = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+   if (!redirect.isEmpty())
+   {
+      notifyWaiting(QByteArray(), false, redirect.toString());
+      redirect.setFragment(QUrl(m_url).fragment());
+      m_url = redirect.toString();
+      emit redirected(m_url);
+      enqueue();
+      return;
+   }
+
+   /* There was a network error 处理网络错误 */
+   if (reply->error() != QNetworkReply::NoError)
+   {
+      notifyWaiting(QByteArray(), false);
+      emit finished(UpdateInfo());
+      return;
+   }
+
+   /* The appcast did not change, use the cached copy 使用缓存的appcast */
+   if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+   {
+      QByteArray cached = cachedAppcast();
+      if (cached.isNull())
+      {
+         removeAppcast();
+         schedule();
+         return;
+      }
+
+      notifyWaiting(cached, true);
+      handleData(cached);
+      return;
+   }
+
+   /* Read what is left of the appcast, it must be complete
+    * 读取剩余数据，appcast必须完整 */
+   if (!readReply(reply) || !m_decoder.isFinished() || !m_parser.isComplete())
+   {
+      notifyWaiting(QByteArray(), false);
+      emit finished(UpdateInfo());
+      return;
+   }
+
+   QByteArray data = m_parser.data();
+   m_parser.reset(MAX_APPCAST_SIZE);
+
+   storeAppcast(data, reply);
+   notifyWaiting(data, true);
+   handleData(data);
+}
+
+/**
+ * Called when the reader that downloaded the same document is done with it.
+ * If the document moved, this reader follows the \a redirect (and most
+ * likely waits for that reader again).
+ * 使用其他读取器下载的同一文档
+ */
+void AppcastReader::onSharedReply(const QByteArray &data, const bool ok, const QString &redirect)
+{
+   if (!redirect.isEmpty())
+   {
+      QUrl target(redirect);
+      target.setFragment(QUrl(m_url).fragment());
+      m_url = target.toString();
+      emit redirected(m_url);
+      enqueue();
+      return;
+   }
+
+   if (!ok)
+   {
+      emit finished(UpdateInfo());
+      return;
+   }
+
+   handleData(data);
+}
+
+/**
+ * Hands the (decompressed) appcast \a data to the \c Updater. The result of
+ * the previous parse is reused if neither the appcast nor the settings of the
+ * check changed.
+ */
+void AppcastReader::handleData(const QByteArray &data)
+{
+   /* The application wants to interpret the appcast by itself */
+   if (m_customAppcast)
+   {
+      emit appcastDownloaded(data);
+      return;
+   }
+
+   QByteArray digest = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+   QString key = m_module + "\n" + m_platformKey + "\n" + m_moduleVersion + "\n" + digest.toHex();
+   if (key != m_parsedKey)
+   {
+      /* Regular appcasts are returned as they are, catalogs are indexed
+       * 在共享目录中查找本模块 */
+      AppcastParser::Span appcast;
+      if (AppcastCatalog::getInstance()->lookup(fetchUrl(), data, m_module, &appcast))
+         m_parsedInfo = parse(data, appcast, m_platformKey, m_moduleVersion);
+      else
+         m_parsedInfo = UpdateInfo();
+
+      m_parsedKey = key;
+   }
+
+   emit finished(m_parsedInfo);
+}
+
+/**
+ * Returns the path (without suffix) of the cached appcast of the current URL,
+ * or an empty string if the cache is disabled
+ */
+QString AppcastReader::cachePath() const
+{
+   QString directory = cacheDirectory();
+   if (directory.isEmpty())
+      return QString();
+
+   QByteArray name = QCryptographicHash::hash(fetchUrl().toUtf8(), QCryptographicHash::Sha1).toHex();
+   return directory + "/" + QString::fromLatin1(name);
+}
+
+/**
+ * Returns the cached appcast of the current URL, or a null byte array if
+ * there is none
+ */
+QByteArray AppcastReader::cachedAppcast() const
+{
+   if (cachePath().isEmpty())
+      return QByteArray();
+
+   QFile file(cachePath() + CACHED_APPCAST);
+   if (!file.open(QFile::ReadOnly))
+      return QByteArray();
+
+   QByteArray data = file.readAll();
+   if (data.isNull())
+      data = QByteArray("");
+
+   return data;
+}
+
+/**
+ * Caches the appcast \a data with the validators of the \a reply. Appcasts
+ * without validators cannot be revalidated, so they are not cached.
+ * 缓存appcast及其ETag和Last-Modified
+ */
+void AppcastReader::storeAppcast(const QByteArray &data, const QNetworkReply *reply)
+{
+   QByteArray etag = reply->rawHeader("ETag");
+   QByteArray lastModified = reply->rawHeader("Last-Modified");
+   if (cachePath().isEmpty() || (etag.isEmpty() && lastModified.isEmpty()))
+   {
+      removeAppcast();
+      return;
+   }
+
+   /* Write the appcast before its validators, so that they never describe
+    * another version of the file */
+   QDir().mkpath(cacheDirectory());
+   QFile::remove(cachePath() + CACHED_INFO);
+
+   QFile file(cachePath() + CACHED_APPCAST);
+   if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(data) != data.size())
+   {
+      file.close();
+      removeAppcast();
+      return;
+   }
+
+   file.close();
+
+   QSettings info(cachePath() + CACHED_INFO, QSettings::IniFormat);
+   info.setValue("url", fetchUrl());
+   info.setValue("etag", etag);
+   info.setValue("last-modified", lastModified);
+   info.sync();
+}
+
+/**
+ * Removes the cached appcast of the current URL
+ */
+void AppcastReader::removeAppcast()
+{
+   if (cachePath().isEmpty())
+      return;
+
+   QFile::remove(cachePath() + CACHED_INFO);
+   QFile::remove(cachePath() + CACHED_APPCAST);
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_AppcastReader.cpp"
+#endif
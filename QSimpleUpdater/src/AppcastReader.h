@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_APPCAST_READER_H
+#define _QSIMPLEUPDATER_APPCAST_READER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMetaType>
+#include <QByteArray>
+#include <QJsonObject>
+
+#include "AppcastParser.h"
+#include "StreamDecoder.h"
+
+class QNetworkReply;
+class QNetworkAccessManager;
+
+/**
+ * \brief Update information read from an appcast
+ */
+struct UpdateInfo
+{
+   UpdateInfo();
+
+   bool valid;
+   QString openUrl;
+   QString changelog;
+   QString downloadUrl;
+   QStringList mirrors;
+   QString latestVersion;
+   QString downloadChecksum;
+   qint64 downloadSize;
+   QString patchUrl;
+   QString patchChecksum;
+   qint64 patchSize;
+   QString chunkManifestUrl;
+   bool hasMandatoryUpdate;
+   bool mandatoryUpdate;
+};
+
+Q_DECLARE_METATYPE(UpdateInfo)
+
+/**
+ * \brief Downloads, decompresses and parses the appcast of an \c Updater
+ *
+ * The reader uses the network manager shared by its thread (see
+ * \c NetworkManager), so it can be moved to the worker thread together with
+ * the \c DownloadTask of the updater. The appcast is decompressed and checked
+ * by an \c AppcastParser as it is received, and only the platform of the
+ * module is parsed from it. The parsed
+ * information is handed back with the \c finished() signal; custom appcasts
+ * are handed back as they are with \c appcastDownloaded().
+ *
+ * Every appcast is stored in the cache directory (see \c cacheDirectory())
+ * with its \c ETag and \c Last-Modified headers. The next check sends them
+ * as \c If-None-Match and \c If-Modified-Since, and if the server answers
+ * \c 304 Not Modified, the stored appcast is used (or the result of the
+ * previous parse, if the platform and version did not change either).
+ *
+ * Readers that point at the same URL share the download and the parsed
+ * document (see \c AppcastCatalog). If the appcast is a catalog, the reader
+ * picks the module named in the URL fragment (\c catalog.json#module), or
+ * the module name of the updater.
+ */
+class AppcastReader : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void redirected(const QString &url);
+   void finished(const UpdateInfo &info);
+   void appcastDownloaded(const QByteArray &data);
+
+public:
+   explicit AppcastReader(QNetworkAccessManager *manager, QObject *parent = 0);
+   ~AppcastReader();
+
+   static UpdateInfo parse(const QByteArray &data, const QString &platformKey, const QString &moduleVersion);
+   static UpdateInfo parse(const QByteArray &data, const AppcastParser::Span &appcast, const QString &platformKey,
+                           const QString &moduleVersion);
+
+   static QString cacheDirectory();
+   static void setCacheDirectory(const QString &path);
+
+public slots:
+   void check(const QString &url, const QString &moduleName, const QString &platformKey,
+              const QString &moduleVersion, const QString &userAgent, const bool customAppcast,
+              const bool background);
+
+private slots:
+   void sendRequest();
+   void onReply();
+   void onReadyRead();
+   void onSharedReply(const QByteArray &data, const bool ok, const QString &redirect);
+
+private:
+   void enqueue();
+   void schedule();
+   bool readReply(QNetworkReply *reply);
+   static UpdateInfo readPlatform(const QJsonObject &platform, const QString &moduleVersion);
+   QString fetchUrl() const;
+   void notifyWaiting(const QByteArray &data, const bool ok, const QString &redirect = QString());
+   void handleData(const QByteArray &data);
+   QString cachePath() const;
+   QByteArray cachedAppcast() const;
+   void storeAppcast(const QByteArray &data, const QNetworkReply *reply);
+   void removeAppcast();
+
+private:
+   QString m_url;
+   QString m_module;
+   QString m_platformKey;
+   QString m_moduleVersion;
+   QString m_userAgentString;
+   bool m_customAppcast;
+   bool m_background;
+
+   QString m_parsedKey;
+   UpdateInfo m_parsedInfo;
+
+   bool m_decoderReady;
+   StreamDecoder m_decoder;
+   AppcastParser m_parser;
+
+   QNetworkAccessManager *m_manager;
+};
+
+#endif
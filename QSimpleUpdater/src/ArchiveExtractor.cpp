@@ -0,0 +1,936 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <zlib.h>
+#include <string.h>
+
+#include <QDir>
+#include <QtEndian>
+#include <QFileInfo>
+#include <QStringList>
+
+#include "StreamDecoder.h"
+#include "ArchiveExtractor.h"
+
+/* Size of the headers and of the data blocks of tar archives */
+static const qint64 TAR_BLOCK = 512;
+
+/* Largest tar metadata entry (long names, pax headers) that we accept */
+static const qint64 MAX_META_SIZE = 1024 * 1024;
+
+/* Size of the blocks produced by the decompressor */
+static const int INFLATE_BLOCK_SIZE = 256 * 1024;
+
+/* Signatures of the zip records */
+static const quint32 ZIP_LOCAL_HEADER = 0x04034b50;
+static const quint32 ZIP_CENTRAL_HEADER = 0x02014b50;
+static const quint32 ZIP_DESCRIPTOR = 0x08074b50;
+static const quint32 ZIP_END_OF_CENTRAL = 0x06054b50;
+static const quint32 ZIP64_END_OF_CENTRAL = 0x06064b50;
+static const quint32 ZIP64_LOCATOR = 0x07064b50;
+static const quint32 ZIP_SIGNATURE = 0x05054b50;
+
+/* Zip flags */
+static const int ZIP_ENCRYPTED = 0x0001;
+static const int ZIP_HAS_DESCRIPTOR = 0x0008;
+
+/**
+ * State of the zlib decompressor, kept out of the header so that the zlib
+ * header is only needed here
+ */
+struct ArchiveExtractor::State
+{
+   z_stream zlib;
+   bool zlibReady;
+};
+
+/**
+ * Returns the string stored in a fixed size (and maybe not terminated) field
+ */
+static QString fieldString(const uchar *field, const int length)
+{
+   return QString::fromUtf8(reinterpret_cast<const char *>(field), int(qstrnlen((const char *)field, length)));
+}
+
+/**
+ * Parses a numeric field of a tar header (octal, or base-256 for large
+ * values), returns \c -1 if it is not valid
+ */
+static qint64 parseTarNumber(const uchar *field, const int length)
+{
+   if (field[0] & 0x80)
+   {
+      qint64 value = field[0] & 0x7f;
+      for (int i = 1; i < length; ++i)
+         value = (value << 8) | field[i];
+
+      return value;
+   }
+
+   int i = 0;
+   while (i < length && field[i] == ' ')
+      ++i;
+
+   qint64 value = 0;
+   for (; i < length && field[i] != 0 && field[i] != ' '; ++i)
+   {
+      if (field[i] < '0' || field[i] > '7')
+         return -1;
+
+      value = value * 8 + (field[i] - '0');
+   }
+
+   return value;
+}
+
+/**
+ * Converts Unix permission bits to Qt permissions. The owner can always read
+ * and write the extracted files, so that they can be replaced later.
+ */
+static QFile::Permissions permissionsFromMode(const int mode)
+{
+   QFile::Permissions permissions = QFile::ReadOwner | QFile::ReadUser | QFile::WriteOwner | QFile::WriteUser;
+   if (mode & 0100)
+      permissions |= QFile::ExeOwner | QFile::ExeUser;
+   if (mode & 0040)
+      permissions |= QFile::ReadGroup;
+   if (mode & 0020)
+      permissions |= QFile::WriteGroup;
+   if (mode & 0010)
+      permissions |= QFile::ExeGroup;
+   if (mode & 0004)
+      permissions |= QFile::ReadOther;
+   if (mode & 0002)
+      permissions |= QFile::WriteOther;
+   if (mode & 0001)
+      permissions |= QFile::ExeOther;
+
+   return permissions;
+}
+
+ArchiveExtractor::ArchiveExtractor()
+{
+   m_format = None;
+   m_step = End;
+   m_offset = 0;
+   m_type = 0;
+   m_mode = 0;
+   m_remaining = 0;
+   m_padding = 0;
+   m_paxSize = -1;
+   m_method = 0;
+   m_flags = 0;
+   m_zip64 = false;
+   m_crc = 0;
+   m_expectedCrc = 0;
+
+   m_state = new State;
+   m_state->zlibReady = false;
+}
+
+ArchiveExtractor::~ArchiveExtractor()
+{
+   abort();
+   delete m_state;
+}
+
+/**
+ * Returns the format of the archive that is being extracted, or \c None if
+ * there is no extraction in progress
+ */
+ArchiveExtractor::Format ArchiveExtractor::format() const
+{
+   return m_format;
+}
+
+/**
+ * Returns \c true once the end of the archive has been reached
+ */
+bool ArchiveExtractor::isFinished() const
+{
+   return m_step == End;
+}
+
+/**
+ * Returns the directory into which the archive is extracted
+ */
+QString ArchiveExtractor::directory() const
+{
+   return m_directory;
+}
+
+/**
+ * Returns a description of the last error
+ */
+QString ArchiveExtractor::errorString() const
+{
+   return m_errorString;
+}
+
+/**
+ * Prepares the extraction of an archive of the given \a format into
+ * \a directory, which is emptied first
+ * 准备解压归档文件到指定目录（先清空目录）
+ */
+bool ArchiveExtractor::open(const Format format, const QString &directory)
+{
+   abort();
+   m_errorString.clear();
+
+   if (format == None)
+   {
+      m_errorString = "Unsupported archive format";
+      return false;
+   }
+
+   m_directory = QDir::cleanPath(QDir(directory).absolutePath());
+   QDir(m_directory).removeRecursively();
+   if (!QDir().mkpath(m_directory))
+   {
+      m_errorString = "Unable to create " + m_directory;
+      return false;
+   }
+
+   m_format = format;
+   m_step = Header;
+   m_longName.clear();
+   m_longLink.clear();
+   m_paxPath.clear();
+   m_paxLink.clear();
+   m_paxSize = -1;
+   return true;
+}
+
+/**
+ * Extracts the entries contained in the next \a size bytes of the archive.
+ * Entries that are split between two calls are continued on the next call.
+ * 解压归档文件的下一段数据
+ *
+ * Returns \c false if the archive is not valid or a file cannot be written,
+ * the extracted files are then removed.
+ */
+bool ArchiveExtractor::write(const char *data, const qint64 size)
+{
+   if (m_format == None)
+      return false;
+
+   /* Anything after the end of the archive is ignored */
+   if (m_step == End)
+      return true;
+
+   m_buffer.append(data, int(size));
+
+   bool progress = true;
+   while (progress && m_step != End)
+   {
+      progress = false;
+      if (!process(&progress))
+         return false;
+   }
+
+   m_buffer.remove(0, int(m_offset));
+   m_offset = 0;
+   return true;
+}
+
+/**
+ * Completes the extraction, returns \c false (and removes the extracted
+ * files) if the archive was truncated
+ */
+bool ArchiveExtractor::finish()
+{
+   if (m_format == None)
+      return false;
+
+   /* Some tools do not write the empty blocks at the end of tar archives */
+   bool complete = m_step == End || (m_format == Tar && m_step == Header && available() == 0);
+   if (!complete)
+      return fail("The archive is truncated");
+
+   m_format = None;
+   m_step = End;
+   m_buffer.clear();
+   m_offset = 0;
+   return true;
+}
+
+/**
+ * Stops the extraction and removes the extracted files, unless the
+ * extraction was completed with \c finish()
+ */
+void ArchiveExtractor::abort()
+{
+   if (m_file.isOpen())
+      m_file.close();
+
+   if (m_state->zlibReady)
+   {
+      inflateEnd(&m_state->zlib);
+      m_state->zlibReady = false;
+   }
+
+   if (m_format != None && !m_directory.isEmpty())
+      QDir(m_directory).removeRecursively();
+
+   m_format = None;
+   m_step = End;
+   m_buffer.clear();
+   m_offset = 0;
+   m_meta.clear();
+}
+
+/**
+ * Returns the format of an archive based on its file name (compression
+ * suffixes are ignored, since the data is decompressed before it is
+ * extracted)
+ */
+ArchiveExtractor::Format ArchiveExtractor::formatFromName(const QString &fileName)
+{
+   QString name = StreamDecoder::stripSuffix(fileName);
+   if (name.endsWith(".tar", Qt::CaseInsensitive))
+      return Tar;
+
+   if (name.endsWith(".zip", Qt::CaseInsensitive))
+      return Zip;
+
+   return None;
+}
+
+/**
+ * Returns the name of the directory that receives the contents of the
+ * archive with the given \a fileName (e.g. \c app-1.2 for \c app-1.2.tar.zst)
+ */
+QString ArchiveExtractor::directoryName(const QString &fileName)
+{
+   QString name = StreamDecoder::stripSuffix(fileName);
+   if (formatFromName(name) != None)
+      name.chop(4);
+
+   return name;
+}
+
+/**
+ * Runs the current step of the extraction, \a progress is set to \c true if
+ * it consumed data or moved on to another step
+ */
+bool ArchiveExtractor::process(bool *progress)
+{
+   if (m_step == Header)
+      return m_format == Tar ? readTarHeader(progress) : readZipHeader(progress);
+
+   if (m_step == Data)
+      return m_format == Zip && m_method == Z_DEFLATED ? inflateData(progress) : readData(progress);
+
+   if (m_step == Descriptor)
+      return readZipDescriptor(progress);
+
+   if (m_step == Padding)
+   {
+      qint64 size = qMin(available(), m_padding);
+      consume(size);
+      m_padding -= size;
+      if (m_padding == 0)
+         m_step = Header;
+
+      *progress = size > 0 || m_padding == 0;
+   }
+
+   return true;
+}
+
+/**
+ * Reads the header of the next entry of a tar archive
+ */
+bool ArchiveExtractor::readTarHeader(bool *progress)
+{
+   if (available() < TAR_BLOCK)
+      return true;
+
+   const uchar *header = peek();
+   *progress = true;
+
+   /* The archive ends with empty blocks */
+   bool empty = true;
+   for (int i = 0; i < TAR_BLOCK && empty; ++i)
+      empty = header[i] == 0;
+
+   if (empty)
+   {
+      consume(TAR_BLOCK);
+      m_step = End;
+      return true;
+   }
+
+   /* Make sure that this is a tar header (the checksum field counts as
+    * spaces) */
+   qint64 sum = 0;
+   for (int i = 0; i < TAR_BLOCK; ++i)
+      sum += (i >= 148 && i < 156) ? ' ' : header[i];
+
+   qint64 size = parseTarNumber(header + 124, 12);
+   if (parseTarNumber(header + 148, 8) != sum || size < 0)
+      return fail("Invalid tar header");
+
+   char type = char(header[156]);
+   int mode = int(parseTarNumber(header + 100, 8));
+   QString name = fieldString(header, 100);
+   QString target = fieldString(header + 157, 100);
+   QString prefix = fieldString(header + 345, 155);
+   if (memcmp(header + 257, "ustar", 5) == 0 && !prefix.isEmpty())
+      name = prefix + "/" + name;
+
+   consume(TAR_BLOCK);
+
+   /* Extended headers describe the next entry */
+   bool meta = type == 'L' || type == 'K' || type == 'x' || type == 'g';
+   if (meta && size > MAX_META_SIZE)
+      return fail("Invalid tar header");
+
+   if (!meta)
+   {
+      if (!m_longName.isEmpty())
+         name = m_longName;
+      if (!m_paxPath.isEmpty())
+         name = m_paxPath;
+      if (!m_longLink.isEmpty())
+         target = m_longLink;
+      if (!m_paxLink.isEmpty())
+         target = m_paxLink;
+      if (m_paxSize >= 0)
+         size = m_paxSize;
+
+      m_longName.clear();
+      m_longLink.clear();
+      m_paxPath.clear();
+      m_paxLink.clear();
+      m_paxSize = -1;
+   }
+
+   m_type = type;
+   m_mode = mode;
+   m_remaining = size;
+   m_padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+   m_meta.clear();
+   m_step = Data;
+
+   return meta || beginEntry(name, type, target);
+}
+
+/**
+ * Reads the next record of a zip archive: the local header of an entry, or
+ * the central directory at the end of the archive
+ */
+bool ArchiveExtractor::readZipHeader(bool *progress)
+{
+   if (available() < 4)
+      return true;
+
+   quint32 signature = qFromLittleEndian<quint32>(peek());
+   if (signature == ZIP_CENTRAL_HEADER)
+      return readZipCentralEntry(progress);
+
+   /* Nothing that follows the central directory interests us */
+   if (signature == ZIP_END_OF_CENTRAL || signature == ZIP64_END_OF_CENTRAL || signature == ZIP64_LOCATOR
+       || signature == ZIP_SIGNATURE)
+   {
+      m_step = End;
+      *progress = true;
+      return true;
+   }
+
+   if (signature != ZIP_LOCAL_HEADER)
+      return fail("Invalid zip header");
+
+   if (available() < 30)
+      return true;
+
+   const uchar *header = peek();
+   int nameLength = qFromLittleEndian<quint16>(header + 26);
+   int extraLength = qFromLittleEndian<quint16>(header + 28);
+   if (available() < 30 + nameLength + extraLength)
+      return true;
+
+   m_flags = qFromLittleEndian<quint16>(header + 6);
+   m_method = qFromLittleEndian<quint16>(header + 8);
+   m_expectedCrc = qFromLittleEndian<quint32>(header + 14);
+   qint64 compressed = qFromLittleEndian<quint32>(header + 18);
+   qint64 size = qFromLittleEndian<quint32>(header + 22);
+   QString name = QString::fromUtf8(reinterpret_cast<const char *>(header) + 30, nameLength);
+
+   /* Sizes that do not fit in 32 bits are stored in the zip64 extra field */
+   m_zip64 = false;
+   const uchar *extra = header + 30 + nameLength;
+   int position = 0;
+   while (position + 4 <= extraLength)
+   {
+      int id = qFromLittleEndian<quint16>(extra + position);
+      int length = qFromLittleEndian<quint16>(extra + position + 2);
+      if (position + 4 + length > extraLength)
+         break;
+
+      if (id == 0x0001)
+      {
+         const uchar *field = extra + position + 4;
+         int offset = 0;
+         m_zip64 = true;
+         if (size == 0xffffffff && offset + 8 <= length)
+         {
+            size = qFromLittleEndian<quint64>(field + offset);
+            offset += 8;
+         }
+
+         if (compressed == 0xffffffff && offset + 8 <= length)
+            compressed = qFromLittleEndian<quint64>(field + offset);
+      }
+
+      position += 4 + length;
+   }
+
+   consume(30 + nameLength + extraLength);
+   *progress = true;
+
+   if (m_flags & ZIP_ENCRYPTED)
+      return fail("Encrypted archives are not supported");
+
+   if (m_method != 0 && m_method != Z_DEFLATED)
+      return fail("Unsupported compression method in " + name);
+
+   /* The end of stored data is only known from the header */
+   if (m_method == 0 && (m_flags & ZIP_HAS_DESCRIPTOR))
+      return fail("Unsupported zip entry " + name);
+
+   if (m_method == Z_DEFLATED)
+   {
+      memset(&m_state->zlib, 0, sizeof(z_stream));
+      if (inflateInit2(&m_state->zlib, -MAX_WBITS) != Z_OK)
+         return fail("Unable to initialize the decompressor");
+
+      m_state->zlibReady = true;
+   }
+
+   m_crc = crc32(0L, Z_NULL, 0);
+   m_remaining = compressed;
+   m_type = name.endsWith('/') ? '5' : '0';
+   m_mode = 0;
+   m_step = Data;
+   return beginEntry(name, m_type, QString());
+}
+
+/**
+ * Reads an entry of the central directory of a zip archive and applies the
+ * Unix permissions (and symbolic links) that only the central directory
+ * stores
+ */
+bool ArchiveExtractor::readZipCentralEntry(bool *progress)
+{
+   if (available() < 46)
+      return true;
+
+   const uchar *header = peek();
+   int nameLength = qFromLittleEndian<quint16>(header + 28);
+   int extraLength = qFromLittleEndian<quint16>(header + 30);
+   int commentLength = qFromLittleEndian<quint16>(header + 32);
+   if (available() < 46 + nameLength + extraLength + commentLength)
+      return true;
+
+   int system = qFromLittleEndian<quint16>(header + 4) >> 8;
+   int mode = int(qFromLittleEndian<quint32>(header + 38) >> 16);
+   QString name = QString::fromUtf8(reinterpret_cast<const char *>(header) + 46, nameLength);
+
+   consume(46 + nameLength + extraLength + commentLength);
+   *progress = true;
+
+   /* Only archives created on Unix store permissions */
+   if (system != 3 || mode == 0 || name.endsWith('/'))
+      return true;
+
+   QString path = entryPath(name);
+   if (path.isEmpty() || path == m_directory)
+      return true;
+
+   /* Symbolic links are stored as files that contain the target */
+   if ((mode & 0170000) == 0120000)
+   {
+      QFile file(path);
+      if (!file.open(QFile::ReadOnly))
+         return true;
+
+      QString target = QString::fromUtf8(file.read(4096));
+      file.close();
+      return createLink(path, target);
+   }
+
+   QFile::setPermissions(path, permissionsFromMode(mode));
+   return true;
+}
+
+/**
+ * Reads the data descriptor that follows a zip entry whose sizes were not
+ * known when its header was written
+ */
+bool ArchiveExtractor::readZipDescriptor(bool *progress)
+{
+   if (available() < 4)
+      return true;
+
+   /* The signature of the descriptor is optional */
+   int skip = qFromLittleEndian<quint32>(peek()) == ZIP_DESCRIPTOR ? 4 : 0;
+   int length = skip + 4 + (m_zip64 ? 16 : 8);
+   if (available() < length)
+      return true;
+
+   m_expectedCrc = qFromLittleEndian<quint32>(peek() + skip);
+   consume(length);
+   *progress = true;
+
+   if (m_crc != m_expectedCrc)
+      return fail("CRC error in the archive");
+
+   m_step = Header;
+   return true;
+}
+
+/**
+ * Copies the data of a tar entry or a stored zip entry to its file
+ */
+bool ArchiveExtractor::readData(bool *progress)
+{
+   qint64 size = qMin(available(), m_remaining);
+   if (size > 0)
+   {
+      if (!writeEntry(reinterpret_cast<const char *>(peek()), size))
+         return false;
+
+      consume(size);
+      m_remaining -= size;
+      *progress = true;
+   }
+
+   if (m_remaining > 0)
+      return true;
+
+   *progress = true;
+   if (!endEntry())
+      return false;
+
+   if (m_format == Tar)
+   {
+      m_step = Padding;
+      return true;
+   }
+
+   if (m_crc != m_expectedCrc)
+      return fail("CRC error in the archive");
+
+   m_step = Header;
+   return true;
+}
+
+/**
+ * Decompresses the data of a deflated zip entry into its file, the end of
+ * the entry is found by the decompressor
+ */
+bool ArchiveExtractor::inflateData(bool *progress)
+{
+   z_stream &zlib = m_state->zlib;
+   qint64 before = available();
+   zlib.next_in = const_cast<Bytef *>(peek());
+   zlib.avail_in = uInt(before);
+
+   /* Keep going while the output block is filled, the decompressor may
+    * still hold data even if all the input has been consumed */
+   int result = Z_OK;
+   QByteArray output(INFLATE_BLOCK_SIZE, Qt::Uninitialized);
+   do
+   {
+      zlib.next_out = reinterpret_cast<Bytef *>(output.data());
+      zlib.avail_out = INFLATE_BLOCK_SIZE;
+      result = inflate(&zlib, Z_NO_FLUSH);
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+         return fail("Invalid compressed data in the archive");
+
+      qint64 produced = INFLATE_BLOCK_SIZE - zlib.avail_out;
+      if (produced > 0 && !writeEntry(output.constData(), produced))
+         return false;
+   } while (result == Z_OK && zlib.avail_out == 0);
+
+   qint64 used = before - zlib.avail_in;
+   consume(used);
+   *progress = used > 0;
+
+   if (result != Z_STREAM_END)
+      return true;
+
+   inflateEnd(&zlib);
+   m_state->zlibReady = false;
+   *progress = true;
+
+   if (!endEntry())
+      return false;
+
+   if (m_flags & ZIP_HAS_DESCRIPTOR)
+   {
+      m_step = Descriptor;
+      return true;
+   }
+
+   if (m_crc != m_expectedCrc)
+      return fail("CRC error in the archive");
+
+   m_step = Header;
+   return true;
+}
+
+/**
+ * Creates the directory, file or link of the entry \a name. Entries of other
+ * types (devices, FIFOs) are skipped.
+ */
+bool ArchiveExtractor::beginEntry(const QString &name, const char type, const QString &target)
+{
+   QString path = entryPath(name);
+   if (path.isEmpty())
+      return fail("Unsafe path in the archive: " + name);
+
+   if (type == '5')
+   {
+      if (!QDir().mkpath(path))
+         return fail("Unable to create " + path);
+
+      return true;
+   }
+
+   if (path == m_directory)
+      return true;
+
+   if (!QDir().mkpath(QFileInfo(path).absolutePath()))
+      return fail("Unable to create " + QFileInfo(path).absolutePath());
+
+   if (type == '2')
+      return createLink(path, target);
+
+   /* Hard links refer to an entry that was extracted before */
+   if (type == '1')
+   {
+      QString source = entryPath(target);
+      if (source.isEmpty())
+         return fail("Unsafe path in the archive: " + target);
+
+      QFile::remove(path);
+      if (!QFile::copy(source, path))
+         return fail("Unable to create " + path);
+
+      return true;
+   }
+
+   if (type != '0' && type != '\0' && type != '7')
+      return true;
+
+   QFile::remove(path);
+   m_file.setFileName(path);
+   if (!m_file.open(QFile::WriteOnly))
+      return fail("Unable to create " + path + ": " + m_file.errorString());
+
+   return true;
+}
+
+/**
+ * Writes data of the current entry to its file (or to the metadata buffer
+ * for extended tar headers)
+ */
+bool ArchiveExtractor::writeEntry(const char *data, const qint64 size)
+{
+   if (m_format == Zip)
+      m_crc = crc32(m_crc, reinterpret_cast<const Bytef *>(data), uInt(size));
+
+   if (m_type == 'L' || m_type == 'K' || m_type == 'x' || m_type == 'g')
+   {
+      m_meta.append(data, int(size));
+      return true;
+   }
+
+   if (m_file.isOpen() && m_file.write(data, size) != size)
+      return fail("Unable to write " + m_file.fileName() + ": " + m_file.errorString());
+
+   return true;
+}
+
+/**
+ * Closes the file of the current entry (or interprets the extended tar
+ * header that was just received)
+ */
+bool ArchiveExtractor::endEntry()
+{
+   if (m_type == 'L')
+      m_longName = QString::fromUtf8(m_meta.constData());
+
+   else if (m_type == 'K')
+      m_longLink = QString::fromUtf8(m_meta.constData());
+
+   else if (m_type == 'x' && !parsePaxHeader(m_meta))
+      return fail("Invalid tar header");
+
+   else if (m_file.isOpen())
+   {
+      QString path = m_file.fileName();
+      bool flushed = m_file.flush();
+      m_file.close();
+      if (!flushed)
+         return fail("Unable to write " + path);
+
+      if (m_format == Tar && m_mode > 0)
+         QFile::setPermissions(path, permissionsFromMode(m_mode));
+   }
+
+   m_meta.clear();
+   return true;
+}
+
+/**
+ * Reads the records of a pax extended header ("<length> <key>=<value>\n"),
+ * which override the fields of the next entry
+ */
+bool ArchiveExtractor::parsePaxHeader(const QByteArray &data)
+{
+   int position = 0;
+   while (position < data.size())
+   {
+      int space = data.indexOf(' ', position);
+      if (space < 0)
+         return false;
+
+      bool ok = false;
+      int length = data.mid(position, space - position).toInt(&ok);
+      if (!ok || length <= space - position || position + length > data.size())
+         return false;
+
+      QByteArray record = data.mid(space + 1, position + length - space - 2);
+      int equals = record.indexOf('=');
+      if (equals > 0)
+      {
+         QByteArray key = record.left(equals);
+         QByteArray value = record.mid(equals + 1);
+         if (key == "path")
+            m_paxPath = QString::fromUtf8(value);
+         else if (key == "linkpath")
+            m_paxLink = QString::fromUtf8(value);
+         else if (key == "size")
+            m_paxSize = value.toLongLong();
+      }
+
+      position += length;
+   }
+
+   return true;
+}
+
+/**
+ * Creates a symbolic link at \a path pointing to \a target, which must be a
+ * relative path that stays inside of the extraction directory. Links are
+ * only created on Unix, other systems skip them.
+ */
+bool ArchiveExtractor::createLink(const QString &path, const QString &target)
+{
+#if defined Q_OS_UNIX
+   QString resolved = QDir::cleanPath(QFileInfo(path).absolutePath() + "/" + target);
+   bool inside = resolved == m_directory || resolved.startsWith(m_directory + "/");
+   if (target.isEmpty() || QDir::isAbsolutePath(target) || !inside)
+      return fail("Unsafe symbolic link in the archive: " + target);
+
+   QFile::remove(path);
+   if (!QFile::link(target, path))
+      return fail("Unable to create " + path);
+#else
+   Q_UNUSED(path);
+   Q_UNUSED(target);
+#endif
+
+   return true;
+}
+
+/**
+ * Returns the path where the entry \a name is extracted, or an empty string
+ * if it would end up outside of the extraction directory
+ */
+QString ArchiveExtractor::entryPath(const QString &name) const
+{
+   QString clean = name;
+   clean.replace('\\', '/');
+   if (clean.startsWith('/') || (clean.length() > 1 && clean.at(1) == ':'))
+      return QString();
+
+   QStringList parts;
+   foreach (const QString &part, clean.split('/', Qt::SkipEmptyParts))
+   {
+      if (part == "..")
+         return QString();
+
+      if (part != ".")
+         parts.append(part);
+   }
+
+   /* Never write through the symbolic links created by the archive, since
+    * their targets were only checked relative to their own location */
+   QString path = m_directory;
+   for (int i = 0; i < parts.count(); ++i)
+   {
+      if (i > 0 && QFileInfo(path).isSymLink())
+         return QString();
+
+      path += "/" + parts.at(i);
+   }
+
+   return path;
+}
+
+/**
+ * Records the \a error, aborts the extraction and returns \c false
+ */
+bool ArchiveExtractor::fail(const QString &error)
+{
+   m_errorString = error;
+   abort();
+   return false;
+}
+
+/**
+ * Returns the number of buffered bytes that have not been processed yet
+ */
+qint64 ArchiveExtractor::available() const
+{
+   return m_buffer.size() - m_offset;
+}
+
+/**
+ * Returns the first buffered byte that has not been processed yet
+ */
+const uchar *ArchiveExtractor::peek() const
+{
+   return reinterpret_cast<const uchar *>(m_buffer.constData()) + m_offset;
+}
+
+/**
+ * Marks \a size buffered bytes as processed
+ */
+void ArchiveExtractor::consume(const qint64 size)
+{
+   m_offset += size;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_ARCHIVE_EXTRACTOR_H
+#define _QSIMPLEUPDATER_ARCHIVE_EXTRACTOR_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * \brief Unpacks tar and zip archives while they are being received
+ *
+ * The \c ArchiveExtractor is fed with the archive as it is written to the
+ * disk (after the transport compression has been removed, so \c .tar.gz and
+ * \c .tar.zst files arrive here as plain tar streams) and creates the files
+ * of every entry as soon as its data arrives. Nothing is read back from the
+ * disk and the archive never has to be complete before the first files are
+ * unpacked.
+ *
+ * Zip archives are read through their local headers: stored entries need to
+ * declare their size, deflated entries may use data descriptors. The central
+ * directory is only used to restore the Unix permissions and symbolic links.
+ *
+ * Entries that would end up outside of the target directory (absolute paths,
+ * \c .. components or symbolic links pointing outside of it) make the
+ * extraction fail.
+ */
+class ArchiveExtractor
+{
+public:
+   enum Format
+   {
+      None,
+      Tar,
+      Zip
+   };
+
+   ArchiveExtractor();
+   ~ArchiveExtractor();
+
+   Format format() const;
+   bool isFinished() const;
+   QString directory() const;
+   QString errorString() const;
+
+   bool open(const Format format, const QString &directory);
+   bool write(const char *data, const qint64 size);
+   bool finish();
+   void abort();
+
+   static Format formatFromName(const QString &fileName);
+   static QString directoryName(const QString &fileName);
+
+private:
+   Q_DISABLE_COPY(ArchiveExtractor)
+
+   struct State;
+
+   enum Step
+   {
+      Header,
+      Data,
+      Padding,
+      Descriptor,
+      End
+   };
+
+   bool process(bool *progress);
+   bool readTarHeader(bool *progress);
+   bool readZipHeader(bool *progress);
+   bool readZipCentralEntry(bool *progress);
+   bool readZipDescriptor(bool *progress);
+   bool readData(bool *progress);
+   bool inflateData(bool *progress);
+   bool beginEntry(const QString &name, const char type, const QString &target);
+   bool writeEntry(const char *data, const qint64 size);
+   bool endEntry();
+   bool parsePaxHeader(const QByteArray &data);
+   bool createLink(const QString &path, const QString &target);
+   QString entryPath(const QString &name) const;
+   bool fail(const QString &error);
+
+   qint64 available() const;
+   const uchar *peek() const;
+   void consume(const qint64 size);
+
+private:
+   Format m_format;
+   Step m_step;
+   QString m_directory;
+   QString m_errorString;
+
+   QByteArray m_buffer;
+   qint64 m_offset;
+
+   QFile m_file;
+   QByteArray m_meta;
+   char m_type;
+   int m_mode;
+   qint64 m_remaining;
+   qint64 m_padding;
+   QString m_longName;
+   QString m_longLink;
+   QString m_paxPath;
+   QString m_paxLink;
+   qint64 m_paxSize;
+
+   int m_method;
+   int m_flags;
+   bool m_zip64;
+   quint32 m_crc;
+   quint32 m_expectedCrc;
+
+   State *m_state;
+};
+
+#endif
@@ -0,0 +1,762 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QFile>
+#include <QThread>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QNetworkAccessManager>
+#include <QCryptographicHash>
+
+#include "ChunkSync.h"
+#include "RateLimiter.h"
+
+/* Amount of data read from the disk at once */
+static const qint64 BLOCK_SIZE = 1024 * 1024;
+
+/* Largest range requested at once and default number of parallel requests */
+static const qint64 MAX_RANGE_SIZE = 4 * 1024 * 1024;
+static const int MAX_CONNECTIONS = 4;
+
+/* Maximum amount of data buffered by each connection */
+static const qint64 READ_BUFFER_SIZE = 1024 * 1024;
+
+/* Number of times failed ranges are requested again */
+static const int MAX_RETRIES = 3;
+
+/* Interval between progress reports */
+static const int PROGRESS_INTERVAL = 200;
+
+/**
+ * Random values used by the gear rolling hash. They are generated with a
+ * fixed seed, publishers and clients must use the same table.
+ */
+struct GearTable
+{
+   quint64 values[256];
+
+   GearTable()
+   {
+      quint64 seed = Q_UINT64_C(0x5153555f43444331);
+      for (int i = 0; i < 256; ++i)
+      {
+         quint64 z = (seed += Q_UINT64_C(0x9e3779b97f4a7c15));
+         z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+         z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+         values[i] = z ^ (z >> 31);
+      }
+   }
+};
+
+static const GearTable &gearTable()
+{
+   static const GearTable table;
+   return table;
+}
+
+/**
+ * Splits the local file in chunks and indexes them by their digest
+ */
+class ScanThread : public QThread
+{
+public:
+   explicit ScanThread(QObject *parent)
+      : QThread(parent)
+      , minSize(0)
+      , avgSize(0)
+      , maxSize(0)
+   {
+   }
+
+   QString path;
+   int minSize;
+   int avgSize;
+   int maxSize;
+   QHash<QByteArray, qint64> index;
+
+protected:
+   void run()
+   {
+      index.clear();
+
+      QFile file(path);
+      if (!file.open(QIODevice::ReadOnly))
+         return;
+
+      foreach (const ChunkSync::Chunk &chunk, ChunkSync::chunkData(&file, minSize, avgSize, maxSize))
+      {
+         if (isInterruptionRequested())
+            return;
+
+         if (!index.contains(chunk.hash))
+            index.insert(chunk.hash, chunk.offset);
+      }
+   }
+};
+
+/**
+ * Copies the chunks that are already available from the local file
+ */
+class CopyThread : public QThread
+{
+public:
+   explicit CopyThread(QObject *parent)
+      : QThread(parent)
+      , success(false)
+      , writer(0)
+      , copied(0)
+   {
+   }
+
+   QString path;
+   bool success;
+   DownloadWriter *writer;
+   QList<ChunkSync::Range> copies;
+   QAtomicInteger<qint64> *copied;
+
+protected:
+   void run()
+   {
+      success = false;
+
+      QFile file(path);
+      if (!file.open(QIODevice::ReadOnly))
+         return;
+
+      foreach (const ChunkSync::Range &range, copies)
+      {
+         if (!file.seek(range.source))
+            return;
+
+         qint64 done = 0;
+         while (done < range.length)
+         {
+            /* Wait for the writer when it has enough data */
+            while (writer->isFull() && !isInterruptionRequested())
+               msleep(5);
+
+            if (isInterruptionRequested())
+               return;
+
+            QByteArray data = file.read(qMin(BLOCK_SIZE, range.length - done));
+            if (data.isEmpty())
+               return;
+
+            writer->write(range.offset + done, data);
+            copied->fetchAndAddRelaxed(data.size());
+            done += data.size();
+         }
+      }
+
+      success = true;
+   }
+};
+
+ChunkSync::ChunkSync(QNetworkAccessManager *manager, QObject *parent)
+   : QObject(parent)
+   , m_copied(0)
+   , m_timer(this)
+   , m_writer(this)
+{
+   m_fetched = 0;
+   m_reused = 0;
+   m_maxConnections = MAX_CONNECTIONS;
+   m_finished = true;
+   m_copying = false;
+   m_limiter = 0;
+   m_manifestReply = 0;
+   m_manager = manager;
+   m_scanner = new ScanThread(this);
+   m_copier = new CopyThread(this);
+
+   m_timer.setInterval(PROGRESS_INTERVAL);
+   connect(&m_timer, SIGNAL(timeout()), this, SLOT(reportProgress()));
+   connect(m_scanner, SIGNAL(finished()), this, SLOT(onScanFinished()));
+   connect(m_copier, SIGNAL(finished()), this, SLOT(onCopyFinished()));
+   connect(&m_writer, SIGNAL(drained()), this, SLOT(readRanges()));
+   connect(&m_writer, SIGNAL(closed(bool)), this, SLOT(onWriterClosed(bool)));
+}
+
+ChunkSync::~ChunkSync()
+{
+   abort();
+}
+
+/**
+ * Returns \c true if there is no transfer in progress
+ */
+bool ChunkSync::isFinished() const
+{
+   return m_finished;
+}
+
+/**
+ * Returns the number of bytes that were taken from the local file
+ */
+qint64 ChunkSync::reusedBytes() const
+{
+   return m_reused;
+}
+
+/**
+ * Reads the chunk manifest in \a data, returns \c false if it is not valid
+ * 解析分块清单
+ */
+bool ChunkSync::parseManifest(const QByteArray &data, Manifest *manifest)
+{
+   QJsonObject object = QJsonDocument::fromJson(data).object();
+
+   manifest->size = qint64(object.value("size").toDouble());
+   manifest->minSize = object.value("min").toInt();
+   manifest->avgSize = object.value("avg").toInt();
+   manifest->maxSize = object.value("max").toInt();
+   manifest->sha256 = object.value("sha256").toString().toLower().toLatin1();
+   manifest->chunks.clear();
+
+   if (manifest->minSize <= 0 || manifest->avgSize < manifest->minSize || manifest->maxSize < manifest->avgSize)
+      return false;
+
+   qint64 offset = 0;
+   foreach (const QJsonValue &value, object.value("chunks").toArray())
+   {
+      QJsonArray array = value.toArray();
+
+      Chunk chunk;
+      chunk.offset = offset;
+      chunk.length = qint64(array.at(1).toDouble());
+      chunk.hash = QByteArray::fromHex(array.at(0).toString().toLatin1());
+
+      if (chunk.length <= 0 || chunk.hash.isEmpty())
+         return false;
+
+      offset += chunk.length;
+      manifest->chunks.append(chunk);
+   }
+
+   return offset == manifest->size && !manifest->sha256.isEmpty();
+}
+
+/**
+ * Creates the chunk manifest of the file at \a path, publish it next to the
+ * file and reference it with the \c chunk-manifest field of the appcast.
+ * 为发布的文件生成分块清单
+ */
+QByteArray ChunkSync::createManifest(const QString &path, const int avgSize)
+{
+   QFile file(path);
+   if (!file.open(QIODevice::ReadOnly))
+      return QByteArray();
+
+   int minSize = avgSize / 4;
+   int maxSize = avgSize * 4;
+
+   QJsonArray chunks;
+   foreach (const Chunk &chunk, chunkData(&file, minSize, avgSize, maxSize))
+   {
+      QJsonArray array;
+      array.append(QString::fromLatin1(chunk.hash.toHex()));
+      array.append(double(chunk.length));
+      chunks.append(array);
+   }
+
+   file.seek(0);
+   QCryptographicHash hash(QCryptographicHash::Sha256);
+   hash.addData(&file);
+
+   QJsonObject object;
+   object.insert("size", double(file.size()));
+   object.insert("sha256", QString::fromLatin1(hash.result().toHex()));
+   object.insert("min", minSize);
+   object.insert("avg", avgSize);
+   object.insert("max", maxSize);
+   object.insert("chunks", chunks);
+
+   return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * Splits the data of the \a device in content-defined chunks. A chunk ends
+ * where the top bits of the gear hash are zero (on average every \a avgSize
+ * bytes), but never before \a minSize bytes or after \a maxSize bytes.
+ * 使用滚动哈希将数据切分为内容定义的分块
+ */
+QVector<ChunkSync::Chunk> ChunkSync::chunkData(QIODevice *device, const int minSize, const int avgSize,
+                                              const int maxSize)
+{
+   const quint64 *gear = gearTable().values;
+
+   int bits = 0;
+   while ((qint64(1) << (bits + 1)) <= avgSize)
+      ++bits;
+
+   const int shift = 64 - bits;
+
+   QVector<Chunk> chunks;
+   QCryptographicHash hash(QCryptographicHash::Sha256);
+   quint64 rolling = 0;
+   qint64 start = 0;
+   qint64 length = 0;
+
+   while (!device->atEnd())
+   {
+      QByteArray block = device->read(BLOCK_SIZE);
+      if (block.isEmpty())
+         break;
+
+      const uchar *data = reinterpret_cast<const uchar *>(block.constData());
+      int begin = 0;
+
+      for (int i = 0; i < block.size(); ++i)
+      {
+         rolling = (rolling << 1) + gear[data[i]];
+         ++length;
+
+         if ((length >= minSize && (rolling >> shift) == 0) || length >= maxSize)
+         {
+            hash.addData(block.constData() + begin, i + 1 - begin);
+
+            Chunk chunk;
+            chunk.offset = start;
+            chunk.length = length;
+            chunk.hash = hash.result();
+            chunks.append(chunk);
+
+            hash.reset();
+            start += length;
+            length = 0;
+            rolling = 0;
+            begin = i + 1;
+         }
+      }
+
+      hash.addData(block.constData() + begin, block.size() - begin);
+   }
+
+   if (length > 0)
+   {
+      Chunk chunk;
+      chunk.offset = start;
+      chunk.length = length;
+      chunk.hash = hash.result();
+      chunks.append(chunk);
+   }
+
+   return chunks;
+}
+
+/**
+ * Aborts the transfer, stops the worker threads and closes the output file
+ */
+void ChunkSync::abort()
+{
+   m_finished = true;
+   m_timer.stop();
+
+   if (m_manifestReply)
+   {
+      m_manifestReply->disconnect(this);
+      m_manifestReply->abort();
+      m_manifestReply->deleteLater();
+      m_manifestReply = 0;
+   }
+
+   foreach (QNetworkReply *reply, m_active.keys())
+   {
+      reply->disconnect(this);
+      reply->abort();
+      reply->deleteLater();
+   }
+
+   m_active.clear();
+   m_missing.clear();
+   m_copies.clear();
+
+   m_scanner->requestInterruption();
+   m_copier->requestInterruption();
+   m_scanner->wait();
+   m_copier->wait();
+   m_copying = false;
+
+   m_writer.abort();
+}
+
+/**
+ * Limits the rate at which the missing chunks are downloaded with the given
+ * \a limiter. Pass \c 0 to disable the limit.
+ */
+void ChunkSync::setRateLimiter(RateLimiter *limiter)
+{
+   if (m_limiter)
+      m_limiter->disconnect(this);
+
+   m_limiter = limiter;
+   if (m_limiter)
+      connect(m_limiter, SIGNAL(ready()), this, SLOT(readRanges()));
+}
+
+/**
+ * Changes the user-agent string sent with every request
+ */
+void ChunkSync::setUserAgentString(const QString &agent)
+{
+   m_userAgentString = agent;
+}
+
+/**
+ * Changes the maximum number of parallel range requests
+ */
+void ChunkSync::setMaxConnections(const int connections)
+{
+   m_maxConnections = qMax(1, connections);
+}
+
+/**
+ * Downloads the chunk manifest at \a manifestUrl and rebuilds the file at
+ * \a url into \a output, using the chunks of the \a base file when possible.
+ * 下载分块清单，复用本地文件中已有的分块，只下载缺失的分块
+ */
+void ChunkSync::start(const QUrl &manifestUrl, const QUrl &url, const QString &base, const QString &output)
+{
+   abort();
+
+   m_url = url;
+   m_base = base;
+   m_output = output;
+   m_fetched = 0;
+   m_reused = 0;
+   m_copied.storeRelease(0);
+   m_retries = 0;
+   m_finished = false;
+
+   m_manifestReply = m_manager->get(createRequest(manifestUrl));
+   connect(m_manifestReply, SIGNAL(finished()), this, SLOT(onManifestFinished()));
+}
+
+/**
+ * Reads the manifest, prepares the output file and scans the local file
+ */
+void ChunkSync::onManifestFinished()
+{
+   QNetworkReply *reply = m_manifestReply;
+   m_manifestReply = 0;
+   reply->deleteLater();
+
+   if (reply->error() != QNetworkReply::NoError || !parseManifest(reply->readAll(), &m_manifest))
+   {
+      fail();
+      return;
+   }
+
+   m_writer.setHashEnabled(true);
+   if (!m_writer.open(m_output, false, m_manifest.size))
+   {
+      fail();
+      return;
+   }
+
+   ScanThread *scanner = static_cast<ScanThread *>(m_scanner);
+   scanner->path = m_base;
+   scanner->minSize = m_manifest.minSize;
+   scanner->avgSize = m_manifest.avgSize;
+   scanner->maxSize = m_manifest.maxSize;
+   scanner->start(QThread::LowPriority);
+}
+
+/**
+ * Compares the chunks of the local file with the manifest, copies the chunks
+ * that we already have and requests the rest
+ * 对比本地分块与清单，复制已有分块，请求缺失分块
+ */
+void ChunkSync::onScanFinished()
+{
+   if (m_finished)
+      return;
+
+   const QHash<QByteArray, qint64> &index = static_cast<ScanThread *>(m_scanner)->index;
+
+   foreach (const Chunk &chunk, m_manifest.chunks)
+   {
+      if (index.contains(chunk.hash))
+      {
+         Range range;
+         range.source = index.value(chunk.hash);
+         range.offset = chunk.offset;
+         range.length = chunk.length;
+         m_reused += chunk.length;
+
+         /* Merge with the previous copy if both sides are contiguous */
+         if (!m_copies.isEmpty())
+         {
+            Range &last = m_copies.last();
+            if (last.source + last.length == range.source && last.offset + last.length == range.offset)
+            {
+               last.length += range.length;
+               continue;
+            }
+         }
+
+         m_copies.append(range);
+      }
+
+      else
+      {
+         /* Merge with the previous missing range if it is contiguous */
+         if (!m_missing.isEmpty())
+         {
+            Range &last = m_missing.last();
+            if (last.offset + last.length == chunk.offset && last.length + chunk.length <= MAX_RANGE_SIZE)
+            {
+               last.length += chunk.length;
+               continue;
+            }
+         }
+
+         Range range;
+         range.source = chunk.offset;
+         range.offset = chunk.offset;
+         range.length = chunk.length;
+         m_missing.append(range);
+      }
+   }
+
+   /* Copy the chunks that we already have */
+   if (!m_copies.isEmpty())
+   {
+      CopyThread *copier = static_cast<CopyThread *>(m_copier);
+      copier->path = m_base;
+      copier->copies = m_copies;
+      copier->writer = &m_writer;
+      copier->copied = &m_copied;
+      m_copying = true;
+      copier->start(QThread::LowPriority);
+   }
+
+   /* Download the rest */
+   m_timer.start();
+   startNextRange();
+   checkCompleted();
+}
+
+/**
+ * Called when all the local chunks have been copied
+ */
+void ChunkSync::onCopyFinished()
+{
+   if (m_finished || !m_copying)
+      return;
+
+   m_copying = false;
+   if (!static_cast<CopyThread *>(m_copier)->success)
+   {
+      fail();
+      return;
+   }
+
+   checkCompleted();
+}
+
+/**
+ * Continues reading the range requests once the writer has room for more data
+ * or the rate limiter allows us to read again
+ */
+void ChunkSync::readRanges()
+{
+   foreach (QNetworkReply *reply, m_active.keys())
+   {
+      if (m_finished)
+         return;
+
+      readRange(reply, false);
+   }
+}
+
+/**
+ * Called when a range request has received new data
+ */
+void ChunkSync::onRangeReadyRead()
+{
+   QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+   if (m_active.contains(reply))
+      readRange(reply, false);
+}
+
+/**
+ * Called when a range request finishes, requests the missing data again if
+ * the request failed
+ */
+void ChunkSync::onRangeFinished()
+{
+   QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+   if (!m_active.contains(reply))
+      return;
+
+   /* Data that was held back while the writer was busy */
+   readRange(reply, true);
+   if (m_finished)
+      return;
+
+   Range range = m_active.take(reply);
+   reply->deleteLater();
+
+   if (range.length > 0)
+   {
+      if (++m_retries > MAX_RETRIES)
+      {
+         fail();
+         return;
+      }
+
+      m_missing.prepend(range);
+   }
+
+   startNextRange();
+   checkCompleted();
+}
+
+/**
+ * Called when the output file has been written and hashed
+ */
+void ChunkSync::onWriterClosed(const bool success)
+{
+   m_timer.stop();
+   m_finished = true;
+   reportProgress();
+
+   QByteArray checksum = m_writer.checksum();
+   bool valid = success && checksum.toHex() == m_manifest.sha256;
+   if (!valid)
+      QFile::remove(m_output);
+
+   emit finished(valid, checksum);
+}
+
+/**
+ * Reports the number of bytes copied and downloaded so far
+ */
+void ChunkSync::reportProgress()
+{
+   emit downloadProgress(m_fetched + m_copied.loadAcquire(), m_manifest.size);
+}
+
+/**
+ * Returns a request for the given \a url with the common headers set
+ */
+QNetworkRequest ChunkSync::createRequest(const QUrl &url) const
+{
+   QNetworkRequest request(url);
+   request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+   if (!m_userAgentString.isEmpty())
+      request.setRawHeader("User-Agent", m_userAgentString.toUtf8());
+
+   return request;
+}
+
+/**
+ * Writes the data received by a range request at its position in the output
+ * file. If \a force is \c false, nothing is read while the writer queue is
+ * full or the rate limit is reached, so that the connection stops reading
+ * from the socket.
+ */
+void ChunkSync::readRange(QNetworkReply *reply, const bool force)
+{
+   if (reply->bytesAvailable() <= 0)
+      return;
+
+   /* The server ignored the range, writing the data would corrupt the file */
+   if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 206)
+   {
+      fail();
+      return;
+   }
+
+   Range &range = m_active[reply];
+   while (reply->bytesAvailable() > 0 && range.length > 0 && (force || !m_writer.isFull()))
+   {
+      qint64 size = qMin(range.length, BLOCK_SIZE);
+      if (m_limiter && !force)
+      {
+         size = qMin(size, m_limiter->available());
+         if (size <= 0)
+            break;
+      }
+
+      QByteArray data = reply->read(size);
+      if (m_limiter)
+         m_limiter->consume(data.size());
+
+      m_writer.write(range.offset, data);
+      range.offset += data.size();
+      range.length -= data.size();
+      m_fetched += data.size();
+   }
+}
+
+/**
+ * Requests the missing ranges, using up to \c m_maxConnections connections
+ */
+void ChunkSync::startNextRange()
+{
+   while (m_active.count() < m_maxConnections && !m_missing.isEmpty())
+   {
+      Range range = m_missing.takeFirst();
+
+      QNetworkRequest request = createRequest(m_url);
+      request.setRawHeader("Accept-Encoding", "identity");
+      request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+      request.setRawHeader("Range", "bytes=" + QByteArray::number(range.offset) + "-"
+                                       + QByteArray::number(range.offset + range.length - 1));
+
+      QNetworkReply *reply = m_manager->get(request);
+      reply->setReadBufferSize(m_limiter ? m_limiter->bufferSize(READ_BUFFER_SIZE) : READ_BUFFER_SIZE);
+      connect(reply, SIGNAL(readyRead()), this, SLOT(onRangeReadyRead()));
+      connect(reply, SIGNAL(finished()), this, SLOT(onRangeFinished()));
+      m_active.insert(reply, range);
+   }
+}
+
+/**
+ * Closes the output file once every chunk has been copied or downloaded
+ */
+void ChunkSync::checkCompleted()
+{
+   if (m_finished || m_copying || !m_active.isEmpty() || !m_missing.isEmpty())
+      return;
+
+   m_writer.finish();
+}
+
+/**
+ * Aborts the transfer and notifies the caller about the error
+ */
+void ChunkSync::fail()
+{
+   abort();
+   QFile::remove(m_output);
+   emit finished(false, QByteArray());
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_ChunkSync.cpp"
+#endif
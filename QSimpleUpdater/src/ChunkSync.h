@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_CHUNK_SYNC_H
+#define _QSIMPLEUPDATER_CHUNK_SYNC_H
+
+#include <QUrl>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QVector>
+#include <QObject>
+#include <QAtomicInteger>
+
+#include "DownloadWriter.h"
+
+class QIODevice;
+class QThread;
+class RateLimiter;
+class QNetworkReply;
+class QNetworkRequest;
+class QNetworkAccessManager;
+
+/**
+ * \brief Rebuilds a file from the chunks of a local file and range requests
+ *
+ * The publisher describes the new file with a chunk manifest (see
+ * \c createManifest()): the file is split in content-defined chunks (using a
+ * rolling gear hash, so that insertions only change the chunks around them)
+ * and the SHA-256 digest of every chunk is listed.
+ *
+ * The client splits the file that it already has (e.g. the previous payload)
+ * with the same parameters, copies every chunk that it already has and only
+ * downloads the missing chunks with HTTP range requests.
+ *
+ * The manifest is a JSON document:
+ *
+ * \code
+ * {
+ *   "size": 314572800,
+ *   "sha256": "<digest of the file>",
+ *   "min": 16384, "avg": 65536, "max": 262144,
+ *   "chunks": [ [ "<digest of the chunk>", 70123 ], ... ]
+ * }
+ * \endcode
+ */
+class ChunkSync : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void downloadProgress(qint64 received, qint64 total);
+   void finished(const bool success, const QByteArray &checksum);
+
+public:
+   struct Chunk
+   {
+      qint64 offset;
+      qint64 length;
+      QByteArray hash;
+   };
+
+   struct Manifest
+   {
+      qint64 size;
+      int minSize;
+      int avgSize;
+      int maxSize;
+      QByteArray sha256;
+      QVector<Chunk> chunks;
+   };
+
+   struct Range
+   {
+      qint64 source;
+      qint64 offset;
+      qint64 length;
+   };
+
+   explicit ChunkSync(QNetworkAccessManager *manager, QObject *parent = 0);
+   ~ChunkSync();
+
+   bool isFinished() const;
+   qint64 reusedBytes() const;
+
+   static bool parseManifest(const QByteArray &data, Manifest *manifest);
+   static QByteArray createManifest(const QString &path, const int avgSize = 64 * 1024);
+   static QVector<Chunk> chunkData(QIODevice *device, const int minSize, const int avgSize, const int maxSize);
+
+public slots:
+   void abort();
+   void setRateLimiter(RateLimiter *limiter);
+   void setUserAgentString(const QString &agent);
+   void setMaxConnections(const int connections);
+   void start(const QUrl &manifestUrl, const QUrl &url, const QString &base, const QString &output);
+
+private slots:
+   void onManifestFinished();
+   void onScanFinished();
+   void onCopyFinished();
+   void readRanges();
+   void onRangeReadyRead();
+   void onRangeFinished();
+   void onWriterClosed(const bool success);
+   void reportProgress();
+
+private:
+   QNetworkRequest createRequest(const QUrl &url) const;
+   void readRange(QNetworkReply *reply, const bool force);
+   void startNextRange();
+   void checkCompleted();
+   void fail();
+
+private:
+   QUrl m_url;
+   QString m_base;
+   QString m_output;
+   QString m_userAgentString;
+
+   bool m_finished;
+   bool m_copying;
+   Manifest m_manifest;
+   QList<Range> m_copies;
+   QList<Range> m_missing;
+   QHash<QNetworkReply *, Range> m_active;
+
+   int m_retries;
+   int m_maxConnections;
+   qint64 m_fetched;
+   qint64 m_reused;
+   QAtomicInteger<qint64> m_copied;
+
+   QTimer m_timer;
+   QThread *m_scanner;
+   QThread *m_copier;
+   DownloadWriter m_writer;
+   RateLimiter *m_limiter;
+   QNetworkReply *m_manifestReply;
+   QNetworkAccessManager *m_manager;
+};
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QCoreApplication>
+#include <QRegularExpression>
+
+#if defined Q_OS_WIN
+#   include <windows.h>
+#elif defined Q_OS_UNIX
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#if defined Q_OS_LINUX
+#   include <sys/ioctl.h>
+#   include <linux/fs.h>
+#elif defined Q_OS_MACOS
+#   include <sys/clonefile.h>
+#endif
+
+#include "DownloadCache.h"
+
+/* Default size limit of the cache directory */
+static const qint64 DEFAULT_MAX_SIZE = Q_INT64_C(2) * 1024 * 1024 * 1024;
+
+/* Time to wait for another process that is trimming the cache */
+static const int LOCK_TIMEOUT = 1000;
+
+static const QString LOCK_FILE("cache.lock");
+static const QRegularExpression KEY_PATTERN("^[0-9a-f]{64}$");
+
+DownloadCache::DownloadCache()
+{
+   m_enabled = true;
+   m_maxSize = DEFAULT_MAX_SIZE;
+   m_directory = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/QSimpleUpdater";
+}
+
+DownloadCache::~DownloadCache() {}
+
+/**
+ * Returns the only instance of the class, which is shared by all the
+ * \c Updater instances
+ * 获取全局唯一的下载缓存
+ */
+DownloadCache *DownloadCache::getInstance()
+{
+   static DownloadCache cache;
+   return &cache;
+}
+
+/**
+ * Returns \c true if verified downloads are stored in (and taken from) the
+ * cache
+ */
+bool DownloadCache::isEnabled() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_enabled;
+}
+
+/**
+ * Returns the directory that holds the cached files
+ */
+QString DownloadCache::directory() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_directory;
+}
+
+/**
+ * Returns the maximum size of the cache directory, in bytes
+ */
+qint64 DownloadCache::maxSize() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_maxSize;
+}
+
+/**
+ * Enables or disables the cache
+ * 设置是否启用下载缓存
+ */
+void DownloadCache::setEnabled(const bool enabled)
+{
+   QMutexLocker locker(&m_mutex);
+   m_enabled = enabled;
+}
+
+/**
+ * Changes the directory that holds the cached files. Applications that use
+ * the same directory share their downloads.
+ * 设置缓存目录
+ */
+void DownloadCache::setDirectory(const QString &path)
+{
+   QMutexLocker locker(&m_mutex);
+   m_directory = path;
+}
+
+/**
+ * Changes the maximum size of the cache directory, the least recently used
+ * files are removed once it is exceeded
+ * 设置缓存目录的最大大小
+ */
+void DownloadCache::setMaxSize(const qint64 bytes)
+{
+   QMutexLocker locker(&m_mutex);
+   m_maxSize = qMax<qint64>(0, bytes);
+}
+
+/**
+ * Looks for the file with the given \a sha256 digest (as a hex string) and,
+ * if it is in the cache, has the expected \a size and still has that digest,
+ * clones (or copies) it to \a filePath (replacing any file there).
+ * 如果缓存中有指定SHA-256值的文件，重新校验后将其复制到目标路径
+ *
+ * Returns \c true if the file was taken from the cache.
+ */
+bool DownloadCache::materialize(const QByteArray &sha256, const qint64 size, const QString &filePath)
+{
+   QString entry = entryPath(sha256);
+   if (entry.isEmpty())
+      return false;
+
+   QFileInfo info(entry);
+   if (!info.isFile() || (size > 0 && info.size() != size))
+      return false;
+
+   /* The entry may have been changed since it was stored (e.g. by an older
+    * version that hard linked it to a download), never hand it out unverified */
+   if (!matches(entry, sha256))
+   {
+      QFile::remove(entry);
+      return false;
+   }
+
+   QFile::remove(filePath);
+   if (!cloneFile(entry, filePath) && !QFile::copy(entry, filePath))
+      return false;
+
+   /* The copy belongs to the user, unlike the read-only cached file */
+   QFile::setPermissions(filePath, QFile::permissions(filePath) | QFile::WriteOwner | QFile::WriteUser);
+
+   touch(entry);
+   return true;
+}
+
+/**
+ * Adds the verified file at \a filePath to the cache under its \a sha256
+ * digest (as a hex string), and removes the least recently used files if the
+ * cache is now too large
+ * 将校验过的文件加入缓存，并按最近最少使用原则清理缓存
+ */
+void DownloadCache::store(const QByteArray &sha256, const QString &filePath)
+{
+   QString entry = entryPath(sha256);
+   if (entry.isEmpty())
+      return;
+
+   QDir dir = QFileInfo(entry).dir();
+   if (!dir.mkpath("."))
+      return;
+
+   /* Keep a private, read-only copy (a hard link would change with the
+    * user's file), under a temporary name first so that other processes
+    * never see a partially copied file */
+   if (!QFileInfo(entry).isFile())
+   {
+      QString temp = entry + ".tmp" + QString::number(QCoreApplication::applicationPid());
+      QFile::remove(temp);
+
+      bool copied = cloneFile(filePath, temp) || QFile::copy(filePath, temp);
+      if (copied)
+         QFile::setPermissions(temp, QFile::ReadOwner | QFile::ReadUser | QFile::ReadGroup | QFile::ReadOther);
+
+      if (!copied || !QFile::rename(temp, entry))
+         QFile::remove(temp);
+   }
+
+   touch(entry);
+   trim(dir.absolutePath(), maxSize());
+}
+
+/**
+ * Makes \a target share the contents of \a source, which must not change
+ * afterwards: the file is cloned if the file system supports it, otherwise
+ * hard linked, otherwise copied. The \a target must not exist.
+ * 优先使用写时复制克隆或硬链接共享文件，否则复制文件
+ */
+bool DownloadCache::linkFile(const QString &source, const QString &target)
+{
+   if (cloneFile(source, target))
+      return true;
+
+#if defined Q_OS_WIN
+   if (CreateHardLinkW((LPCWSTR)QDir::toNativeSeparators(target).utf16(),
+                       (LPCWSTR)QDir::toNativeSeparators(source).utf16(), NULL))
+      return true;
+#elif defined Q_OS_UNIX
+   if (::link(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0)
+      return true;
+#endif
+
+   return QFile::copy(source, target);
+}
+
+/**
+ * Makes \a target a copy-on-write clone of \a source, so that changing one
+ * file never changes the other. Returns \c false if the file system does not
+ * support clones. The \a target must not exist.
+ * 使用写时复制克隆文件
+ */
+bool DownloadCache::cloneFile(const QString &source, const QString &target)
+{
+   QByteArray from = QFile::encodeName(source);
+   QByteArray to = QFile::encodeName(target);
+
+#if defined Q_OS_LINUX && defined FICLONE
+   int in = ::open(from.constData(), O_RDONLY);
+   if (in >= 0)
+   {
+      int out = ::open(to.constData(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+      if (out >= 0)
+      {
+         bool cloned = ::ioctl(out, FICLONE, in) == 0;
+         ::close(out);
+         ::close(in);
+
+         if (cloned)
+         {
+            QFile::setPermissions(target, QFile::permissions(source));
+            return true;
+         }
+
+         ::unlink(to.constData());
+      }
+
+      else
+         ::close(in);
+   }
+#elif defined Q_OS_MACOS
+   if (::clonefile(from.constData(), to.constData(), 0) == 0)
+      return true;
+#else
+   Q_UNUSED(from);
+   Q_UNUSED(to);
+#endif
+
+   return false;
+}
+
+/**
+ * Returns the path of the cached file with the given \a sha256 digest, or an
+ * empty string if the cache is disabled or the digest is not valid
+ */
+QString DownloadCache::entryPath(const QByteArray &sha256) const
+{
+   QMutexLocker locker(&m_mutex);
+
+   /* The digest comes from the appcast, make sure that it is a file name */
+   QString key = QString::fromLatin1(sha256);
+   if (!m_enabled || m_directory.isEmpty() || !KEY_PATTERN.match(key).hasMatch())
+      return QString();
+
+   return QDir(m_directory).filePath(key);
+}
+
+/**
+ * Removes the least recently used files of the cache \a directory until its
+ * size is below \a maxSize. The cache may be shared by several processes, so
+ * a lock file protects the directory while it is trimmed.
+ */
+void DownloadCache::trim(const QString &directory, const qint64 maxSize)
+{
+   QDir dir(directory);
+   QLockFile lock(dir.filePath(LOCK_FILE));
+   if (!lock.tryLock(LOCK_TIMEOUT))
+      return;
+
+   QFileInfoList entries;
+   qint64 total = 0;
+   foreach (const QFileInfo &file, dir.entryInfoList(QDir::Files))
+   {
+      if (!KEY_PATTERN.match(file.fileName()).hasMatch())
+         continue;
+
+      /* Sort the files by their last access, the oldest first */
+      total += file.size();
+      int i = 0;
+      while (i < entries.count() && entries.at(i).lastRead() <= file.lastRead())
+         ++i;
+
+      entries.insert(i, file);
+   }
+
+   foreach (const QFileInfo &file, entries)
+   {
+      if (total <= maxSize)
+         break;
+
+      if (QFile::remove(file.absoluteFilePath()))
+         total -= file.size();
+   }
+}
+
+/**
+ * Returns \c true if the SHA-256 digest of the file at \a path is
+ * \a sha256 (as a hex string)
+ */
+bool DownloadCache::matches(const QString &path, const QByteArray &sha256) const
+{
+   QFile file(path);
+   if (!file.open(QFile::ReadOnly))
+      return false;
+
+   QCryptographicHash hash(QCryptographicHash::Sha256);
+   if (!hash.addData(&file))
+      return false;
+
+   return hash.result().toHex() == sha256.toLower();
+}
+
+/**
+ * Marks the cached file at \a path as used now, the access time is the key of
+ * the least recently used policy
+ */
+void DownloadCache::touch(const QString &path)
+{
+   QFile file(path);
+   if (file.open(QFile::ReadOnly))
+      file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileAccessTime);
+}
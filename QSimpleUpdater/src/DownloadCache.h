@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_DOWNLOAD_CACHE_H
+#define _QSIMPLEUPDATER_DOWNLOAD_CACHE_H
+
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * \brief Content-addressed store of the verified downloads
+ *
+ * Every download whose SHA-256 digest is defined by the appcast is added to
+ * the cache once it has been verified, under a file named after its digest.
+ * Before a download starts, the cache is searched for the digest: if the
+ * file is there (because another module, another application or a previous
+ * check downloaded it), it is linked into the download directory and no
+ * network transfer happens at all.
+ *
+ * Files are shared with reflinks (copy-on-write clones) where the file system
+ * supports them, otherwise copied. Hard links are never used between the
+ * cache and a download directory: the user may modify a downloaded file, and
+ * that must not change the cached one. The cached files are read-only and
+ * their digest is verified again before they are used. The cache directory
+ * is shared by all the applications of the user, so the size limit is
+ * enforced across processes: the least recently used files are removed
+ * first.
+ *
+ * The cache is shared by all the \c Updater instances and may be used from
+ * several threads at once.
+ */
+class DownloadCache
+{
+public:
+   static DownloadCache *getInstance();
+
+   bool isEnabled() const;
+   QString directory() const;
+   qint64 maxSize() const;
+
+   void setEnabled(const bool enabled);
+   void setDirectory(const QString &path);
+   void setMaxSize(const qint64 bytes);
+
+   bool materialize(const QByteArray &sha256, const qint64 size, const QString &filePath);
+   void store(const QByteArray &sha256, const QString &filePath);
+
+   static bool linkFile(const QString &source, const QString &target);
+   static bool cloneFile(const QString &source, const QString &target);
+
+private:
+   explicit DownloadCache();
+   ~DownloadCache();
+
+   QString entryPath(const QByteArray &sha256) const;
+   void trim(const QString &directory, const qint64 maxSize);
+   void touch(const QString &path);
+   bool matches(const QString &path, const QByteArray &sha256) const;
+
+private:
+   mutable QMutex m_mutex;
+   bool m_enabled;
+   QString m_directory;
+   qint64 m_maxSize;
+};
+
+#endif
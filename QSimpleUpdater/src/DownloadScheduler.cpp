@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "RateLimiter.h"
+#include "DownloadScheduler.h"
+
+/* Default limits, similar to the limits used by web browsers */
+static const int DEFAULT_CONNECTIONS = 6;
+static const int DEFAULT_HOST_CONNECTIONS = 2;
+
+/* Share of the total rate given to each priority (mandatory updates get four
+ * times the bandwidth of a background download) */
+static const int PRIORITY_WEIGHTS[] = { 4, 2, 1 };
+
+DownloadScheduler::DownloadScheduler()
+{
+   m_maxConnections = DEFAULT_CONNECTIONS;
+   m_maxHostConnections = DEFAULT_HOST_CONNECTIONS;
+   m_maxDownloadRate = 0;
+}
+
+DownloadScheduler::~DownloadScheduler()
+{
+   m_active.clear();
+   m_waiting.clear();
+}
+
+/**
+ * Returns the only instance of the class, which is shared by all the
+ * \c Updater instances
+ * 获取全局唯一的下载调度器
+ */
+DownloadScheduler *DownloadScheduler::getInstance()
+{
+   static DownloadScheduler scheduler;
+   return &scheduler;
+}
+
+/**
+ * Returns the maximum number of connections that may be open at the same time
+ */
+int DownloadScheduler::maxConnections() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_maxConnections;
+}
+
+/**
+ * Returns the maximum number of connections that may be open at the same
+ * time with the same host
+ */
+int DownloadScheduler::maxHostConnections() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_maxHostConnections;
+}
+
+/**
+ * Returns the total download rate shared by the active downloads, in bytes per
+ * second (\c 0 if unlimited)
+ */
+qint64 DownloadScheduler::maxDownloadRate() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_maxDownloadRate;
+}
+
+/**
+ * Returns \c true if the \a client has been allowed to start its transfer and
+ * has not released its slot yet
+ */
+bool DownloadScheduler::isActive(QObject *client) const
+{
+   QMutexLocker locker(&m_mutex);
+   return indexOf(m_active, client) >= 0;
+}
+
+/**
+ * Returns \c true if the \a client is waiting for a slot
+ */
+bool DownloadScheduler::isQueued(QObject *client) const
+{
+   QMutexLocker locker(&m_mutex);
+   return indexOf(m_waiting, client) >= 0;
+}
+
+/**
+ * Queues a transfer of the \a client to the given \a url. Once the transfer
+ * may start, the slot \a member of the \a client is invoked (through the
+ * event loop). If the \a client already holds a slot, it keeps it as long as
+ * the host of the \a url has a free connection, otherwise it waits at the
+ * head of its priority.
+ *
+ * The optional \a limiter receives the share of the total download rate that
+ * the transfer may use.
+ * 将传输加入队列，轮到它时调用 \a member 槽
+ */
+void DownloadScheduler::enqueue(QObject *client, const QUrl &url, const Priority priority, const char *member,
+                                RateLimiter *limiter)
+{
+   QMutexLocker locker(&m_mutex);
+
+   Ticket ticket;
+   ticket.client = client;
+   ticket.host = url.host().toLower();
+   ticket.connections = 1;
+   ticket.priority = priority;
+   ticket.member = member;
+   ticket.limiter = limiter;
+
+   /* The client restarts its transfer (e.g. after a failed patch), possibly
+    * with another host (e.g. a mirror) */
+   int index = indexOf(m_active, client);
+   if (index >= 0)
+   {
+      m_active.removeAt(index);
+      if (hostConnections(ticket.host) < m_maxHostConnections)
+      {
+         m_active.insert(index, ticket);
+         shareBandwidth();
+         QMetaObject::invokeMethod(client, member, Qt::QueuedConnection);
+         return;
+      }
+
+      insertWaiting(ticket, true);
+      schedule();
+      return;
+   }
+
+   index = indexOf(m_waiting, client);
+   if (index >= 0)
+      m_waiting.removeAt(index);
+   else
+      connect(client, SIGNAL(destroyed(QObject *)), this, SLOT(onClientDestroyed(QObject *)), Qt::DirectConnection);
+
+   insertWaiting(ticket, false);
+   schedule();
+}
+
+/**
+ * Frees the slot (or the queue entry) of the \a client and starts the next
+ * waiting transfer
+ * 释放传输槽位，启动下一个等待中的传输
+ */
+void DownloadScheduler::release(QObject *client)
+{
+   QMutexLocker locker(&m_mutex);
+
+   int index = indexOf(m_active, client);
+   if (index >= 0)
+   {
+      if (m_active.at(index).limiter)
+         QMetaObject::invokeMethod(m_active.at(index).limiter, "setShare", Qt::QueuedConnection, Q_ARG(qint64, 0));
+
+      m_active.removeAt(index);
+   }
+
+   else
+   {
+      index = indexOf(m_waiting, client);
+      if (index < 0)
+         return;
+
+      m_waiting.removeAt(index);
+   }
+
+   disconnect(client, SIGNAL(destroyed(QObject *)), this, SLOT(onClientDestroyed(QObject *)));
+   schedule();
+}
+
+/**
+ * Asks for \a connections connections in total for the active transfer of
+ * the \a client, and returns the number of connections that it may open
+ * (at least one, fewer than requested if the limits do not allow more).
+ * Returns \c 0 if the \a client does not hold a slot.
+ * 为活动传输申请多个连接，返回允许打开的连接数
+ */
+int DownloadScheduler::acquireConnections(QObject *client, const int connections)
+{
+   QMutexLocker locker(&m_mutex);
+
+   int index = indexOf(m_active, client);
+   if (index < 0)
+      return 0;
+
+   Ticket &ticket = m_active[index];
+   int total = m_maxConnections - (activeConnections() - ticket.connections);
+   int host = m_maxHostConnections - (hostConnections(ticket.host) - ticket.connections);
+
+   int previous = ticket.connections;
+   ticket.connections = qMax(1, qMin(connections, qMin(total, host)));
+   if (ticket.connections < previous)
+      schedule();
+
+   return ticket.connections;
+}
+
+/**
+ * Changes the \a priority of the transfer of the \a client without
+ * interrupting it: a waiting transfer moves in the queue, an active transfer
+ * gets the share of the total download rate of its new priority
+ * 修改传输的优先级（不中断传输）
+ */
+void DownloadScheduler::setPriority(QObject *client, const Priority priority)
+{
+   QMutexLocker locker(&m_mutex);
+
+   int index = indexOf(m_active, client);
+   if (index >= 0)
+   {
+      m_active[index].priority = priority;
+      shareBandwidth();
+      return;
+   }
+
+   index = indexOf(m_waiting, client);
+   if (index < 0)
+      return;
+
+   Ticket ticket = m_waiting.takeAt(index);
+   ticket.priority = priority;
+   insertWaiting(ticket, false);
+   schedule();
+}
+
+/**
+ * Changes the maximum number of connections that may be open at the same
+ * time
+ * 设置全局最大并发连接数
+ */
+void DownloadScheduler::setMaxConnections(const int connections)
+{
+   QMutexLocker locker(&m_mutex);
+   m_maxConnections = qMax(1, connections);
+   schedule();
+}
+
+/**
+ * Changes the maximum number of connections that may be open at the same
+ * time with the same host
+ * 设置每个主机的最大并发连接数
+ */
+void DownloadScheduler::setMaxHostConnections(const int connections)
+{
+   QMutexLocker locker(&m_mutex);
+   m_maxHostConnections = qMax(1, connections);
+   schedule();
+}
+
+/**
+ * Changes the total download rate shared by the active downloads, in bytes
+ * per second. A value of \c 0 removes the limit.
+ * 设置所有下载共享的总速率
+ */
+void DownloadScheduler::setMaxDownloadRate(const qint64 bytesPerSecond)
+{
+   QMutexLocker locker(&m_mutex);
+   m_maxDownloadRate = qMax(qint64(0), bytesPerSecond);
+   shareBandwidth();
+}
+
+/**
+ * Forgets the transfers of a client that has been deleted (this is called
+ * from the thread of the client, before its children are deleted)
+ */
+void DownloadScheduler::onClientDestroyed(QObject *client)
+{
+   QMutexLocker locker(&m_mutex);
+
+   int index = indexOf(m_active, client);
+   if (index >= 0)
+      m_active.removeAt(index);
+
+   index = indexOf(m_waiting, client);
+   if (index >= 0)
+      m_waiting.removeAt(index);
+
+   schedule();
+}
+
+/**
+ * Starts the waiting transfers with the highest priority, as long as the
+ * global and per-host limits allow it
+ */
+void DownloadScheduler::schedule()
+{
+   int i = 0;
+   while (i < m_waiting.count() && activeConnections() < m_maxConnections)
+   {
+      /* Transfers to a busy host do not block the transfers to other hosts */
+      if (hostConnections(m_waiting.at(i).host) >= m_maxHostConnections)
+      {
+         ++i;
+         continue;
+      }
+
+      Ticket ticket = m_waiting.takeAt(i);
+      m_active.append(ticket);
+      QMetaObject::invokeMethod(ticket.client, ticket.member.constData(), Qt::QueuedConnection);
+   }
+
+   shareBandwidth();
+}
+
+/**
+ * Divides the total download rate between the active downloads, according
+ * to the weight of their priorities
+ */
+void DownloadScheduler::shareBandwidth()
+{
+   int weights = 0;
+   foreach (const Ticket &ticket, m_active)
+   {
+      if (ticket.limiter)
+         weights += PRIORITY_WEIGHTS[ticket.priority];
+   }
+
+   foreach (const Ticket &ticket, m_active)
+   {
+      if (!ticket.limiter)
+         continue;
+
+      qint64 share = 0;
+      if (m_maxDownloadRate > 0)
+         share = qMax(qint64(1), m_maxDownloadRate * PRIORITY_WEIGHTS[ticket.priority] / weights);
+
+      QMetaObject::invokeMethod(ticket.limiter, "setShare", Qt::QueuedConnection, Q_ARG(qint64, share));
+   }
+}
+
+/**
+ * Returns the number of connections of the active transfers
+ */
+int DownloadScheduler::activeConnections() const
+{
+   int count = 0;
+   foreach (const Ticket &ticket, m_active)
+      count += ticket.connections;
+
+   return count;
+}
+
+/**
+ * Returns the number of connections of the active transfers with the given
+ * \a host
+ */
+int DownloadScheduler::hostConnections(const QString &host) const
+{
+   int count = 0;
+   foreach (const Ticket &ticket, m_active)
+   {
+      if (ticket.host == host)
+         count += ticket.connections;
+   }
+
+   return count;
+}
+
+/**
+ * Queues the \a ticket after the tickets of the same priority, or before them
+ * if \a first is \c true, so that the queue stays sorted by priority
+ */
+void DownloadScheduler::insertWaiting(const Ticket &ticket, const bool first)
+{
+   int position = m_waiting.count();
+   while (position > 0 && (m_waiting.at(position - 1).priority > ticket.priority
+                           || (first && m_waiting.at(position - 1).priority == ticket.priority)))
+      --position;
+
+   m_waiting.insert(position, ticket);
+}
+
+/**
+ * Returns the position of the ticket of the \a client in the given list
+ */
+int DownloadScheduler::indexOf(const QList<Ticket> &tickets, QObject *client) const
+{
+   for (int i = 0; i < tickets.count(); ++i)
+   {
+      if (tickets.at(i).client == client)
+         return i;
+   }
+
+   return -1;
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_DownloadScheduler.cpp"
+#endif
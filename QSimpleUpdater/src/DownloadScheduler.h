@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_DOWNLOAD_SCHEDULER_H
+#define _QSIMPLEUPDATER_DOWNLOAD_SCHEDULER_H
+
+#include <QUrl>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QByteArray>
+
+class RateLimiter;
+
+/**
+ * \brief Coordinates the transfers of all the \c Updater instances
+ *
+ * Every appcast check and every download asks the scheduler for a slot
+ * before it opens a connection (\c enqueue()) and gives it back when it is
+ * done (\c release()). The scheduler opens at most \c maxConnections()
+ * connections at once, and at most \c maxHostConnections() per host, taking
+ * the waiting transfers by priority (mandatory updates, then foreground, then
+ * background transfers) and in the order in which they were queued. A
+ * transfer starts with one connection, and asks for more with
+ * \c acquireConnections() before it opens them (e.g. the segments of a
+ * segmented download).
+ *
+ * If a total download rate is set, it is shared between the active
+ * downloads through their rate limiters, weighted by their priority.
+ *
+ * The clients may live in different threads: the scheduler is protected by a
+ * mutex, and it only reaches the clients and their limiters through queued
+ * invocations.
+ */
+class DownloadScheduler : public QObject
+{
+   Q_OBJECT
+
+public:
+   enum Priority
+   {
+      Mandatory,
+      Foreground,
+      Background
+   };
+
+   static DownloadScheduler *getInstance();
+
+   int maxConnections() const;
+   int maxHostConnections() const;
+   qint64 maxDownloadRate() const;
+   bool isActive(QObject *client) const;
+   bool isQueued(QObject *client) const;
+
+   void enqueue(QObject *client, const QUrl &url, const Priority priority, const char *member,
+                RateLimiter *limiter = 0);
+   void release(QObject *client);
+   int acquireConnections(QObject *client, const int connections);
+   void setPriority(QObject *client, const Priority priority);
+
+public slots:
+   void setMaxConnections(const int connections);
+   void setMaxHostConnections(const int connections);
+   void setMaxDownloadRate(const qint64 bytesPerSecond);
+
+private slots:
+   void onClientDestroyed(QObject *client);
+
+private:
+   explicit DownloadScheduler();
+   ~DownloadScheduler();
+
+   struct Ticket
+   {
+      QObject *client;
+      QString host;
+      int connections;
+      Priority priority;
+      QByteArray member;
+      QPointer<RateLimiter> limiter;
+   };
+
+   void schedule();
+   void shareBandwidth();
+   int activeConnections() const;
+   int hostConnections(const QString &host) const;
+   void insertWaiting(const Ticket &ticket, const bool first);
+   int indexOf(const QList<Ticket> &tickets, QObject *client) const;
+
+private:
+   mutable QMutex m_mutex;
+   int m_maxConnections;
+   int m_maxHostConnections;
+   qint64 m_maxDownloadRate;
+
+   QList<Ticket> m_active;
+   QList<Ticket> m_waiting;
+};
+
+#endif
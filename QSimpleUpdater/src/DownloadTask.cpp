@@ -0,0 +1,1542 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QFileInfo>
+#include <QSettings>
+#include <QMutexLocker>
+#include <QNetworkReply>
+#include <QCoreApplication>
+#include <QNetworkAccessManager>
+#include <QRegularExpression>
+#include <QRegularExpressionMatch>
+
+#include "DownloadTask.h"
+#include "ArchiveExtractor.h"
+#include "ChunkSync.h"
+#include "DownloadCache.h"
+#include "PatchEngine.h"
+#include "DownloadScheduler.h"
+#include "RateLimiter.h"
+#include "DownloadWriter.h"
+#include "MirrorSelector.h"
+#include "SegmentedDownload.h"
+
+static const QString PATCH_FILE(".patch");
+static const QString PARTIAL_DOWN(".part");
+static const QString PARTIAL_INFO(".part.info");
+static const QString EXTRACTING_DIR(".extracting");
+
+/* Maximum amount of data buffered by the network reply */
+static const qint64 READ_BUFFER_SIZE = 1024 * 1024;
+
+/* Maximum amount of data handed to the writer at once */
+static const qint64 READ_CHUNK_SIZE = 256 * 1024;
+
+/* Interval between two progress reports, in milliseconds */
+static const int PROGRESS_INTERVAL = 100;
+
+/* A transfer that receives nothing for this long moves to another mirror */
+static const int STALL_TIMEOUT = 15000;
+
+/* Parallel range requests of a chunk sync, if the scheduler allows them */
+static const int SYNC_CONNECTIONS = 4;
+
+/* Thread shared by the tasks (and appcast readers) of all the updaters */
+static bool USE_WORKER_THREAD = false;
+static QThread *WORKER_THREAD = 0;
+
+/* Disk space that all the prefetches may use before the user confirms their
+ * updates, and the part of it that the tasks reserved */
+static QMutex PREFETCH_MUTEX;
+static qint64 PREFETCH_BUDGET = 512 * 1024 * 1024;
+static qint64 PREFETCH_RESERVED = 0;
+
+/* Time between two attempts to stop the worker thread */
+static const int STOP_INTERVAL = 10;
+
+/* Stops the worker thread before the application object is destroyed */
+static void stopWorkerThread()
+{
+   if (!WORKER_THREAD)
+      return;
+
+   /* The worker may be waiting for a call that it queued to this thread
+    * (e.g. a getter of the QSimpleUpdater) and that nobody runs anymore,
+    * dropping the call wakes it up */
+   WORKER_THREAD->quit();
+   while (!WORKER_THREAD->wait(STOP_INTERVAL))
+      QCoreApplication::removePostedEvents(0, QEvent::MetaCall);
+
+   delete WORKER_THREAD;
+   WORKER_THREAD = 0;
+}
+
+DownloadTask::DownloadTask(QNetworkAccessManager *manager, QObject *parent)
+   : QObject(parent)
+   , m_progressTimer(this)
+   , m_stallTimer(this)
+{
+   /* Every child object follows the task when it is moved to a thread, the
+    * shared network manager must already live in that thread */
+   m_reply = 0;
+   m_manager = manager;
+   m_limiter = new RateLimiter(m_manager, this);
+   m_writer = new DownloadWriter(this);
+   m_patchEngine = new PatchEngine(this);
+   m_segmented = new SegmentedDownload(m_manager, this);
+   m_chunkSync = new ChunkSync(m_manager, this);
+   m_mirrorSelector = new MirrorSelector(m_manager, this);
+
+   /* Initialize internal values */
+   m_fileName = "";
+   m_state = Idle;
+   m_mandatoryUpdate = false;
+   m_backgroundDownload = false;
+   m_resumeEnabled = true;
+   m_resumeOffset = 0;
+   m_segmentCount = 1;
+   m_encoding = StreamDecoder::Identity;
+   m_expectedSize = 0;
+   m_patchSize = 0;
+   m_patching = false;
+   m_transferFailed = false;
+   m_transferCanceled = false;
+   m_transferStalled = false;
+   m_prefetching = false;
+   m_budgetReached = false;
+   m_prefetchReserved = 0;
+   m_received = 0;
+   m_mirrorsRanked = false;
+   m_mirrorIndex = 0;
+   m_extractArchives = false;
+   m_extracting = false;
+   m_writerActive = false;
+   m_progressChanged = false;
+
+   /* Set download directory */
+   m_downloadDir.setPath(QDir::homePath() + "/Downloads/");
+
+   /* Received data is written to the disk by the writer thread */
+   connect(m_writer, SIGNAL(drained()), this, SLOT(saveFile()));
+   connect(m_writer, SIGNAL(closed(bool)), this, SLOT(onWriterClosed(bool)));
+
+   /* Patches are applied in a separate thread */
+   connect(m_patchEngine, SIGNAL(patched(bool, QByteArray)), this, SLOT(patchApplied(bool, QByteArray)));
+
+   /* Segmented downloads report their progress like single downloads */
+   connect(m_segmented, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(updateProgress(qint64, qint64)));
+   connect(m_segmented, SIGNAL(finished(bool)), this, SLOT(segmentedFinished(bool)));
+   connect(m_segmented, SIGNAL(rangesUnsupported()), this, SLOT(startSingleDownload()));
+
+   /* Every transfer reads its data through the same rate limiter */
+   m_segmented->setRateLimiter(m_limiter);
+   m_chunkSync->setRateLimiter(m_limiter);
+   connect(m_limiter, SIGNAL(ready()), this, SLOT(saveFile()));
+
+   /* Chunk synchronization reports its progress as well */
+   connect(m_chunkSync, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(updateProgress(qint64, qint64)));
+   connect(m_chunkSync, SIGNAL(finished(bool, QByteArray)), this, SLOT(chunkSyncFinished(bool, QByteArray)));
+
+   /* The progress is reported at a fixed rate, not for every received block */
+   m_progressTimer.setInterval(PROGRESS_INTERVAL);
+   connect(&m_progressTimer, SIGNAL(timeout()), this, SLOT(reportProgress()));
+
+   /* The download starts on the fastest mirror, and moves to the next one
+    * if it stops receiving data */
+   m_stallTimer.setSingleShot(true);
+   m_stallTimer.setInterval(STALL_TIMEOUT);
+   connect(&m_stallTimer, SIGNAL(timeout()), this, SLOT(transferStalled()));
+   connect(m_mirrorSelector, SIGNAL(finished()), this, SLOT(mirrorsRanked()));
+}
+
+DownloadTask::~DownloadTask()
+{
+   /* The scheduler must forget the limiter before it is deleted */
+   DownloadScheduler::getInstance()->release(this);
+   releasePrefetchSpace();
+
+   /* Keep what was received so far when the application quits */
+   abortWriter();
+
+   delete m_reply;
+   delete m_segmented;
+   delete m_chunkSync;
+   delete m_mirrorSelector;
+   delete m_limiter;
+   delete m_writer;
+   delete m_patchEngine;
+}
+
+/**
+ * Returns \c true if the tasks created from now on are moved to the worker
+ * thread
+ */
+bool DownloadTask::useWorkerThread()
+{
+   return USE_WORKER_THREAD;
+}
+
+/**
+ * If \a enabled is set to \c true, the network managers, the parsing of the
+ * appcasts and the disk writes of the updaters created afterwards run in a
+ * worker thread, and the UI thread only receives their state changes.
+ * 设置是否在工作线程中执行网络和磁盘操作
+ */
+void DownloadTask::setUseWorkerThread(const bool enabled)
+{
+   USE_WORKER_THREAD = enabled;
+}
+
+/**
+ * Returns the thread shared by the tasks of all the updaters, starting it on
+ * the first call. It is stopped when the application object is destroyed.
+ * \note Call this function from the UI thread
+ */
+QThread *DownloadTask::workerThread()
+{
+   if (!WORKER_THREAD)
+   {
+      WORKER_THREAD = new QThread();
+      WORKER_THREAD->setObjectName("QSimpleUpdater");
+      WORKER_THREAD->start();
+      qAddPostRoutine(stopWorkerThread);
+   }
+
+   return WORKER_THREAD;
+}
+
+/**
+ * Returns the number of bytes that all the prefetches together may store
+ * before the user confirms their updates
+ */
+qint64 DownloadTask::prefetchBudget()
+{
+   QMutexLocker locker(&PREFETCH_MUTEX);
+   return PREFETCH_BUDGET;
+}
+
+/**
+ * Changes the number of bytes that all the prefetches together may store
+ * before the user confirms their updates, \c 0 removes the limit
+ * 设置所有预下载共同可以使用的磁盘空间
+ */
+void DownloadTask::setPrefetchBudget(const qint64 bytes)
+{
+   QMutexLocker locker(&PREFETCH_MUTEX);
+   PREFETCH_BUDGET = qMax<qint64>(0, bytes);
+}
+
+/**
+ * Begins downloading the file at the given \a url, once the download
+ * scheduler allows it. If the file is being prefetched, the transfer goes on
+ * with the priority of a normal download.
+ * 通过指定的URL开始下载文件（等待下载调度器分配传输槽位）
+ */
+void DownloadTask::start(const QUrl &url)
+{
+   /* The user confirmed the update that is being prefetched
+    * 用户确认了正在预下载的更新，以普通优先级继续下载 */
+   bool running = m_state == Waiting || m_state == Downloading || m_state == Patching;
+   if (m_prefetching && running && url == m_fullUrl)
+   {
+      confirmPrefetch();
+      DownloadScheduler::getInstance()->setPriority(this, DownloadScheduler::Priority(priority()));
+      return;
+   }
+
+   confirmPrefetch();
+   restart(url);
+}
+
+/**
+ * Downloads the file at the given \a url in the background, before the user
+ * confirms the update. The prefetch reserves its disk space from the budget
+ * shared by all the prefetches (see \c setPrefetchBudget()), pauses once the
+ * budget is used up, and it is resumed by \c start().
+ * 在用户确认更新之前，以后台优先级预先下载文件
+ */
+void DownloadTask::prefetch(const QUrl &url)
+{
+   /* The file is already there, or on its way */
+   if (url == m_fullUrl && m_state != Idle && m_state != Failed && m_state != Canceled && m_state != Paused)
+      return;
+
+   /* The space is reserved again for the file that is kept */
+   releasePrefetchSpace();
+   m_prefetching = true;
+   restart(url);
+}
+
+/**
+ * Called once the user confirmed the prefetched update: the file no longer
+ * counts against the prefetch budget
+ * 用户确认了预下载的更新，归还其占用的预下载预算
+ */
+void DownloadTask::confirmPrefetch()
+{
+   m_prefetching = false;
+   releasePrefetchSpace();
+}
+
+/**
+ * Discards the current transfer and queues a new transfer of the given
+ * \a url in the download scheduler
+ */
+void DownloadTask::restart(const QUrl &url)
+{
+   /* Forget any previous transfer */
+   if (m_reply)
+   {
+      m_reply->disconnect(this);
+      m_reply->deleteLater();
+      m_reply = 0;
+   }
+   abortWriter();
+   m_segmented->abort();
+   m_chunkSync->abort();
+   m_mirrorSelector->abort();
+
+   /* Ensure that downloads directory exists 检查下载目录是否存在，如果不存在则创建 */
+   if (!m_downloadDir.exists())
+      m_downloadDir.mkpath(".");
+
+   /* Take the file from the download cache if another module (or another
+    * application) already downloaded it 如果下载缓存中已有该文件，则无需下载 */
+   if (takeFromCache())
+      return;
+
+   /* The mirrors of another file must be ranked again */
+   if (url != m_fullUrl)
+      m_mirrorsRanked = false;
+
+   /* Wait until the scheduler lets us start (it limits the number of
+    * transfers of all the updaters) 等待下载调度器分配传输槽位 */
+   m_fullUrl = url;
+   m_throughput.reset();
+   m_progressChanged = false;
+   setState(Waiting);
+   DownloadScheduler::getInstance()->enqueue(this, url, DownloadScheduler::Priority(priority()), "beginDownload",
+                                             m_limiter);
+}
+
+/**
+ * Stops the transfer (or removes it from the download scheduler queue). The
+ * partial file of a single download is kept so that it can be resumed.
+ * 取消下载
+ */
+void DownloadTask::cancel()
+{
+   DownloadScheduler::getInstance()->release(this);
+   m_mirrorSelector->abort();
+
+   /* Segmented downloads cannot be resumed, remove their data */
+   if (!m_segmented->isFinished())
+   {
+      m_segmented->abort();
+      removePartialDownload();
+   }
+
+   if (!m_chunkSync->isFinished())
+   {
+      m_chunkSync->abort();
+      removePartialDownload();
+   }
+
+   /* The reply reports the cancellation once the writer has saved the data
+    * that was already received (see writerClosed()) */
+   if (m_reply && !m_reply->isFinished())
+   {
+      m_reply->abort();
+      return;
+   }
+
+   if (m_state == Waiting || m_state == Downloading)
+      setState(Canceled);
+}
+
+/**
+ * Stops the transfer right away and removes everything that was downloaded,
+ * used when the user declines a prefetched update
+ * 用户拒绝更新时停止预下载并删除已下载的数据
+ */
+void DownloadTask::discard()
+{
+   DownloadScheduler::getInstance()->release(this);
+   if (m_reply)
+   {
+      m_reply->disconnect(this);
+      m_reply->abort();
+      m_reply->deleteLater();
+      m_reply = 0;
+   }
+   m_writer->abort();
+   m_segmented->abort();
+   m_chunkSync->abort();
+   m_mirrorSelector->abort();
+   m_patchEngine->wait();
+   m_writerActive = false;
+
+   removePartialDownload();
+   if (m_state == Completed)
+      QFile::remove(m_downloadDir.filePath(m_fileName));
+
+   m_prefetching = false;
+   m_budgetReached = false;
+   releasePrefetchSpace();
+   if (m_state != Idle)
+      setState(Canceled);
+}
+
+/**
+ * Starts the transfer of the file registered with \c start(), once the
+ * download scheduler allows it
+ * 下载调度器允许后开始传输
+ */
+void DownloadTask::beginDownload()
+{
+   if (!DownloadScheduler::getInstance()->isActive(this))
+      return;
+
+   /* Another module may have downloaded the file while we were waiting */
+   if (takeFromCache())
+      return;
+
+   setState(Downloading);
+
+   /* Race the download URL and its mirrors before the first transfer
+    * 首次传输前探测下载地址和所有镜像，选择响应最快的一个 */
+   if (!m_mirrors.isEmpty() && !m_mirrorsRanked)
+   {
+      QList<QUrl> candidates;
+      candidates.append(m_fullUrl);
+      candidates.append(m_mirrors);
+      m_mirrorSelector->setUserAgentString(m_userAgentString);
+      m_mirrorSelector->probe(candidates);
+      return;
+   }
+
+   QUrl url = currentMirror();
+
+   /* Download the patch instead of the full file if it can be applied to
+    * the previous download, or reuse the chunks of the previous download,
+    * otherwise remove old downloads
+    * 如果可以对旧文件应用补丁，则下载补丁；如果有分块清单，则复用旧文件的分块；
+    * 否则删除可能存在的旧的下载文件 */
+   m_patching = canPatch();
+   m_downloadUrl = m_patching ? m_patchUrl : url;
+   m_resumeOffset = 0;
+   m_extracting = false;
+   m_limiter->setUserAgentString(m_userAgentString);
+   m_limiter->setProbeUrl(url);
+
+   /* Compressed files (.gz/.zst) are decompressed while they are received,
+    * so they must be downloaded as a single stream
+    * 压缩文件在接收时解压，只能使用单个连接下载 */
+   bool compressed = StreamDecoder::formatFromUrl(url) != StreamDecoder::Identity;
+   bool syncing = !m_patching && !compressed && canSync();
+   if (!m_patching && !syncing)
+      QFile::remove(m_downloadDir.filePath(m_fileName));
+
+   /* Only download the chunks that the previous download does not have
+    * 只下载旧文件中没有的分块 */
+   if (syncing)
+   {
+      removePartialDownload();
+      m_chunkSync->setMaxConnections(DownloadScheduler::getInstance()->acquireConnections(this, SYNC_CONNECTIONS));
+      m_chunkSync->setUserAgentString(m_userAgentString);
+      m_chunkSync->start(m_chunkManifest, url, m_downloadDir.filePath(m_fileName), partialFilePath());
+   }
+
+   /* Use several connections, unless we can resume a previous download (or
+    * we prefetch the file, prefetches must be resumable, or we extract the
+    * archive while it is received, which needs the data in order)
+    * 使用多个连接分段下载，除非可以继续之前的下载、正在预下载或需要边下载边解压 */
+   else if (m_segmentCount > 1 && !m_patching && !m_prefetching && !compressed && !canExtract()
+            && resumeValidator().isEmpty())
+   {
+      removePartialDownload();
+      m_segmented->setSegmentCount(DownloadScheduler::getInstance()->acquireConnections(this, m_segmentCount));
+      m_segmented->setUserAgentString(m_userAgentString);
+      m_segmented->setHashEnabled(!m_expectedChecksum.isEmpty());
+      m_segmented->setMirrors(equivalentMirrors(url));
+      m_segmented->start(url, partialFilePath());
+   }
+
+   else
+      startSingleDownload();
+}
+
+/**
+ * Downloads the file using a single connection
+ * 使用单个连接下载文件
+ */
+void DownloadTask::startSingleDownload()
+{
+   /* Give back the connections of a segmented download that fell back to a
+    * single connection */
+   DownloadScheduler::getInstance()->acquireConnections(this, 1);
+
+   /* Configure the network request 创建QNetworkRequest对象，配置URL和一些请求属性，例如重定向策略和用户代理*/
+   QNetworkRequest request(m_downloadUrl);
+   request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+   if (!m_userAgentString.isEmpty())
+      request.setRawHeader("User-Agent", m_userAgentString.toUtf8());
+
+   /* Continue a previous partial download if the server can validate it,
+    * otherwise remove the old partial download 删除可能存在的部分下载文件*/
+   if (!prepareResume(request))
+      removePartialDownload();
+
+   /* Let the server compress the file, unless we request a range of it
+    * 允许服务器压缩传输（续传时除外） */
+   m_encoding = StreamDecoder::Identity;
+   request.setRawHeader("Accept-Encoding", m_resumeOffset > 0 ? "identity" : StreamDecoder::acceptEncoding());
+
+   /* Start download, limit the memory used by the reply so that Qt stops
+    * reading from the socket while the writer thread is busy (or the rate
+    * limit is reached) */
+   m_reply = m_manager->get(request);
+   m_reply->setReadBufferSize(m_limiter->bufferSize(READ_BUFFER_SIZE));
+   m_transferStalled = false;
+   m_budgetReached = false;
+   m_received = 0;
+   m_stallTimer.start();
+
+   /* Save the data and track the progress of the download */
+   connect(m_reply, SIGNAL(metaDataChanged()), this, SLOT(metaDataChanged()));
+   connect(m_reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(updateProgress(qint64, qint64)));
+   connect(m_reply, SIGNAL(readyRead()), this, SLOT(saveFile()));
+   connect(m_reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+}
+
+/**
+ * Changes the name of the downloaded file. Compression suffixes (\c .gz and
+ * \c .zst) are removed, since such files are decompressed while downloading.
+ * 设置下载的文件名
+ */
+void DownloadTask::setFileName(const QString &file)
+{
+   m_fileName = StreamDecoder::stripSuffix(file);
+
+   if (m_fileName.isEmpty())
+      m_fileName = "QSU_Update.bin";
+}
+
+/**
+ * Changes the user-agent string used to communicate with the remote HTTP server
+ * 设置用于与远程HTTP服务器通信的用户代理字符串
+ */
+void DownloadTask::setUserAgentString(const QString &agent)
+{
+   m_userAgentString = agent;
+}
+
+/**
+ * Called when the reply of a single download has finished, waits for the
+ * writer to save the remaining data
+ * 单连接下载结束后的处理，等待写线程写完剩余数据
+ */
+void DownloadTask::replyFinished()
+{
+   m_transferFailed = m_reply->error() != QNetworkReply::NoError;
+   m_transferCanceled = m_reply->error() == QNetworkReply::OperationCanceledError && !m_transferStalled;
+   m_stallTimer.stop();
+
+   /* Hand the data that was held back to the writer and wait for it */
+   if (m_writer->isOpen())
+   {
+      while (m_reply->bytesAvailable() > 0)
+         m_writer->append(m_reply->read(READ_CHUNK_SIZE));
+
+      m_writer->finish();
+   }
+
+   else
+      writerClosed(true);
+}
+
+/**
+ * Called when the writer thread has closed the file. The signal may still be
+ * queued when the transfer is restarted or discarded, it is then ignored.
+ */
+void DownloadTask::onWriterClosed(const bool success)
+{
+   if (!m_writerActive)
+      return;
+
+   m_writerActive = false;
+   writerClosed(success);
+}
+
+/**
+ * Called when the writer thread has written all the received data to the disk
+ * 写线程完成写入后的处理
+ */
+void DownloadTask::writerClosed(const bool success)
+{
+   /* The disk failed while the download was still running */
+   if (m_reply && !m_reply->isFinished())
+   {
+      m_reply->disconnect(this);
+      m_reply->abort();
+      m_transferFailed = true;
+   }
+
+   /* The patch could not be downloaded, download the full file instead */
+   if (m_patching && (!success || (m_transferFailed && !m_transferCanceled)))
+   {
+      startFullDownload();
+      return;
+   }
+
+   if (!success)
+   {
+      DownloadScheduler::getInstance()->release(this);
+      removePartialDownload();
+      setState(Failed, WriteError);
+      return;
+   }
+
+   if (m_transferFailed)
+   {
+      /* Keep the partial file around so that the next attempt can resume */
+      if (!m_resumeEnabled)
+         removePartialDownload();
+      else
+         storeCommittedSize();
+
+      /* Continue on the next mirror, the partial file is resumed if the
+       * mirror serves the same file 切换到下一个镜像继续下载 */
+      if (!m_transferCanceled && switchMirror())
+      {
+         m_reply->deleteLater();
+         m_reply = 0;
+         beginDownload();
+         return;
+      }
+
+      DownloadScheduler::getInstance()->release(this);
+      if (m_budgetReached)
+         setState(Paused);
+      else if (m_transferCanceled)
+         setState(Canceled);
+      else
+         setState(Failed, NetworkError);
+
+      return;
+   }
+
+   if (m_reply)
+      m_reply->close();
+
+   completeDownload(m_writer->checksum());
+}
+
+/**
+ * Called when a segmented download finishes
+ * 分段下载完成后的处理
+ */
+void DownloadTask::segmentedFinished(const bool success)
+{
+   if (!success)
+   {
+      removePartialDownload();
+      if (switchMirror())
+      {
+         beginDownload();
+         return;
+      }
+
+      DownloadScheduler::getInstance()->release(this);
+      setState(Failed, NetworkError);
+      return;
+   }
+
+   completeDownload(m_segmented->checksum());
+}
+
+/**
+ * Called when the file has been rebuilt from the chunks of the previous
+ * download, downloads the full file if that was not possible
+ * 分块同步完成后的处理，失败则下载完整文件
+ */
+void DownloadTask::chunkSyncFinished(const bool success, const QByteArray &checksum)
+{
+   if (!success)
+   {
+      startFullDownload();
+      return;
+   }
+
+   completeDownload(checksum);
+}
+
+/**
+ * Renames the partial file and notifies the \c Downloader
+ * 重命名文件，发射下载完成信号
+ */
+void DownloadTask::completeDownload(const QByteArray &checksum)
+{
+   /* Make sure that we received the file described by the appcast */
+   if (!verifyDownload(checksum))
+   {
+      if (m_patching)
+      {
+         startFullDownload();
+         return;
+      }
+
+      DownloadScheduler::getInstance()->release(this);
+      removePartialDownload();
+      QDir(extractionPath() + EXTRACTING_DIR).removeRecursively();
+      setState(Failed, ChecksumError);
+      return;
+   }
+
+   /* Rebuild the new file from the previous download and the patch */
+   if (m_patching)
+   {
+      applyPatch();
+      return;
+   }
+
+   /* The transfer is over, let the next download start */
+   DownloadScheduler::getInstance()->release(this);
+
+   /* Rename file, the partial file is kept if that is not possible */
+   QFile::remove(m_downloadDir.filePath(m_fileName));
+   if (!QFile::rename(partialFilePath(), m_downloadDir.filePath(m_fileName)))
+   {
+      QDir(extractionPath() + EXTRACTING_DIR).removeRecursively();
+      m_extracting = false;
+      setState(Failed, WriteError);
+      return;
+   }
+
+   QFile::remove(partialInfoPath());
+
+   /* Share the verified file with other modules and applications */
+   DownloadCache::getInstance()->store(m_expectedChecksum, m_downloadDir.filePath(m_fileName));
+
+   /* The archive was extracted while it was received, the verified files
+    * replace the previous ones 校验通过后，用解压的文件替换旧目录 */
+   bool unpacked = false;
+   if (m_extracting && m_writer->isExtracted())
+   {
+      QDir(extractionPath()).removeRecursively();
+      unpacked = QDir().rename(extractionPath() + EXTRACTING_DIR, extractionPath());
+   }
+
+   if (m_extracting && !unpacked)
+      QDir(extractionPath() + EXTRACTING_DIR).removeRecursively();
+
+   m_extracting = false;
+
+   /* Notify the UI */
+   setState(Completed);
+   if (unpacked)
+      emit extracted(extractionPath());
+
+   emit finished(m_downloadDir.filePath(m_fileName));
+}
+
+/**
+ * Applies the downloaded patch to the previous download in the patch thread
+ * 将下载的补丁应用到旧文件
+ */
+void DownloadTask::applyPatch()
+{
+   setState(Patching);
+
+   QString patch = partialFilePath();
+   QFile::remove(partialInfoPath());
+
+   /* From now on we are dealing with the full file */
+   m_patching = false;
+   m_patchFile = patch;
+   m_patchEngine->apply(m_downloadDir.filePath(m_fileName), patch, partialFilePath());
+}
+
+/**
+ * Called when the patch thread has rebuilt the new file
+ * 补丁应用完成后的处理，校验失败则下载完整文件
+ */
+void DownloadTask::patchApplied(const bool success, const QByteArray &checksum)
+{
+   QFile::remove(m_patchFile);
+
+   /* The update was declined while the patch was applied */
+   if (m_state != Patching)
+      return;
+
+   if (!success || !verifyDownload(checksum))
+   {
+      startFullDownload();
+      return;
+   }
+
+   completeDownload(checksum);
+}
+
+/**
+ * Discards the patch (or the chunk manifest) and downloads the full file
+ * 放弃补丁或分块清单，下载完整文件
+ */
+void DownloadTask::startFullDownload()
+{
+   removePartialDownload();
+   m_patching = false;
+   m_patchUrl.clear();
+   m_chunkManifest.clear();
+   restart(m_fullUrl);
+}
+
+/**
+ * Returns \c true if a patch for the previous download is available and the
+ * result of applying it can be verified
+ */
+bool DownloadTask::canPatch() const
+{
+   if (m_patchUrl.isEmpty() || m_expectedChecksum.isEmpty())
+      return false;
+
+   return QFileInfo(m_downloadDir.filePath(m_fileName)).isFile();
+}
+
+/**
+ * Returns \c true if a chunk manifest is available and there is a previous
+ * download to take the chunks from
+ */
+bool DownloadTask::canSync() const
+{
+   if (m_chunkManifest.isEmpty())
+      return false;
+
+   return QFileInfo(m_downloadDir.filePath(m_fileName)).isFile();
+}
+
+/**
+ * Writes the downloaded data to the disk
+ * 将下载的数据写入磁盘
+ */
+void DownloadTask::saveFile()
+{
+   if (!m_reply)
+      return;
+
+   /* Check if we need to redirect */
+   QUrl url = m_reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+   if (!url.isEmpty())
+   {
+      restart(url);
+      return;
+   }
+
+   /* The remaining data is handled by replyFinished() */
+   if (m_reply->isFinished())
+      return;
+
+   /* Error pages (e.g. 404 or 500) are not part of the file, discard them
+    * 错误页面不属于下载文件，直接丢弃 */
+   QVariant status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+   if (status.isValid() && status.toInt() != 200 && status.toInt() != 206)
+   {
+      m_reply->readAll();
+      return;
+   }
+
+   /* Hand the downloaded data to the writer thread, unless it is busy or
+    * the rate limit is reached 写线程繁忙或达到速率限制时暂停读取 */
+   if (!m_writer->isOpen() && !openWriter())
+      return;
+
+   bool exhausted = false;
+   m_reply->setReadBufferSize(m_limiter->bufferSize(READ_BUFFER_SIZE));
+   while (m_reply->bytesAvailable() > 0 && !m_writer->isFull())
+   {
+      qint64 size = qMin(READ_CHUNK_SIZE, m_limiter->available());
+      if (m_prefetching && size > 0)
+      {
+         qint64 stored = m_resumeOffset + m_received;
+         qint64 granted = reservePrefetchSpace(stored + size) - stored;
+         if (granted < size)
+         {
+            size = granted;
+            exhausted = true;
+         }
+      }
+
+      if (size <= 0)
+         break;
+
+      QByteArray data = m_reply->read(size);
+      m_limiter->consume(data.size());
+      m_writer->append(data);
+      m_received += data.size();
+      m_stallTimer.start();
+   }
+
+   /* The prefetches used up their disk budget, keep the partial file until
+    * the user confirms the update 预下载达到磁盘预算后暂停 */
+   qint64 stored = m_resumeOffset + m_received;
+   if (exhausted && stored != m_throughput.total())
+   {
+      m_budgetReached = true;
+      m_reply->abort();
+   }
+}
+
+/**
+ * Opens the partial file with the writer thread, appending to it if we are
+ * resuming a previous download. If the size of the file is known (from the
+ * appcast or the \c Content-Length header), the writer allocates it upfront.
+ * 打开部分下载文件，交给写线程（已知大小时预分配磁盘空间）
+ */
+bool DownloadTask::openWriter()
+{
+   /* The Content-Length of compressed data says nothing about the file */
+   qint64 size = m_patching ? m_patchSize : m_expectedSize;
+   if (size <= 0 && m_encoding == StreamDecoder::Identity)
+   {
+      qint64 length = m_reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+      if (length > 0)
+         size = m_resumeOffset + length;
+   }
+
+   /* A prefetch may only allocate the disk space that it could reserve
+    * before the user confirms the update, the file grows past it afterwards */
+   if (m_prefetching && size > 0)
+      size = qMin(size, reservePrefetchSpace(size));
+
+   /* Unpack archives while they are written (patches are not archives) */
+   m_extracting = !m_patching && canExtract();
+   if (m_extracting)
+      m_writer->setExtraction(ArchiveExtractor::formatFromName(m_fileName), extractionPath() + EXTRACTING_DIR);
+   else
+      m_writer->setExtraction(ArchiveExtractor::None, QString());
+
+   m_writer->setHashEnabled(!m_expectedChecksum.isEmpty());
+   m_writer->setDecoding(m_encoding);
+   if (m_writer->open(partialFilePath(), m_resumeOffset > 0, size))
+   {
+      m_writerActive = true;
+      return true;
+   }
+
+   m_reply->disconnect(this);
+   m_reply->abort();
+   DownloadScheduler::getInstance()->release(this);
+   setState(Failed, WriteError);
+   return false;
+}
+
+/**
+ * Get response filename.
+ * 获取响应的文件名
+ */
+void DownloadTask::metaDataChanged()
+{
+   /* Redirects are followed by Qt, only look at the final response */
+   int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+   if (status >= 300 && status < 400)
+      return;
+
+   /* The partial file no longer matches the remote file (it is larger than
+    * the remote file), fetch the whole file again */
+   if (status == 416 && m_resumeOffset > 0)
+   {
+      removePartialDownload();
+      restart(m_fullUrl);
+      return;
+   }
+
+   /* The server ignored our range request (or the file changed), so the
+    * reply contains the whole file and the partial file must be dropped */
+   if (m_resumeOffset > 0 && status != 206)
+   {
+      m_resumeOffset = 0;
+      removePartialDownload();
+   }
+
+   /* Compressed data is decompressed by the writer thread. The partial file
+    * then holds decompressed data, so the download cannot be resumed
+    * 压缩数据由写线程解压，此时无法断点续传 */
+   if (status == 200)
+   {
+      m_encoding = StreamDecoder::formatFromEncoding(m_reply->rawHeader("Content-Encoding"));
+      if (m_encoding == StreamDecoder::Identity)
+         m_encoding = StreamDecoder::formatFromUrl(m_downloadUrl);
+   }
+
+   QString filename = "";
+   QVariant variant = m_reply->header(QNetworkRequest::ContentDispositionHeader);
+   if (variant.isValid())
+   {
+      QString contentDisposition = QByteArray::fromPercentEncoding(variant.toByteArray()).constData();
+      QRegularExpression regExp("filename=(\S+)");
+      QRegularExpressionMatch match = regExp.match(contentDisposition);
+      if (match.hasMatch())
+      {
+         filename = match.captured(1);
+      }
+      setFileName(filename);
+   }
+
+   /* Open the output file once we know its name */
+   if ((status == 200 || status == 206) && !m_writer->isOpen())
+      openWriter();
+
+   /* Remember how to validate the partial file on the next attempt (the
+    * file name of the Content-Disposition header is already applied) */
+   if (m_writer->isOpen() && m_encoding == StreamDecoder::Identity)
+      storeValidators();
+}
+
+/**
+ * Records the progress of the transfer, it is reported to the UI by
+ * \c reportProgress()
+ * 记录下载进度
+ */
+void DownloadTask::updateProgress(qint64 received, qint64 total)
+{
+   /* Account for the bytes that were already on disk before resuming */
+   if (total > 0)
+      total += m_resumeOffset;
+   received += m_resumeOffset;
+
+   m_throughput.update(received, total);
+   m_progressChanged = true;
+
+   if (m_reply && !m_reply->isFinished())
+      m_stallTimer.start();
+}
+
+/**
+ * Called once the mirrors have been probed, starts the transfer on the
+ * fastest one
+ * 镜像探测完成后，从最快的镜像开始下载
+ */
+void DownloadTask::mirrorsRanked()
+{
+   m_mirrorsRanked = true;
+   m_mirrorIndex = 0;
+   beginDownload();
+}
+
+/**
+ * Called when a single download did not receive any data for a while, aborts
+ * it so that it continues on the next mirror (see \c writerClosed())
+ * 传输停滞时中止当前连接，切换到下一个镜像
+ */
+void DownloadTask::transferStalled()
+{
+   if (!m_reply || m_reply->isFinished() || !canSwitchMirror())
+      return;
+
+   m_transferStalled = true;
+   m_reply->abort();
+}
+
+/**
+ * Emits the last recorded progress, with the current rate (in bytes per
+ * second) and the estimated remaining time (in seconds, \c -1 if unknown).
+ * The rate is reported even if no data arrived, so that stalls are visible.
+ * 定时发送下载进度、速率和剩余时间，避免频繁唤醒UI线程
+ */
+void DownloadTask::reportProgress()
+{
+   if (!m_progressChanged && !m_throughput.isValid())
+      return;
+
+   m_progressChanged = false;
+   emit progressChanged(m_throughput.received(), m_throughput.total(), m_throughput.currentRate(),
+                        m_throughput.remainingTime());
+}
+
+/**
+ * Adds the \c Range and \c If-Range headers to the \a request if a partial
+ * file from a previous attempt exists and we know the validator (ETag or
+ * Last-Modified date) that the server sent for it.
+ * 如果存在可验证的部分下载文件，则设置断点续传的请求头
+ *
+ * Returns \c true if the partial file can be kept.
+ */
+bool DownloadTask::prepareResume(QNetworkRequest &request)
+{
+   m_resumeOffset = 0;
+
+   QByteArray validator = resumeValidator();
+   if (validator.isEmpty())
+      return false;
+
+   m_resumeOffset = QFileInfo(partialFilePath()).size();
+   request.setRawHeader("Range", "bytes=" + QByteArray::number(m_resumeOffset) + "-");
+   request.setRawHeader("If-Range", validator);
+   return true;
+}
+
+/**
+ * Compares the size of the partial file and its SHA-256 digest (computed by
+ * the writer while the data was received) with the values of the appcast.
+ * 校验下载文件的大小和SHA-256值
+ */
+bool DownloadTask::verifyDownload(const QByteArray &checksum) const
+{
+   qint64 size = m_patching ? m_patchSize : m_expectedSize;
+   QByteArray expected = m_patching ? m_patchChecksum : m_expectedChecksum;
+
+   if (size > 0 && QFileInfo(partialFilePath()).size() != size)
+      return false;
+
+   if (!expected.isEmpty() && checksum.toHex() != expected)
+      return false;
+
+   return true;
+}
+
+/**
+ * Returns the validator (ETag or Last-Modified date) that allows us to resume
+ * the partial file of the current download, or an empty array if the partial
+ * file cannot be resumed.
+ */
+QByteArray DownloadTask::resumeValidator() const
+{
+   if (!m_resumeEnabled)
+      return QByteArray();
+
+   QFileInfo part(partialFilePath());
+   if (!part.exists() || part.size() <= 0)
+      return QByteArray();
+
+   /* The partial file may come from another mirror of the same file */
+   QSettings info(partialInfoPath(), QSettings::IniFormat);
+   QUrl source(info.value("url").toString());
+   if (source != m_downloadUrl && !equivalentMirrors(source).contains(m_downloadUrl))
+      return QByteArray();
+
+   /* The partial file was allocated with its final size, and the transfer
+    * was interrupted before we knew how much of it holds data */
+   if (info.value("committed", part.size()).toLongLong() != part.size())
+      return QByteArray();
+
+   /* If-Range only accepts strong validators */
+   QByteArray validator = info.value("etag").toByteArray();
+   if (validator.isEmpty() || validator.startsWith("W/"))
+      validator = info.value("last-modified").toByteArray();
+
+   return validator;
+}
+
+/**
+ * Saves the validators of the current reply next to the partial file so that
+ * an interrupted download can be resumed later.
+ * 保存ETag和Last-Modified，用于下次续传时校验部分文件
+ */
+void DownloadTask::storeValidators()
+{
+   QSettings info(partialInfoPath(), QSettings::IniFormat);
+   info.setValue("url", m_downloadUrl.toString());
+   info.setValue("etag", m_reply->rawHeader("ETag"));
+   info.setValue("last-modified", m_reply->rawHeader("Last-Modified"));
+
+   /* The size of an allocated file does not tell how much of it holds data
+    * until the writer truncates it */
+   if (m_writer->isPreallocated())
+      info.setValue("committed", m_resumeOffset);
+   else
+      info.remove("committed");
+
+   info.sync();
+}
+
+/**
+ * Records the amount of data in an allocated partial file once the writer has
+ * closed it (and truncated the space allocated for the rest of the file).
+ * Files that were not allocated upfront do not need it, their size is the
+ * amount of data.
+ * 记录预分配的部分下载文件中已写入的数据量
+ */
+void DownloadTask::storeCommittedSize()
+{
+   if (!QFile::exists(partialInfoPath()))
+      return;
+
+   QSettings info(partialInfoPath(), QSettings::IniFormat);
+   if (!info.contains("committed"))
+      return;
+
+   info.setValue("committed", QFileInfo(partialFilePath()).size());
+   info.sync();
+}
+
+/**
+ * Copies (or links) the file from the download cache if it holds a file with
+ * the expected checksum, and finishes the task. Returns \c false if the file
+ * must be downloaded.
+ * 如果下载缓存中已有该文件，则直接使用缓存的文件
+ */
+bool DownloadTask::takeFromCache()
+{
+   QString filePath = m_downloadDir.filePath(m_fileName);
+   if (!DownloadCache::getInstance()->materialize(m_expectedChecksum, m_expectedSize, filePath))
+      return false;
+
+   DownloadScheduler::getInstance()->release(this);
+
+   m_patching = false;
+   m_resumeOffset = 0;
+   removePartialDownload();
+
+   m_throughput.reset();
+   updateProgress(QFileInfo(filePath).size(), QFileInfo(filePath).size());
+   setState(Completed);
+   emit finished(filePath);
+   return true;
+}
+
+/**
+ * Stops the writer, which truncates the partial file to the data received
+ * without gaps, and records that size so that the download can be resumed
+ * 停止写线程并记录部分文件中已写入的数据量
+ */
+void DownloadTask::abortWriter()
+{
+   m_writer->abort();
+   m_writerActive = false;
+
+   if (m_resumeEnabled)
+      storeCommittedSize();
+}
+
+/**
+ * Removes the partial file and its validator information
+ * 删除部分下载文件及其校验信息
+ */
+void DownloadTask::removePartialDownload()
+{
+   QFile::remove(partialFilePath());
+   QFile::remove(partialInfoPath());
+}
+
+/**
+ * Returns the path of the file that holds the data received so far
+ */
+QString DownloadTask::partialFilePath() const
+{
+   return m_downloadDir.filePath(downloadName() + PARTIAL_DOWN);
+}
+
+/**
+ * Returns the path of the file that stores the validators of the partial file
+ */
+QString DownloadTask::partialInfoPath() const
+{
+   return m_downloadDir.filePath(downloadName() + PARTIAL_INFO);
+}
+
+/**
+ * Returns the directory that receives the contents of the downloaded archive
+ */
+QString DownloadTask::extractionPath() const
+{
+   return m_downloadDir.filePath(ArchiveExtractor::directoryName(m_fileName));
+}
+
+/**
+ * Returns \c true if the downloaded file is an archive that must be extracted
+ */
+bool DownloadTask::canExtract() const
+{
+   return m_extractArchives && ArchiveExtractor::formatFromName(m_fileName) != ArchiveExtractor::None;
+}
+
+/**
+ * Returns the name of the file that is being downloaded (the update file or
+ * the patch for the update file)
+ */
+QString DownloadTask::downloadName() const
+{
+   return m_patching ? m_fileName + PATCH_FILE : m_fileName;
+}
+
+/**
+ * Returns the URL of the full file on the mirror that is currently used
+ */
+QUrl DownloadTask::currentMirror() const
+{
+   QList<QUrl> mirrors = m_mirrorSelector->mirrors();
+   if (!m_mirrorsRanked || m_mirrorIndex >= mirrors.count())
+      return m_fullUrl;
+
+   return mirrors.at(m_mirrorIndex);
+}
+
+/**
+ * Returns \c true if the full file is downloaded and there is another mirror
+ * left to try
+ */
+bool DownloadTask::canSwitchMirror() const
+{
+   if (!m_mirrorsRanked || m_patching)
+      return false;
+
+   return m_mirrorIndex + 1 < m_mirrorSelector->mirrors().count();
+}
+
+/**
+ * Moves on to the next (slower) mirror, returns \c false if there is none
+ */
+bool DownloadTask::switchMirror()
+{
+   if (!canSwitchMirror())
+      return false;
+
+   ++m_mirrorIndex;
+   return true;
+}
+
+/**
+ * Returns the mirrors that serve exactly the same file as the given \a url
+ * (same size and strong ETag), the fastest first. Data from different
+ * mirrors is only combined if the SHA-256 digest of the file is known, so
+ * that the result can be verified.
+ */
+QList<QUrl> DownloadTask::equivalentMirrors(const QUrl &url) const
+{
+   QList<QUrl> mirrors;
+   if (!m_mirrorsRanked || m_expectedChecksum.isEmpty())
+      return mirrors;
+
+   foreach (const QUrl &mirror, m_mirrorSelector->mirrors())
+   {
+      if (mirror != url && m_mirrorSelector->isInterchangeable(url, mirror))
+         mirrors.append(mirror);
+   }
+
+   return mirrors;
+}
+
+/**
+ * Grows the disk space reserved by this prefetch to \a bytes, as far as the
+ * budget shared by all the prefetches allows, and returns the space that is
+ * now reserved
+ */
+qint64 DownloadTask::reservePrefetchSpace(const qint64 bytes)
+{
+   QMutexLocker locker(&PREFETCH_MUTEX);
+
+   qint64 wanted = bytes - m_prefetchReserved;
+   if (wanted > 0 && PREFETCH_BUDGET > 0)
+      wanted = qMin(wanted, qMax<qint64>(0, PREFETCH_BUDGET - PREFETCH_RESERVED));
+
+   if (wanted > 0)
+   {
+      m_prefetchReserved += wanted;
+      PREFETCH_RESERVED += wanted;
+   }
+
+   return m_prefetchReserved;
+}
+
+/**
+ * Returns the disk space reserved by this prefetch to the shared budget
+ */
+void DownloadTask::releasePrefetchSpace()
+{
+   QMutexLocker locker(&PREFETCH_MUTEX);
+   PREFETCH_RESERVED -= m_prefetchReserved;
+   m_prefetchReserved = 0;
+}
+
+/**
+ * Returns the priority used to queue the download in the download scheduler
+ */
+int DownloadTask::priority() const
+{
+   if (m_prefetching)
+      return DownloadScheduler::Background;
+
+   if (m_mandatoryUpdate)
+      return DownloadScheduler::Mandatory;
+
+   return m_backgroundDownload ? DownloadScheduler::Background : DownloadScheduler::Foreground;
+}
+
+/**
+ * Reports the progress recorded so far and the new \a state to the UI. The
+ * progress and stall timers only run while data is being received.
+ */
+void DownloadTask::setState(const State state, const Error error)
+{
+   reportProgress();
+
+   if (state == Downloading)
+      m_progressTimer.start();
+   else
+   {
+      m_progressTimer.stop();
+      m_stallTimer.stop();
+   }
+
+   /* The next attempt races the mirrors again */
+   if (state == Failed)
+      m_mirrorsRanked = false;
+
+   m_state = state;
+   emit stateChanged(state, error);
+}
+
+/**
+ * 设置下载目录
+ */
+void DownloadTask::setDownloadDir(const QString &downloadDir)
+{
+   if (m_downloadDir.absolutePath() != downloadDir)
+      m_downloadDir.setPath(downloadDir);
+}
+
+/**
+ * Mandatory downloads are started before the downloads of other updaters
+ * 设置是否是强制更新
+ */
+void DownloadTask::setMandatoryUpdate(const bool mandatory_update)
+{
+   m_mandatoryUpdate = mandatory_update;
+}
+
+/**
+ * If \a resume is set to \c true, the partial file of an interrupted download
+ * is kept and continued with a HTTP range request (see \c Downloader).
+ * 设置是否启用断点续传
+ */
+void DownloadTask::setResumeDownloads(const bool resume)
+{
+   m_resumeEnabled = resume;
+}
+
+/**
+ * Changes the maximum number of parallel connections used to download a file
+ * 设置分段下载使用的最大连接数
+ */
+void DownloadTask::setSegmentCount(const int count)
+{
+   m_segmentCount = qMax(1, count);
+}
+
+/**
+ * Background downloads are started after the downloads of other updaters
+ * 设置是否为后台下载
+ */
+void DownloadTask::setBackgroundDownload(const bool background)
+{
+   m_backgroundDownload = background;
+}
+
+/**
+ * Limits the download rate to the given number of bytes per second, a value
+ * of \c 0 removes the limit
+ * 设置最大下载速率（字节/秒），0表示不限速
+ */
+void DownloadTask::setMaxDownloadRate(const qint64 bytesPerSecond)
+{
+   m_limiter->setMaxRate(bytesPerSecond);
+}
+
+/**
+ * Enables or disables the adaptive throttling of the rate limiter
+ * 设置是否根据网络延迟自动降低下载速率
+ */
+void DownloadTask::setAdaptiveThrottling(const bool adaptive)
+{
+   m_limiter->setAdaptive(adaptive);
+}
+
+/**
+ * Changes the SHA-256 digest (as a hex string) and the \a size in bytes that
+ * the downloaded file must have
+ * 设置下载文件预期的SHA-256值和大小
+ */
+void DownloadTask::setExpectedChecksum(const QString &sha256, const qint64 size)
+{
+   m_expectedSize = size;
+   m_expectedChecksum = sha256.trimmed().toLower().toLatin1();
+}
+
+/**
+ * Registers a binary patch that turns the previously downloaded file into the
+ * new file, pass an empty \a url to disable patching
+ * 设置可应用于旧文件的二进制补丁
+ */
+void DownloadTask::setPatch(const QUrl &url, const QString &sha256, const qint64 size)
+{
+   m_patchUrl = url;
+   m_patchSize = size;
+   m_patchChecksum = sha256.trimmed().toLower().toLatin1();
+}
+
+/**
+ * Changes the URL of the chunk manifest of the file, pass an empty \a url to
+ * disable chunk synchronization
+ * 设置分块清单的URL
+ */
+void DownloadTask::setChunkManifest(const QUrl &url)
+{
+   m_chunkManifest = url;
+}
+
+/**
+ * Changes the other URLs (mirrors) of the full file, they are ranked again
+ * before the next transfer
+ * 设置完整文件的镜像列表
+ */
+void DownloadTask::setMirrors(const QStringList &mirrors)
+{
+   QList<QUrl> urls;
+   foreach (const QString &mirror, mirrors)
+   {
+      if (!mirror.isEmpty())
+         urls.append(QUrl(mirror));
+   }
+
+   if (urls != m_mirrors)
+   {
+      m_mirrors = urls;
+      m_mirrorsRanked = false;
+   }
+}
+
+/**
+ * If \a extract is \c true, tar and zip archives (also compressed with gzip
+ * or zstd) are extracted while they are downloaded
+ * 设置是否在下载归档文件时同时解压
+ */
+void DownloadTask::setExtractArchives(const bool extract)
+{
+   m_extractArchives = extract;
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_DownloadTask.cpp"
+#endif
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_DOWNLOAD_TASK_H
+#define _QSIMPLEUPDATER_DOWNLOAD_TASK_H
+
+#include <QDir>
+#include <QUrl>
+#include <QList>
+#include <QTimer>
+#include <QObject>
+
+#include <QSimpleUpdater.h>
+
+#include "StreamDecoder.h"
+#include "ThroughputEstimator.h"
+
+class QThread;
+class QNetworkReply;
+class QNetworkRequest;
+class QNetworkAccessManager;
+class ChunkSync;
+class PatchEngine;
+class RateLimiter;
+class DownloadWriter;
+class MirrorSelector;
+class SegmentedDownload;
+
+/**
+ * \brief Downloads, verifies and patches an update file without any UI
+ *
+ * The task owns every object that touches the network or the disk (writer,
+ * patch engine, segmented download, chunk synchronization and rate limiter),
+ * they all send their requests through the network manager shared by the
+ * thread of the task (see \c NetworkManager). It only talks to the outside
+ * world through its slots and signals, so it can be moved to another thread
+ * (see \c workerThread()): the \c Downloader dialog then receives the state
+ * changes and the progress through queued connections. The progress (with
+ * the rate and remaining time measured by a \c ThroughputEstimator) is
+ * coalesced and reported at most every \c 100 ms, so the UI thread does not
+ * wake up for every received block.
+ *
+ * If the file has mirrors, they are ranked by a \c MirrorSelector before the
+ * first transfer. A transfer that fails or stalls continues on the next
+ * mirror, from the current offset if both mirrors serve the same file.
+ *
+ * A task can also prefetch the file before the user confirms the update
+ * (\c prefetch()): it then runs with the background priority, uses a single
+ * resumable stream and pauses once all the prefetches together have stored
+ * \c prefetchBudget() bytes.
+ * Calling \c start() with the same URL turns it into a normal download.
+ *
+ * If archive extraction is enabled, tar and zip files downloaded as a single
+ * stream are unpacked by the writer thread while they arrive. The files go
+ * to a staging directory that only replaces the final directory (and emits
+ * \c extracted()) once the checksum of the archive has been verified.
+ */
+class DownloadTask : public QObject
+{
+   Q_OBJECT
+
+public:
+   /* Same values as the public QSimpleUpdater::DownloadState */
+   enum State
+   {
+      Idle = QSimpleUpdater::Idle,
+      Waiting = QSimpleUpdater::Waiting,
+      Downloading = QSimpleUpdater::Downloading,
+      Patching = QSimpleUpdater::Patching,
+      Completed = QSimpleUpdater::Completed,
+      Failed = QSimpleUpdater::Failed,
+      Canceled = QSimpleUpdater::Canceled,
+      Paused = QSimpleUpdater::Paused
+   };
+
+   enum Error
+   {
+      NoError,
+      WriteError,
+      ChecksumError,
+      NetworkError
+   };
+
+signals:
+   void stateChanged(int state, int error);
+   void progressChanged(qint64 received, qint64 total, qreal rate, qint64 remainingTime);
+   void finished(const QString &filePath);
+   void extracted(const QString &directory);
+
+public:
+   explicit DownloadTask(QNetworkAccessManager *manager, QObject *parent = 0);
+   ~DownloadTask();
+
+   static bool useWorkerThread();
+   static void setUseWorkerThread(const bool enabled);
+   static QThread *workerThread();
+   static qint64 prefetchBudget();
+   static void setPrefetchBudget(const qint64 bytes);
+
+public slots:
+   void start(const QUrl &url);
+   void prefetch(const QUrl &url);
+   void confirmPrefetch();
+   void cancel();
+   void discard();
+   void setFileName(const QString &file);
+   void setUserAgentString(const QString &agent);
+   void setDownloadDir(const QString &downloadDir);
+   void setMandatoryUpdate(const bool mandatory_update);
+   void setResumeDownloads(const bool resume);
+   void setSegmentCount(const int count);
+   void setBackgroundDownload(const bool background);
+   void setMaxDownloadRate(const qint64 bytesPerSecond);
+   void setAdaptiveThrottling(const bool adaptive);
+   void setExpectedChecksum(const QString &sha256, const qint64 size);
+   void setPatch(const QUrl &url, const QString &sha256, const qint64 size);
+   void setChunkManifest(const QUrl &url);
+   void setMirrors(const QStringList &mirrors);
+   void setExtractArchives(const bool extract);
+
+private slots:
+   void saveFile();
+   void replyFinished();
+   void metaDataChanged();
+   void beginDownload();
+   void startSingleDownload();
+   void reportProgress();
+   void onWriterClosed(const bool success);
+   void patchApplied(const bool success, const QByteArray &checksum);
+   void segmentedFinished(const bool success);
+   void chunkSyncFinished(const bool success, const QByteArray &checksum);
+   void updateProgress(qint64 received, qint64 total);
+   void mirrorsRanked();
+   void transferStalled();
+
+private:
+   void restart(const QUrl &url);
+   int priority() const;
+   QString partialFilePath() const;
+   QString partialInfoPath() const;
+   QString extractionPath() const;
+   bool canExtract() const;
+   void removePartialDownload();
+   bool openWriter();
+   bool canPatch() const;
+   bool canSync() const;
+   void applyPatch();
+   void startFullDownload();
+   QString downloadName() const;
+   QUrl currentMirror() const;
+   bool canSwitchMirror() const;
+   bool switchMirror();
+   QList<QUrl> equivalentMirrors(const QUrl &url) const;
+   void completeDownload(const QByteArray &checksum);
+   bool verifyDownload(const QByteArray &checksum) const;
+   QByteArray resumeValidator() const;
+   bool prepareResume(QNetworkRequest &request);
+   void storeValidators();
+   void storeCommittedSize();
+   void abortWriter();
+   void writerClosed(const bool success);
+   bool takeFromCache();
+   qint64 reservePrefetchSpace(const qint64 bytes);
+   void releasePrefetchSpace();
+   void setState(const State state, const Error error = NoError);
+
+private:
+   QUrl m_fullUrl;
+   QUrl m_patchUrl;
+   QUrl m_chunkManifest;
+   QUrl m_downloadUrl;
+   QList<QUrl> m_mirrors;
+   QString m_patchFile;
+   QDir m_downloadDir;
+   QString m_fileName;
+   QString m_userAgentString;
+
+   State m_state;
+   bool m_mandatoryUpdate;
+   bool m_backgroundDownload;
+   bool m_resumeEnabled;
+   qint64 m_resumeOffset;
+   int m_segmentCount;
+   StreamDecoder::Format m_encoding;
+   qint64 m_expectedSize;
+   QByteArray m_expectedChecksum;
+   bool m_patching;
+   bool m_transferFailed;
+   bool m_transferCanceled;
+   bool m_transferStalled;
+   bool m_prefetching;
+   bool m_budgetReached;
+   qint64 m_prefetchReserved;
+   qint64 m_received;
+   bool m_mirrorsRanked;
+   int m_mirrorIndex;
+   bool m_extractArchives;
+   bool m_extracting;
+   bool m_writerActive;
+   qint64 m_patchSize;
+   QByteArray m_patchChecksum;
+
+   bool m_progressChanged;
+   ThroughputEstimator m_throughput;
+   QTimer m_progressTimer;
+   QTimer m_stallTimer;
+
+   QNetworkReply *m_reply;
+   QNetworkAccessManager *m_manager;
+   PatchEngine *m_patchEngine;
+   DownloadWriter *m_writer;
+   SegmentedDownload *m_segmented;
+   ChunkSync *m_chunkSync;
+   RateLimiter *m_limiter;
+   MirrorSelector *m_mirrorSelector;
+};
+
+#endif
@@ -0,0 +1,663 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStorageInfo>
+
+#if defined Q_OS_LINUX
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <string.h>
+#endif
+
+#include "DownloadWriter.h"
+
+/* Default amount of memory that may be waiting to be written */
+static const qint64 DEFAULT_CAPACITY = 8 * 1024 * 1024;
+
+/* Wait for this many bytes (or for the timeout) before writing */
+static const qint64 COALESCE_SIZE = 512 * 1024;
+static const unsigned long COALESCE_TIMEOUT = 100;
+
+/* Largest buffer passed to a single write() call */
+static const qint64 MAX_WRITE_SIZE = 4 * 1024 * 1024;
+
+/* Block size used when data has to be read back to be hashed */
+static const qint64 HASH_READ_SIZE = 1024 * 1024;
+
+DownloadWriter::DownloadWriter(QObject *parent)
+   : QThread(parent)
+   , m_hash(QCryptographicHash::Sha256)
+{
+   m_open = false;
+   m_full = false;
+   m_aborted = false;
+   m_finishing = false;
+   m_queued = 0;
+   m_position = 0;
+   m_written = 0;
+   m_committed = 0;
+   m_preallocated = false;
+   m_capacity = DEFAULT_CAPACITY;
+   m_hashed = 0;
+   m_hashPrefix = 0;
+   m_hashEnabled = false;
+   m_decoding = StreamDecoder::Identity;
+   m_decoded = 0;
+   m_extractFormat = ArchiveExtractor::None;
+   m_extractPrefix = 0;
+   m_extracted = 0;
+   m_extractionDone = false;
+}
+
+DownloadWriter::~DownloadWriter()
+{
+   abort();
+}
+
+/**
+ * Returns \c true if the output file is open and accepts new data
+ */
+bool DownloadWriter::isOpen() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_open && !m_finishing;
+}
+
+/**
+ * Returns \c true if the queue is full. The producer should wait for the
+ * \c drained() signal before handing more data to the writer.
+ */
+bool DownloadWriter::isFull() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_queued >= m_capacity;
+}
+
+/**
+ * Returns the maximum number of bytes that may be waiting to be written
+ */
+qint64 DownloadWriter::capacity() const
+{
+   return m_capacity;
+}
+
+/**
+ * Returns a description of the last I/O error
+ */
+QString DownloadWriter::errorString() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_errorString;
+}
+
+/**
+ * Returns the SHA-256 digest of the file, available after \c closed() has
+ * been emitted if hashing was enabled
+ */
+QByteArray DownloadWriter::checksum() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_checksum;
+}
+
+/**
+ * Returns \c true if the archive was completely extracted, available after
+ * \c closed() has been emitted if an extraction was requested
+ */
+bool DownloadWriter::isExtracted() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_extractionDone;
+}
+
+/**
+ * Returns \c true if the file was allocated with its final size when it was
+ * opened, in which case its size says nothing about the received data until
+ * it is closed
+ */
+bool DownloadWriter::isPreallocated() const
+{
+   QMutexLocker locker(&m_mutex);
+   return m_open && m_preallocated;
+}
+
+/**
+ * Opens the file at \a path and starts the writer thread. If \a append is
+ * \c true, new data is written after the current end of the file, otherwise
+ * the file is truncated. If \a size is positive, the file is allocated with
+ * that size (after checking the free disk space), so that data can be
+ * written at any offset.
+ * 打开输出文件，预分配磁盘空间并启动写线程
+ */
+bool DownloadWriter::open(const QString &path, const bool append, const qint64 size)
+{
+   abort();
+
+   QIODevice::OpenMode mode = QIODevice::ReadWrite;
+   if (!append)
+      mode |= QIODevice::Truncate;
+
+   /* Compressed data can only be appended to a new file */
+   if (m_decoding != StreamDecoder::Identity && (append || !m_decoder.init(m_decoding)))
+   {
+      m_errorString = m_decoder.errorString();
+      return false;
+   }
+
+   m_file.setFileName(path);
+   if (!m_file.open(mode))
+   {
+      m_errorString = m_file.errorString();
+      return false;
+   }
+
+   /* Data that is already in the file is kept */
+   m_written = append ? m_file.size() : 0;
+   m_committed = m_written;
+   m_ahead.clear();
+   m_preallocated = size > m_written;
+   if (m_preallocated && !preallocate(size))
+   {
+      m_file.close();
+      return false;
+   }
+
+   m_open = true;
+   m_full = false;
+   m_aborted = false;
+   m_finishing = false;
+   m_queued = 0;
+   m_position = m_written;
+   m_decoded = 0;
+   m_errorString.clear();
+
+   /* Data that is already in the file is hashed before the new data */
+   m_hash.reset();
+   m_hashed = 0;
+   m_unhashed.clear();
+   m_checksum.clear();
+   m_hashPrefix = append ? m_position : 0;
+
+   /* The archive is extracted again from its start */
+   m_extractPrefix = append ? m_position : 0;
+   m_extracted = 0;
+   m_extractionDone = false;
+
+   start();
+   return true;
+}
+
+/**
+ * Queues \a data to be written after the previously appended data
+ * 将数据加入写队列（追加）
+ */
+void DownloadWriter::append(const QByteArray &data)
+{
+   QMutexLocker locker(&m_mutex);
+   enqueue(m_position, data);
+}
+
+/**
+ * Queues \a data to be written at the given \a offset of the file
+ * 将数据加入写队列（指定位置）
+ */
+void DownloadWriter::write(const qint64 offset, const QByteArray &data)
+{
+   QMutexLocker locker(&m_mutex);
+   enqueue(offset, data);
+}
+
+/**
+ * Adds a chunk to the queue, the mutex must be locked by the caller
+ */
+void DownloadWriter::enqueue(const qint64 offset, const QByteArray &data)
+{
+   if (!m_open || m_finishing || data.isEmpty())
+      return;
+
+   Chunk chunk;
+   chunk.offset = offset;
+   chunk.data = data;
+   m_queue.enqueue(chunk);
+
+   m_queued += data.size();
+   m_position = qMax(m_position, offset + data.size());
+   if (m_queued >= m_capacity)
+      m_full = true;
+
+   m_condition.wakeOne();
+}
+
+/**
+ * Changes the maximum number of bytes that may be waiting to be written
+ */
+void DownloadWriter::setCapacity(const qint64 bytes)
+{
+   m_capacity = qMax(COALESCE_SIZE, bytes);
+}
+
+/**
+ * If \a enabled is \c true, the SHA-256 digest of the file is computed while
+ * it is written. Must be called before \c open().
+ * 设置是否在写入时计算SHA-256校验值
+ */
+void DownloadWriter::setHashEnabled(const bool enabled)
+{
+   m_hashEnabled = enabled;
+}
+
+/**
+ * If \a format is not \c StreamDecoder::Identity, the appended data is
+ * decompressed before it is written. Must be called before \c open(), and
+ * cannot be combined with \c write() or appending to an existing file.
+ * 设置写入前对数据进行解压的格式
+ */
+void DownloadWriter::setDecoding(const StreamDecoder::Format format)
+{
+   m_decoding = format;
+}
+
+/**
+ * If \a format is not \c ArchiveExtractor::None, the data of the file is
+ * extracted into \a directory while it is written. Must be called before
+ * \c open(), and only works with data that is written in order.
+ * 设置下载时同时解压归档文件的格式和目录
+ */
+void DownloadWriter::setExtraction(const ArchiveExtractor::Format format, const QString &directory)
+{
+   m_extractFormat = format;
+   m_extractDir = directory;
+}
+
+/**
+ * Writes the remaining data, closes the file and emits \c closed()
+ * 写入剩余数据并关闭文件
+ */
+void DownloadWriter::finish()
+{
+   QMutexLocker locker(&m_mutex);
+   m_finishing = true;
+   m_condition.wakeOne();
+}
+
+/**
+ * Discards the queued data and closes the file without emitting \c closed().
+ * An allocated file is truncated to the data written without gaps, so that
+ * it can be resumed.
+ */
+void DownloadWriter::abort()
+{
+   {
+      QMutexLocker locker(&m_mutex);
+      m_aborted = true;
+      m_queue.clear();
+      m_queued = 0;
+      m_condition.wakeOne();
+   }
+
+   wait();
+
+   if (m_file.isOpen())
+   {
+      /* Drop the allocated space that did not receive any data */
+      if (m_preallocated && m_file.flush() && m_file.size() > m_committed)
+         m_file.resize(m_committed);
+
+      m_file.close();
+   }
+
+   /* Remove the files of an interrupted extraction */
+   m_extractor.abort();
+
+   m_open = false;
+}
+
+/**
+ * Writer thread: waits until enough data is queued (or the timeout expires)
+ * and writes everything that is queued at once.
+ * 写线程：合并队列中的数据块后写入磁盘
+ */
+void DownloadWriter::run()
+{
+   bool success = true;
+
+   /* Hash the data of the resumed download (read once) */
+   if (m_hashEnabled && m_hashPrefix > 0)
+      success = hashFromFile(0, m_hashPrefix);
+
+   /* Extract the data of the resumed download before the new data */
+   if (success && m_extractFormat != ArchiveExtractor::None)
+   {
+      if (m_extractor.open(m_extractFormat, m_extractDir))
+         extractFromFile(m_extractPrefix);
+   }
+
+   while (success)
+   {
+      QList<Chunk> chunks;
+      qint64 bytes = 0;
+
+      {
+         QMutexLocker locker(&m_mutex);
+         while (m_queued < COALESCE_SIZE && !m_finishing && !m_aborted)
+         {
+            if (!m_condition.wait(&m_mutex, COALESCE_TIMEOUT) && m_queued > 0)
+               break;
+         }
+
+         if (m_aborted)
+            return;
+
+         if (m_queue.isEmpty() && m_finishing)
+            break;
+
+         chunks = m_queue;
+         m_queue.clear();
+         foreach (const Chunk &chunk, chunks)
+            bytes += chunk.data.size();
+      }
+
+      success = writeChunks(chunks);
+
+      bool wasFull = false;
+      {
+         QMutexLocker locker(&m_mutex);
+         m_queued -= bytes;
+         if (!success)
+            m_errorString = m_file.errorString();
+
+         /* Ask the producer to continue once half of the queue is free */
+         if (m_full && m_queued < m_capacity / 2)
+         {
+            m_full = false;
+            wasFull = true;
+         }
+      }
+
+      if (!success)
+         break;
+
+      if (wasFull)
+         emit drained();
+   }
+
+   /* The compressed stream was truncated */
+   if (success && m_decoding != StreamDecoder::Identity && !m_decoder.isFinished())
+      success = false;
+
+   if (!m_file.flush())
+      success = false;
+
+   /* Drop the allocated space that did not receive any data */
+   if (m_preallocated && m_file.size() > m_committed && !m_file.resize(m_committed))
+      success = false;
+
+   QByteArray checksum;
+   if (m_hashEnabled && success)
+      checksum = m_hash.result();
+
+   /* Keep the extracted files only if the whole archive was received */
+   bool extracted = false;
+   if (success && m_extractor.format() != ArchiveExtractor::None)
+      extracted = m_extractor.finish();
+   else
+      m_extractor.abort();
+
+   m_file.close();
+
+   {
+      QMutexLocker locker(&m_mutex);
+      m_open = false;
+      m_checksum = checksum;
+      m_extractionDone = extracted;
+      m_queue.clear();
+      m_queued = 0;
+   }
+
+   emit closed(success);
+}
+
+/**
+ * Writes the queued \a chunks, decompressing them first if needed
+ */
+bool DownloadWriter::writeChunks(const QList<Chunk> &chunks)
+{
+   if (m_decoding == StreamDecoder::Identity)
+      return writeBlocks(chunks);
+
+   /* Write the decompressed data after the data decompressed so far */
+   Chunk decoded;
+   decoded.offset = m_decoded;
+   foreach (const Chunk &chunk, chunks)
+   {
+      if (!m_decoder.decode(chunk.data, &decoded.data))
+         return false;
+   }
+
+   m_decoded += decoded.data.size();
+   if (decoded.data.isEmpty())
+      return true;
+
+   return writeBlocks(QList<Chunk>() << decoded);
+}
+
+/**
+ * Merges consecutive \a chunks into large buffers and writes them
+ */
+bool DownloadWriter::writeBlocks(const QList<Chunk> &chunks)
+{
+   int i = 0;
+   while (i < chunks.count())
+   {
+      qint64 offset = chunks.at(i).offset;
+      QByteArray buffer = chunks.at(i).data;
+      ++i;
+
+      while (i < chunks.count() && chunks.at(i).offset == offset + buffer.size()
+             && buffer.size() + chunks.at(i).data.size() <= MAX_WRITE_SIZE)
+      {
+         buffer.append(chunks.at(i).data);
+         ++i;
+      }
+
+      if (m_file.pos() != offset && !m_file.seek(offset))
+         return false;
+
+      if (m_file.write(buffer) != buffer.size())
+         return false;
+
+      m_written = qMax(m_written, offset + buffer.size());
+      commitWritten(offset, offset + buffer.size());
+
+      if (m_hashEnabled && !hashWritten(offset, buffer))
+         return false;
+
+      extractWritten(offset, buffer);
+   }
+
+   return true;
+}
+
+/**
+ * Adds the \a data written at \a offset to the digest. If there is a gap
+ * before the data, it is hashed later (see \c hashFromFile()).
+ * 将写入的数据加入SHA-256计算
+ */
+bool DownloadWriter::hashWritten(const qint64 offset, const QByteArray &data)
+{
+   qint64 end = offset + data.size();
+
+   if (offset <= m_hashed && end > m_hashed)
+   {
+      m_hash.addData(data.constData() + (m_hashed - offset), int(end - m_hashed));
+      m_hashed = end;
+   }
+
+   else if (offset > m_hashed)
+      m_unhashed.insert(offset, qMax(end, m_unhashed.value(offset)));
+
+   /* Hash the data that was written ahead once the gap is filled */
+   while (!m_unhashed.isEmpty() && m_unhashed.firstKey() <= m_hashed)
+   {
+      qint64 rangeEnd = m_unhashed.first();
+      m_unhashed.erase(m_unhashed.begin());
+
+      if (rangeEnd > m_hashed && !hashFromFile(m_hashed, rangeEnd))
+         return false;
+   }
+
+   return true;
+}
+
+/**
+ * Reads the data between \a from and \a to back from the file and adds it
+ * to the digest
+ */
+bool DownloadWriter::hashFromFile(const qint64 from, const qint64 to)
+{
+   if (!m_file.flush() || !m_file.seek(from))
+      return false;
+
+   qint64 position = from;
+   while (position < to)
+   {
+      QByteArray data = m_file.read(qMin(HASH_READ_SIZE, to - position));
+      if (data.isEmpty())
+         return false;
+
+      m_hash.addData(data);
+      position += data.size();
+   }
+
+   m_hashed = to;
+   return true;
+}
+
+/**
+ * Passes the \a data written at \a offset to the archive extractor. The
+ * extraction is stopped (without failing the download) if the archive is not
+ * valid or the data does not arrive in order.
+ * 将写入的数据交给解压器
+ */
+void DownloadWriter::extractWritten(const qint64 offset, const QByteArray &data)
+{
+   if (m_extractor.format() == ArchiveExtractor::None)
+      return;
+
+   if (offset != m_extractPrefix + m_extracted)
+   {
+      m_extractor.abort();
+      return;
+   }
+
+   m_extracted += data.size();
+   m_extractor.write(data.constData(), data.size());
+}
+
+/**
+ * Reads the data before \a to back from the file and passes it to the
+ * archive extractor, used when a download is resumed
+ */
+void DownloadWriter::extractFromFile(const qint64 to)
+{
+   if (to <= 0 || !m_file.flush() || !m_file.seek(0))
+      return;
+
+   qint64 position = 0;
+   while (position < to && m_extractor.format() != ArchiveExtractor::None)
+   {
+      QByteArray data = m_file.read(qMin(HASH_READ_SIZE, to - position));
+      if (data.isEmpty())
+      {
+         m_extractor.abort();
+         return;
+      }
+
+      m_extractor.write(data.constData(), data.size());
+      position += data.size();
+   }
+}
+
+/**
+ * Records that the data between \a offset and \a end was written. Data
+ * written after a gap is only committed once the gap is filled.
+ */
+void DownloadWriter::commitWritten(const qint64 offset, const qint64 end)
+{
+   if (offset > m_committed)
+   {
+      m_ahead.insert(offset, qMax(end, m_ahead.value(offset)));
+      return;
+   }
+
+   m_committed = qMax(m_committed, end);
+   while (!m_ahead.isEmpty() && m_ahead.firstKey() <= m_committed)
+   {
+      m_committed = qMax(m_committed, m_ahead.first());
+      m_ahead.erase(m_ahead.begin());
+   }
+}
+
+/**
+ * Checks that the disk has room for the file and allocates it with the given
+ * \a size. On Linux, the blocks are reserved with \c posix_fallocate(),
+ * which lets the file system allocate them contiguously; other systems (or
+ * file systems without support for it) resize the file instead.
+ * 检查剩余磁盘空间并预分配文件
+ */
+bool DownloadWriter::preallocate(const qint64 size)
+{
+   qint64 current = m_file.size();
+
+   QStorageInfo storage(QFileInfo(m_file.fileName()).absolutePath());
+   if (storage.isValid() && storage.bytesAvailable() < size - current)
+   {
+      m_errorString = "Not enough free disk space";
+      return false;
+   }
+
+#if defined Q_OS_LINUX
+   int error = posix_fallocate(m_file.handle(), current, size - current);
+   if (error == 0)
+      return true;
+
+   if (error != EINVAL && error != EOPNOTSUPP)
+   {
+      m_errorString = QString::fromLocal8Bit(strerror(error));
+      return false;
+   }
+#endif
+
+   if (!m_file.resize(size))
+   {
+      m_errorString = m_file.errorString();
+      return false;
+   }
+
+   return true;
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_DownloadWriter.cpp"
+#endif
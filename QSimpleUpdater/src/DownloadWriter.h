@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_DOWNLOAD_WRITER_H
+#define _QSIMPLEUPDATER_DOWNLOAD_WRITER_H
+
+#include <QMap>
+#include <QFile>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QByteArray>
+#include <QWaitCondition>
+#include <QCryptographicHash>
+
+#include "StreamDecoder.h"
+#include "ArchiveExtractor.h"
+
+/**
+ * \brief Writes downloaded data to the disk from a dedicated thread
+ *
+ * The \c DownloadWriter keeps the output file open for the whole transfer and
+ * receives the downloaded buffers through a bounded queue. The writer thread
+ * coalesces consecutive buffers into large writes, so that the GUI thread
+ * never blocks on the disk.
+ *
+ * When the queue is full, \c isFull() returns \c true and the producer should
+ * stop reading from the socket until the \c drained() signal is emitted.
+ *
+ * If hashing is enabled, the SHA-256 digest of the file is computed while the
+ * data is written. Data written ahead of the hashed part (e.g. by a segmented
+ * download) is read back once the gap before it has been filled.
+ *
+ * Appended data can also be decompressed by the writer thread (see
+ * \c setDecoding()), in which case the decompressed data is written and hashed.
+ *
+ * If an archive format is set with \c setExtraction(), the written data is
+ * also passed to an \c ArchiveExtractor, so that the archive is unpacked
+ * while it is being downloaded. A failed extraction does not fail the
+ * download, \c isExtracted() simply returns \c false once it is closed.
+ *
+ * If the final size of the file is known, the free disk space is checked and
+ * the whole file is allocated when it is opened, so that the transfer fails
+ * immediately instead of running out of space after several minutes, and the
+ * file system can give the file contiguous blocks. The data is then written
+ * at its position in the allocated file. A file that ends up shorter than
+ * allocated is truncated to the data written without gaps from its start
+ * when it is closed or aborted, so that it can be resumed.
+ */
+class DownloadWriter : public QThread
+{
+   Q_OBJECT
+
+signals:
+   void drained();
+   void closed(const bool success);
+
+public:
+   explicit DownloadWriter(QObject *parent = 0);
+   ~DownloadWriter();
+
+   bool isOpen() const;
+   bool isFull() const;
+   qint64 capacity() const;
+   QString errorString() const;
+   QByteArray checksum() const;
+   bool isExtracted() const;
+   bool isPreallocated() const;
+
+   bool open(const QString &path, const bool append, const qint64 size = -1);
+   void append(const QByteArray &data);
+   void write(const qint64 offset, const QByteArray &data);
+   void setCapacity(const qint64 bytes);
+   void setHashEnabled(const bool enabled);
+   void setDecoding(const StreamDecoder::Format format);
+   void setExtraction(const ArchiveExtractor::Format format, const QString &directory);
+   void finish();
+   void abort();
+
+protected:
+   void run();
+
+private:
+   struct Chunk
+   {
+      qint64 offset;
+      QByteArray data;
+   };
+
+   void enqueue(const qint64 offset, const QByteArray &data);
+   bool writeChunks(const QList<Chunk> &chunks);
+   bool writeBlocks(const QList<Chunk> &chunks);
+   bool hashWritten(const qint64 offset, const QByteArray &data);
+   bool hashFromFile(const qint64 from, const qint64 to);
+   void extractWritten(const qint64 offset, const QByteArray &data);
+   void extractFromFile(const qint64 to);
+   bool preallocate(const qint64 size);
+   void commitWritten(const qint64 offset, const qint64 end);
+
+private:
+   QFile m_file;
+   mutable QMutex m_mutex;
+   QWaitCondition m_condition;
+   QQueue<Chunk> m_queue;
+   QString m_errorString;
+   QByteArray m_checksum;
+   QCryptographicHash m_hash;
+   QMap<qint64, qint64> m_unhashed;
+
+   bool m_open;
+   bool m_full;
+   bool m_aborted;
+   bool m_finishing;
+   qint64 m_queued;
+   qint64 m_capacity;
+   qint64 m_position;
+   qint64 m_written;
+   qint64 m_committed;
+   QMap<qint64, qint64> m_ahead;
+   bool m_preallocated;
+   qint64 m_hashed;
+   qint64 m_hashPrefix;
+   bool m_hashEnabled;
+
+   StreamDecoder m_decoder;
+   StreamDecoder::Format m_decoding;
+   qint64 m_decoded;
+
+   ArchiveExtractor m_extractor;
+   ArchiveExtractor::Format m_extractFormat;
+   QString m_extractDir;
+   qint64 m_extractPrefix;
+   qint64 m_extracted;
+   bool m_extractionDone;
+};
+
+#endif
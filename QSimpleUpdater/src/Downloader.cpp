@@ -22,19 +22,16 @@
 
 #include <QDir>
 #include <QFile>
+#include <QThread>
 #include <QProcess>
-#include <QDateTime>
 #include <QMessageBox>
-#include <QNetworkReply>
 #include <QDesktopServices>
-#include <QNetworkAccessManager>
-#include <QRegularExpression>
-#include <QRegularExpressionMatch>
 #include <math.h>
 
 #include "Downloader.h"
-
-static const QString PARTIAL_DOWN(".part");
+#include "DownloadTask.h"
+#include "SlotInstaller.h"
+#include "NetworkManager.h"
 
 //构造函数，初始化界面和成员变量
 Downloader::Downloader(QWidget *parent)
@@ -43,19 +40,36 @@ Downloader::Downloader(QWidget *parent)
    m_ui = new Ui::Downloader;
    m_ui->setupUi(this);
 
-   /* Initialize private members */
-   m_manager = new QNetworkAccessManager();
-
    /* Initialize internal values */
    m_url = "";
-   m_fileName = "";
-   m_startTime = 0;
+   m_filePath = "";
+   m_state = DownloadTask::Idle;
+   m_prefetching = false;
    m_useCustomProcedures = false;
    m_mandatoryUpdate = false;
+   m_backgroundDownload = false;
+   m_resumeEnabled = true;
+   m_adaptiveThrottling = false;
+   m_extractArchives = false;
+   m_segmentCount = 1;
+   m_maxDownloadRate = 0;
 
    /* Set download directory */
    m_downloadDir.setPath(QDir::homePath() + "/Downloads/");
 
+   /* The task does the network and disk I/O, in the worker thread if the
+    * application enabled it 网络和磁盘操作由下载任务执行（可在工作线程中） */
+   QThread *thread = DownloadTask::useWorkerThread() ? DownloadTask::workerThread() : QThread::currentThread();
+   m_task = new DownloadTask(NetworkManager::forThread(thread));
+   if (thread != QThread::currentThread())
+      m_task->moveToThread(thread);
+
+   connect(m_task, SIGNAL(stateChanged(int, int)), this, SLOT(stateChanged(int, int)));
+   connect(m_task, SIGNAL(progressChanged(qint64, qint64, qreal, qint64)), this,
+           SLOT(updateProgress(qint64, qint64, qreal, qint64)));
+   connect(m_task, SIGNAL(finished(QString)), this, SLOT(taskFinished(QString)));
+   connect(m_task, SIGNAL(extracted(QString)), this, SLOT(taskExtracted(QString)));
+
    /* Make the window look like a modal dialog */
    setWindowIcon(QIcon());
    setWindowFlags(Qt::Dialog | Qt::CustomizeWindowHint | Qt::WindowTitleHint);
@@ -74,8 +88,12 @@ Downloader::Downloader(QWidget *parent)
 Downloader::~Downloader()
 {
    delete m_ui;
-   delete m_reply;
-   delete m_manager;
+
+   /* A task in the worker thread must be deleted by that thread */
+   if (m_task->thread() == thread())
+      delete m_task;
+   else
+      m_task->deleteLater();
 }
 
 /**
@@ -89,6 +107,97 @@ bool Downloader::useCustomInstallProcedures() const
    return m_useCustomProcedures;
 }
 
+/**
+ * Returns \c true if an interrupted download is continued from the existing
+ * partial file instead of being downloaded again from the first byte.
+ * 返回是否启用断点续传
+ */
+bool Downloader::resumeDownloads() const
+{
+   return m_resumeEnabled;
+}
+
+/**
+ * Returns the maximum number of parallel connections used to download a file
+ * 返回分段下载使用的最大连接数
+ */
+int Downloader::segmentCount() const
+{
+   return m_segmentCount;
+}
+
+/**
+ * Returns \c true if the download yields to foreground downloads when the
+ * download scheduler has to choose which transfer starts first
+ * 返回是否为后台下载（优先级较低）
+ */
+bool Downloader::backgroundDownload() const
+{
+   return m_backgroundDownload;
+}
+
+/**
+ * Returns the maximum download rate in bytes per second (\c 0 if unlimited)
+ * 返回最大下载速率（字节/秒）
+ */
+qint64 Downloader::maxDownloadRate() const
+{
+   return m_maxDownloadRate;
+}
+
+/**
+ * Returns \c true if the download rate is reduced when the round-trip time to
+ * the server rises
+ * 返回是否启用自适应限速
+ */
+bool Downloader::adaptiveThrottling() const
+{
+   return m_adaptiveThrottling;
+}
+
+/**
+ * Returns \c true if tar and zip archives are extracted while they are
+ * downloaded
+ * 返回是否在下载归档文件时同时解压
+ */
+bool Downloader::extractArchives() const
+{
+   return m_extractArchives;
+}
+
+/**
+ * Returns \c true if the file at the given \a url is being (or has been)
+ * prefetched and the user has not confirmed or declined it yet
+ */
+bool Downloader::isPrefetching(const QUrl &url) const
+{
+   return m_prefetching && url == m_prefetchUrl;
+}
+
+/**
+ * Returns the installation root used for slot installs, or an empty string
+ * if the downloaded file is opened by the OS instead
+ * 返回槽位安装的根目录
+ */
+QString Downloader::installDirectory() const
+{
+   return m_installDir;
+}
+
+/**
+ * Activates the version that was installed before the current one (see
+ * \c setInstallDirectory()), returns \c false if there is none
+ * 回滚到上一个安装的版本
+ */
+bool Downloader::rollbackUpdate()
+{
+   if (m_installDir.isEmpty())
+      return false;
+
+   SlotInstaller installer(m_installDir);
+   return installer.rollback();
+}
+
 /**
  * Changes the URL, which is used to indentify the downloader dialog
  * with an \c Updater instance
@@ -103,56 +212,81 @@ void Downloader::setUrlId(const QString &url)
 
 /**
  * Begins downloading the file at the given \a url
- * 通过指定的URL开始下载文件。它配置网络请求并启动下载。下载过程中，使用信号和槽机制实时更新UI。
+ * 通过指定的URL开始下载文件。下载由下载任务执行，UI只根据任务报告的状态和进度更新。
  */
 void Downloader::startDownload(const QUrl &url)
 {
+   /* The update has already been prefetched, install it right away
+    * 更新已预先下载完成，直接安装 */
+   bool prefetched = m_prefetching && url == m_prefetchUrl;
+   m_prefetching = false;
+   if (prefetched && m_state == DownloadTask::Completed && QFile::exists(m_filePath))
+   {
+      QMetaObject::invokeMethod(m_task, "confirmPrefetch");
+      taskFinished(m_filePath);
+      return;
+   }
+
    /* Reset UI */
    m_ui->progressBar->setValue(0);//将下载进度条重置为0
    m_ui->stopButton->setText(tr("stop"));
    m_ui->downloadLabel->setText(tr("Download updates"));
    m_ui->timeLabel->setText(tr("Remaining time") + ": " + tr("..."));
 
-   /* Configure the network request 创建QNetworkRequest对象，配置URL和一些请求属性，例如重定向策略和用户代理*/
-   QNetworkRequest request(url);
-   request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
-   if (!m_userAgentString.isEmpty())
-      request.setRawHeader("User-Agent", m_userAgentString.toUtf8());
+   /* The task waits for the download scheduler before it starts */
+   m_filePath = "";
+   m_extractedDir = "";
+   QMetaObject::invokeMethod(m_task, "start", Q_ARG(QUrl, url));
 
-   /* Start download */
-   m_reply = m_manager->get(request);
-   m_startTime = QDateTime::currentDateTime().toSecsSinceEpoch();
+   //显示下载器窗口函数，是QWidget类的成员函数，被用于确保下载器窗口在开始下载时处于正常状态，以便用户能够看到和交互下载进度。这样，即使用户之前将窗口最小化或最大化，下载开始时窗口会被还原到正常状态
+   showNormal();
+}
 
-   /* Ensure that downloads directory exists 检查下载目录是否存在，如果不存在则创建 */
-   if (!m_downloadDir.exists())
-      m_downloadDir.mkpath(".");
+/**
+ * Downloads the file at the given \a url in the background without showing
+ * the dialog, before the user confirms the update. Once \c startDownload()
+ * is called with the same \a url, the prefetched file is installed (or the
+ * prefetch continues as a normal download).
+ * 在用户确认更新之前，在后台预先下载文件
+ */
+void Downloader::prefetch(const QUrl &url)
+{
+   if (url != m_prefetchUrl)
+   {
+      m_filePath = "";
+      m_extractedDir = "";
+   }
 
-   /* Remove old downloads 删除可能存在的旧的下载文件和部分下载文件*/
-   QFile::remove(m_downloadDir.filePath(m_fileName));
-   QFile::remove(m_downloadDir.filePath(m_fileName + PARTIAL_DOWN));
+   m_prefetching = true;
+   m_prefetchUrl = url;
+   QMetaObject::invokeMethod(m_task, "prefetch", Q_ARG(QUrl, url));
+}
 
-   /* Update UI when download progress changes or download finishes */
-   //SIGNAL(metaDataChanged()) >> 在QNetworkReply的元数据发生变化时（例如，文件名变化）发射>>metaDataChanged()信号被用于获取HTTP响应的Content-Disposition头，从中提取文件名。这个文件名是服务端告诉客户端下载文件时建议的文件名。获取到文件名后，它会被用作下载文件的名称，以便后续的文件保存和处理。
-   //SIGNAL(downloadProgress(qint64, qint64)) >> 在下载过程中发射，提供已接收和总大小的参数，用于更新下载进度
-   //SIGNAL(finished()) >> 在下载完成时发射
-   connect(m_reply, SIGNAL(metaDataChanged()), this, SLOT(metaDataChanged()));
-   connect(m_reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(updateProgress(qint64, qint64)));
-   connect(m_reply, SIGNAL(finished()), this, SLOT(finished()));
+/**
+ * Stops the prefetch started by \c prefetch() and removes the data that it
+ * downloaded, used when the user declines the update
+ * 用户拒绝更新时停止预下载并删除已下载的数据
+ */
+void Downloader::discardPrefetch()
+{
+   if (!m_prefetching)
+      return;
 
-   //显示下载器窗口函数，是QWidget类的成员函数，被用于确保下载器窗口在开始下载时处于正常状态，以便用户能够看到和交互下载进度。这样，即使用户之前将窗口最小化或最大化，下载开始时窗口会被还原到正常状态
-   showNormal();
+   m_prefetching = false;
+   m_prefetchUrl = QUrl();
+   m_filePath = "";
+   m_extractedDir = "";
+   QMetaObject::invokeMethod(m_task, "discard");
 }
 
 /**
- * Changes the name of the downloaded file
+ * Changes the name of the downloaded file (the task removes compression
+ * suffixes, such as \c .gz and \c .zst)
  * 设置下载的文件名
  */
 void Downloader::setFileName(const QString &file)
 {
-   m_fileName = file;
-
-   if (m_fileName.isEmpty())
-      m_fileName = "QSU_Update.bin";
+   QMetaObject::invokeMethod(m_task, "setFileName", Q_ARG(QString, file));
 }
 
 /**
@@ -161,32 +295,81 @@ void Downloader::setFileName(const QString &file)
  */
 void Downloader::setUserAgentString(const QString &agent)
 {
-   m_userAgentString = agent;
+   QMetaObject::invokeMethod(m_task, "setUserAgentString", Q_ARG(QString, agent));
 }
 
 /**
- * 下载完成后的处理，重命名文件，发射下载完成信号，安装更新
+ * Updates the labels of the dialog when the state of the task changes
+ * 根据下载任务的状态更新界面
  */
-void Downloader::finished()
+void Downloader::stateChanged(int state, int error)
 {
-   if (m_reply->error() != QNetworkReply::NoError)
+   m_state = state;
+   emit downloadStateChanged(m_url, state);
+
+   if (state == DownloadTask::Waiting)
+      m_ui->downloadLabel->setText(tr("Waiting for other downloads") + "...");
+
+   else if (state == DownloadTask::Downloading)
+      m_ui->downloadLabel->setText(tr("Download updates"));
+
+   else if (state == DownloadTask::Paused)
+      m_ui->downloadLabel->setText(tr("Download paused"));
+
+   /* The patch thread does not report its progress */
+   else if (state == DownloadTask::Patching)
    {
-      QFile::remove(m_downloadDir.filePath(m_fileName + PARTIAL_DOWN));
+      m_ui->downloadLabel->setText(tr("Applying update patch") + "...");
+      m_ui->progressBar->setMaximum(0);
       return;
    }
 
-   /* Rename file */
-   QFile::rename(m_downloadDir.filePath(m_fileName + PARTIAL_DOWN), m_downloadDir.filePath(m_fileName));
+   else if (error == DownloadTask::WriteError)
+      m_ui->downloadLabel->setText(tr("Unable to save the update file"));
 
-   /* Notify application */
-   emit downloadFinished(m_url, m_downloadDir.filePath(m_fileName));
+   else if (error == DownloadTask::ChecksumError)
+   {
+      m_ui->downloadLabel->setText(tr("The downloaded file is corrupted"));
+      m_ui->timeLabel->setText(tr("Please try to download the update again"));
+   }
+
+   m_ui->progressBar->setMaximum(100);
+}
+
+/**
+ * Notifies the application and installs the update once the task has saved
+ * the downloaded file
+ * 发射下载完成信号，安装更新
+ */
+void Downloader::taskFinished(const QString &filePath)
+{
+   m_filePath = filePath;
+
+   /* Prefetched updates are installed once the user confirms them */
+   if (m_prefetching)
+      return;
+
+   /* Notify application (the archive was extracted before the task
+    * reported the downloaded file) */
+   if (!m_extractedDir.isEmpty())
+      emit archiveExtracted(m_url, m_extractedDir);
+
+   emit downloadFinished(m_url, m_filePath);
 
    /* Install the update */
-   m_reply->close();
    installUpdate();
    setVisible(false);
 }
 
+/**
+ * Remembers the directory into which the task extracted the downloaded
+ * archive, the application is notified with the downloaded file
+ */
+void Downloader::taskExtracted(const QString &directory)
+{
+   m_extractedDir = directory;
+}
+
 /**
  * Opens the downloaded file.
  * 打开下载的文件
@@ -195,8 +378,8 @@ void Downloader::finished()
  */
 void Downloader::openDownload()
 {
-   if (!m_fileName.isEmpty())
-      QDesktopServices::openUrl(QUrl::fromLocalFile(m_downloadDir.filePath(m_fileName)));
+   if (!m_filePath.isEmpty())
+      QDesktopServices::openUrl(QUrl::fromLocalFile(m_filePath));
 
    else
    {
@@ -218,6 +401,14 @@ void Downloader::installUpdate()
    if (useCustomInstallProcedures())
       return;
 
+   /* Install the extracted update next to the running version instead of
+    * quitting during the installation 在应用运行时将更新安装到备用槽位 */
+   if (!m_installDir.isEmpty() && !m_extractedDir.isEmpty() && SlotInstaller::isSupported())
+   {
+      installToSlot();
+      return;
+   }
+
    /* Update labels */
    m_ui->stopButton->setText(tr("close"));
    m_ui->downloadLabel->setText(tr("Download completed!"));
@@ -261,6 +452,56 @@ void Downloader::installUpdate()
    }
 }
 
+/**
+ * Moves the extracted update into the inactive slot of the installation
+ * directory, activates it and offers to restart the application from it.
+ * The running version keeps working until the application is restarted.
+ * 将更新安装到备用槽位并切换，然后提示用户重启应用
+ */
+void Downloader::installToSlot()
+{
+   m_ui->stopButton->setText(tr("close"));
+   m_ui->downloadLabel->setText(tr("Installing the update") + "...");
+
+   /* The entry point must be found before the running slot changes */
+   SlotInstaller installer(m_installDir);
+   QString entryPoint = installer.entryPoint();
+   if (!installer.install(m_extractedDir, entryPoint))
+   {
+      m_ui->downloadLabel->setText(tr("Unable to install the update"));
+      m_ui->timeLabel->setText(installer.errorString());
+      QMessageBox::critical(this, tr("Error"), tr("Unable to install the update") + ": " + installer.errorString(),
+                            QMessageBox::Close);
+      return;
+   }
+
+   /* The extracted files now live in the slot */
+   m_extractedDir = "";
+   m_ui->downloadLabel->setText(tr("Update installed!"));
+   m_ui->timeLabel->setText(tr("Restart the application to use the new version"));
+
+   QMessageBox box;
+   box.setIcon(QMessageBox::Question);
+   box.setWindowIcon(QIcon(":/icons/nupdate.png"));
+   box.setWindowTitle("Install Window");
+   box.setDefaultButton(QMessageBox::Ok);
+   box.setStandardButtons(QMessageBox::Ok | QMessageBox::Cancel);
+   box.setInformativeText(tr("Click OK to restart the application"));
+
+   QString text = tr("The new version has been installed, it will be used the next time the application starts");
+   if (m_mandatoryUpdate)
+      text = tr("The new version has been installed. This is a mandatory update, the application will be restarted");
+
+   box.setText("<h3>" + text + "</h3>");
+
+   /* Start the new version from the current link and quit */
+   if (box.exec() == QMessageBox::Ok || m_mandatoryUpdate)
+   {
+      QProcess::startDetached(installer.currentLink() + "/" + entryPoint, QCoreApplication::arguments().mid(1));
+      QApplication::quit();
+   }
+}
+
 /**
  * Prompts the user if he/she wants to cancel the download and cancels the
  * download if the user agrees to do that.
@@ -268,7 +509,8 @@ void Downloader::installUpdate()
  */
 void Downloader::cancelDownload()
 {
-   if (!m_reply->isFinished())
+   bool downloading = m_state == DownloadTask::Waiting || m_state == DownloadTask::Downloading;
+   if (downloading)
    {
       QMessageBox box;
       box.setWindowTitle(tr("Cancel update"));
@@ -285,13 +527,15 @@ void Downloader::cancelDownload()
       if (box.exec() == QMessageBox::Yes)
       {
          hide();
-         m_reply->abort();
+         QMetaObject::invokeMethod(m_task, "cancel");
+
          if (m_mandatoryUpdate)
             QApplication::quit();
       }
    }
    else
    {
+      QMetaObject::invokeMethod(m_task, "cancel");
       if (m_mandatoryUpdate)
          QApplication::quit();
 
@@ -299,32 +543,6 @@ void Downloader::cancelDownload()
    }
 }
 
-/**
- * Writes the downloaded data to the disk
- * 将下载的数据写入磁盘
- */
-void Downloader::saveFile(qint64 received, qint64 total)
-{
-   Q_UNUSED(received);
-   Q_UNUSED(total);
-
-   /* Check if we need to redirect */
-   QUrl url = m_reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
-   if (!url.isEmpty())
-   {
-      startDownload(url);
-      return;
-   }
-
-   /* Save downloaded data to disk */
-   QFile file(m_downloadDir.filePath(m_fileName + PARTIAL_DOWN));
-   if (file.open(QIODevice::WriteOnly | QIODevice::Append))
-   {
-      file.write(m_reply->readAll());
-      file.close();
-   }
-}
-
 /**
  * Calculates the appropiate size units (bytes, KB or MB) for the received
  * data and the total download size. Then, this function proceeds to update the
@@ -358,34 +576,18 @@ void Downloader::calculateSizes(qint64 received, qint64 total)
                                 + ")");
 }
 
-/**
- * Get response filename.
- * 获取响应的文件名
- */
-void Downloader::metaDataChanged()
-{
-   QString filename = "";
-   QVariant variant = m_reply->header(QNetworkRequest::ContentDispositionHeader);
-   if (variant.isValid())
-   {
-      QString contentDisposition = QByteArray::fromPercentEncoding(variant.toByteArray()).constData();
-      QRegularExpression regExp("filename=(\S+)");
-      QRegularExpressionMatch match = regExp.match(contentDisposition);
-      if (match.hasMatch())
-      {
-         filename = match.captured(1);
-      }
-      setFileName(filename);
-   }
-}
-
 /**
  * Uses the \a received and \a total parameters to get the download progress
- * and update the progressbar value on the dialog.
- * 更新下载进度条，计算下载剩余时间，保存文件
+ * and update the progressbar value on the dialog. The \a rate (bytes per
+ * second) and the \a remainingTime (seconds) are measured by the task. The
+ * progress is also forwarded to the application (at most ten times per
+ * second, see \c DownloadTask).
+ * 更新下载进度条和剩余时间
  */
-void Downloader::updateProgress(qint64 received, qint64 total)
+void Downloader::updateProgress(qint64 received, qint64 total, qreal rate, qint64 remainingTime)
 {
+   emit downloadProgress(m_url, received, total, rate, remainingTime);
+
    if (total > 0)
    {
       m_ui->progressBar->setMinimum(0);
@@ -393,8 +595,7 @@ void Downloader::updateProgress(qint64 received, qint64 total)
       m_ui->progressBar->setValue((received * 100) / total);
 
       calculateSizes(received, total);
-      calculateTimeRemaining(received, total);
-      saveFile(received, total);
+      calculateTimeRemaining(remainingTime);
    }
 
    else
@@ -408,21 +609,17 @@ void Downloader::updateProgress(qint64 received, qint64 total)
 }
 
 /**
- * Uses two time samples (from the current time and a previous sample) to
- * calculate how many bytes have been downloaded.
- * 根据两个时间样本计算剩余时间
- * Then, this function proceeds to calculate the appropiate units of time
- * (hours, minutes or seconds) and constructs a user-friendly string, which
- * is displayed in the dialog.
+ * Calculates the appropiate units of time (hours, minutes or seconds) for
+ * the estimated \a remainingTime (in seconds, negative if unknown) and
+ * constructs a user-friendly string, which is displayed in the dialog.
+ * 将剩余时间转换为合适的单位并显示
  */
-void Downloader::calculateTimeRemaining(qint64 received, qint64 total)
+void Downloader::calculateTimeRemaining(qint64 remainingTime)
 {
-   uint difference = QDateTime::currentDateTime().toSecsSinceEpoch() - m_startTime;
-
-   if (difference > 0)
+   if (remainingTime >= 0)
    {
       QString timeString;
-      qreal timeRemaining = (total - received) / (received / difference);
+      qreal timeRemaining = remainingTime;
 
       if (timeRemaining > 7200)
       {
@@ -484,6 +681,8 @@ void Downloader::setDownloadDir(const QString &downloadDir)
 {
    if (m_downloadDir.absolutePath() != downloadDir)
       m_downloadDir.setPath(downloadDir);
+
+   QMetaObject::invokeMethod(m_task, "setDownloadDir", Q_ARG(QString, downloadDir));
 }
 
 /**
@@ -494,6 +693,7 @@ void Downloader::setDownloadDir(const QString &downloadDir)
 void Downloader::setMandatoryUpdate(const bool mandatory_update)
 {
    m_mandatoryUpdate = mandatory_update;
+   QMetaObject::invokeMethod(m_task, "setMandatoryUpdate", Q_ARG(bool, mandatory_update));
 }
 
 /**
@@ -508,6 +708,146 @@ void Downloader::setUseCustomInstallProcedures(const bool custom)
    m_useCustomProcedures = custom;
 }
 
+/**
+ * If \a resume is set to \c true, the \c Downloader keeps the partial file of
+ * an interrupted download and continues it with a HTTP range request, as long
+ * as the server confirms (through the ETag or Last-Modified header) that the
+ * remote file did not change in the meantime.
+ * 设置是否启用断点续传
+ */
+void Downloader::setResumeDownloads(const bool resume)
+{
+   m_resumeEnabled = resume;
+   QMetaObject::invokeMethod(m_task, "setResumeDownloads", Q_ARG(bool, resume));
+}
+
+/**
+ * Changes the maximum number of parallel connections used to download a file.
+ * If \a count is greater than one and the server supports range requests, the
+ * file is split in several ranges that are downloaded at the same time.
+ * 设置分段下载使用的最大连接数
+ */
+void Downloader::setSegmentCount(const int count)
+{
+   m_segmentCount = qMax(1, count);
+   QMetaObject::invokeMethod(m_task, "setSegmentCount", Q_ARG(int, m_segmentCount));
+}
+
+/**
+ * If \a background is set to \c true, the download is started after the
+ * mandatory and foreground downloads of the other updaters, and it gets a
+ * smaller share of the total download rate (see \c DownloadScheduler).
+ * 设置是否为后台下载
+ */
+void Downloader::setBackgroundDownload(const bool background)
+{
+   m_backgroundDownload = background;
+   QMetaObject::invokeMethod(m_task, "setBackgroundDownload", Q_ARG(bool, background));
+}
+
+/**
+ * Limits the download rate to the given number of bytes per second, so that
+ * the update does not take the bandwidth needed by the application. The data
+ * is read from the socket at that rate (the server slows down instead of the
+ * data being buffered). A value of \c 0 removes the limit.
+ * 设置最大下载速率（字节/秒），0表示不限速
+ */
+void Downloader::setMaxDownloadRate(const qint64 bytesPerSecond)
+{
+   m_maxDownloadRate = qMax(qint64(0), bytesPerSecond);
+   QMetaObject::invokeMethod(m_task, "setMaxDownloadRate", Q_ARG(qint64, m_maxDownloadRate));
+}
+
+/**
+ * If \a adaptive is set to \c true, the round-trip time to the download
+ * server is measured during the download, and the download rate is reduced
+ * while it rises (i.e. while the download delays other traffic).
+ * 设置是否根据网络延迟自动降低下载速率
+ */
+void Downloader::setAdaptiveThrottling(const bool adaptive)
+{
+   m_adaptiveThrottling = adaptive;
+   QMetaObject::invokeMethod(m_task, "setAdaptiveThrottling", Q_ARG(bool, adaptive));
+}
+
+/**
+ * Changes the SHA-256 digest (as a hex string) and the \a size in bytes that
+ * the downloaded file must have. The file is only renamed and reported to the
+ * application if it matches. Empty/zero values disable the respective check.
+ * 设置下载文件预期的SHA-256值和大小
+ */
+void Downloader::setExpectedChecksum(const QString &sha256, const qint64 size)
+{
+   QMetaObject::invokeMethod(m_task, "setExpectedChecksum", Q_ARG(QString, sha256), Q_ARG(qint64, size));
+}
+
+/**
+ * Registers a binary patch that turns the previously downloaded file (the
+ * file with the same name in \c downloadDir()) into the new file. The patch
+ * is only used if the SHA-256 digest of the new file is known, so that the
+ * result can be verified. If anything fails, the full file is downloaded.
+ * Pass an empty \a url to disable patching.
+ * 设置可应用于旧文件的二进制补丁
+ */
+void Downloader::setPatch(const QUrl &url, const QString &sha256, const qint64 size)
+{
+   QMetaObject::invokeMethod(m_task, "setPatch", Q_ARG(QUrl, url), Q_ARG(QString, sha256), Q_ARG(qint64, size));
+}
+
+/**
+ * Changes the URL of the chunk manifest of the file (see \c ChunkSync). If a
+ * previous download exists in \c downloadDir(), the chunks that it shares
+ * with the new file are copied and only the other chunks are downloaded.
+ * Pass an empty \a url to disable chunk synchronization.
+ * 设置分块清单的URL，用于复用旧文件中相同的分块
+ */
+void Downloader::setChunkManifest(const QUrl &url)
+{
+   QMetaObject::invokeMethod(m_task, "setChunkManifest", Q_ARG(QUrl, url));
+}
+
+/**
+ * Changes the other URLs (mirrors) of the file. Before the transfer starts,
+ * the download URL and the mirrors are probed and the fastest one is used.
+ * If the transfer fails or stalls, it continues on the next mirror (from the
+ * current offset if both mirrors serve the same ETag and the SHA-256 digest
+ * of the file is known).
+ * 设置文件的镜像列表，自动选择最快的镜像并在失败时切换
+ */
+void Downloader::setMirrors(const QStringList &mirrors)
+{
+   QMetaObject::invokeMethod(m_task, "setMirrors", Q_ARG(QStringList, mirrors));
+}
+
+/**
+ * If \a extract is \c true, tar and zip archives (also compressed with gzip
+ * or zstd) are extracted into a directory next to the downloaded file while
+ * they are downloaded. The directory is named after the archive (without its
+ * suffixes) and only replaces the previous one once the checksum of the
+ * archive has been verified.
+ * 设置是否在下载归档文件时同时解压
+ */
+void Downloader::setExtractArchives(const bool extract)
+{
+   m_extractArchives = extract;
+   QMetaObject::invokeMethod(m_task, "setExtractArchives", Q_ARG(bool, extract || !m_installDir.isEmpty()));
+}
+
+/**
+ * Changes the installation root used for slot installs (Linux only). If it
+ * is not empty, downloaded archives are extracted and installed into the
+ * slot that is not running, which is then activated by atomically replacing
+ * the \c current link of the \a directory (see \c SlotInstaller). The
+ * application must be started through that link. Pass an empty string to
+ * open the downloaded file with the OS instead.
+ * 设置槽位安装的根目录（仅Linux），为空则使用系统打开下载的文件
+ */
+void Downloader::setInstallDirectory(const QString &directory)
+{
+   m_installDir = directory;
+   QMetaObject::invokeMethod(m_task, "setExtractArchives", Q_ARG(bool, m_extractArchives || !directory.isEmpty()));
+}
+
 #if QSU_INCLUDE_MOC
 #   include "moc_Downloader.cpp"
 #endif
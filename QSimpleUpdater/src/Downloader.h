@@ -32,11 +32,14 @@ namespace Ui
 class Downloader;
 }
 
-class QNetworkReply;
-class QNetworkAccessManager;
+class DownloadTask;
 
 /**
  * \brief Implements an integrated file downloader with a nice UI
+ *
+ * The transfer itself is done by a \c DownloadTask, which may live in a
+ * worker thread. The dialog forwards its settings to the task and only
+ * reacts to the state changes and the progress that the task reports.
  */
 class Downloader : public QWidget
 {
@@ -44,12 +47,24 @@ class Downloader : public QWidget
 
 signals:
    void downloadFinished(const QString &url, const QString &filepath);
+   void archiveExtracted(const QString &url, const QString &directory);
+   void downloadStateChanged(const QString &url, const int state);
+   void downloadProgress(const QString &url, qint64 received, qint64 total, qreal rate, qint64 remainingTime);
 
 public:
    explicit Downloader(QWidget *parent = 0);
    ~Downloader();
 
    bool useCustomInstallProcedures() const;
+   bool resumeDownloads() const;
+   int segmentCount() const;
+   bool backgroundDownload() const;
+   qint64 maxDownloadRate() const;
+   bool adaptiveThrottling() const;
+   bool extractArchives() const;
+   bool isPrefetching(const QUrl &url) const;
+   QString installDirectory() const;
+   bool rollbackUpdate();
 
    QString downloadDir() const;
    void setDownloadDir(const QString &downloadDir);
@@ -57,38 +72,60 @@ public:
 public slots:
    void setUrlId(const QString &url);
    void startDownload(const QUrl &url);
+   void prefetch(const QUrl &url);
+   void discardPrefetch();
    void setFileName(const QString &file);
    void setUserAgentString(const QString &agent);
    void setUseCustomInstallProcedures(const bool custom);
    void setMandatoryUpdate(const bool mandatory_update);
+   void setResumeDownloads(const bool resume);
+   void setSegmentCount(const int count);
+   void setBackgroundDownload(const bool background);
+   void setMaxDownloadRate(const qint64 bytesPerSecond);
+   void setAdaptiveThrottling(const bool adaptive);
+   void setExpectedChecksum(const QString &sha256, const qint64 size);
+   void setPatch(const QUrl &url, const QString &sha256, const qint64 size);
+   void setChunkManifest(const QUrl &url);
+   void setMirrors(const QStringList &mirrors);
+   void setExtractArchives(const bool extract);
+   void setInstallDirectory(const QString &directory);
 
 private slots:
-   void finished();
-   void metaDataChanged();
    void openDownload();
    void installUpdate();
    void cancelDownload();
-   void saveFile(qint64 received, qint64 total);
+   void taskFinished(const QString &filePath);
+   void taskExtracted(const QString &directory);
+   void stateChanged(int state, int error);
    void calculateSizes(qint64 received, qint64 total);
-   void updateProgress(qint64 received, qint64 total);
-   void calculateTimeRemaining(qint64 received, qint64 total);
+   void updateProgress(qint64 received, qint64 total, qreal rate, qint64 remainingTime);
+   void calculateTimeRemaining(qint64 remainingTime);
 
 private:
+   void installToSlot();
    qreal round(const qreal &input);
 
 private:
    QString m_url;
-   uint m_startTime;
    QDir m_downloadDir;
-   QString m_fileName;
+   QString m_filePath;
+   QString m_extractedDir;
+   QString m_installDir;
    Ui::Downloader *m_ui;
-   QNetworkReply *m_reply;
-   QString m_userAgentString;
 
+   int m_state;
+   bool m_prefetching;
+   QUrl m_prefetchUrl;
    bool m_useCustomProcedures;
    bool m_mandatoryUpdate;
-
-   QNetworkAccessManager *m_manager;
+   bool m_backgroundDownload;
+   bool m_resumeEnabled;
+   bool m_adaptiveThrottling;
+   bool m_extractArchives;
+   int m_segmentCount;
+   qint64 m_maxDownloadRate;
+
+   DownloadTask *m_task;
 };
 
 #endif
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QNetworkAccessManager>
+
+#include "MirrorSelector.h"
+
+/* Mirrors that do not answer within this time are ranked last */
+static const int PROBE_TIMEOUT = 5000;
+
+/* Time given to the other mirrors once the fastest mirror answered */
+static const int RANK_DELAY = 500;
+
+MirrorSelector::MirrorSelector(QNetworkAccessManager *manager, QObject *parent)
+   : QObject(parent)
+   , m_timer(this)
+{
+   m_finished = true;
+   m_manager = manager;
+
+   m_timer.setSingleShot(true);
+   connect(&m_timer, SIGNAL(timeout()), this, SLOT(rank()));
+}
+
+MirrorSelector::~MirrorSelector()
+{
+   abort();
+}
+
+/**
+ * Returns \c true if there are no probes in progress
+ */
+bool MirrorSelector::isFinished() const
+{
+   return m_finished;
+}
+
+/**
+ * Returns the mirrors ordered by their response time, the fastest first
+ * \note The list is empty until the \c finished() signal is emitted
+ */
+QList<QUrl> MirrorSelector::mirrors() const
+{
+   return m_ranking;
+}
+
+/**
+ * Returns the validator (strong ETag or Last-Modified date) reported by the
+ * mirror at the given \a url, or an empty array if it is not known
+ */
+QByteArray MirrorSelector::validator(const QUrl &url) const
+{
+   const Probe *probe = probeForUrl(url);
+   if (!probe || !probe->answered)
+      return QByteArray();
+
+   if (!probe->etag.isEmpty() && !probe->etag.startsWith("W/"))
+      return probe->etag;
+
+   return probe->lastModified;
+}
+
+/**
+ * Returns \c true if both mirrors reported the same size and the same strong
+ * ETag, i.e. if a transfer can continue on the \a second mirror from the
+ * point where it stopped on the \a first one
+ * 判断两个镜像是否提供完全相同的文件
+ */
+bool MirrorSelector::isInterchangeable(const QUrl &first, const QUrl &second) const
+{
+   if (first == second)
+      return true;
+
+   const Probe *a = probeForUrl(first);
+   const Probe *b = probeForUrl(second);
+   if (!a || !b || !a->answered || !b->answered)
+      return false;
+
+   if (a->size <= 0 || a->size != b->size)
+      return false;
+
+   if (a->etag.isEmpty() || a->etag.startsWith("W/"))
+      return false;
+
+   return a->etag == b->etag;
+}
+
+/**
+ * Stops the probes that are still running
+ */
+void MirrorSelector::abort()
+{
+   m_timer.stop();
+   m_finished = true;
+
+   for (int i = 0; i < m_probes.count(); ++i)
+   {
+      QNetworkReply *reply = m_probes.at(i).reply;
+      if (reply)
+      {
+         reply->disconnect(this);
+         reply->abort();
+         reply->deleteLater();
+         m_probes[i].reply = 0;
+      }
+   }
+}
+
+/**
+ * Changes the user-agent string sent with the probe requests
+ */
+void MirrorSelector::setUserAgentString(const QString &agent)
+{
+   m_userAgentString = agent;
+}
+
+/**
+ * Sends a \c HEAD request to each one of the given \a mirrors at the same
+ * time, the \c finished() signal is emitted once they are ranked
+ * 同时探测所有镜像，按响应时间排序
+ */
+void MirrorSelector::probe(const QList<QUrl> &mirrors)
+{
+   abort();
+
+   m_probes.clear();
+   m_ranking.clear();
+   m_finished = false;
+   m_clock.start();
+
+   foreach (const QUrl &url, mirrors)
+   {
+      if (probeForUrl(url))
+         continue;
+
+      QNetworkRequest request(url);
+      request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+      request.setRawHeader("Accept-Encoding", "identity");
+      if (!m_userAgentString.isEmpty())
+         request.setRawHeader("User-Agent", m_userAgentString.toUtf8());
+
+      Probe probe;
+      probe.url = url;
+      probe.answered = false;
+      probe.failed = false;
+      probe.latency = 0;
+      probe.size = 0;
+      probe.reply = m_manager->head(request);
+      connect(probe.reply, SIGNAL(finished()), this, SLOT(onProbeFinished()));
+      m_probes.append(probe);
+   }
+
+   m_timer.start(PROBE_TIMEOUT);
+}
+
+/**
+ * Records the response time and the validators of a mirror
+ */
+void MirrorSelector::onProbeFinished()
+{
+   QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+   if (!reply)
+      return;
+
+   int pending = 0;
+   for (int i = 0; i < m_probes.count(); ++i)
+   {
+      Probe &probe = m_probes[i];
+      if (probe.reply == reply)
+      {
+         probe.reply = 0;
+         probe.latency = m_clock.elapsed();
+         probe.failed = reply->error() != QNetworkReply::NoError;
+         probe.answered = !probe.failed;
+         probe.size = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+         probe.etag = reply->rawHeader("ETag");
+         probe.lastModified = reply->rawHeader("Last-Modified");
+
+         /* Give the other mirrors a moment to answer as well */
+         if (probe.answered && m_timer.remainingTime() > RANK_DELAY)
+            m_timer.start(RANK_DELAY);
+      }
+
+      else if (probe.reply)
+         ++pending;
+   }
+
+   reply->deleteLater();
+   if (pending == 0)
+      rank();
+}
+
+/**
+ * Orders the mirrors by their response time and notifies the caller
+ */
+void MirrorSelector::rank()
+{
+   if (m_finished)
+      return;
+
+   abort();
+
+   /* Insertion sort, there are only a few mirrors */
+   QList<Probe> answered;
+   foreach (const Probe &probe, m_probes)
+   {
+      if (!probe.answered)
+         continue;
+
+      int i = 0;
+      while (i < answered.count() && answered.at(i).latency <= probe.latency)
+         ++i;
+
+      answered.insert(i, probe);
+   }
+
+   foreach (const Probe &probe, answered)
+      m_ranking.append(probe.url);
+
+   /* Mirrors that did not answer in time may still work */
+   foreach (const Probe &probe, m_probes)
+   {
+      if (!probe.answered && !probe.failed)
+         m_ranking.append(probe.url);
+   }
+
+   /* Every mirror failed, let the download report the actual error */
+   if (m_ranking.isEmpty())
+   {
+      foreach (const Probe &probe, m_probes)
+         m_ranking.append(probe.url);
+   }
+
+   emit finished();
+}
+
+/**
+ * Returns the probe of the mirror at the given \a url, or \c 0
+ */
+const MirrorSelector::Probe *MirrorSelector::probeForUrl(const QUrl &url) const
+{
+   for (int i = 0; i < m_probes.count(); ++i)
+   {
+      if (m_probes.at(i).url == url)
+         return &m_probes.at(i);
+   }
+
+   return 0;
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_MirrorSelector.cpp"
+#endif
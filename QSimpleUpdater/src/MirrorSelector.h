@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_MIRROR_SELECTOR_H
+#define _QSIMPLEUPDATER_MIRROR_SELECTOR_H
+
+#include <QUrl>
+#include <QList>
+#include <QTimer>
+#include <QObject>
+#include <QElapsedTimer>
+
+class QNetworkReply;
+class QNetworkAccessManager;
+
+/**
+ * \brief Ranks the mirrors of a file by the latency of their responses
+ *
+ * The selector sends a \c HEAD request to every mirror at the same time. The
+ * mirrors that answer are ranked by their response time, the ones that did
+ * not answer within the timeout are kept at the end of the list (they may
+ * still be used if everything else fails) and the ones that reported an
+ * error are dropped. The \c finished() signal is emitted shortly after the
+ * fastest mirror answered, without waiting for the slow ones.
+ *
+ * The size and validators reported by each mirror are kept, so that the
+ * caller knows which mirrors serve exactly the same file (see
+ * \c isInterchangeable()).
+ */
+class MirrorSelector : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void finished();
+
+public:
+   explicit MirrorSelector(QNetworkAccessManager *manager, QObject *parent = 0);
+   ~MirrorSelector();
+
+   bool isFinished() const;
+   QList<QUrl> mirrors() const;
+   QByteArray validator(const QUrl &url) const;
+   bool isInterchangeable(const QUrl &first, const QUrl &second) const;
+
+public slots:
+   void abort();
+   void setUserAgentString(const QString &agent);
+   void probe(const QList<QUrl> &mirrors);
+
+private slots:
+   void rank();
+   void onProbeFinished();
+
+private:
+   struct Probe
+   {
+      QUrl url;
+      bool answered;
+      bool failed;
+      qint64 latency;
+      qint64 size;
+      QByteArray etag;
+      QByteArray lastModified;
+      QNetworkReply *reply;
+   };
+
+   const Probe *probeForUrl(const QUrl &url) const;
+
+private:
+   QTimer m_timer;
+   QElapsedTimer m_clock;
+   QString m_userAgentString;
+
+   bool m_finished;
+   QList<QUrl> m_ranking;
+   QList<Probe> m_probes;
+   QNetworkAccessManager *m_manager;
+};
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QPointer>
+#include <QDateTime>
+#include <QSettings>
+#include <QMutexLocker>
+#include <QNetworkReply>
+#include <QStandardPaths>
+#include <QCoreApplication>
+
+#ifndef QT_NO_SSL
+#   include <QSslConfiguration>
+#endif
+
+#include "NetworkManager.h"
+
+/* Lifetime of the session tickets whose server did not give a hint */
+static const int DEFAULT_TICKET_LIFETIME = 2 * 60 * 60;
+
+/* TLS session ticket received from a host */
+struct TlsSession
+{
+   QByteArray ticket;
+   QDateTime expires;
+};
+
+/* Managers of the threads, and settings shared by all of them */
+static QMutex MUTEX;
+static QHash<QThread *, QPointer<QNetworkAccessManager>> MANAGERS;
+static bool HTTP2_ENABLED = true;
+static bool SESSION_FILE_SET = false;
+static QString SESSION_FILE;
+static bool SESSIONS_LOADED = false;
+static QHash<QString, TlsSession> SESSIONS;
+
+/**
+ * Returns the file in which the session tickets are stored, the mutex must
+ * be locked by the caller
+ */
+static QString sessionFile()
+{
+   if (!SESSION_FILE_SET)
+   {
+      SESSION_FILE = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/qsimpleupdater-tls.ini";
+      SESSION_FILE_SET = true;
+   }
+
+   return SESSION_FILE;
+}
+
+/**
+ * Reads the session tickets stored by previous runs, the mutex must be
+ * locked by the caller
+ */
+static void loadSessions()
+{
+   if (SESSIONS_LOADED)
+      return;
+
+   SESSIONS_LOADED = true;
+   if (sessionFile().isEmpty())
+      return;
+
+   QSettings settings(sessionFile(), QSettings::IniFormat);
+   foreach (const QString &host, settings.childGroups())
+   {
+      TlsSession session;
+      session.ticket = QByteArray::fromBase64(settings.value(host + "/ticket").toByteArray());
+      session.expires = settings.value(host + "/expires").toDateTime();
+      if (!session.ticket.isEmpty() && session.expires > QDateTime::currentDateTimeUtc())
+         SESSIONS.insert(host, session);
+   }
+}
+
+NetworkManager::NetworkManager()
+   : QNetworkAccessManager()
+{
+   connect(this, SIGNAL(finished(QNetworkReply *)), this, SLOT(storeSession(QNetworkReply *)));
+}
+
+/**
+ * Returns the network manager shared by the objects that live in the given
+ * \a thread, creating it if needed. Managers of secondary threads are
+ * deleted when their thread finishes.
+ * 返回指定线程共享的网络管理器
+ */
+QNetworkAccessManager *NetworkManager::forThread(QThread *thread)
+{
+   QMutexLocker locker(&MUTEX);
+   QPointer<QNetworkAccessManager> manager = MANAGERS.value(thread);
+   if (manager)
+      return manager;
+
+   NetworkManager *shared = new NetworkManager();
+   if (shared->thread() != thread)
+      shared->moveToThread(thread);
+
+   /* The manager of the main thread lives as long as the application */
+   if (!QCoreApplication::instance() || thread != QCoreApplication::instance()->thread())
+      connect(thread, SIGNAL(finished()), shared, SLOT(deleteLater()));
+
+   MANAGERS.insert(thread, shared);
+   return shared;
+}
+
+/**
+ * Makes the updaters use the network manager of the application for the
+ * objects that live in the thread of the \a manager. Must be called before
+ * the updaters are created.
+ * 设置应用程序提供的网络管理器
+ */
+void NetworkManager::setSharedManager(QNetworkAccessManager *manager)
+{
+   if (!manager)
+      return;
+
+   QMutexLocker locker(&MUTEX);
+   MANAGERS.insert(manager->thread(), manager);
+}
+
+/**
+ * Returns \c true if the requests are allowed to use HTTP/2
+ */
+bool NetworkManager::http2Enabled()
+{
+   QMutexLocker locker(&MUTEX);
+   return HTTP2_ENABLED;
+}
+
+/**
+ * Allows or forbids HTTP/2 for the requests sent after this call
+ * 设置是否允许使用HTTP/2
+ */
+void NetworkManager::setHttp2Enabled(const bool enabled)
+{
+   QMutexLocker locker(&MUTEX);
+   HTTP2_ENABLED = enabled;
+}
+
+/**
+ * Returns the file in which the TLS session tickets are stored, or an empty
+ * string if they are only kept in memory
+ */
+QString NetworkManager::sessionCacheFile()
+{
+   QMutexLocker locker(&MUTEX);
+   return sessionFile();
+}
+
+/**
+ * Changes the file in which the TLS session tickets are stored, pass an empty
+ * \a path to keep them in memory only
+ * 设置保存TLS会话票据的文件，为空则只保存在内存中
+ */
+void NetworkManager::setSessionCacheFile(const QString &path)
+{
+   QMutexLocker locker(&MUTEX);
+   SESSION_FILE = path;
+   SESSION_FILE_SET = true;
+   SESSIONS_LOADED = false;
+   SESSIONS.clear();
+}
+
+/**
+ * Allows HTTP/2 and resumes the stored TLS session of the host for every
+ * request sent through the manager. Range requests are left on HTTP/1.1,
+ * since their parallel connections would otherwise be multiplexed over a
+ * single HTTP/2 connection.
+ */
+QNetworkReply *NetworkManager::createRequest(Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
+{
+   QNetworkRequest shared(request);
+   bool range = shared.hasRawHeader("Range");
+   if (http2Enabled() && !range && !shared.attribute(QNetworkRequest::Http2AllowedAttribute).isValid())
+      shared.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+
+#ifndef QT_NO_SSL
+   if (shared.url().scheme() == "https")
+   {
+      /* Let the TLS socket hand the session tickets back to us */
+      QSslConfiguration ssl = shared.sslConfiguration();
+      ssl.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+      QMutexLocker locker(&MUTEX);
+      loadSessions();
+      TlsSession session = SESSIONS.value(shared.url().host());
+      bool valid = !session.ticket.isEmpty() && session.expires > QDateTime::currentDateTimeUtc();
+      if (valid && ssl.sessionTicket().isEmpty())
+         ssl.setSessionTicket(session.ticket);
+
+      shared.setSslConfiguration(ssl);
+   }
+#endif
+
+   return QNetworkAccessManager::createRequest(op, shared, outgoingData);
+}
+
+/**
+ * Remembers the TLS session ticket that the server of the \a reply sent, so
+ * that the next connection to the host (also after a restart) resumes it
+ */
+void NetworkManager::storeSession(QNetworkReply *reply)
+{
+#ifndef QT_NO_SSL
+   if (reply->url().scheme() != "https")
+      return;
+
+   QSslConfiguration ssl = reply->sslConfiguration();
+   QByteArray ticket = ssl.sessionTicket();
+   if (ticket.isEmpty())
+      return;
+
+   QString host = reply->url().host();
+   int lifetime = ssl.sessionTicketLifeTimeHint();
+
+   QMutexLocker locker(&MUTEX);
+   loadSessions();
+   if (SESSIONS.value(host).ticket == ticket)
+      return;
+
+   TlsSession session;
+   session.ticket = ticket;
+   session.expires = QDateTime::currentDateTimeUtc().addSecs(lifetime > 0 ? lifetime : DEFAULT_TICKET_LIFETIME);
+   SESSIONS.insert(host, session);
+
+   if (!sessionFile().isEmpty())
+   {
+      QSettings settings(sessionFile(), QSettings::IniFormat);
+      settings.setValue(host + "/ticket", ticket.toBase64());
+      settings.setValue(host + "/expires", session.expires);
+      settings.sync();
+
+      /* The tickets allow resuming the TLS sessions, keep them private */
+      QFile::setPermissions(sessionFile(), QFile::ReadOwner | QFile::WriteOwner);
+   }
+#else
+   Q_UNUSED(reply);
+#endif
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_NetworkManager.cpp"
+#endif
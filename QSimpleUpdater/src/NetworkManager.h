@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_NETWORK_MANAGER_H
+#define _QSIMPLEUPDATER_NETWORK_MANAGER_H
+
+#include <QNetworkAccessManager>
+
+class QThread;
+
+/**
+ * \brief Network manager shared by all the updaters of a thread
+ *
+ * A \c QNetworkAccessManager can only be used from its own thread, so there
+ * is one shared manager per thread (see \c forThread()) instead of one per
+ * appcast reader and per download. All the checks and downloads of a thread
+ * then share the connection cache of the manager: the connections to a host
+ * are kept alive and reused, and HTTP/2 connections multiplex the requests
+ * of every module over a single connection.
+ *
+ * Every request except range requests is allowed to use HTTP/2 (negotiated
+ * with ALPN, servers without support for it keep using HTTP/1.1). The TLS
+ * session tickets sent by the servers are stored in a file, so the first
+ * connection to a host after a restart resumes the previous session instead
+ * of doing a full handshake. The tickets are secrets (they hold the keys of
+ * the sessions), so the file is only readable by its owner.
+ *
+ * The application can also provide its own manager (\c setSharedManager()),
+ * which is then used for the objects of its thread as it is.
+ */
+class NetworkManager : public QNetworkAccessManager
+{
+   Q_OBJECT
+
+public:
+   static QNetworkAccessManager *forThread(QThread *thread);
+   static void setSharedManager(QNetworkAccessManager *manager);
+
+   static bool http2Enabled();
+   static void setHttp2Enabled(const bool enabled);
+   static QString sessionCacheFile();
+   static void setSessionCacheFile(const QString &path);
+
+protected:
+   QNetworkReply *createRequest(Operation op, const QNetworkRequest &request, QIODevice *outgoingData = 0);
+
+private slots:
+   void storeSession(QNetworkReply *reply);
+
+private:
+   explicit NetworkManager();
+};
+
+#endif
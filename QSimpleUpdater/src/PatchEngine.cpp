@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QFile>
+#include <QCryptographicHash>
+
+#include "PatchEngine.h"
+
+/* Magic string at the beginning of every patch */
+static const QByteArray PATCH_MAGIC("QSU/BSDIFF43RAW");
+
+/* Amount of data processed at once */
+static const qint64 BLOCK_SIZE = 1024 * 1024;
+
+/**
+ * Decodes a bsdiff integer (little endian, sign in the most significant bit)
+ */
+static qint64 readOffset(const QByteArray &data, const int index)
+{
+   const uchar *buf = reinterpret_cast<const uchar *>(data.constData()) + index;
+
+   qint64 value = buf[7] & 0x7F;
+   for (int i = 6; i >= 0; --i)
+      value = (value << 8) + buf[i];
+
+   if (buf[7] & 0x80)
+      value = -value;
+
+   return value;
+}
+
+/**
+ * Reads exactly \a size bytes from the \a file
+ */
+static bool readExactly(QFile &file, const qint64 size, QByteArray *data)
+{
+   *data = file.read(size);
+   return data->size() == size;
+}
+
+PatchEngine::PatchEngine(QObject *parent)
+   : QThread(parent)
+{
+}
+
+PatchEngine::~PatchEngine()
+{
+   wait();
+}
+
+/**
+ * Returns the magic string at the beginning of every patch
+ */
+QByteArray PatchEngine::magic()
+{
+   return PATCH_MAGIC;
+}
+
+/**
+ * Applies the \a patch to the \a base file in a separate thread and writes
+ * the result to \a output. The \c patched() signal is emitted when done.
+ * 在后台线程中应用补丁
+ */
+void PatchEngine::apply(const QString &base, const QString &patch, const QString &output)
+{
+   wait();
+
+   m_base = base;
+   m_patch = patch;
+   m_output = output;
+
+   start(QThread::LowPriority);
+}
+
+/**
+ * Applies the \a patch to the \a base file and writes the result to the
+ * \a output file. If \a checksum is given, it receives the SHA-256 digest of
+ * the output file.
+ * 应用补丁，由旧文件和补丁文件生成新文件
+ *
+ * Returns \c false if any of the files cannot be accessed or if the patch is
+ * corrupted.
+ */
+bool PatchEngine::applyPatch(const QString &base, const QString &patch, const QString &output, QByteArray *checksum)
+{
+   QFile oldFile(base);
+   QFile patchFile(patch);
+   QFile newFile(output);
+
+   if (!oldFile.open(QIODevice::ReadOnly) || !patchFile.open(QIODevice::ReadOnly))
+      return false;
+
+   if (!newFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+      return false;
+
+   /* Read the header */
+   QByteArray header;
+   if (!readExactly(patchFile, PATCH_MAGIC.size() + 8, &header) || !header.startsWith(PATCH_MAGIC))
+      return false;
+
+   qint64 newSize = readOffset(header, PATCH_MAGIC.size());
+   if (newSize < 0)
+      return false;
+
+   QCryptographicHash hash(QCryptographicHash::Sha256);
+   qint64 oldSize = oldFile.size();
+   qint64 oldPos = 0;
+   qint64 newPos = 0;
+
+   while (newPos < newSize)
+   {
+      /* Read the control triple */
+      QByteArray control;
+      if (!readExactly(patchFile, 24, &control))
+         return false;
+
+      qint64 diffLength = readOffset(control, 0);
+      qint64 extraLength = readOffset(control, 8);
+      qint64 seek = readOffset(control, 16);
+
+      /* Compare with the remaining space, crafted values must not overflow */
+      if (diffLength < 0 || extraLength < 0 || diffLength > newSize - newPos
+          || extraLength > newSize - newPos - diffLength)
+         return false;
+
+      /* The diff bytes and the next position lie inside the old file */
+      if (diffLength > oldSize - oldPos || seek < -(oldPos + diffLength) || seek > oldSize - (oldPos + diffLength))
+         return false;
+
+      /* Add the diff bytes to the old data */
+      qint64 done = 0;
+      while (done < diffLength)
+      {
+         QByteArray block;
+         qint64 length = qMin(BLOCK_SIZE, diffLength - done);
+         if (!readExactly(patchFile, length, &block))
+            return false;
+
+         /* Only the part of the block that lies inside the old file */
+         qint64 from = qMax<qint64>(0, -(oldPos + done));
+         qint64 to = qMin(length, oldSize - (oldPos + done));
+         if (from < to)
+         {
+            QByteArray old;
+            if (!oldFile.seek(oldPos + done + from) || !readExactly(oldFile, to - from, &old))
+               return false;
+
+            char *data = block.data();
+            for (qint64 i = from; i < to; ++i)
+               data[i] = char(data[i] + old.at(int(i - from)));
+         }
+
+         if (newFile.write(block) != block.size())
+            return false;
+
+         hash.addData(block);
+         done += length;
+      }
+
+      newPos += diffLength;
+      oldPos += diffLength;
+
+      /* Copy the extra bytes */
+      done = 0;
+      while (done < extraLength)
+      {
+         QByteArray block;
+         if (!readExactly(patchFile, qMin(BLOCK_SIZE, extraLength - done), &block))
+            return false;
+
+         if (newFile.write(block) != block.size())
+            return false;
+
+         hash.addData(block);
+         done += block.size();
+      }
+
+      newPos += extraLength;
+      oldPos += seek;
+   }
+
+   if (!newFile.flush())
+      return false;
+
+   if (checksum)
+      *checksum = hash.result();
+
+   return true;
+}
+
+/**
+ * Patch thread
+ */
+void PatchEngine::run()
+{
+   QByteArray checksum;
+   bool success = applyPatch(m_base, m_patch, m_output, &checksum);
+   emit patched(success, checksum);
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_PatchEngine.cpp"
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_PATCH_ENGINE_H
+#define _QSIMPLEUPDATER_PATCH_ENGINE_H
+
+#include <QThread>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * \brief Rebuilds a new payload from the previous payload and a binary patch
+ *
+ * The patches use the bsdiff algorithm in a single, uncompressed stream: the
+ * "QSU/BSDIFF43RAW" magic string and the size of the new file, followed by
+ * control triples (diff length, extra length, seek) that are each directly
+ * followed by their diff and extra bytes. This is not the bzip2-compressed
+ * layout of the stock bsdiff tools, hence the distinct magic string; the
+ * patches are created with the \c qsudiff tool. The stream itself is not
+ * compressed (serve the patch compressed instead), which allows the patch to
+ * be applied while reading it sequentially.
+ *
+ * The SHA-256 digest of the rebuilt file is computed while it is written, so
+ * that the caller can verify it without reading it again.
+ */
+class PatchEngine : public QThread
+{
+   Q_OBJECT
+
+signals:
+   void patched(const bool success, const QByteArray &checksum);
+
+public:
+   explicit PatchEngine(QObject *parent = 0);
+   ~PatchEngine();
+
+   void apply(const QString &base, const QString &patch, const QString &output);
+
+   static QByteArray magic();
+   static bool applyPatch(const QString &base, const QString &patch, const QString &output,
+                          QByteArray *checksum = 0);
+
+protected:
+   void run();
+
+private:
+   QString m_base;
+   QString m_patch;
+   QString m_output;
+};
+
+#endif
@@ -20,21 +20,70 @@
  * THE SOFTWARE.
  */
 
+#include <QHash>
+#include <QThread>
+#include <QPointer>
+#include <QReadLocker>
+#include <QCoreApplication>
+#include <QWriteLocker>
+#include <QReadWriteLock>
+
 #include "Updater.h"
 #include "QSimpleUpdater.h"
+#include "DownloadScheduler.h"
+#include "DownloadTask.h"
+#include "DownloadCache.h"
+#include "NetworkManager.h"
+#include "AppcastReader.h"
+
+
+/**
+ * UPDATERS 是一个静态的 QHash，以url为键保存指向 Updater 类对象的指针。
+ * The registered updaters, indexed by their URL. The registry may be read
+ * from any thread, hence the lock; the updaters themselves are only created
+ * in the thread of the QSimpleUpdater.
+ */
+static QReadWriteLock REGISTRY_LOCK;
+static QHash<QString, Updater *> UPDATERS;
+
+/* Batch checks that are waiting for some of their modules */
+struct BatchCheck
+{
+    QStringList urls;
+    QList<QPointer<Updater>> updaters;
+    QList<Updater *> pending;
+};
 
+static QList<BatchCheck> BATCHES;
 
 /**
- * URLS 是一个静态的 QList，保存了一组url字符串（QString）。
- * UPDATERS 是一个静态的 QList，保存了一组指向 Updater 类对象的指针。
+ * Returns \c true if the calling thread may wait for a call that it queues
+ * to the thread of the \a updater. Nobody runs queued calls once the
+ * application is closing down (and the post routines wait for the worker
+ * thread, see \c DownloadTask), so the caller would wait forever.
  */
-static QList<QString> URLS;
-static QList<Updater *> UPDATERS;
+static bool canWaitFor(const QObject *updater)
+{
+    if (QCoreApplication::closingDown() || !QCoreApplication::instance())
+        return false;
+
+    return updater->thread() != QThread::currentThread();
+}
+
+QSimpleUpdater::QSimpleUpdater()
+{
+    /* The updaters own widgets, they must live in the GUI thread even if the
+     * instance is first requested from a worker thread, which may not even
+     * run an event loop */
+    if (QCoreApplication::instance() && thread() != QCoreApplication::instance()->thread())
+        moveToThread(QCoreApplication::instance()->thread());
+}
 
 QSimpleUpdater::~QSimpleUpdater()
 {
-    URLS.clear();
+    BATCHES.clear();
 
+    QWriteLocker locker(&REGISTRY_LOCK);
     foreach (Updater *updater, UPDATERS)
         updater->deleteLater();
 
@@ -51,6 +100,32 @@ QSimpleUpdater *QSimpleUpdater::getInstance()
     return &updater;
 }
 
+/**
+ * Returns the value of the \a getter of the \c Updater instance registered
+ * with the given \a url. The updaters are only read in their own thread, so
+ * calls made from other threads wait until the thread of the
+ * \c QSimpleUpdater runs the getter, unless the application is closing
+ * down (the default value is returned then).
+ */
+template <typename T, typename Getter>
+T QSimpleUpdater::read(const QString &url, Getter getter) const
+{
+    if (QThread::currentThread() != thread())
+    {
+        T value = T();
+        if (canWaitFor(this))
+            QMetaObject::invokeMethod(const_cast<QSimpleUpdater *>(this), [&]() { value = read<T>(url, getter); },
+                                      Qt::BlockingQueuedConnection);
+        return value;
+    }
+
+    QPointer<Updater> updater = getUpdater(url);
+    if (!updater)
+        return T();
+
+    return (updater.data()->*getter)();
+}
+
 /**
  * 检查是否使用自定义的应用程序清单（appcast）格式
  * Returns \c true if the \c Updater instance registered with the given \a url
@@ -62,7 +137,7 @@ QSimpleUpdater *QSimpleUpdater::getInstance()
  */
 bool QSimpleUpdater::usesCustomAppcast(const QString &url) const
 {
-    return getUpdater(url)->customAppcast();
+    return read<bool>(url, &Updater::customAppcast);
 }
 
 /**
@@ -75,7 +150,7 @@ bool QSimpleUpdater::usesCustomAppcast(const QString &url) const
  */
 bool QSimpleUpdater::getNotifyOnUpdate(const QString &url) const
 {
-    return getUpdater(url)->notifyOnUpdate();
+    return read<bool>(url, &Updater::notifyOnUpdate);
 }
 
 /**
@@ -88,7 +163,7 @@ bool QSimpleUpdater::getNotifyOnUpdate(const QString &url) const
  */
 bool QSimpleUpdater::getNotifyOnFinish(const QString &url) const
 {
-    return getUpdater(url)->notifyOnFinish();
+    return read<bool>(url, &Updater::notifyOnFinish);
 }
 
 /**
@@ -102,7 +177,7 @@ bool QSimpleUpdater::getNotifyOnFinish(const QString &url) const
  */
 bool QSimpleUpdater::getUpdateAvailable(const QString &url) const
 {
-    return getUpdater(url)->updateAvailable();
+    return read<bool>(url, &Updater::updateAvailable);
 }
 
 /**
@@ -115,7 +190,7 @@ bool QSimpleUpdater::getUpdateAvailable(const QString &url) const
  */
 bool QSimpleUpdater::getDownloaderEnabled(const QString &url) const
 {
-    return getUpdater(url)->downloaderEnabled();
+    return read<bool>(url, &Updater::downloaderEnabled);
 }
 
 /**
@@ -132,7 +207,241 @@ bool QSimpleUpdater::getDownloaderEnabled(const QString &url) const
  */
 bool QSimpleUpdater::usesCustomInstallProcedures(const QString &url) const
 {
-    return getUpdater(url)->useCustomInstallProcedures();
+    return read<bool>(url, &Updater::useCustomInstallProcedures);
+}
+
+/**
+ * 检查是否启用断点续传
+ * Returns \c true if the \c Updater instance registered with the given \a url
+ * resumes interrupted downloads instead of downloading them again.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+bool QSimpleUpdater::getResumeDownloads(const QString &url) const
+{
+    return read<bool>(url, &Updater::resumeDownloads);
+}
+
+/**
+ * 获取分段下载的并行连接数
+ * Returns the number of parallel connections that the integrated downloader of
+ * the \c Updater instance registered with the given \a url uses.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+int QSimpleUpdater::getDownloadSegments(const QString &url) const
+{
+    return read<int>(url, &Updater::downloadSegments);
+}
+
+/**
+ * 获取是否启用自适应限速
+ * Returns \c true if the integrated downloader of the \c Updater instance
+ * registered with the given \a url reduces its download rate when the
+ * network latency rises.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+bool QSimpleUpdater::getAdaptiveThrottling(const QString &url) const
+{
+    return read<bool>(url, &Updater::adaptiveThrottling);
+}
+
+/**
+ * 获取最大下载速率（字节/秒）
+ * Returns the maximum download rate (in bytes per second) of the integrated
+ * downloader of the \c Updater instance registered with the given \a url,
+ * or \c 0 if the download rate is not limited.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+qint64 QSimpleUpdater::getMaxDownloadRate(const QString &url) const
+{
+    return read<qint64>(url, &Updater::maxDownloadRate);
+}
+
+/**
+ * 获取是否为后台更新
+ * Returns \c true if the update checks and downloads of the \c Updater
+ * instance registered with the given \a url yield to the foreground transfers
+ * of the other \c Updater instances.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+bool QSimpleUpdater::getBackgroundDownload(const QString &url) const
+{
+    return read<bool>(url, &Updater::backgroundDownload);
+}
+
+/**
+ * 获取是否在用户确认之前预先下载更新
+ * Returns \c true if the \c Updater instance registered with the given \a url
+ * downloads the updates in the background before the user confirms them.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+bool QSimpleUpdater::getPrefetchUpdates(const QString &url) const
+{
+    return read<bool>(url, &Updater::prefetchUpdates);
+}
+
+/**
+ * 获取是否在下载归档文件时同时解压
+ * Returns \c true if the integrated downloader of the \c Updater instance
+ * registered with the given \a url extracts tar and zip archives while they
+ * are downloaded.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+bool QSimpleUpdater::getExtractArchives(const QString &url) const
+{
+    return read<bool>(url, &Updater::extractArchives);
+}
+
+/**
+ * 获取槽位安装的根目录
+ * Returns the installation root used for the slot installs of the
+ * \c Updater instance registered with the given \a url, or an empty string
+ * if the downloaded files are opened by the OS.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+QString QSimpleUpdater::getInstallDirectory(const QString &url) const
+{
+    return read<QString>(url, &Updater::installDirectory);
+}
+
+/**
+ * 回滚到上一个安装的版本
+ * Activates the version that the \c Updater instance registered with the
+ * given \a url installed before the current one (see
+ * \c setInstallDirectory()). The versions are swapped, so a second call
+ * undoes the rollback. The application must be restarted to run it.
+ *
+ * Returns \c false if slot installs are disabled or not supported, or if
+ * there is no previous version.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+bool QSimpleUpdater::rollbackUpdate(const QString &url)
+{
+    return read<bool>(url, &Updater::rollbackUpdate);
+}
+
+/**
+ * 获取所有模块同时进行的最大传输数
+ * Returns the maximum number of update checks and downloads that run at the
+ * same time, counting the transfers of all the \c Updater instances.
+ */
+int QSimpleUpdater::getMaxConcurrentDownloads() const
+{
+    return DownloadScheduler::getInstance()->maxConnections();
+}
+
+/**
+ * 获取每个服务器同时进行的最大传输数
+ * Returns the maximum number of update checks and downloads that run at the
+ * same time with the same server.
+ */
+int QSimpleUpdater::getMaxHostConnections() const
+{
+    return DownloadScheduler::getInstance()->maxHostConnections();
+}
+
+/**
+ * 获取所有下载共享的总速率
+ * Returns the total download rate (in bytes per second) shared by the
+ * downloads of all the \c Updater instances, or \c 0 if it is not limited.
+ */
+qint64 QSimpleUpdater::getMaxTotalDownloadRate() const
+{
+    return DownloadScheduler::getInstance()->maxDownloadRate();
+}
+
+/**
+ * 获取是否在工作线程中执行网络和磁盘操作
+ * Returns \c true if the \c Updater instances created from now on download,
+ * parse and save their files in a worker thread.
+ */
+bool QSimpleUpdater::getUseWorkerThread() const
+{
+    return DownloadTask::useWorkerThread();
+}
+
+/**
+ * 获取是否启用下载缓存
+ * Returns \c true if the verified downloads are shared through the download
+ * cache (see \c setUseDownloadCache()).
+ */
+bool QSimpleUpdater::getUseDownloadCache() const
+{
+    return DownloadCache::getInstance()->isEnabled();
+}
+
+/**
+ * 获取下载缓存目录
+ * Returns the directory of the download cache.
+ */
+QString QSimpleUpdater::getDownloadCacheDir() const
+{
+    return DownloadCache::getInstance()->directory();
+}
+
+/**
+ * 获取下载缓存的最大大小
+ * Returns the maximum size of the download cache, in bytes.
+ */
+qint64 QSimpleUpdater::getMaxDownloadCacheSize() const
+{
+    return DownloadCache::getInstance()->maxSize();
+}
+
+/**
+ * 获取所有预下载共同可以使用的磁盘空间
+ * Returns the number of bytes that all the prefetched updates together may
+ * store before the user confirms them (\c 0 if it is not limited).
+ */
+qint64 QSimpleUpdater::getPrefetchBudget() const
+{
+    return DownloadTask::prefetchBudget();
+}
+
+/**
+ * 获取是否允许使用HTTP/2
+ * Returns \c true if the appcast checks and downloads may use HTTP/2.
+ */
+bool QSimpleUpdater::getUseHttp2() const
+{
+    return NetworkManager::http2Enabled();
+}
+
+/**
+ * 获取保存TLS会话票据的文件
+ * Returns the file in which the TLS session tickets of the update servers
+ * are stored, or an empty string if they are only kept in memory.
+ */
+QString QSimpleUpdater::getTlsSessionCacheFile() const
+{
+    return NetworkManager::sessionCacheFile();
+}
+
+/**
+ * 获取appcast缓存目录
+ * Returns the directory in which the appcasts are cached, or an empty string
+ * if the cache is disabled.
+ */
+QString QSimpleUpdater::getAppcastCacheDir() const
+{
+    return AppcastReader::cacheDirectory();
 }
 
 /**
@@ -147,7 +456,7 @@ bool QSimpleUpdater::usesCustomInstallProcedures(const QString &url) const
  */
 QString QSimpleUpdater::getOpenUrl(const QString &url) const
 {
-    return getUpdater(url)->openUrl();
+    return read<QString>(url, &Updater::openUrl);
 }
 
 /**
@@ -161,7 +470,7 @@ QString QSimpleUpdater::getOpenUrl(const QString &url) const
  */
 QString QSimpleUpdater::getChangelog(const QString &url) const
 {
-    return getUpdater(url)->changelog();
+    return read<QString>(url, &Updater::changelog);
 }
 
 /**
@@ -176,7 +485,7 @@ QString QSimpleUpdater::getChangelog(const QString &url) const
  */
 QString QSimpleUpdater::getModuleName(const QString &url) const
 {
-    return getUpdater(url)->moduleName();
+    return read<QString>(url, &Updater::moduleName);
 }
 
 /**
@@ -190,7 +499,7 @@ QString QSimpleUpdater::getModuleName(const QString &url) const
  */
 QString QSimpleUpdater::getDownloadUrl(const QString &url) const
 {
-    return getUpdater(url)->downloadUrl();
+    return read<QString>(url, &Updater::downloadUrl);
 }
 
 /**
@@ -209,7 +518,7 @@ QString QSimpleUpdater::getDownloadUrl(const QString &url) const
  */
 QString QSimpleUpdater::getPlatformKey(const QString &url) const
 {
-    return getUpdater(url)->platformKey();
+    return read<QString>(url, &Updater::platformKey);
 }
 
 /**
@@ -223,7 +532,7 @@ QString QSimpleUpdater::getPlatformKey(const QString &url) const
  */
 QString QSimpleUpdater::getLatestVersion(const QString &url) const
 {
-    return getUpdater(url)->latestVersion();
+    return read<QString>(url, &Updater::latestVersion);
 }
 
 /**
@@ -238,7 +547,7 @@ QString QSimpleUpdater::getLatestVersion(const QString &url) const
  */
 QString QSimpleUpdater::getModuleVersion(const QString &url) const
 {
-    return getUpdater(url)->moduleVersion();
+    return read<QString>(url, &Updater::moduleVersion);
 }
 
 /**
@@ -251,7 +560,35 @@ QString QSimpleUpdater::getModuleVersion(const QString &url) const
  */
 QString QSimpleUpdater::getUserAgentString(const QString &url) const
 {
-    return getUpdater(url)->userAgentString();
+    return read<QString>(url, &Updater::userAgentString);
+}
+
+/**
+ * 获取下载文件的SHA-256值
+ * Returns the SHA-256 digest (as a hex string) of the download defined by the
+ * appcast of the \c Updater instance registered with the given \a url.
+ *
+ * \warning You should call \c checkForUpdates() before using this function
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+QString QSimpleUpdater::getDownloadChecksum(const QString &url) const
+{
+    return read<QString>(url, &Updater::downloadChecksum);
+}
+
+/**
+ * 获取下载文件的大小
+ * Returns the size in bytes of the download defined by the appcast of the
+ * \c Updater instance registered with the given \a url.
+ *
+ * \warning You should call \c checkForUpdates() before using this function
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+qint64 QSimpleUpdater::getDownloadSize(const QString &url) const
+{
+    return read<qint64>(url, &Updater::downloadSize);
 }
 
 /**
@@ -264,12 +601,74 @@ QString QSimpleUpdater::getUserAgentString(const QString &url) const
  */
 void QSimpleUpdater::checkForUpdates(const QString &url)
 {
-    getUpdater(url)->checkForUpdates();
+    invoke(url, "checkForUpdates");
+}
+
+/**
+ * 批量检查更新
+ * Checks for updates of all the modules registered with the given \a urls at
+ * once. The checks are sent concurrently, the download scheduler limits how
+ * many of them run at the same time (and how many per host). Once every
+ * module has been checked, the \c batchCheckFinished() signal is emitted
+ * with one \c UpdateSummary per URL, in the order of \a urls. The
+ * \c checkingFinished() signal is still emitted for every module, but the
+ * modules do not ask the user about their updates: the application is
+ * expected to prompt once, from the summaries.
+ *
+ * \note If an \c Updater instance registered with one of the \a urls is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::checkForUpdates(const QStringList &urls)
+{
+    qRegisterMetaType<UpdateSummary>("UpdateSummary");
+    qRegisterMetaType<QList<UpdateSummary>>("QList<UpdateSummary>");
+
+    /* The batches are tracked in the thread of the updaters */
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, "checkForUpdates", Qt::QueuedConnection, Q_ARG(QStringList, urls));
+        return;
+    }
+
+    BatchCheck batch;
+    batch.urls = urls;
+    batch.urls.removeDuplicates();
+    foreach (const QString &url, batch.urls)
+    {
+        batch.updaters.append(getUpdater(url));
+        batch.pending.append(batch.updaters.last());
+    }
+
+    if (batch.urls.isEmpty())
+    {
+        emit batchCheckFinished(QList<UpdateSummary>());
+        return;
+    }
+
+    /* Register the batch before the first check can finish */
+    BATCHES.append(batch);
+    foreach (Updater *updater, batch.pending)
+        updater->checkForUpdates(false);
+}
+
+/**
+ * 开始下载更新
+ * Downloads the update found by the last check of the \c Updater instance
+ * registered with the given \a url (or opens its web page), as if the user
+ * confirmed it in the update dialog. This is meant for the applications
+ * that prompt once for the modules of a batch check.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::startDownload(const QString &url)
+{
+    invoke(url, "startDownload");
 }
 
 void QSimpleUpdater::setDownloadDir(const QString &url, const QString &dir)
 {
-   getUpdater(url)->setDownloadDir(dir);
+   invoke(url, "setDownloadDir", Q_ARG(QString, dir));
 }
 
 /**
@@ -284,7 +683,7 @@ void QSimpleUpdater::setDownloadDir(const QString &url, const QString &dir)
  */
 void QSimpleUpdater::setModuleName(const QString &url, const QString &name)
 {
-    getUpdater(url)->setModuleName(name);
+    invoke(url, "setModuleName", Q_ARG(QString, name));
 }
 
 /**
@@ -297,7 +696,7 @@ void QSimpleUpdater::setModuleName(const QString &url, const QString &name)
  */
 void QSimpleUpdater::setNotifyOnUpdate(const QString &url, const bool notify)
 {
-    getUpdater(url)->setNotifyOnUpdate(notify);
+    invoke(url, "setNotifyOnUpdate", Q_ARG(bool, notify));
 }
 
 /**
@@ -311,7 +710,7 @@ void QSimpleUpdater::setNotifyOnUpdate(const QString &url, const bool notify)
  */
 void QSimpleUpdater::setNotifyOnFinish(const QString &url, const bool notify)
 {
-    getUpdater(url)->setNotifyOnFinish(notify);
+    invoke(url, "setNotifyOnFinish", Q_ARG(bool, notify));
 }
 
 /**
@@ -331,7 +730,7 @@ void QSimpleUpdater::setNotifyOnFinish(const QString &url, const bool notify)
  */
 void QSimpleUpdater::setPlatformKey(const QString &url, const QString &platform)
 {
-    getUpdater(url)->setPlatformKey(platform);
+    invoke(url, "setPlatformKey", Q_ARG(QString, platform));
 }
 
 /**
@@ -345,7 +744,7 @@ void QSimpleUpdater::setPlatformKey(const QString &url, const QString &platform)
  */
 void QSimpleUpdater::setModuleVersion(const QString &url, const QString &version)
 {
-    getUpdater(url)->setModuleVersion(version);
+    invoke(url, "setModuleVersion", Q_ARG(QString, version));
 }
 
 /**
@@ -359,7 +758,7 @@ void QSimpleUpdater::setModuleVersion(const QString &url, const QString &version
  */
 void QSimpleUpdater::setDownloaderEnabled(const QString &url, const bool enabled)
 {
-    getUpdater(url)->setDownloaderEnabled(enabled);
+    invoke(url, "setDownloaderEnabled", Q_ARG(bool, enabled));
 }
 
 /**
@@ -372,7 +771,7 @@ void QSimpleUpdater::setDownloaderEnabled(const QString &url, const bool enabled
  */
 void QSimpleUpdater::setUserAgentString(const QString &url, const QString &agent)
 {
-    getUpdater(url)->setUserAgentString(agent);
+    invoke(url, "setUserAgentString", Q_ARG(QString, agent));
 }
 
 /**
@@ -387,7 +786,7 @@ void QSimpleUpdater::setUserAgentString(const QString &url, const QString &agent
  */
 void QSimpleUpdater::setUseCustomAppcast(const QString &url, const bool customAppcast)
 {
-    getUpdater(url)->setUseCustomAppcast(customAppcast);
+    invoke(url, "setUseCustomAppcast", Q_ARG(bool, customAppcast));
 }
 
 /**
@@ -404,14 +803,438 @@ void QSimpleUpdater::setUseCustomAppcast(const QString &url, const bool customAp
  */
 void QSimpleUpdater::setUseCustomInstallProcedures(const QString &url, const bool custom)
 {
-    getUpdater(url)->setUseCustomInstallProcedures(custom);
+    invoke(url, "setUseCustomInstallProcedures", Q_ARG(bool, custom));
 }
 /**
  * 设置是否为强制更新
  */
 void QSimpleUpdater::setMandatoryUpdate(const QString &url, const bool mandatory_update)
 {
-    getUpdater(url)->setMandatoryUpdate(mandatory_update);
+    invoke(url, "setMandatoryUpdate", Q_ARG(bool, mandatory_update));
+}
+
+/**
+ * 设置是否启用断点续传
+ * If \a resume is set to \c true, the integrated downloader of the \c Updater
+ * instance registered with the given \a url keeps the partial file of an
+ * interrupted download and continues it with a HTTP range request. The partial
+ * file is only reused if the server confirms that the file did not change.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setResumeDownloads(const QString &url, const bool resume)
+{
+    invoke(url, "setResumeDownloads", Q_ARG(bool, resume));
+}
+
+/**
+ * 设置分段下载的并行连接数
+ * Changes the number of parallel connections used by the integrated downloader
+ * of the \c Updater instance registered with the given \a url.
+ *
+ * If \a segments is greater than \c 1 and the server supports range requests,
+ * the file is split in several byte ranges that are downloaded concurrently.
+ * Segments that fall behind are split again while the download progresses.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setDownloadSegments(const QString &url, const int segments)
+{
+    invoke(url, "setDownloadSegments", Q_ARG(int, segments));
+}
+
+/**
+ * 设置最大下载速率（字节/秒）
+ * Limits the download rate of the integrated downloader of the \c Updater
+ * instance registered with the given \a url to \a bytesPerSecond, so that
+ * the update does not take the bandwidth needed by the application. The data
+ * is read from the socket at that rate instead of being buffered in memory.
+ * A value of \c 0 (the default) removes the limit.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setMaxDownloadRate(const QString &url, const qint64 bytesPerSecond)
+{
+    invoke(url, "setMaxDownloadRate", Q_ARG(qint64, bytesPerSecond));
+}
+
+/**
+ * 设置是否启用自适应限速
+ * If \a adaptive is set to \c true, the integrated downloader of the
+ * \c Updater instance registered with the given \a url measures the
+ * round-trip time to the download server and reduces its download rate while
+ * the latency rises, so that latency-sensitive traffic is not delayed.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setAdaptiveThrottling(const QString &url, const bool adaptive)
+{
+    invoke(url, "setAdaptiveThrottling", Q_ARG(bool, adaptive));
+}
+
+/**
+ * 设置是否为后台更新
+ * If \a background is set to \c true, the update checks and downloads of the
+ * \c Updater instance registered with the given \a url are started after the
+ * mandatory and foreground transfers of the other \c Updater instances, and
+ * they get a smaller share of the total download rate.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setBackgroundDownload(const QString &url, const bool background)
+{
+    invoke(url, "setBackgroundDownload", Q_ARG(bool, background));
+}
+
+/**
+ * 设置是否在用户确认之前预先下载更新
+ * If \a prefetch is set to \c true, the \c Updater instance registered with
+ * the given \a url downloads and verifies the update file in the background
+ * (with the lowest priority and a single resumable connection) as soon as it
+ * finds a newer version. When the user confirms the update, it is installed
+ * right away. Prefetches pause once they reach the prefetch budget (see
+ * \c setPrefetchBudget()) and continue when the user confirms the update.
+ * If the user declines the update, the downloaded data is removed.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setPrefetchUpdates(const QString &url, const bool prefetch)
+{
+    invoke(url, "setPrefetchUpdates", Q_ARG(bool, prefetch));
+}
+
+/**
+ * 设置是否在下载归档文件时同时解压
+ * If \a extract is set to \c true, the integrated downloader of the
+ * \c Updater instance registered with the given \a url extracts tar and zip
+ * archives (also when they are compressed with gzip or zstd) while they are
+ * downloaded, so the files are ready as soon as the download is verified.
+ * The files are extracted next to the downloaded file, into a directory named
+ * after it, and the \c archiveExtracted() signal is emitted before the
+ * \c downloadFinished() signal.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setExtractArchives(const QString &url, const bool extract)
+{
+    invoke(url, "setExtractArchives", Q_ARG(bool, extract));
+}
+
+/**
+ * 设置槽位安装的根目录（仅Linux）
+ * Enables slot installs for the \c Updater instance registered with the
+ * given \a url. The \a directory contains two slots (\c slot-a and
+ * \c slot-b) and a \c current link that points to the running one; the
+ * application must be started through \c directory/current.
+ *
+ * The downloaded archive is extracted while it is downloaded and, once its
+ * checksum is verified, moved into the slot that is not running while the
+ * application keeps working. If the slot contains the executable of the
+ * application, the \c current link is atomically replaced and the user is
+ * asked to restart the application. The slot that was running is kept as
+ * the \c previous slot, see \c rollbackUpdate().
+ *
+ * Slot installs are only supported on Linux, other systems (or files that
+ * are not archives) open the downloaded file as before. Pass an empty
+ * \a directory to disable them.
+ *
+ * \note If an \c Updater instance registered with the given \a url is not
+ *       found, that \c Updater instance will be initialized automatically
+ */
+void QSimpleUpdater::setInstallDirectory(const QString &url, const QString &directory)
+{
+    invoke(url, "setInstallDirectory", Q_ARG(QString, directory));
+}
+
+/**
+ * 设置所有模块同时进行的最大传输数
+ * Changes the maximum number of update checks and downloads that run at the
+ * same time, counting the transfers of all the \c Updater instances (six by
+ * default). The other transfers wait in a queue, mandatory updates first,
+ * then foreground and background transfers. Each segment of a segmented
+ * download counts as a transfer.
+ */
+void QSimpleUpdater::setMaxConcurrentDownloads(const int downloads)
+{
+    DownloadScheduler::getInstance()->setMaxConnections(downloads);
+}
+
+/**
+ * 设置每个服务器同时进行的最大传输数
+ * Changes the maximum number of update checks and downloads that run at the
+ * same time with the same server (two by default). Each segment of a
+ * segmented download counts as a transfer, so segmented downloads use at
+ * most this many connections (see \c setDownloadSegments()).
+ */
+void QSimpleUpdater::setMaxHostConnections(const int connections)
+{
+    DownloadScheduler::getInstance()->setMaxHostConnections(connections);
+}
+
+/**
+ * 设置所有下载共享的总速率
+ * Limits the total download rate of all the \c Updater instances to
+ * \a bytesPerSecond. The rate is shared between the active downloads,
+ * mandatory updates get a larger share than foreground downloads, which get a
+ * larger share than background downloads. A value of \c 0 removes the limit.
+ */
+void QSimpleUpdater::setMaxTotalDownloadRate(const qint64 bytesPerSecond)
+{
+    DownloadScheduler::getInstance()->setMaxDownloadRate(bytesPerSecond);
+}
+
+/**
+ * 设置是否在工作线程中执行网络和磁盘操作
+ * If \a enabled is set to \c true, the network requests, the parsing of the
+ * update definitions and the disk writes of the \c Updater instances created
+ * afterwards run in a worker thread shared by all of them. The UI thread only
+ * receives the state changes and the download progress (at most ten times per
+ * second), so animations are not interrupted by the downloads.
+ *
+ * \note Call this function before the first \c Updater instance is created,
+ *       i.e. before using any of the functions that take an \a url.
+ */
+void QSimpleUpdater::setUseWorkerThread(const bool enabled)
+{
+    DownloadTask::setUseWorkerThread(enabled);
+}
+
+/**
+ * 设置是否启用下载缓存
+ * If \a enabled is set to \c true (the default), every download whose SHA-256
+ * digest is defined by the update definitions is added to the download cache
+ * once it has been verified. Before a download starts, the cache is searched
+ * for the digest, and if the file is there it is linked into the download
+ * directory instead of being downloaded again.
+ */
+void QSimpleUpdater::setUseDownloadCache(const bool enabled)
+{
+    DownloadCache::getInstance()->setEnabled(enabled);
+}
+
+/**
+ * 设置下载缓存目录
+ * Changes the directory of the download cache. Applications that use the same
+ * directory (by default, a \c QSimpleUpdater folder in the cache location of
+ * the user) share their downloads.
+ */
+void QSimpleUpdater::setDownloadCacheDir(const QString &dir)
+{
+    DownloadCache::getInstance()->setDirectory(dir);
+}
+
+/**
+ * 设置下载缓存的最大大小
+ * Changes the maximum size of the download cache (2 GB by default). Once it is
+ * exceeded, the least recently used files are removed from the cache.
+ */
+void QSimpleUpdater::setMaxDownloadCacheSize(const qint64 bytes)
+{
+    DownloadCache::getInstance()->setMaxSize(bytes);
+}
+
+/**
+ * 设置所有预下载共同可以使用的磁盘空间
+ * Changes the number of bytes that all the prefetched updates together may
+ * store before the user confirms them (512 MB by default). Prefetches reserve
+ * their space from this budget as they download, and pause once it is used
+ * up; the rest is downloaded once the user confirms the update. A value of
+ * \c 0 removes the limit.
+ */
+void QSimpleUpdater::setPrefetchBudget(const qint64 bytes)
+{
+    DownloadTask::setPrefetchBudget(bytes);
+}
+
+/**
+ * 设置是否允许使用HTTP/2
+ * If \a enabled is set to \c true (the default), the appcast checks and
+ * downloads may use HTTP/2 when the server supports it. The checks of all the
+ * modules hosted on the same server are then multiplexed over a single
+ * connection.
+ */
+void QSimpleUpdater::setUseHttp2(const bool enabled)
+{
+    NetworkManager::setHttp2Enabled(enabled);
+}
+
+/**
+ * 设置保存TLS会话票据的文件
+ * Changes the file in which the TLS session tickets of the update servers
+ * are stored, so that the first connection after a restart resumes the
+ * previous TLS session instead of doing a full handshake. By default, the
+ * tickets are stored in the cache directory of the application. Pass an
+ * empty \a path to keep them in memory only.
+ *
+ * \note The tickets allow resuming the TLS sessions of the update servers,
+ *       so the file is created with owner-only permissions. Keep it out of
+ *       shared or synchronized directories.
+ */
+void QSimpleUpdater::setTlsSessionCacheFile(const QString &path)
+{
+    NetworkManager::setSessionCacheFile(path);
+}
+
+/**
+ * 设置appcast缓存目录
+ * Changes the directory in which the appcasts are cached with their
+ * \c ETag and \c Last-Modified headers (by default, a directory in the cache
+ * directory of the application). The following checks ask the server to
+ * send the appcast only if it changed, and reuse the cached copy when the
+ * server answers \c 304 Not Modified. Pass an empty \a dir to download the
+ * whole appcast on every check.
+ */
+void QSimpleUpdater::setAppcastCacheDir(const QString &dir)
+{
+    AppcastReader::setCacheDirectory(dir);
+}
+
+/**
+ * 设置应用程序提供的网络管理器
+ * Makes the \c Updater instances created from now on use the given
+ * \a manager for the checks and downloads that run in the thread of the
+ * \a manager, so that they share its connections (and its proxy, cookies
+ * or TLS configuration) with the application. The \a manager is used as it
+ * is and must outlive the updaters.
+ *
+ * By default, the updaters of a thread share a manager created by the
+ * library, which allows HTTP/2 and stores the TLS session tickets (see
+ * \c setUseHttp2() and \c setTlsSessionCacheFile()).
+ */
+void QSimpleUpdater::setNetworkAccessManager(QNetworkAccessManager *manager)
+{
+    NetworkManager::setSharedManager(manager);
+}
+
+/**
+ * 移除注册在给定URL的 Updater 实例
+ * Removes the \c Updater instance registered with the given \a url, along
+ * with its downloader, once it returns to its event loop. Pending batch
+ * checks report the module as not checked. Returns \c false if no
+ * \c Updater instance is registered with the given \a url.
+ *
+ * \note The functions that take the \a url create a new \c Updater instance
+ *       if they are called afterwards.
+ */
+bool QSimpleUpdater::removeUpdater(const QString &url)
+{
+    QWriteLocker locker(&REGISTRY_LOCK);
+    Updater *updater = UPDATERS.take(url);
+    if (!updater)
+        return false;
+
+    updater->deleteLater();
+    return true;
+}
+
+/**
+ * Removes the updater that finished its check from the pending batch checks
+ * (the \a url is not used, since it changes if the appcast was redirected),
+ * and reports the results of the batches that are complete
+ */
+void QSimpleUpdater::onCheckingFinished(const QString &url)
+{
+    Q_UNUSED(url);
+    finishBatches(qobject_cast<Updater *>(sender()));
+}
+
+/**
+ * Removes an updater that was deleted (see \c removeUpdater()) from the
+ * pending batch checks
+ */
+void QSimpleUpdater::onUpdaterDestroyed(QObject *updater)
+{
+    finishBatches(static_cast<Updater *>(updater));
+}
+
+/**
+ * Removes the given \a updater from the pending batch checks, and reports
+ * the results of the batches that are complete
+ */
+void QSimpleUpdater::finishBatches(Updater *updater)
+{
+    int i = 0;
+    while (i < BATCHES.count())
+    {
+        BATCHES[i].pending.removeAll(updater);
+        if (!BATCHES.at(i).pending.isEmpty())
+        {
+            ++i;
+            continue;
+        }
+
+        QList<UpdateSummary> results;
+        for (int j = 0; j < BATCHES.at(i).urls.count(); ++j)
+        {
+            UpdateSummary summary;
+            summary.url = BATCHES.at(i).urls.at(j);
+
+            /* Removed updaters are reported as not checked */
+            Updater *checked = BATCHES.at(i).updaters.at(j);
+            if (checked)
+            {
+                summary.moduleName = checked->moduleName();
+                summary.moduleVersion = checked->moduleVersion();
+                summary.latestVersion = checked->latestVersion();
+                summary.updateAvailable = checked->updateAvailable();
+                summary.mandatoryUpdate = checked->mandatoryUpdate();
+                summary.downloadSize = checked->downloadSize();
+            }
+
+            results.append(summary);
+        }
+
+        BATCHES.removeAt(i);
+        emit batchCheckFinished(results);
+    }
+}
+
+/**
+ * Calls the slot \a member of the \c Updater instance registered with the
+ * given \a url. Calls made from other threads are queued to the thread of
+ * the \c Updater, in order.
+ */
+void QSimpleUpdater::invoke(const QString &url, const char *member, QGenericArgument argument) const
+{
+    if (QThread::currentThread() == thread())
+    {
+        QPointer<Updater> updater = getUpdater(url);
+        if (updater)
+            QMetaObject::invokeMethod(updater, member, Qt::DirectConnection, argument);
+
+        return;
+    }
+
+    /* The updater cannot be deleted while it is in the registry and we hold
+     * the lock (see removeUpdater()), and queuing the call does not wait */
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        {
+            QReadLocker locker(&REGISTRY_LOCK);
+            Updater *updater = UPDATERS.value(url);
+            if (updater)
+            {
+                QMetaObject::invokeMethod(updater, member, Qt::QueuedConnection, argument);
+                return;
+            }
+        }
+
+        if (attempt > 0 || !canWaitFor(this))
+            return;
+
+        /* The updaters own widgets, they are created in the thread of the
+         * QSimpleUpdater while we wait */
+        QObject *created = 0;
+        QMetaObject::invokeMethod(const_cast<QSimpleUpdater *>(this), "createUpdater", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QObject *, created), Q_ARG(QString, url));
+    }
 }
 
 /**
@@ -420,20 +1243,34 @@ void QSimpleUpdater::setMandatoryUpdate(const QString &url, const bool mandatory
  *
  * If an \c Updater instance registered with teh given \a url does not exist,
  * this function will create it and configure it automatically.
+ *
+ * \note Must be called from the thread of the \c QSimpleUpdater, where the
+ *       updaters live and are deleted (see \c read() and \c invoke())
  */
-Updater *QSimpleUpdater::getUpdater(const QString &url) const
+QPointer<Updater> QSimpleUpdater::getUpdater(const QString &url) const
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+    return static_cast<Updater *>(const_cast<QSimpleUpdater *>(this)->createUpdater(url));
+}
+
+/**
+ * Creates and registers the \c Updater instance of the given \a url, unless
+ * a call from another thread did it first
+ */
+QObject *QSimpleUpdater::createUpdater(const QString &url)
 {
-    if (!URLS.contains(url))
     {
-        /**
-        * 创建一个 Updater 类的实例并分配其内存空间给指针 updater
-        * 一个动态分配对象的操作，用于在堆上创建一个 Updater 对象
-        */
-        Updater *updater = new Updater;
-        updater->setUrl(url);
+        QReadLocker locker(&REGISTRY_LOCK);
+        if (UPDATERS.contains(url))
+            return UPDATERS.value(url);
+    }
 
-        URLS.append(url);
-        UPDATERS.append(updater);
+    /**
+    * 创建一个 Updater 类的实例并分配其内存空间给指针 updater
+    * 一个动态分配对象的操作，用于在堆上创建一个 Updater 对象
+    */
+    Updater *updater = new Updater;
+    updater->setUrl(url);
 
         /**
          * checkingFinished 信号是 Updater 类中定义的信号，用于通知检查完成。
@@ -441,13 +1278,20 @@ Updater *QSimpleUpdater::getUpdater(const QString &url) const
          * 连接这两个信号的目的是在当前对象中处理 Updater 对象检查完成的事件。
          * (也就是 Window.cpp中的“connect(m_updater, SIGNAL(checkingFinished(QString)), this, SLOT(updateChangelog(QString)))”中处理“updateChangelog(QString)”)
          */
-        connect(updater, SIGNAL(checkingFinished(QString)), this, SIGNAL(checkingFinished(QString)));
-        connect(updater, SIGNAL(downloadFinished(QString, QString)), this, SIGNAL(downloadFinished(QString, QString)));
-        connect(updater, SIGNAL(appcastDownloaded(QString, QByteArray)), this,SIGNAL(appcastDownloaded(QString, QByteArray)));
-    }
+    connect(updater, SIGNAL(checkingFinished(QString)), this, SIGNAL(checkingFinished(QString)));
+    connect(updater, SIGNAL(checkingFinished(QString)), this, SLOT(onCheckingFinished(QString)));
+    connect(updater, SIGNAL(downloadFinished(QString, QString)), this, SIGNAL(downloadFinished(QString, QString)));
+    connect(updater, SIGNAL(archiveExtracted(QString, QString)), this, SIGNAL(archiveExtracted(QString, QString)));
+    connect(updater, SIGNAL(appcastDownloaded(QString, QByteArray)), this,SIGNAL(appcastDownloaded(QString, QByteArray)));
+    connect(updater, SIGNAL(downloadStateChanged(QString, int)), this, SIGNAL(downloadStateChanged(QString, int)));
+    connect(updater, SIGNAL(downloadProgress(QString, qint64, qint64, qreal, qint64)), this,
+            SIGNAL(downloadProgress(QString, qint64, qint64, qreal, qint64)));
+    connect(updater, SIGNAL(destroyed(QObject *)), this, SLOT(onUpdaterDestroyed(QObject *)));
 
-    //根据给定的URL返回相应 Updater 指针
-    return UPDATERS.at(URLS.indexOf(url));
+    //根据给定的URL注册 Updater 指针
+    QWriteLocker locker(&REGISTRY_LOCK);
+    UPDATERS.insert(url, updater);
+    return updater;
 }
 
 #if QSU_INCLUDE_MOC
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QNetworkAccessManager>
+
+#include "RateLimiter.h"
+
+/* Smallest amount of data read at once, and smallest bucket size */
+static const qint64 MIN_BURST = 16 * 1024;
+
+/* Lowest rate used by the adaptive mode */
+static const qint64 MIN_RATE = 32 * 1024;
+
+/* Interval between round-trip time measurements */
+static const int PROBE_INTERVAL = 2000;
+
+/* Number of measurements used to find the base round-trip time */
+static const int RTT_HISTORY = 15;
+
+/* Queueing delay (round-trip time above the base value) that we tolerate */
+static const qint64 TARGET_DELAY = 50;
+
+RateLimiter::RateLimiter(QNetworkAccessManager *manager, QObject *parent)
+   : QObject(parent)
+   , m_wakeTimer(this)
+   , m_probeTimer(this)
+{
+   m_adaptive = false;
+   m_maxRate = 0;
+   m_share = 0;
+   m_currentRate = 0;
+   m_consumed = 0;
+   m_probeConsumed = 0;
+   m_tokens = 0;
+   m_probeReply = 0;
+   m_manager = manager;
+
+   m_clock.start();
+   m_wakeTimer.setSingleShot(true);
+   m_probeTimer.setInterval(PROBE_INTERVAL);
+   connect(&m_wakeTimer, SIGNAL(timeout()), this, SIGNAL(ready()));
+   connect(&m_probeTimer, SIGNAL(timeout()), this, SLOT(probe()));
+}
+
+RateLimiter::~RateLimiter()
+{
+   if (m_probeReply)
+   {
+      m_probeReply->disconnect(this);
+      m_probeReply->abort();
+      m_probeReply->deleteLater();
+   }
+}
+
+/**
+ * Returns \c true if the rate is adjusted to the measured round-trip time
+ */
+bool RateLimiter::adaptive() const
+{
+   return m_adaptive;
+}
+
+/**
+ * Returns \c true if the download rate is currently limited
+ */
+bool RateLimiter::isLimited() const
+{
+   return m_currentRate > 0;
+}
+
+/**
+ * Returns the configured maximum rate in bytes per second (\c 0 if unlimited)
+ */
+qint64 RateLimiter::maxRate() const
+{
+   return m_maxRate;
+}
+
+/**
+ * Returns the rate that is currently enforced in bytes per second, which is
+ * lower than \c maxRate() if the adaptive mode backed off (\c 0 if unlimited)
+ */
+qint64 RateLimiter::currentRate() const
+{
+   return m_currentRate;
+}
+
+/**
+ * Returns the read buffer size that network replies should use instead of
+ * \a size, so that a limited download does not buffer more than a fraction
+ * of a second of data.
+ */
+qint64 RateLimiter::bufferSize(const qint64 size) const
+{
+   if (!isLimited())
+      return size;
+
+   return qBound(MIN_BURST, m_currentRate / 4, size);
+}
+
+/**
+ * Returns the number of bytes that may be read right now. If nothing may be
+ * read, the \c ready() signal is emitted once the bucket has been refilled.
+ * 返回当前允许读取的字节数
+ */
+qint64 RateLimiter::available()
+{
+   if (!isLimited())
+      return Q_INT64_C(0x7fffffffffffffff);
+
+   refill();
+   if (m_tokens >= 1)
+      return qint64(m_tokens);
+
+   /* Wake the caller once enough tokens for a useful read are available */
+   if (!m_wakeTimer.isActive())
+   {
+      qint64 burst = qMin(MIN_BURST, qMax(qint64(1), m_currentRate / 4));
+      m_wakeTimer.start(qMax(1, int((burst - m_tokens) * 1000 / m_currentRate)));
+   }
+
+   return 0;
+}
+
+/**
+ * Removes the given number of \a bytes from the bucket
+ */
+void RateLimiter::consume(const qint64 bytes)
+{
+   m_consumed += bytes;
+   m_throughput.update(m_consumed);
+
+   if (isLimited())
+   {
+      refill();
+      m_tokens -= bytes;
+   }
+}
+
+/**
+ * Changes the maximum download rate in bytes per second, \c 0 disables the
+ * limit (the adaptive mode may still reduce the rate)
+ * 设置最大下载速率（字节/秒）
+ */
+void RateLimiter::setMaxRate(const qint64 bytesPerSecond)
+{
+   m_maxRate = qMax(qint64(0), bytesPerSecond);
+   setCurrentRate(rateLimit());
+}
+
+/**
+ * Changes the share of the total download rate that the download scheduler
+ * gives to this download, \c 0 if the total rate is not limited
+ * 设置调度器分配给该下载的速率
+ */
+void RateLimiter::setShare(const qint64 bytesPerSecond)
+{
+   if (m_share == bytesPerSecond)
+      return;
+
+   m_share = qMax(qint64(0), bytesPerSecond);
+   setCurrentRate(rateLimit());
+}
+
+/**
+ * Enables or disables the adjustment of the rate to the round-trip time
+ * 启用或禁用根据往返时间自动调整速率
+ */
+void RateLimiter::setAdaptive(const bool adaptive)
+{
+   m_adaptive = adaptive;
+   m_rttSamples.clear();
+
+   if (adaptive)
+   {
+      m_probeTimer.start();
+      probe();
+   }
+
+   else
+   {
+      m_probeTimer.stop();
+      setCurrentRate(rateLimit());
+   }
+}
+
+/**
+ * Changes the URL used to measure the round-trip time, this should be the URL
+ * of the file that is downloaded
+ */
+void RateLimiter::setProbeUrl(const QUrl &url)
+{
+   if (url.host() != m_probeUrl.host())
+      m_rttSamples.clear();
+
+   m_probeUrl = url;
+
+   /* Measure the idle round-trip time before the download starts */
+   if (m_adaptive)
+      probe();
+}
+
+/**
+ * Changes the user-agent string sent with the probe requests
+ */
+void RateLimiter::setUserAgentString(const QString &agent)
+{
+   m_userAgentString = agent;
+}
+
+/**
+ * Sends a \c HEAD request to the download server to measure the round-trip
+ * time, unless a probe is still running
+ * 发送HEAD请求测量往返时间
+ */
+void RateLimiter::probe()
+{
+   if (m_probeReply || !m_probeUrl.isValid())
+      return;
+
+   QNetworkRequest request(m_probeUrl);
+   if (!m_userAgentString.isEmpty())
+      request.setRawHeader("User-Agent", m_userAgentString.toUtf8());
+
+   m_probeClock.start();
+   m_probeReply = m_manager->head(request);
+   connect(m_probeReply, SIGNAL(finished()), this, SLOT(onProbeFinished()));
+}
+
+/**
+ * Compares the measured round-trip time with the base value: backs off
+ * multiplicatively if the queueing delay is too high, and increases the rate
+ * additively otherwise.
+ * 根据往返时间调整速率（乘性减少，加性增加）
+ */
+void RateLimiter::onProbeFinished()
+{
+   QNetworkReply *reply = m_probeReply;
+   m_probeReply = 0;
+   reply->deleteLater();
+
+   qint64 rtt = m_probeClock.elapsed();
+   if (reply->error() != QNetworkReply::NoError || !m_adaptive)
+      return;
+
+   /* Look at the rate that we actually get */
+   qint64 throughput = qint64(m_throughput.currentRate());
+   bool downloading = m_consumed > m_probeConsumed;
+   m_probeConsumed = m_consumed;
+
+   m_rttSamples.append(rtt);
+   while (m_rttSamples.count() > RTT_HISTORY)
+      m_rttSamples.removeFirst();
+
+   qint64 baseRtt = rtt;
+   foreach (qint64 sample, m_rttSamples)
+      baseRtt = qMin(baseRtt, sample);
+
+   if (!downloading)
+      return;
+
+   /* The download fills the queues of the link, slow down */
+   if (rtt - baseRtt > TARGET_DELAY)
+   {
+      qint64 rate = isLimited() ? qMin(m_currentRate, throughput) : throughput;
+      setCurrentRate(qMax(MIN_RATE, rate * 3 / 4));
+   }
+
+   /* No congestion, speed up again */
+   else if (isLimited())
+   {
+      qint64 rate = m_currentRate + qMax(MIN_RATE, m_currentRate / 10);
+
+      /* Without a configured maximum, stop limiting once the limit is far
+       * above the rate that we actually get */
+      if (rateLimit() > 0)
+         setCurrentRate(qMin(rate, rateLimit()));
+      else if (rate > throughput * 2)
+         setCurrentRate(0);
+      else
+         setCurrentRate(rate);
+   }
+}
+
+/**
+ * Adds the tokens accumulated since the last call to the bucket
+ */
+void RateLimiter::refill()
+{
+   qint64 elapsed = m_clock.restart();
+   qreal burst = qMax(MIN_BURST, m_currentRate / 4);
+   m_tokens = qMin(burst, m_tokens + qreal(elapsed) * m_currentRate / 1000);
+}
+
+/**
+ * Returns the lowest of the configured maximum rate and the share given by
+ * the download scheduler (\c 0 if neither is set)
+ */
+qint64 RateLimiter::rateLimit() const
+{
+   if (m_maxRate > 0 && m_share > 0)
+      return qMin(m_maxRate, m_share);
+
+   return qMax(m_maxRate, m_share);
+}
+
+/**
+ * Changes the enforced rate and wakes the readers if it is no longer limited
+ */
+void RateLimiter::setCurrentRate(const qint64 rate)
+{
+   refill();
+   m_currentRate = rate;
+
+   if (!isLimited())
+   {
+      m_tokens = 0;
+      m_wakeTimer.stop();
+      emit ready();
+   }
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_RateLimiter.cpp"
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_RATE_LIMITER_H
+#define _QSIMPLEUPDATER_RATE_LIMITER_H
+
+#include <QUrl>
+#include <QList>
+#include <QTimer>
+#include <QObject>
+#include <QElapsedTimer>
+
+#include "ThroughputEstimator.h"
+
+class QNetworkReply;
+class QNetworkAccessManager;
+
+/**
+ * \brief Token bucket that limits the rate at which downloads are read
+ *
+ * The download classes ask the limiter how many bytes they may read from
+ * their network replies (\c available()) and report what they read
+ * (\c consume()). Since the replies have a bounded read buffer, Qt stops
+ * reading from the socket while no tokens are left, so the TCP window closes
+ * and the sender slows down instead of the data piling up in memory. The
+ * \c ready() signal is emitted once the bucket has been refilled.
+ *
+ * In adaptive mode, the round-trip time to the download server is measured
+ * periodically with small \c HEAD requests. When it rises well above the
+ * lowest value observed (i.e. our download fills the queues of the link), the
+ * rate is reduced; otherwise it slowly grows back to the configured maximum.
+ */
+class RateLimiter : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void ready();
+
+public:
+   explicit RateLimiter(QNetworkAccessManager *manager, QObject *parent = 0);
+   ~RateLimiter();
+
+   bool adaptive() const;
+   bool isLimited() const;
+   qint64 maxRate() const;
+   qint64 currentRate() const;
+   qint64 bufferSize(const qint64 size) const;
+
+   qint64 available();
+   void consume(const qint64 bytes);
+
+public slots:
+   void setMaxRate(const qint64 bytesPerSecond);
+   void setShare(const qint64 bytesPerSecond);
+   void setAdaptive(const bool adaptive);
+   void setProbeUrl(const QUrl &url);
+   void setUserAgentString(const QString &agent);
+
+private slots:
+   void probe();
+   void onProbeFinished();
+
+private:
+   void refill();
+   qint64 rateLimit() const;
+   void setCurrentRate(const qint64 rate);
+
+private:
+   QUrl m_probeUrl;
+   QString m_userAgentString;
+
+   bool m_adaptive;
+   qint64 m_maxRate;
+   qint64 m_share;
+   qint64 m_currentRate;
+   qint64 m_consumed;
+   qint64 m_probeConsumed;
+   qreal m_tokens;
+
+   QList<qint64> m_rttSamples;
+   QElapsedTimer m_clock;
+   QElapsedTimer m_probeClock;
+   ThroughputEstimator m_throughput;
+   QTimer m_wakeTimer;
+   QTimer m_probeTimer;
+   QNetworkReply *m_probeReply;
+   QNetworkAccessManager *m_manager;
+};
+
+#endif
@@ -0,0 +1,604 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QFile>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QNetworkAccessManager>
+
+#include "RateLimiter.h"
+#include "SegmentedDownload.h"
+
+/* Do not split ranges smaller than this */
+static const qint64 MIN_SEGMENT_SIZE = 1024 * 1024;
+
+/* Interval used to measure the rate of each segment and rebalance them */
+static const int REBALANCE_INTERVAL = 1000;
+
+/* Number of times a failed segment is requested again (from each source) */
+static const int MAX_RETRIES = 3;
+
+/* A segment that receives nothing for this long moves to another mirror */
+static const int STALL_TIMEOUT = 15000;
+
+/* Maximum amount of data buffered by each connection */
+static const qint64 READ_BUFFER_SIZE = 1024 * 1024;
+
+/* Maximum amount of data handed to the writer at once */
+static const qint64 READ_CHUNK_SIZE = 256 * 1024;
+
+SegmentedDownload::SegmentedDownload(QNetworkAccessManager *manager, QObject *parent)
+   : QObject(parent)
+   , m_timer(this)
+   , m_writer(this)
+{
+   m_probe = 0;
+   m_limiter = 0;
+   m_total = 0;
+   m_received = 0;
+   m_finished = true;
+   m_segmentCount = 4;
+   m_manager = manager;
+
+   m_timer.setInterval(REBALANCE_INTERVAL);
+   connect(&m_timer, SIGNAL(timeout()), this, SLOT(rebalance()));
+   connect(&m_writer, SIGNAL(drained()), this, SLOT(readSegments()));
+   connect(&m_writer, SIGNAL(closed(bool)), this, SLOT(onWriterClosed(bool)));
+}
+
+SegmentedDownload::~SegmentedDownload()
+{
+   abort();
+}
+
+/**
+ * Returns \c true if there is no transfer in progress
+ */
+bool SegmentedDownload::isFinished() const
+{
+   return m_finished;
+}
+
+/**
+ * Returns the maximum number of parallel connections used for the download
+ */
+int SegmentedDownload::segmentCount() const
+{
+   return m_segmentCount;
+}
+
+/**
+ * Returns the size of the remote file, as reported by the probe request
+ */
+qint64 SegmentedDownload::bytesTotal() const
+{
+   return m_total;
+}
+
+/**
+ * Returns the number of bytes received by all segments
+ */
+qint64 SegmentedDownload::bytesReceived() const
+{
+   return m_received;
+}
+
+/**
+ * Returns the SHA-256 digest of the downloaded file (if hashing is enabled)
+ */
+QByteArray SegmentedDownload::checksum() const
+{
+   return m_writer.checksum();
+}
+
+/**
+ * Aborts all the pending requests and closes the output file
+ * 中止所有分段请求
+ */
+void SegmentedDownload::abort()
+{
+   m_timer.stop();
+   m_finished = true;
+
+   if (m_probe)
+   {
+      m_probe->disconnect(this);
+      m_probe->abort();
+      m_probe->deleteLater();
+      m_probe = 0;
+   }
+
+   foreach (Segment *segment, m_segments)
+   {
+      if (segment->reply)
+      {
+         segment->reply->disconnect(this);
+         segment->reply->abort();
+         segment->reply->deleteLater();
+      }
+
+      delete segment;
+   }
+
+   m_segments.clear();
+   m_writer.abort();
+}
+
+/**
+ * Changes the maximum number of parallel connections
+ */
+void SegmentedDownload::setSegmentCount(const int count)
+{
+   m_segmentCount = qMax(1, count);
+}
+
+/**
+ * If \a enabled is \c true, the SHA-256 digest of the file is computed while
+ * the segments are written
+ */
+void SegmentedDownload::setHashEnabled(const bool enabled)
+{
+   m_writer.setHashEnabled(enabled);
+}
+
+/**
+ * Limits the rate at which the segments are read with the given \a limiter,
+ * which is shared by all the connections. Pass \c 0 to disable the limit.
+ */
+void SegmentedDownload::setRateLimiter(RateLimiter *limiter)
+{
+   if (m_limiter)
+      m_limiter->disconnect(this);
+
+   m_limiter = limiter;
+   if (m_limiter)
+      connect(m_limiter, SIGNAL(ready()), this, SLOT(readSegments()));
+}
+
+/**
+ * Changes the user-agent string sent with every request
+ */
+void SegmentedDownload::setUserAgentString(const QString &agent)
+{
+   m_userAgentString = agent;
+}
+
+/**
+ * Registers other URLs of the file that is downloaded. The \a mirrors must
+ * serve exactly the same file (same size and strong ETag) as the URL given
+ * to \c start(), since the segments fetched from them are written into the
+ * same file.
+ * 设置提供相同文件的镜像，分段可以从不同的镜像下载
+ */
+void SegmentedDownload::setMirrors(const QList<QUrl> &mirrors)
+{
+   m_mirrors = mirrors;
+}
+
+/**
+ * Probes the server at the given \a url and, if range requests are supported,
+ * downloads the file into \a filePath using several connections.
+ * 探测服务器是否支持范围请求，然后开始分段下载
+ */
+void SegmentedDownload::start(const QUrl &url, const QString &filePath)
+{
+   abort();
+
+   m_url = url;
+   m_total = 0;
+   m_received = 0;
+   m_finished = false;
+   m_etag.clear();
+   m_sources.clear();
+   m_filePath = filePath;
+
+   m_probe = m_manager->head(createRequest(m_url));
+   connect(m_probe, SIGNAL(finished()), this, SLOT(onProbeFinished()));
+}
+
+/**
+ * Looks for segments that are slower than the rest and, if there are free
+ * connections, splits the remaining range of the slowest segment in two.
+ * 重新拆分速度较慢的分段
+ */
+void SegmentedDownload::rebalance()
+{
+   int active = 0;
+   Segment *slowest = 0;
+   qreal slowestEta = 0;
+
+   foreach (Segment *segment, m_segments)
+   {
+      if (!segment->reply)
+         continue;
+
+      ++active;
+
+      /* Continue a stalled segment on another mirror */
+      if (segment->received == segment->checked)
+         ++segment->idle;
+      else
+         segment->idle = 0;
+
+      segment->checked = segment->received;
+      if (segment->idle * REBALANCE_INTERVAL >= STALL_TIMEOUT && m_sources.count() > 1)
+      {
+         stopSegment(segment);
+         switchSource(segment);
+         startSegment(segment);
+         continue;
+      }
+
+      /* Find the segment that will take the longest time to complete */
+      qint64 remaining = segment->end - segment->start + 1 - segment->received;
+      if (remaining < 2 * MIN_SEGMENT_SIZE)
+         continue;
+
+      qreal eta = remaining / qMax<qreal>(segment->throughput.currentRate(), 1);
+      if (!slowest || eta > slowestEta)
+      {
+         slowest = segment;
+         slowestEta = eta;
+      }
+   }
+
+   if (!slowest || active >= m_segmentCount)
+      return;
+
+   /* Give the upper half of the remaining range to a new connection, the
+    * old connection stops once it reaches its new end */
+   qint64 position = slowest->start + slowest->received;
+   qint64 middle = position + (slowest->end - position + 1) / 2;
+   qint64 end = slowest->end;
+
+   slowest->end = middle - 1;
+   addSegment(middle, end);
+}
+
+/**
+ * Called when the \c HEAD request finishes, creates the initial segments if
+ * the server supports range requests.
+ */
+void SegmentedDownload::onProbeFinished()
+{
+   QNetworkReply *reply = m_probe;
+   m_probe = 0;
+   reply->deleteLater();
+
+   bool ranges = reply->rawHeader("Accept-Ranges").trimmed().toLower() == "bytes";
+   qint64 length = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+
+   if (reply->error() != QNetworkReply::NoError || !ranges || length <= 0)
+   {
+      m_finished = true;
+      emit rangesUnsupported();
+      return;
+   }
+
+   /* Make sure that every segment comes from the same version of the file */
+   m_etag = reply->rawHeader("ETag");
+   if (m_etag.startsWith("W/"))
+      m_etag.clear();
+
+   /* Segments can only come from the mirrors if If-Range guards them */
+   m_sources.append(m_url);
+   if (!m_etag.isEmpty())
+      m_sources.append(m_mirrors);
+
+   /* Preallocate the output file so that segments can write anywhere */
+   m_total = length;
+   if (!m_writer.open(m_filePath, false, m_total))
+   {
+      fail();
+      return;
+   }
+
+   /* Split the file in equally sized ranges */
+   int count = qBound<qint64>(1, m_total / MIN_SEGMENT_SIZE, m_segmentCount);
+   qint64 size = m_total / count;
+   for (int i = 0; i < count; ++i)
+   {
+      qint64 start = i * size;
+      qint64 end = (i == count - 1) ? m_total - 1 : start + size - 1;
+      addSegment(start, end);
+   }
+
+   m_timer.start();
+}
+
+/**
+ * Reads the data received by a segment, unless the writer is busy
+ * 读取分段数据（写线程繁忙时暂停读取）
+ */
+void SegmentedDownload::onSegmentReadyRead()
+{
+   Segment *segment = segmentForReply(qobject_cast<QNetworkReply *>(sender()));
+   if (!segment)
+      return;
+
+   readSegment(segment, false);
+   checkCompleted();
+}
+
+/**
+ * Continues reading the segments once the writer has room for more data or
+ * the rate limiter allows us to read again
+ */
+void SegmentedDownload::readSegments()
+{
+   foreach (Segment *segment, m_segments)
+   {
+      if (m_finished)
+         return;
+
+      if (segment->reply)
+         readSegment(segment, false);
+   }
+
+   checkCompleted();
+}
+
+/**
+ * Called when a segment finishes, retries failed segments and completes the
+ * download once every segment has been received.
+ */
+void SegmentedDownload::onSegmentFinished()
+{
+   QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+   Segment *segment = segmentForReply(reply);
+   if (!segment)
+      return;
+
+   /* Data that was held back while the writer was busy */
+   readSegment(segment, true);
+   if (m_finished || !segment->reply)
+   {
+      checkCompleted();
+      return;
+   }
+
+   segment->reply = 0;
+   reply->deleteLater();
+
+   /* Request the missing part of the segment again, from the next mirror */
+   if (segment->received < segment->end - segment->start + 1)
+   {
+      if (++segment->retries > MAX_RETRIES * m_sources.count())
+      {
+         fail();
+         return;
+      }
+
+      switchSource(segment);
+      startSegment(segment);
+      return;
+   }
+
+   checkCompleted();
+}
+
+/**
+ * Called when the writer has written all the data to the disk
+ */
+void SegmentedDownload::onWriterClosed(const bool success)
+{
+   if (!success)
+   {
+      fail();
+      return;
+   }
+
+   m_finished = true;
+   emit finished(true);
+}
+
+/**
+ * Returns the segment that is being fetched by the given \a reply
+ */
+SegmentedDownload::Segment *SegmentedDownload::segmentForReply(QNetworkReply *reply) const
+{
+   if (!reply)
+      return 0;
+
+   foreach (Segment *segment, m_segments)
+   {
+      if (segment->reply == reply)
+         return segment;
+   }
+
+   return 0;
+}
+
+/**
+ * Returns a request for the given \a url with the common headers set
+ */
+QNetworkRequest SegmentedDownload::createRequest(const QUrl &url) const
+{
+   QNetworkRequest request(url);
+   request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+   if (!m_userAgentString.isEmpty())
+      request.setRawHeader("User-Agent", m_userAgentString.toUtf8());
+
+   /* Ranges and sizes refer to the file as it is stored */
+   request.setRawHeader("Accept-Encoding", "identity");
+
+   /* Each segment needs its own connection, HTTP/2 would multiplex them */
+   request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+
+   return request;
+}
+
+/**
+ * Hands the data received by the \a segment to the writer. If \a force is
+ * \c false, nothing is read while the writer queue is full or the rate limit
+ * is reached, so that the connection stops reading from the socket.
+ * 将分段数据交给写线程，写线程繁忙或达到速率限制时不读取
+ */
+void SegmentedDownload::readSegment(Segment *segment, const bool force)
+{
+   QNetworkReply *reply = segment->reply;
+   if (!reply || reply->bytesAvailable() <= 0)
+      return;
+
+   /* The server ignored the range, writing the data would corrupt the file */
+   int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+   if (status == 200)
+   {
+      fail();
+      return;
+   }
+
+   /* An error page (e.g. 503 or 429), the segment is requested again once
+    * the reply finishes, like after a network error */
+   if (status != 206)
+   {
+      reply->readAll();
+      return;
+   }
+
+   while (reply->bytesAvailable() > 0 && (force || !m_writer.isFull()))
+   {
+      /* Do not write past the end of the segment (it may have been split) */
+      qint64 remaining = segment->end - segment->start + 1 - segment->received;
+      qint64 size = qMin(remaining, READ_CHUNK_SIZE);
+      if (m_limiter && !force)
+      {
+         size = qMin(size, m_limiter->available());
+         if (size <= 0)
+            break;
+      }
+
+      QByteArray data = reply->read(size);
+      if (m_limiter)
+         m_limiter->consume(data.size());
+
+      m_writer.write(segment->start + segment->received, data);
+      segment->received += data.size();
+      segment->throughput.update(segment->received, segment->end - segment->start + 1);
+      m_received += data.size();
+
+      /* The segment was split and it reached its new end */
+      if (segment->received >= segment->end - segment->start + 1)
+      {
+         stopSegment(segment);
+         break;
+      }
+   }
+
+   emit downloadProgress(m_received, m_total);
+}
+
+/**
+ * Closes the connection of the \a segment
+ */
+void SegmentedDownload::stopSegment(Segment *segment)
+{
+   if (!segment->reply)
+      return;
+
+   segment->reply->disconnect(this);
+   segment->reply->abort();
+   segment->reply->deleteLater();
+   segment->reply = 0;
+}
+
+/**
+ * Requests the part of the \a segment that has not been received yet
+ */
+void SegmentedDownload::startSegment(Segment *segment)
+{
+   qint64 from = segment->start + segment->received;
+
+   QNetworkRequest request = createRequest(m_sources.at(segment->source));
+   request.setRawHeader("Range", "bytes=" + QByteArray::number(from) + "-" + QByteArray::number(segment->end));
+   if (!m_etag.isEmpty())
+      request.setRawHeader("If-Range", m_etag);
+
+   segment->idle = 0;
+   segment->checked = segment->received;
+   segment->reply = m_manager->get(request);
+   segment->reply->setReadBufferSize(m_limiter ? m_limiter->bufferSize(READ_BUFFER_SIZE) : READ_BUFFER_SIZE);
+   connect(segment->reply, SIGNAL(readyRead()), this, SLOT(onSegmentReadyRead()));
+   connect(segment->reply, SIGNAL(finished()), this, SLOT(onSegmentFinished()));
+}
+
+/**
+ * Registers and starts a new segment for the given byte range
+ */
+void SegmentedDownload::addSegment(const qint64 start, const qint64 end)
+{
+   Segment *segment = new Segment;
+   segment->start = start;
+   segment->end = end;
+   segment->received = 0;
+   segment->retries = 0;
+   segment->idle = 0;
+   segment->checked = 0;
+   segment->reply = 0;
+
+   /* Spread the segments over the download server and the mirrors */
+   segment->source = m_segments.count() % m_sources.count();
+
+   m_segments.append(segment);
+   startSegment(segment);
+}
+
+/**
+ * Moves the \a segment to the next mirror (if there is more than one source)
+ */
+void SegmentedDownload::switchSource(Segment *segment)
+{
+   segment->source = (segment->source + 1) % m_sources.count();
+}
+
+/**
+ * Waits for the writer once every segment has been received
+ */
+void SegmentedDownload::checkCompleted()
+{
+   if (m_finished || m_segments.isEmpty() || !m_writer.isOpen())
+      return;
+
+   foreach (Segment *segment, m_segments)
+   {
+      if (segment->reply || segment->received < segment->end - segment->start + 1)
+         return;
+   }
+
+   /* Every segment is complete */
+   m_timer.stop();
+   m_writer.finish();
+}
+
+/**
+ * Aborts the download and notifies the caller about the error
+ */
+void SegmentedDownload::fail()
+{
+   abort();
+   QFile::remove(m_filePath);
+   emit finished(false);
+}
+
+#if QSU_INCLUDE_MOC
+#   include "moc_SegmentedDownload.cpp"
+#endif
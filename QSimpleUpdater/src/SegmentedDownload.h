@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_SEGMENTED_DOWNLOAD_H
+#define _QSIMPLEUPDATER_SEGMENTED_DOWNLOAD_H
+
+#include <QUrl>
+#include <QList>
+#include <QTimer>
+#include <QObject>
+#include <QByteArray>
+
+#include "DownloadWriter.h"
+#include "ThroughputEstimator.h"
+
+class RateLimiter;
+class QNetworkReply;
+class QNetworkRequest;
+class QNetworkAccessManager;
+
+/**
+ * \brief Downloads a file over several parallel HTTP range requests
+ *
+ * The \c SegmentedDownload first probes the server with a \c HEAD request. If
+ * the server advertises \c Accept-Ranges and a \c Content-Length, the output
+ * file is preallocated and split into byte ranges that are fetched
+ * concurrently, each one written at its own offset of the file by a
+ * \c DownloadWriter thread.
+ *
+ * Slow segments are split again once a connection becomes free, so that the
+ * tail of the download does not depend on a single slow stream.
+ *
+ * If mirrors that serve the same file (same size and strong ETag) are
+ * registered with \c setMirrors(), the segments are spread over the download
+ * server and the mirrors. A segment that fails or stops receiving data
+ * continues from its current offset on the next mirror.
+ *
+ * If the server does not support range requests, the \c rangesUnsupported()
+ * signal is emitted and the caller should fall back to a single stream.
+ */
+class SegmentedDownload : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void rangesUnsupported();
+   void finished(const bool success);
+   void downloadProgress(qint64 received, qint64 total);
+
+public:
+   explicit SegmentedDownload(QNetworkAccessManager *manager, QObject *parent = 0);
+   ~SegmentedDownload();
+
+   bool isFinished() const;
+   int segmentCount() const;
+   qint64 bytesTotal() const;
+   qint64 bytesReceived() const;
+   QByteArray checksum() const;
+
+public slots:
+   void abort();
+   void setSegmentCount(const int count);
+   void setHashEnabled(const bool enabled);
+   void setRateLimiter(RateLimiter *limiter);
+   void setUserAgentString(const QString &agent);
+   void setMirrors(const QList<QUrl> &mirrors);
+   void start(const QUrl &url, const QString &filePath);
+
+private slots:
+   void rebalance();
+   void onProbeFinished();
+   void readSegments();
+   void onSegmentReadyRead();
+   void onSegmentFinished();
+   void onWriterClosed(const bool success);
+
+private:
+   struct Segment
+   {
+      qint64 start;
+      qint64 end;
+      qint64 received;
+      ThroughputEstimator throughput;
+      int retries;
+      int source;
+      int idle;
+      qint64 checked;
+      QNetworkReply *reply;
+   };
+
+   Segment *segmentForReply(QNetworkReply *reply) const;
+   QNetworkRequest createRequest(const QUrl &url) const;
+   void readSegment(Segment *segment, const bool force);
+   void stopSegment(Segment *segment);
+   void startSegment(Segment *segment);
+   void switchSource(Segment *segment);
+   void checkCompleted();
+   void addSegment(const qint64 start, const qint64 end);
+   void fail();
+
+private:
+   QUrl m_url;
+   QList<QUrl> m_mirrors;
+   QList<QUrl> m_sources;
+   QTimer m_timer;
+   QString m_filePath;
+   DownloadWriter m_writer;
+   QByteArray m_etag;
+   QString m_userAgentString;
+
+   int m_segmentCount;
+   bool m_finished;
+   qint64 m_total;
+   qint64 m_received;
+
+   QList<Segment *> m_segments;
+   QNetworkReply *m_probe;
+   RateLimiter *m_limiter;
+   QNetworkAccessManager *m_manager;
+};
+
+#endif
@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QDirIterator>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+
+#if defined Q_OS_LINUX
+#   include <stdio.h>
+#   include <limits.h>
+#   include <unistd.h>
+#endif
+
+#include "DownloadCache.h"
+#include "SlotInstaller.h"
+
+/* Names of the slots and of the links inside of the installation root */
+static const QString SLOT_A("slot-a");
+static const QString SLOT_B("slot-b");
+static const QString CURRENT_LINK("current");
+static const QString PREVIOUS_LINK("previous");
+
+/**
+ * Returns the target of the symbolic link at \a path as it is stored in the
+ * link (which may be relative), or an empty string if it cannot be read
+ */
+static QString readLink(const QString &path)
+{
+#if defined Q_OS_LINUX
+   char link[PATH_MAX];
+   ssize_t length = ::readlink(QFile::encodeName(path).constData(), link, sizeof(link) - 1);
+   if (length > 0)
+      return QFile::decodeName(QByteArray(link, int(length)));
+#else
+   Q_UNUSED(path);
+#endif
+
+   return QString();
+}
+
+SlotInstaller::SlotInstaller(const QString &root)
+{
+   m_root = QDir::cleanPath(QDir(root).absolutePath());
+}
+
+/**
+ * Returns \c true if slot installs are supported on this system
+ */
+bool SlotInstaller::isSupported()
+{
+#if defined Q_OS_LINUX
+   return true;
+#else
+   return false;
+#endif
+}
+
+/**
+ * Returns the installation root, which contains the slots and the links
+ */
+QString SlotInstaller::root() const
+{
+   return m_root;
+}
+
+/**
+ * Returns a description of the last error
+ */
+QString SlotInstaller::errorString() const
+{
+   return m_errorString;
+}
+
+/**
+ * Returns the slot that the \c current link points to, or an empty string if
+ * nothing has been installed yet
+ */
+QString SlotInstaller::currentSlot() const
+{
+   return linkTarget(CURRENT_LINK);
+}
+
+/**
+ * Returns the slot that the running executable was started from, or an empty
+ * string if it does not run from a slot. This differs from \c currentSlot()
+ * once an update has been activated and the application was not restarted.
+ */
+QString SlotInstaller::runningSlot() const
+{
+   QString application = QFileInfo(QCoreApplication::applicationFilePath()).canonicalFilePath();
+   foreach (const QString &name, QStringList() << SLOT_A << SLOT_B)
+   {
+      QString slot = QFileInfo(slotPath(name)).canonicalFilePath();
+      if (!slot.isEmpty() && application.startsWith(slot + "/"))
+         return slotPath(name);
+   }
+
+   return QString();
+}
+
+/**
+ * Returns the slot of the version before the current one, or an empty string
+ * if there is none
+ */
+QString SlotInstaller::previousSlot() const
+{
+   return linkTarget(PREVIOUS_LINK);
+}
+
+/**
+ * Returns the path of the \c current link, the application must be started
+ * through it to run the active version
+ */
+QString SlotInstaller::currentLink() const
+{
+   return slotPath(CURRENT_LINK);
+}
+
+/**
+ * Returns the path of the running executable relative to its slot (or its
+ * file name if the application does not run from a slot yet)
+ */
+QString SlotInstaller::entryPoint() const
+{
+   QString application = QFileInfo(QCoreApplication::applicationFilePath()).canonicalFilePath();
+   QString slot = QFileInfo(runningSlot()).canonicalFilePath();
+   if (!slot.isEmpty() && application.startsWith(slot + "/"))
+      return application.mid(slot.length() + 1);
+
+   return QFileInfo(application).fileName();
+}
+
+/**
+ * Moves the files of \a directory into the slot that is neither running nor
+ * current, checks that the slot holds exactly those files and an executable
+ * \a entryPoint, and activates it. The slot that was current becomes the
+ * \c previous slot.
+ * 将更新安装到备用槽位，校验后原子切换当前版本
+ */
+bool SlotInstaller::install(const QString &directory, const QString &entryPoint)
+{
+   if (!isSupported())
+      return fail("Slot installs are not supported on this system");
+
+   if (!QDir().mkpath(m_root))
+      return fail("Unable to create " + m_root);
+
+   /* Both slots are in use until the application restarts */
+   QString current = currentSlot();
+   QString slot = stagingSlot();
+   if (slot.isEmpty())
+      return fail("An update is already installed, restart the application before installing another one");
+
+   QString content = contentDirectory(directory);
+   Manifest manifest;
+   if (!readManifest(content, &manifest))
+      return fail("Unable to read the update files in " + content);
+
+   if (!stage(content, slot))
+      return false;
+
+   if (!verify(slot, entryPoint, manifest))
+   {
+      QDir(slot).removeRecursively();
+      return false;
+   }
+
+   return swapLinks(slot, current);
+}
+
+/**
+ * Activates the previous slot again, the current slot becomes the previous
+ * one (so a second call undoes the rollback)
+ * 回滚到上一个版本
+ */
+bool SlotInstaller::rollback()
+{
+   if (!isSupported())
+      return fail("Slot installs are not supported on this system");
+
+   QString previous = previousSlot();
+   if (previous.isEmpty() || !QFileInfo(previous).isDir())
+      return fail("There is no previous version to roll back to");
+
+   return swapLinks(previous, currentSlot());
+}
+
+/**
+ * Returns the slot that receives the next update: the slot that neither the
+ * running executable nor the \c current link use, or an empty string if
+ * they use one slot each
+ */
+QString SlotInstaller::stagingSlot() const
+{
+   QString current = QFileInfo(currentSlot()).canonicalFilePath();
+   QString running = QFileInfo(runningSlot()).canonicalFilePath();
+   foreach (const QString &name, QStringList() << SLOT_A << SLOT_B)
+   {
+      QString slot = QFileInfo(slotPath(name)).canonicalFilePath();
+      if (slot.isEmpty() || (slot != current && slot != running))
+         return slotPath(name);
+   }
+
+   return QString();
+}
+
+/**
+ * Returns the path of the slot or link with the given \a name
+ */
+QString SlotInstaller::slotPath(const QString &name) const
+{
+   return m_root + "/" + name;
+}
+
+/**
+ * Returns the absolute path that the link with the given \a name points to,
+ * or an empty string if there is no such link
+ */
+QString SlotInstaller::linkTarget(const QString &name) const
+{
+   QFileInfo info(slotPath(name));
+   if (!info.isSymLink())
+      return QString();
+
+   return QDir::cleanPath(info.symLinkTarget());
+}
+
+/**
+ * Archives usually contain a single top-level directory, in which case its
+ * contents are installed instead of the directory itself
+ */
+QString SlotInstaller::contentDirectory(const QString &directory) const
+{
+   QFileInfoList entries = QDir(directory).entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System
+                                                         | QDir::NoDotAndDotDot);
+   if (entries.count() == 1 && entries.first().isDir() && !entries.first().isSymLink())
+      return entries.first().absoluteFilePath();
+
+   return directory;
+}
+
+/**
+ * Replaces the contents of \a slot with the files of \a directory. The files
+ * are moved, or copied if the slot is on another file system.
+ */
+bool SlotInstaller::stage(const QString &directory, const QString &slot)
+{
+   if (!QFileInfo(directory).isDir())
+      return fail("Unable to find the update files in " + directory);
+
+   /* The previous version is overwritten, it can no longer be restored */
+   if (previousSlot() == slot)
+      QFile::remove(slotPath(PREVIOUS_LINK));
+
+   QDir(slot).removeRecursively();
+   if (QDir().rename(directory, slot))
+      return true;
+
+   if (!copyTree(directory, slot))
+   {
+      QDir(slot).removeRecursively();
+      return fail("Unable to copy the update files to " + slot);
+   }
+
+   QDir(directory).removeRecursively();
+   return true;
+}
+
+/**
+ * Copies the \a source directory to \a target, keeping symbolic links and
+ * permissions (files are cloned when the file system allows it)
+ */
+bool SlotInstaller::copyTree(const QString &source, const QString &target)
+{
+   if (!QDir().mkpath(target))
+      return false;
+
+   QFileInfoList entries = QDir(source).entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System
+                                                      | QDir::NoDotAndDotDot);
+   foreach (const QFileInfo &info, entries)
+   {
+      QString path = target + "/" + info.fileName();
+      if (info.isSymLink())
+      {
+         QString link = readLink(info.filePath());
+         if (link.isEmpty() || !QFile::link(link, path))
+            return false;
+      }
+
+      else if (info.isDir())
+      {
+         if (!copyTree(info.filePath(), path))
+            return false;
+      }
+
+      else if (!DownloadCache::linkFile(info.filePath(), path))
+         return false;
+   }
+
+   return QFile::setPermissions(target, QFile::permissions(source));
+}
+
+/**
+ * Records every entry of \a directory in \a manifest, by its relative path:
+ * the permissions and SHA-256 digest of files, the permissions of
+ * directories and the target of symbolic links
+ */
+bool SlotInstaller::readManifest(const QString &directory, Manifest *manifest)
+{
+   manifest->clear();
+
+   QDir root(directory);
+   QDirIterator it(directory, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                   QDirIterator::Subdirectories);
+   while (it.hasNext())
+   {
+      it.next();
+      QFileInfo info = it.fileInfo();
+
+      QByteArray entry;
+      if (info.isSymLink())
+         entry = "link:" + QFile::encodeName(readLink(info.filePath()));
+
+      else if (info.isDir())
+         entry = "dir:" + QByteArray::number(int(info.permissions()));
+
+      else
+      {
+         QFile file(info.filePath());
+         QCryptographicHash hash(QCryptographicHash::Sha256);
+         if (!file.open(QFile::ReadOnly) || !hash.addData(&file))
+            return false;
+
+         entry = "file:" + QByteArray::number(int(info.permissions())) + ":" + hash.result().toHex();
+      }
+
+      manifest->insert(root.relativeFilePath(info.filePath()), entry);
+   }
+
+   return true;
+}
+
+/**
+ * Checks that the staged \a slot holds exactly the files of the update (as
+ * recorded in \a manifest), that its links stay inside of the slot and that
+ * the executable \a entryPoint is there, so that the application can be
+ * restarted from it
+ */
+bool SlotInstaller::verify(const QString &slot, const QString &entryPoint, const Manifest &manifest)
+{
+   Manifest staged;
+   if (!readManifest(slot, &staged))
+      return fail("Unable to read the update files in " + slot);
+
+   if (staged != manifest)
+      return fail("The update files were not staged correctly in " + slot);
+
+   /* A link that leaves the slot would run files of another version */
+   QString root = QFileInfo(slot).canonicalFilePath();
+   QDirIterator it(slot, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                   QDirIterator::Subdirectories);
+   while (it.hasNext())
+   {
+      it.next();
+      QString link = readLink(it.filePath());
+      if (!link.isEmpty())
+      {
+         QString parent = QFileInfo(it.fileInfo().absolutePath()).canonicalFilePath();
+         QString target = QDir::cleanPath(parent + "/" + link);
+         if (QDir::isAbsolutePath(link) || (target != root && !target.startsWith(root + "/")))
+            return fail("The update file " + QDir(slot).relativeFilePath(it.filePath()) + " links outside of it");
+      }
+   }
+
+   QFileInfo info(slot + "/" + entryPoint);
+   if (entryPoint.isEmpty() || !info.isFile())
+      return fail("The update does not contain " + entryPoint);
+
+   if (!info.isExecutable())
+      return fail("The update file " + entryPoint + " is not executable");
+
+   /* The entry point itself must not lead out of the slot either */
+   if (!info.canonicalFilePath().startsWith(root + "/"))
+      return fail("The update file " + entryPoint + " is outside of the update");
+
+   return true;
+}
+
+/**
+ * Points the \c current link to \a current and the \c previous link to
+ * \a previous (if there is one)
+ */
+bool SlotInstaller::swapLinks(const QString &current, const QString &previous)
+{
+   if (!replaceLink(CURRENT_LINK, QFileInfo(current).fileName()))
+      return false;
+
+   if (!previous.isEmpty() && !replaceLink(PREVIOUS_LINK, QFileInfo(previous).fileName()))
+      return false;
+
+   return true;
+}
+
+/**
+ * Points the link with the given \a name to \a target (relative to the
+ * installation root). The new link is created next to the old one and
+ * renamed over it, so the link always points to a complete slot.
+ */
+bool SlotInstaller::replaceLink(const QString &name, const QString &target)
+{
+#if defined Q_OS_LINUX
+   QString link = slotPath(name);
+   QString temp = link + ".new";
+
+   QFile::remove(temp);
+   if (!QFile::link(target, temp))
+      return fail("Unable to create " + temp);
+
+   if (::rename(QFile::encodeName(temp).constData(), QFile::encodeName(link).constData()) != 0)
+   {
+      QFile::remove(temp);
+      return fail("Unable to replace " + link);
+   }
+
+   return true;
+#else
+   Q_UNUSED(name);
+   Q_UNUSED(target);
+   return fail("Slot installs are not supported on this system");
+#endif
+}
+
+/**
+ * Records the \a error and returns \c false
+ */
+bool SlotInstaller::fail(const QString &error)
+{
+   m_errorString = error;
+   return false;
+}
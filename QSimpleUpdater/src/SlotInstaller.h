@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_SLOT_INSTALLER_H
+#define _QSIMPLEUPDATER_SLOT_INSTALLER_H
+
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * \brief Installs updates into A/B slots and activates them atomically
+ *
+ * The installation root contains two slots (\c slot-a and \c slot-b) and two
+ * symbolic links: \c current points to the slot that the application runs
+ * from and \c previous to the slot of the version before it. An update is
+ * staged into the slot that is not running while the application keeps
+ * working, verified, and activated by replacing the \c current link with a
+ * single \c rename() call. The application only has to be restarted from
+ * the \c current link, and \c rollback() brings the previous version back
+ * the same way.
+ *
+ * The running slot is found from the path of the executable, not from the
+ * \c current link: once an update has been activated, the other slot is
+ * still in use until the application restarts, so further installs are
+ * refused until then. The staged slot is compared file by file (with their
+ * SHA-256 digests) with the update before it is activated.
+ *
+ * The layout relies on symbolic links and on \c rename() replacing them
+ * atomically, so slot installs are only supported on Linux.
+ */
+class SlotInstaller
+{
+public:
+   explicit SlotInstaller(const QString &root);
+
+   static bool isSupported();
+
+   QString root() const;
+   QString errorString() const;
+   QString currentSlot() const;
+   QString runningSlot() const;
+   QString previousSlot() const;
+   QString currentLink() const;
+   QString entryPoint() const;
+
+   bool install(const QString &directory, const QString &entryPoint);
+   bool rollback();
+
+private:
+   typedef QHash<QString, QByteArray> Manifest;
+
+   QString stagingSlot() const;
+   QString slotPath(const QString &name) const;
+   QString linkTarget(const QString &name) const;
+   QString contentDirectory(const QString &directory) const;
+   bool stage(const QString &directory, const QString &slot);
+   bool copyTree(const QString &source, const QString &target);
+   bool readManifest(const QString &directory, Manifest *manifest);
+   bool verify(const QString &slot, const QString &entryPoint, const Manifest &manifest);
+   bool swapLinks(const QString &current, const QString &previous);
+   bool replaceLink(const QString &name, const QString &target);
+   bool fail(const QString &error);
+
+private:
+   QString m_root;
+   QString m_errorString;
+};
+
+#endif
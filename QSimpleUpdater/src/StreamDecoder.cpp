@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <zlib.h>
+#ifdef QSU_ENABLE_ZSTD
+#   include <zstd.h>
+#endif
+
+#include "StreamDecoder.h"
+
+/* Size of the blocks produced by the decompressors */
+static const int OUTPUT_BLOCK_SIZE = 256 * 1024;
+
+/**
+ * State of the decompression libraries, kept out of the header so that
+ * their headers are only needed here
+ */
+struct StreamDecoder::State
+{
+   z_stream zlib;
+   bool zlibReady;
+#ifdef QSU_ENABLE_ZSTD
+   ZSTD_DCtx *zstd;
+#endif
+};
+
+StreamDecoder::StreamDecoder()
+{
+   m_format = Identity;
+   m_finished = false;
+
+   m_state = new State;
+   m_state->zlibReady = false;
+#ifdef QSU_ENABLE_ZSTD
+   m_state->zstd = 0;
+#endif
+}
+
+StreamDecoder::~StreamDecoder()
+{
+   release();
+   delete m_state;
+}
+
+/**
+ * Returns the format of the data passed to \c decode()
+ */
+StreamDecoder::Format StreamDecoder::format() const
+{
+   return m_format;
+}
+
+/**
+ * Returns \c true if the end of the compressed stream has been reached. If
+ * this is not the case once all the data was received, the data is truncated.
+ */
+bool StreamDecoder::isFinished() const
+{
+   return m_finished;
+}
+
+/**
+ * Returns a description of the last error
+ */
+QString StreamDecoder::errorString() const
+{
+   return m_errorString;
+}
+
+/**
+ * Prepares the decoder for a new stream in the given \a format, returns
+ * \c false if the format is not supported by this build
+ * 初始化解码器
+ */
+bool StreamDecoder::init(const Format format)
+{
+   release();
+
+   m_format = format;
+   m_finished = format == Identity;
+   m_errorString.clear();
+
+   if (format == Gzip)
+   {
+      z_stream *zlib = &m_state->zlib;
+      zlib->zalloc = Z_NULL;
+      zlib->zfree = Z_NULL;
+      zlib->opaque = Z_NULL;
+      zlib->next_in = Z_NULL;
+      zlib->avail_in = 0;
+
+      /* Accept both gzip and zlib headers */
+      if (inflateInit2(zlib, MAX_WBITS + 32) != Z_OK)
+      {
+         m_errorString = "Unable to initialize zlib";
+         return false;
+      }
+
+      m_state->zlibReady = true;
+   }
+
+   else if (format == Zstd)
+   {
+#ifdef QSU_ENABLE_ZSTD
+      m_state->zstd = ZSTD_createDCtx();
+      if (!m_state->zstd)
+      {
+         m_errorString = "Unable to initialize zstd";
+         return false;
+      }
+#else
+      m_errorString = "zstd support is not enabled";
+      return false;
+#endif
+   }
+
+   return true;
+}
+
+/**
+ * Decompresses the given \a input and appends the result to \a output,
+ * returns \c false if the data is not valid. If \a maxSize is not negative,
+ * the decompression stops (and fails) as soon as more than \a maxSize bytes
+ * would be appended, so that a small input cannot expand without bounds.
+ * 解压数据块（可限制解压后的大小）
+ */
+bool StreamDecoder::decode(const QByteArray &input, QByteArray *output, const qint64 maxSize)
+{
+   if (m_format == Identity)
+   {
+      if (maxSize >= 0 && input.size() > maxSize)
+      {
+         m_errorString = "The decompressed data is too large";
+         return false;
+      }
+
+      output->append(input);
+      return true;
+   }
+
+   if (input.isEmpty())
+      return true;
+
+   if (m_format == Gzip)
+      return decodeZlib(input.constData(), input.size(), output, maxSize);
+
+   return decodeZstd(input.constData(), input.size(), output, maxSize);
+}
+
+/**
+ * Returns \c true if data in the given \a format can be decoded
+ */
+bool StreamDecoder::isSupported(const Format format)
+{
+#ifdef QSU_ENABLE_ZSTD
+   Q_UNUSED(format);
+   return true;
+#else
+   return format != Zstd;
+#endif
+}
+
+/**
+ * Returns the value of the \c Accept-Encoding header for the encodings that
+ * we can decode
+ */
+QByteArray StreamDecoder::acceptEncoding()
+{
+#ifdef QSU_ENABLE_ZSTD
+   return "zstd, gzip, deflate";
+#else
+   return "gzip, deflate";
+#endif
+}
+
+/**
+ * Returns the format of a response with the given \c Content-Encoding header
+ */
+StreamDecoder::Format StreamDecoder::formatFromEncoding(const QByteArray &encoding)
+{
+   QByteArray value = encoding.trimmed().toLower();
+   if (value == "gzip" || value == "x-gzip" || value == "deflate")
+      return Gzip;
+
+   if (value == "zstd")
+      return Zstd;
+
+   return Identity;
+}
+
+/**
+ * Returns the format of a file that is published as is, using the suffix of
+ * the \a url (\c .gz or \c .zst)
+ */
+StreamDecoder::Format StreamDecoder::formatFromUrl(const QUrl &url)
+{
+   QString path = url.path().toLower();
+   if (path.endsWith(".gz"))
+      return Gzip;
+
+   if (path.endsWith(".zst"))
+      return Zstd;
+
+   return Identity;
+}
+
+/**
+ * Returns the format of the given \a data, using the magic number of gzip
+ * and zstd streams
+ */
+StreamDecoder::Format StreamDecoder::formatFromData(const QByteArray &data)
+{
+   if (data.startsWith("\x1f\x8b"))
+      return Gzip;
+
+   if (data.startsWith("\x28\xb5\x2f\xfd"))
+      return Zstd;
+
+   return Identity;
+}
+
+/**
+ * Removes the compression suffix from the given \a fileName, since the file
+ * is stored decompressed
+ */
+QString StreamDecoder::stripSuffix(const QString &fileName)
+{
+   if (fileName.endsWith(".gz", Qt::CaseInsensitive))
+      return fileName.left(fileName.length() - 3);
+
+   if (fileName.endsWith(".zst", Qt::CaseInsensitive))
+      return fileName.left(fileName.length() - 4);
+
+   return fileName;
+}
+
+/**
+ * Decompresses the whole \a data, giving up if the result would be larger
+ * than \a maxSize bytes
+ * 一次性解压数据（用于小文件，例如appcast）
+ */
+QByteArray StreamDecoder::decodeAll(const QByteArray &data, const Format format, const qint64 maxSize, bool *ok)
+{
+   StreamDecoder decoder;
+   QByteArray output;
+
+   *ok = decoder.init(format);
+
+   /* The decoder stops as soon as the output exceeds the size limit */
+   if (*ok)
+      *ok = decoder.decode(data, &output, maxSize);
+
+   if (*ok && !decoder.isFinished())
+      *ok = false;
+
+   return *ok ? output : QByteArray();
+}
+
+/**
+ * Frees the state of the current decompressor
+ */
+void StreamDecoder::release()
+{
+   if (m_state->zlibReady)
+   {
+      inflateEnd(&m_state->zlib);
+      m_state->zlibReady = false;
+   }
+
+#ifdef QSU_ENABLE_ZSTD
+   if (m_state->zstd)
+   {
+      ZSTD_freeDCtx(m_state->zstd);
+      m_state->zstd = 0;
+   }
+#endif
+}
+
+/**
+ * Returns the size of the next block appended to \a output, which held
+ * \a offset bytes before the call to \c decode(): one byte more than the
+ * rest of \a maxSize at most, so that exceeding it can be detected. Returns
+ * \c 0 (and records the error) if the limit was exceeded.
+ */
+int StreamDecoder::blockSize(const QByteArray *output, const int offset, const qint64 maxSize)
+{
+   if (maxSize < 0)
+      return OUTPUT_BLOCK_SIZE;
+
+   qint64 remaining = maxSize - (output->size() - offset);
+   if (remaining < 0)
+   {
+      m_errorString = "The decompressed data is too large";
+      return 0;
+   }
+
+   return int(qMin<qint64>(OUTPUT_BLOCK_SIZE, remaining + 1));
+}
+
+/**
+ * Decompresses gzip or zlib data, concatenated gzip members are supported
+ */
+bool StreamDecoder::decodeZlib(const char *data, const qint64 size, QByteArray *output, const qint64 maxSize)
+{
+   if (!m_state->zlibReady)
+      return false;
+
+   z_stream *zlib = &m_state->zlib;
+   zlib->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+   zlib->avail_in = uInt(size);
+
+   int start = output->size();
+   forever
+   {
+      /* Another gzip member follows the previous one */
+      if (m_finished)
+      {
+         if (zlib->avail_in == 0)
+            break;
+
+         if (inflateReset(zlib) != Z_OK)
+            return false;
+
+         m_finished = false;
+      }
+
+      int block = blockSize(output, start, maxSize);
+      if (block == 0)
+         return false;
+
+      int offset = output->size();
+      output->resize(offset + block);
+      zlib->next_out = reinterpret_cast<Bytef *>(output->data() + offset);
+      zlib->avail_out = uInt(block);
+
+      int result = inflate(zlib, Z_NO_FLUSH);
+      output->resize(offset + block - int(zlib->avail_out));
+
+      if (result == Z_STREAM_END)
+      {
+         m_finished = true;
+         continue;
+      }
+
+      /* All the input has been consumed */
+      if (result == Z_BUF_ERROR)
+         break;
+
+      if (result != Z_OK)
+      {
+         m_errorString = zlib->msg ? QString::fromLatin1(zlib->msg) : QString("Invalid compressed data");
+         return false;
+      }
+
+      /* Continue while the output block was filled, more data may follow */
+      if (zlib->avail_in == 0 && zlib->avail_out > 0)
+         break;
+   }
+
+   return blockSize(output, start, maxSize) > 0;
+}
+
+/**
+ * Decompresses zstd data, concatenated frames are supported
+ */
+bool StreamDecoder::decodeZstd(const char *data, const qint64 size, QByteArray *output, const qint64 maxSize)
+{
+#ifdef QSU_ENABLE_ZSTD
+   if (!m_state->zstd)
+      return false;
+
+   ZSTD_inBuffer input = { data, size_t(size), 0 };
+
+   int start = output->size();
+   forever
+   {
+      int block = blockSize(output, start, maxSize);
+      if (block == 0)
+         return false;
+
+      int offset = output->size();
+      output->resize(offset + block);
+
+      ZSTD_outBuffer buffer = { output->data() + offset, size_t(block), 0 };
+      size_t result = ZSTD_decompressStream(m_state->zstd, &buffer, &input);
+      output->resize(offset + int(buffer.pos));
+
+      if (ZSTD_isError(result))
+      {
+         m_errorString = QString::fromLatin1(ZSTD_getErrorName(result));
+         return false;
+      }
+
+      /* A result of zero means that a frame has been completely decoded */
+      m_finished = result == 0;
+
+      /* Continue while the output block was filled, more data may follow */
+      if (input.pos == input.size && buffer.pos < buffer.size)
+         break;
+   }
+
+   return blockSize(output, start, maxSize) > 0;
+#else
+   Q_UNUSED(data);
+   Q_UNUSED(size);
+   Q_UNUSED(output);
+   Q_UNUSED(maxSize);
+   return false;
+#endif
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_STREAM_DECODER_H
+#define _QSIMPLEUPDATER_STREAM_DECODER_H
+
+#include <QUrl>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * \brief Decompresses gzip/zlib (and zstd) streams block by block
+ *
+ * The \c StreamDecoder is fed with the compressed data as it is received and
+ * returns the decompressed data, so that compressed appcasts and payloads
+ * never have to be held in memory as a whole.
+ *
+ * gzip and zlib use the zlib library (the system library, or the copy that
+ * is bundled with Qt). zstd support is optional, since it needs libzstd:
+ * build with \c CONFIG+=qsu_zstd to enable it.
+ */
+class StreamDecoder
+{
+public:
+   enum Format
+   {
+      Identity,
+      Gzip,
+      Zstd
+   };
+
+   StreamDecoder();
+   ~StreamDecoder();
+
+   Format format() const;
+   bool isFinished() const;
+   QString errorString() const;
+
+   bool init(const Format format);
+   bool decode(const QByteArray &input, QByteArray *output, const qint64 maxSize = -1);
+
+   static bool isSupported(const Format format);
+   static QByteArray acceptEncoding();
+   static Format formatFromEncoding(const QByteArray &encoding);
+   static Format formatFromUrl(const QUrl &url);
+   static Format formatFromData(const QByteArray &data);
+   static QString stripSuffix(const QString &fileName);
+   static QByteArray decodeAll(const QByteArray &data, const Format format, const qint64 maxSize, bool *ok);
+
+private:
+   Q_DISABLE_COPY(StreamDecoder)
+
+   struct State;
+
+   void release();
+   bool decodeZlib(const char *data, const qint64 size, QByteArray *output, const qint64 maxSize);
+   bool decodeZstd(const char *data, const qint64 size, QByteArray *output, const qint64 maxSize);
+   int blockSize(const QByteArray *output, const int offset, const qint64 maxSize);
+
+private:
+   Format m_format;
+   bool m_finished;
+   QString m_errorString;
+   State *m_state;
+};
+
+#endif
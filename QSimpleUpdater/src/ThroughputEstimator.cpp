@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <math.h>
+
+#include "ThroughputEstimator.h"
+
+/* Minimum time between two rate samples, in milliseconds */
+static const qint64 SAMPLE_INTERVAL = 250;
+
+/* Time constant of the moving average, in milliseconds */
+static const qreal TIME_CONSTANT = 3000;
+
+ThroughputEstimator::ThroughputEstimator()
+{
+   reset();
+}
+
+/**
+ * Returns \c true once the estimator has received its first update
+ */
+bool ThroughputEstimator::isValid() const
+{
+   return m_clock.isValid();
+}
+
+/**
+ * Returns the total size of the transfer (\c -1 if unknown)
+ */
+qint64 ThroughputEstimator::total() const
+{
+   return m_total;
+}
+
+/**
+ * Returns the number of bytes received so far
+ */
+qint64 ThroughputEstimator::received() const
+{
+   return m_received;
+}
+
+/**
+ * Returns the time elapsed since the first update, in milliseconds
+ */
+qint64 ThroughputEstimator::elapsed() const
+{
+   return m_clock.isValid() ? m_clock.elapsed() : 0;
+}
+
+/**
+ * Returns the current rate in bytes per second. If no data was received
+ * since the last sample, the rate decays as if an empty sample was taken now.
+ * 返回当前速率（字节/秒，指数加权移动平均）
+ */
+qreal ThroughputEstimator::currentRate() const
+{
+   if (!m_clock.isValid())
+      return 0;
+
+   qint64 idle = m_clock.elapsed() - m_sampleTime;
+   if (idle <= SAMPLE_INTERVAL)
+      return m_sampled ? m_rate : averageRate();
+
+   qreal instant = (m_received - m_sampleReceived) * 1000.0 / idle;
+   if (!m_sampled)
+      return instant;
+
+   qreal alpha = 1 - exp(-idle / TIME_CONSTANT);
+   return m_rate + alpha * (instant - m_rate);
+}
+
+/**
+ * Returns the average rate since the first update, in bytes per second
+ * 返回平均速率（字节/秒）
+ */
+qreal ThroughputEstimator::averageRate() const
+{
+   qint64 time = elapsed();
+   if (time <= 0)
+      return 0;
+
+   return (m_received - m_startReceived) * 1000.0 / time;
+}
+
+/**
+ * Returns the estimated time left to complete the transfer, in seconds, or
+ * \c -1 if the total size or the rate are unknown
+ * 返回预计剩余时间（秒），未知时返回-1
+ */
+qint64 ThroughputEstimator::remainingTime() const
+{
+   qreal rate = currentRate();
+   if (m_total <= 0 || rate < 1)
+      return -1;
+
+   return qint64(ceil(qMax(qint64(0), m_total - m_received) / rate));
+}
+
+/**
+ * Forgets the previous transfer
+ */
+void ThroughputEstimator::reset()
+{
+   m_clock.invalidate();
+   m_total = -1;
+   m_received = 0;
+   m_startReceived = 0;
+   m_sampleTime = 0;
+   m_sampleReceived = 0;
+   m_rate = 0;
+   m_sampled = false;
+}
+
+/**
+ * Registers the number of bytes \a received so far and the \a total size of
+ * the transfer (a value of zero or less if unknown)
+ * 更新已接收的字节数
+ */
+void ThroughputEstimator::update(const qint64 received, const qint64 total)
+{
+   m_total = total > 0 ? total : -1;
+
+   /* The first update is the starting point */
+   if (!m_clock.isValid())
+   {
+      m_clock.start();
+      m_received = received;
+      m_startReceived = received;
+      m_sampleReceived = received;
+      return;
+   }
+
+   m_received = received;
+
+   qint64 now = m_clock.elapsed();
+   qint64 interval = now - m_sampleTime;
+   if (interval < SAMPLE_INTERVAL)
+      return;
+
+   qreal instant = (m_received - m_sampleReceived) * 1000.0 / interval;
+   if (m_sampled)
+      m_rate += (1 - exp(-interval / TIME_CONSTANT)) * (instant - m_rate);
+   else
+      m_rate = instant;
+
+   m_sampled = true;
+   m_sampleTime = now;
+   m_sampleReceived = m_received;
+}
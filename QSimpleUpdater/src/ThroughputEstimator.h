@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef _QSIMPLEUPDATER_THROUGHPUT_ESTIMATOR_H
+#define _QSIMPLEUPDATER_THROUGHPUT_ESTIMATOR_H
+
+#include <QtGlobal>
+#include <QElapsedTimer>
+
+/**
+ * \brief Measures the rate of a transfer and the time left to complete it
+ *
+ * The estimator is fed with the number of bytes received so far (and the
+ * total size, if known). It uses a monotonic clock and samples the rate at
+ * most every \c 250 ms; the current rate is an exponentially weighted moving
+ * average of these samples (with a time constant of three seconds), so it
+ * follows changes quickly without jumping on every network packet. The
+ * average rate covers the whole transfer.
+ *
+ * The first update only sets the starting point, so data that was already
+ * there (e.g. the partial file of a resumed download) does not count as
+ * received in no time.
+ */
+class ThroughputEstimator
+{
+public:
+   ThroughputEstimator();
+
+   bool isValid() const;
+   qint64 total() const;
+   qint64 received() const;
+   qint64 elapsed() const;
+   qreal currentRate() const;
+   qreal averageRate() const;
+   qint64 remainingTime() const;
+
+   void reset();
+   void update(const qint64 received, const qint64 total = -1);
+
+private:
+   QElapsedTimer m_clock;
+   qint64 m_total;
+   qint64 m_received;
+   qint64 m_startReceived;
+   qint64 m_sampleTime;
+   qint64 m_sampleReceived;
+   qreal m_rate;
+   bool m_sampled;
+};
+
+#endif
@@ -20,16 +20,16 @@
  * THE SOFTWARE.
  */
 
-#include <QJsonValue>
-#include <QJsonObject>
+#include <QThread>
 #include <QMessageBox>
 #include <QApplication>
-#include <QJsonDocument>
 #include <QDesktopServices>
 #include <QTextEdit>
 
 #include "Updater.h"
 #include "Downloader.h"
+#include "DownloadTask.h"
+#include "NetworkManager.h"
 
 Updater::Updater()
 {
@@ -38,11 +38,19 @@ Updater::Updater()
     m_changelog = "";
     m_downloadUrl = "";
     m_latestVersion = "";
+    m_downloadChecksum = "";
+    m_downloadSize = 0;
+    m_patchUrl = "";
+    m_patchChecksum = "";
+    m_patchSize = 0;
+    m_chunkManifestUrl = "";
     m_customAppcast = false;
     m_notifyOnUpdate = true;
     m_notifyOnFinish = false;
     m_updateAvailable = false;
     m_downloaderEnabled = true;
+    m_prefetchUpdates = false;
+    m_promptOnCheck = true;
     /*
      * qApp 是一个指向全局的 QApplication 对象的指针，它提供了对应用程序的全局信息和状态的访问
      * QApplication 是 Qt 框架中用于管理应用程序全局状态的类。
@@ -57,7 +65,13 @@ Updater::Updater()
     m_mandatoryUpdate = false;
 
     m_downloader = new Downloader();
-    m_manager = new QNetworkAccessManager();
+
+    /* Fetch and parse the appcast in the worker thread, if enabled, through
+     * the network manager shared by that thread */
+    QThread *thread = DownloadTask::useWorkerThread() ? DownloadTask::workerThread() : QThread::currentThread();
+    m_reader = new AppcastReader(NetworkManager::forThread(thread));
+    if (thread != QThread::currentThread())
+        m_reader->moveToThread(thread);
 
 #if defined Q_OS_WIN
     m_platform = "windows";
@@ -74,12 +88,26 @@ Updater::Updater()
     setUserAgentString(QString("%1/%2 (Qt; QSimpleUpdater)").arg(qApp->applicationName(), qApp->applicationVersion()));
 
     connect(m_downloader, SIGNAL(downloadFinished(QString, QString)), this, SIGNAL(downloadFinished(QString, QString)));
-    connect(m_manager, SIGNAL(finished(QNetworkReply *)), this, SLOT(onReply(QNetworkReply *)));
+    connect(m_downloader, SIGNAL(archiveExtracted(QString, QString)), this, SIGNAL(archiveExtracted(QString, QString)));
+    connect(m_downloader, SIGNAL(downloadStateChanged(QString, int)), this, SIGNAL(downloadStateChanged(QString, int)));
+    connect(m_downloader, SIGNAL(downloadProgress(QString, qint64, qint64, qreal, qint64)), this,
+            SIGNAL(downloadProgress(QString, qint64, qint64, qreal, qint64)));
+    connect(m_reader, SIGNAL(redirected(QString)), this, SLOT(onRedirected(QString)));
+    connect(m_reader, SIGNAL(appcastDownloaded(QByteArray)), this, SLOT(onAppcastDownloaded(QByteArray)));
+    connect(m_reader, SIGNAL(finished(UpdateInfo)), this, SLOT(onCheckFinished(UpdateInfo)));
 }
 
 Updater::~Updater()
 {
+    /* Updaters are only deleted once they are removed from the registry,
+     * nobody will confirm their prefetched update anymore */
+    m_downloader->discardPrefetch();
     delete m_downloader;
+
+    if (m_reader->thread() == thread())
+        delete m_reader;
+    else
+        m_reader->deleteLater();
 }
 
 /**
@@ -148,6 +176,18 @@ QString Updater::downloadUrl() const
     return m_downloadUrl;
 }
 
+/**
+ * Returns the other URLs (mirrors) of the update file defined by the update
+ * definitions file. The downloader picks the fastest one and switches to
+ * another one if the transfer fails or stalls.
+ * 返回更新文件的镜像列表
+ * \warning You should call \c checkForUpdates() before using this function
+ */
+QStringList Updater::mirrors() const
+{
+    return m_mirrors;
+}
+
 /**
  * Returns the latest version defined by the update definitions file.
  * 返回更新定义文件中定义的最新版本
@@ -158,6 +198,50 @@ QString Updater::latestVersion() const
     return m_latestVersion;
 }
 
+/**
+ * Returns the SHA-256 digest (hex) of the download defined by the update
+ * definitions file, or an empty string if the appcast does not define it.
+ * 返回更新定义文件中定义的下载文件SHA-256值
+ * \warning You should call \c checkForUpdates() before using this function
+ */
+QString Updater::downloadChecksum() const
+{
+    return m_downloadChecksum;
+}
+
+/**
+ * Returns the size in bytes of the download defined by the update definitions
+ * file, or \c 0 if the appcast does not define it.
+ * 返回更新定义文件中定义的下载文件大小
+ * \warning You should call \c checkForUpdates() before using this function
+ */
+qint64 Updater::downloadSize() const
+{
+    return m_downloadSize;
+}
+
+/**
+ * Returns the URL of the patch that turns the installed version into the
+ * latest version, or an empty string if the appcast does not define one.
+ * 返回适用于当前版本的增量补丁URL
+ * \warning You should call \c checkForUpdates() before using this function
+ */
+QString Updater::patchUrl() const
+{
+    return m_patchUrl;
+}
+
+/**
+ * Returns the URL of the chunk manifest of the latest version, or an empty
+ * string if the appcast does not define one.
+ * 返回最新版本的分块清单URL
+ * \warning You should call \c checkForUpdates() before using this function
+ */
+QString Updater::chunkManifestUrl() const
+{
+    return m_chunkManifestUrl;
+}
+
 /**
  * Returns the user-agent header used by the client when communicating
  * 返回在HTTP通信中使用的用户代理标头
@@ -253,22 +337,118 @@ bool Updater::useCustomInstallProcedures() const
     return m_downloader->useCustomInstallProcedures();
 }
 
+/**
+ * Returns \c true if interrupted downloads are resumed from the partial file
+ * 如果中断的下载可以从部分文件继续，则返回true
+ */
+bool Updater::resumeDownloads() const
+{
+    return m_downloader->resumeDownloads();
+}
+
+/**
+ * Returns the number of parallel connections used by the integrated downloader
+ * 返回集成下载器使用的并行连接数
+ */
+int Updater::downloadSegments() const
+{
+    return m_downloader->segmentCount();
+}
+
+/**
+ * Returns the maximum download rate of the integrated downloader in bytes per
+ * second (\c 0 if unlimited)
+ * 返回集成下载器的最大下载速率
+ */
+qint64 Updater::maxDownloadRate() const
+{
+    return m_downloader->maxDownloadRate();
+}
+
+/**
+ * Returns \c true if the integrated downloader reduces its rate when the
+ * network latency rises
+ * 返回集成下载器是否启用自适应限速
+ */
+bool Updater::adaptiveThrottling() const
+{
+    return m_downloader->adaptiveThrottling();
+}
+
+/**
+ * Returns \c true if the update checks and downloads of this updater yield to
+ * the foreground transfers of the other updaters
+ * 返回是否为后台更新
+ */
+bool Updater::backgroundDownload() const
+{
+    return m_downloader->backgroundDownload();
+}
+
+/**
+ * Returns \c true if the updates found by this updater are downloaded in the
+ * background before the user confirms them
+ * 返回是否在用户确认之前预先下载更新
+ */
+bool Updater::prefetchUpdates() const
+{
+    return m_prefetchUpdates;
+}
+
+/**
+ * Returns \c true if the integrated downloader extracts tar and zip archives
+ * while they are downloaded
+ * 返回集成下载器是否在下载归档文件时同时解压
+ */
+bool Updater::extractArchives() const
+{
+    return m_downloader->extractArchives();
+}
+
+/**
+ * Returns the installation root used by the integrated downloader for slot
+ * installs, or an empty string if they are disabled
+ * 返回槽位安装的根目录
+ */
+QString Updater::installDirectory() const
+{
+    return m_downloader->installDirectory();
+}
+
+/**
+ * Activates the version that was installed before the current one, returns
+ * \c false if there is none
+ * 回滚到上一个安装的版本
+ */
+bool Updater::rollbackUpdate()
+{
+    return m_downloader->rollbackUpdate();
+}
+
 /**
  * Downloads and interpets the update definitions file referenced by the
- * \c url() function.
- * 下载和解释更新定义文件
+ * \c url() function. The request is sent once the download scheduler allows
+ * it, so that checking many modules does not flood the server.
+ * 下载和解释更新定义文件（由下载调度器控制并发）
  */
 void Updater::checkForUpdates()
 {
-    QNetworkRequest request(url());
-    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
-
-    if (!userAgentString().isEmpty())
-    {
-        request.setRawHeader("User-Agent", userAgentString().toUtf8());
-    }
-    m_manager->get(request);
+    checkForUpdates(true);
+}
 
+/**
+ * Same as \c checkForUpdates(), but if \a prompt is \c false the user is not
+ * asked about the result of the check (the application reports the results
+ * of batch checks by itself)
+ * 检查更新，\a prompt 为 \c false 时不弹出提示框（用于批量检查）
+ */
+void Updater::checkForUpdates(const bool prompt)
+{
+    m_promptOnCheck = prompt;
+    QMetaObject::invokeMethod(m_reader, "check", Q_ARG(QString, url()), Q_ARG(QString, moduleName()),
+                              Q_ARG(QString, platformKey()), Q_ARG(QString, moduleVersion()),
+                              Q_ARG(QString, userAgentString()), Q_ARG(bool, customAppcast()),
+                              Q_ARG(bool, m_downloader->backgroundDownload()));
 }
 
 /**
@@ -402,87 +582,139 @@ void Updater::setMandatoryUpdate(const bool mandatory_update)
 {
     m_mandatoryUpdate = mandatory_update;
 }
+
 /**
- * Called when the download of the update definitions file is finished.
- * 在更新定义文件下载完成时调用
- * 处理重定向、网络错误、自定义应用广播解释、JSON解析，并设置更新信息。
- */
-void Updater::onReply(QNetworkReply *reply)
-{
-    /* Check if we need to redirect 检查是否需要重定向
-    * 如果收到了重定向的URL，将新的URL设置为当前URL，并重新发起检查更新的请求。
-    */
-    QVariant redirectionTarget = reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
-    if (!redirectionTarget.isNull()) {
-        QUrl redirect = redirectionTarget.toUrl();
-        if (redirect.isValid()) {
-            // 重定向URL有效，可以使用redirect
-            qDebug() << "Redirect to:" << redirect.toString();
-        } else {
-            // 重定向URL无效
-            qDebug() << "Invalid redirect URL";
-        }
-    } else {
-        // 没有重定向
-        qDebug() << "No redirection";
-    }
+ * If \a resume is set to \c true, the integrated downloader will continue an
+ * interrupted download (using HTTP range requests) instead of starting over.
+ * 设置是否启用断点续传
+ */
+void Updater::setResumeDownloads(const bool resume)
+{
+    m_downloader->setResumeDownloads(resume);
+}
 
-    QUrl redirect = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
-    qInfo()<<redirect;
-    if (!redirect.isEmpty())
-    {
-        setUrl(redirect.toString());
-        checkForUpdates();
-        return;
-    }
+/**
+ * Changes the number of parallel connections used by the integrated
+ * downloader. A value of \c 1 disables segmented downloads.
+ * 设置集成下载器使用的并行连接数
+ */
+void Updater::setDownloadSegments(const int segments)
+{
+    m_downloader->setSegmentCount(segments);
+}
 
-    /* There was a network error 处理网络错误
-    * 如果发生网络错误，设置更新不可用并发出 checkingFinished 信号。
-    */
-    if (reply->error() != QNetworkReply::NoError)
-    {
-        qInfo()<<"sss";
-        setUpdateAvailable(false);
-        emit checkingFinished(url());
-        return;
-    }
-    /* The application wants to interpret the appcast by itself
-    * 处理自定义的应用程序广播（appcast）是为了允许应用程序在检查更新时自定义处理广播的情况
-    * 这通常用于应用程序需要特殊处理更新信息的情况，而不仅仅是解析标准的JSON响应
-    */
-    if (customAppcast())
-    {
-        emit appcastDownloaded(url(), reply->readAll());
-        emit checkingFinished(url());
-        return;
-    }
+/**
+ * Limits the download rate of the integrated downloader to the given number
+ * of bytes per second, \c 0 removes the limit.
+ * 设置集成下载器的最大下载速率
+ */
+void Updater::setMaxDownloadRate(const qint64 bytesPerSecond)
+{
+    m_downloader->setMaxDownloadRate(bytesPerSecond);
+}
 
-    /* Try to create a JSON document from downloaded data
-     * 尝试从下载的数据中创建一个 JSON 文档
-     */
-    QJsonDocument document = QJsonDocument::fromJson(reply->readAll());
+/**
+ * Enables or disables the adaptive throttling of the integrated downloader
+ * 设置集成下载器是否启用自适应限速
+ */
+void Updater::setAdaptiveThrottling(const bool adaptive)
+{
+    m_downloader->setAdaptiveThrottling(adaptive);
+}
+
+/**
+ * If \a background is set to \c true, the update checks and downloads of
+ * this updater are started after the foreground transfers of the other
+ * updaters, and get a smaller share of the total download rate.
+ * 设置是否为后台更新
+ */
+void Updater::setBackgroundDownload(const bool background)
+{
+    m_downloader->setBackgroundDownload(background);
+}
+
+/**
+ * If \a prefetch is set to \c true, the update file is downloaded (and
+ * verified) with the background priority as soon as a newer version is
+ * found, while the user is asked whether to install it. Once the user
+ * confirms the update, it is installed right away (or the prefetch continues
+ * as a normal download).
+ * 设置是否在用户确认之前预先下载更新
+ */
+void Updater::setPrefetchUpdates(const bool prefetch)
+{
+    m_prefetchUpdates = prefetch;
+}
 
-    /* JSON is invalid  如果 JSON 无效，设置更新不可用并发出 checkingFinished 信号*/
-    if (document.isNull())
+/**
+ * If \a extract is set to \c true, the integrated downloader extracts tar and
+ * zip archives while they are downloaded
+ * 设置集成下载器是否在下载归档文件时同时解压
+ */
+void Updater::setExtractArchives(const bool extract)
+{
+    m_downloader->setExtractArchives(extract);
+}
+
+/**
+ * Changes the installation root used by the integrated downloader for slot
+ * installs, pass an empty string to disable them
+ * 设置槽位安装的根目录
+ */
+void Updater::setInstallDirectory(const QString &directory)
+{
+    m_downloader->setInstallDirectory(directory);
+}
+
+/**
+ * Called when the appcast has been moved to another \a url
+ * 更新定义文件被重定向时调用
+ */
+void Updater::onRedirected(const QString &url)
+{
+    setUrl(url);
+}
+
+/**
+ * Called when a custom appcast has been downloaded, the application
+ * interprets the \a data by itself
+ * 自定义appcast下载完成时调用
+ */
+void Updater::onAppcastDownloaded(const QByteArray &data)
+{
+    emit appcastDownloaded(url(), data);
+    emit checkingFinished(url());
+}
+
+/**
+ * Called when the update definitions file has been downloaded and parsed
+ * (in the thread of the appcast reader). An invalid \a info means that the
+ * file could not be downloaded or interpreted.
+ * 在更新定义文件下载并解析完成时调用，设置更新信息并提示用户
+ */
+void Updater::onCheckFinished(const UpdateInfo &info)
+{
+    if (!info.valid)
     {
-        qInfo()<<"fff";
         setUpdateAvailable(false);
         emit checkingFinished(url());
         return;
     }
 
-    /* Get the platform information  获取平台信息和更新信息 */
-    QJsonObject updates = document.object().value("updates").toObject();
-    QJsonObject platform = updates.value(platformKey()).toObject();
-
-    /* Get update information 从 JSON 文档中提取更新信息 */
-    m_openUrl = platform.value("open-url").toString();
-    m_changelog = platform.value("changelog").toString();
-    m_downloadUrl = platform.value("download-url").toString();
-    m_latestVersion = platform.value("latest-version").toString();
-    //"mandatory-update"强制更新
-    if (platform.contains("mandatory-update"))
-        m_mandatoryUpdate = platform.value("mandatory-update").toBool();
+    /* Get update information 保存更新信息 */
+    m_openUrl = info.openUrl;
+    m_changelog = info.changelog;
+    m_downloadUrl = info.downloadUrl;
+    m_mirrors = info.mirrors;
+    m_latestVersion = info.latestVersion;
+    m_downloadChecksum = info.downloadChecksum;
+    m_downloadSize = info.downloadSize;
+    m_chunkManifestUrl = info.chunkManifestUrl;
+    m_patchUrl = info.patchUrl;
+    m_patchChecksum = info.patchChecksum;
+    m_patchSize = info.patchSize;
+    if (info.hasMandatoryUpdate)
+        m_mandatoryUpdate = info.mandatoryUpdate;
 
     /* Compare latest and current version
      * 比较版本并设置相应信息（比较最新版本和当前版本，并设置更新是否可用）
@@ -504,6 +736,24 @@ void Updater::setUpdateAvailable(const bool available)
 {
     m_updateAvailable = available;
 
+    /* A newer check supersedes the update that was prefetched before (also
+     * for batch checks, where nobody declines it) 新的检查结果取代之前预下载的更新 */
+    bool prefetch = updateAvailable() && prefetchUpdates() && downloaderEnabled() && openUrl().isEmpty();
+    if (!prefetch || !m_downloader->isPrefetching(QUrl(downloadUrl())))
+        m_downloader->discardPrefetch();
+
+    /* Download the update while the user decides whether to install it
+     * 在用户确认之前于后台预先下载更新 */
+    if (prefetch)
+    {
+        configureDownloader();
+        m_downloader->prefetch(QUrl(downloadUrl()));
+    }
+
+    /* The application prompts once for all the modules of a batch check */
+    if (!m_promptOnCheck)
+        return;
+
     QMessageBox box;
     box.setTextFormat(Qt::RichText);
     box.setIcon(QMessageBox::Information);
@@ -531,23 +781,14 @@ void Updater::setUpdateAvailable(const bool available)
         box.setDefaultButton(QMessageBox::Yes);
 
         if (box.exec() == QMessageBox::Yes)
-        {
-            if (!openUrl().isEmpty())
-                QDesktopServices::openUrl(QUrl(openUrl()));
-
-            else if (downloaderEnabled())
-            {
-                m_downloader->setUrlId(url());
-                m_downloader->setFileName(downloadUrl().split("/").last());
-                m_downloader->setMandatoryUpdate(m_mandatoryUpdate);
-                m_downloader->startDownload(QUrl(downloadUrl()));
-            }
+            startDownload();
 
-            else
-                QDesktopServices::openUrl(QUrl(downloadUrl()));
-        }
         else
         {
+            /* Do not keep the prefetched update on the disk
+             * 用户拒绝更新，删除预下载的文件 */
+            m_downloader->discardPrefetch();
+
             if (m_mandatoryUpdate)
             {
                 QApplication::quit();
@@ -568,6 +809,44 @@ void Updater::setUpdateAvailable(const bool available)
     }
 }
 
+/**
+ * Downloads the update found by the last check (or opens its web page), as
+ * if the user confirmed it in the update dialog
+ * 开始下载上次检查发现的更新（或打开其网页）
+ */
+void Updater::startDownload()
+{
+    if (!updateAvailable())
+        return;
+
+    if (!openUrl().isEmpty())
+        QDesktopServices::openUrl(QUrl(openUrl()));
+
+    else if (downloaderEnabled())
+    {
+        configureDownloader();
+        m_downloader->startDownload(QUrl(downloadUrl()));
+    }
+
+    else
+        QDesktopServices::openUrl(QUrl(downloadUrl()));
+}
+
+/**
+ * Hands the information about the update file to the downloader
+ * 将更新文件的信息交给下载器
+ */
+void Updater::configureDownloader()
+{
+    m_downloader->setUrlId(url());
+    m_downloader->setFileName(downloadUrl().split("/").last());
+    m_downloader->setMandatoryUpdate(m_mandatoryUpdate);
+    m_downloader->setExpectedChecksum(downloadChecksum(), downloadSize());
+    m_downloader->setPatch(QUrl(patchUrl()), m_patchChecksum, m_patchSize);
+    m_downloader->setChunkManifest(QUrl(chunkManifestUrl()));
+    m_downloader->setMirrors(mirrors());
+}
+
 /**
  * Compares the two version strings (\a x and \a y).
  *     - If \a x is greater than \y, this function returns \c true.
@@ -25,11 +25,11 @@
 
 #include <QUrl>
 #include <QObject>
-#include <QNetworkReply>
-#include <QNetworkAccessManager>
 
 #include <QSimpleUpdater.h>
 
+#include "AppcastReader.h"
+
 class Downloader;
 
 /**
@@ -42,7 +42,10 @@ class QSU_DECL Updater : public QObject
 signals:
    void checkingFinished(const QString &url);
    void downloadFinished(const QString &url, const QString &filepath);
+   void archiveExtracted(const QString &url, const QString &directory);
    void appcastDownloaded(const QString &url, const QByteArray &data);
+   void downloadStateChanged(const QString &url, const int state);
+   void downloadProgress(const QString &url, qint64 received, qint64 total, qreal rate, qint64 remainingTime);
 
 public:
    Updater();
@@ -53,10 +56,15 @@ public:
    QString changelog() const;
    QString moduleName() const;
    QString downloadUrl() const;
+   QStringList mirrors() const;
    QString platformKey() const;
    QString moduleVersion() const;
    QString latestVersion() const;
    QString userAgentString() const;
+   QString downloadChecksum() const;
+   qint64 downloadSize() const;
+   QString patchUrl() const;
+   QString chunkManifestUrl() const;
    bool mandatoryUpdate() const;
 
    bool customAppcast() const;
@@ -65,9 +73,20 @@ public:
    bool updateAvailable() const;
    bool downloaderEnabled() const;
    bool useCustomInstallProcedures() const;
+   bool resumeDownloads() const;
+   int downloadSegments() const;
+   qint64 maxDownloadRate() const;
+   bool adaptiveThrottling() const;
+   bool backgroundDownload() const;
+   bool prefetchUpdates() const;
+   bool extractArchives() const;
+   QString installDirectory() const;
+   bool rollbackUpdate();
 
 public slots:
    void checkForUpdates();
+   void checkForUpdates(const bool prompt);
+   void startDownload();
    void setUrl(const QString &url);
    void setModuleName(const QString &name);
    void setNotifyOnUpdate(const bool notify);
@@ -80,13 +99,24 @@ public slots:
    void setUseCustomAppcast(const bool customAppcast);
    void setUseCustomInstallProcedures(const bool custom);
    void setMandatoryUpdate(const bool mandatory_update);
+   void setResumeDownloads(const bool resume);
+   void setDownloadSegments(const int segments);
+   void setMaxDownloadRate(const qint64 bytesPerSecond);
+   void setAdaptiveThrottling(const bool adaptive);
+   void setBackgroundDownload(const bool background);
+   void setPrefetchUpdates(const bool prefetch);
+   void setExtractArchives(const bool extract);
+   void setInstallDirectory(const QString &directory);
 
 private slots:
-   void onReply(QNetworkReply *reply);
+   void onRedirected(const QString &url);
+   void onAppcastDownloaded(const QByteArray &data);
+   void onCheckFinished(const UpdateInfo &info);
    void setUpdateAvailable(const bool available);
 
 private:
    bool compare(const QString &x, const QString &y);
+   void configureDownloader();
 
 private:
    QString m_url;
@@ -98,17 +128,26 @@ private:
    bool m_updateAvailable;
    bool m_downloaderEnabled;
    bool m_mandatoryUpdate;
+   bool m_prefetchUpdates;
+   bool m_promptOnCheck;
 
    QString m_openUrl;
    QString m_platform;
    QString m_changelog;
    QString m_moduleName;
    QString m_downloadUrl;
+   QStringList m_mirrors;
    QString m_moduleVersion;
    QString m_latestVersion;
+   QString m_downloadChecksum;
+   qint64 m_downloadSize;
+   QString m_patchUrl;
+   QString m_patchChecksum;
+   qint64 m_patchSize;
+   QString m_chunkManifestUrl;
 
    Downloader *m_downloader;
-   QNetworkAccessManager *m_manager;
+   AppcastReader *m_reader;
 };
 
 #endif
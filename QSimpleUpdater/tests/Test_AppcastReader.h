@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_APPCASTREADER_H
+#define TEST_APPCASTREADER_H
+
+#include <QtTest>
+#include <QCborValue>
+#include <AppcastReader.h>
+#include <StreamDecoder.h>
+
+class Test_AppcastReader : public QObject
+{
+   Q_OBJECT
+
+private:
+   static QJsonObject appcast()
+   {
+      return QJsonDocument::fromJson("{\"updates\": {"
+                                     "  \"windows\": {"
+                                     "    \"latest-version\": \"2.0\","
+                                     "    \"download-url\": \"https://example.com/app-2.0.zip\","
+                                     "    \"changelog\": \"Fixes\","
+                                     "    \"sha256\": \"abcd\","
+                                     "    \"size\": 4096,"
+                                     "    \"mandatory-update\": true,"
+                                     "    \"mirrors\": [\"https://mirror.example.com/app-2.0.zip\"],"
+                                     "    \"patches\": ["
+                                     "      {\"from-version\": \"1.0\", \"url\": \"https://example.com/1.0.patch\","
+                                     "       \"sha256\": \"ef01\", \"size\": 512}"
+                                     "    ]"
+                                     "  },"
+                                     "  \"linux\": {\"latest-version\": \"1.5\"}"
+                                     "}}")
+         .object();
+   }
+
+   static void verify(const UpdateInfo &info)
+   {
+      QVERIFY(info.valid);
+      QCOMPARE(info.latestVersion, QString("2.0"));
+      QCOMPARE(info.downloadUrl, QString("https://example.com/app-2.0.zip"));
+      QCOMPARE(info.changelog, QString("Fixes"));
+      QCOMPARE(info.downloadChecksum, QString("abcd"));
+      QCOMPARE(info.downloadSize, qint64(4096));
+      QCOMPARE(info.mirrors, QStringList("https://mirror.example.com/app-2.0.zip"));
+      QVERIFY(info.hasMandatoryUpdate);
+      QVERIFY(info.mandatoryUpdate);
+      QCOMPARE(info.patchUrl, QString("https://example.com/1.0.patch"));
+      QCOMPARE(info.patchChecksum, QString("ef01"));
+      QCOMPARE(info.patchSize, qint64(512));
+   }
+
+private slots:
+   void parsesJson()
+   {
+      QByteArray data = QJsonDocument(appcast()).toJson();
+      verify(AppcastReader::parse(data, "windows", "1.0"));
+
+      UpdateInfo other = AppcastReader::parse(data, "linux", "1.0");
+      QVERIFY(other.valid);
+      QCOMPARE(other.latestVersion, QString("1.5"));
+      QVERIFY(!other.hasMandatoryUpdate);
+   }
+
+   void parsesCbor()
+   {
+      QByteArray data = QCborValue::fromJsonValue(appcast()).toCbor();
+      verify(AppcastReader::parse(data, "windows", "1.0"));
+
+      /* With the self-describe tag (d9 d9 f7) */
+      QByteArray tagged = QCborValue(QCborKnownTags::Signature, QCborValue::fromJsonValue(appcast())).toCbor();
+      QVERIFY(tagged.startsWith("\xd9\xd9\xf7"));
+      verify(AppcastReader::parse(tagged, "windows", "1.0"));
+   }
+
+   void ignoresPatchesForOtherVersions()
+   {
+      UpdateInfo info = AppcastReader::parse(QJsonDocument(appcast()).toJson(), "windows", "0.9");
+      QVERIFY(info.valid);
+      QVERIFY(info.patchUrl.isEmpty());
+      QCOMPARE(info.patchSize, qint64(0));
+   }
+
+   void handlesMissingPlatforms()
+   {
+      UpdateInfo info = AppcastReader::parse(QJsonDocument(appcast()).toJson(), "macos", "1.0");
+      QVERIFY(info.valid);
+      QVERIFY(info.latestVersion.isEmpty());
+      QVERIFY(info.downloadUrl.isEmpty());
+   }
+
+   void rejectsInvalidAppcasts()
+   {
+      QVERIFY(!AppcastReader::parse("not an appcast", "windows", "1.0").valid);
+      QVERIFY(!AppcastReader::parse("[1, 2, 3]", "windows", "1.0").valid);
+      QVERIFY(!AppcastReader::parse(QByteArray(), "windows", "1.0").valid);
+   }
+
+   void stopsDecompressionBombs()
+   {
+      /* 16 MB of zeros compress to a few KB (qCompress() prefixes the size) */
+      QByteArray data(16 * 1024 * 1024, 0);
+      QByteArray compressed = qCompress(data, 9).mid(4);
+      QVERIFY(compressed.size() < 64 * 1024);
+
+      StreamDecoder decoder;
+      QByteArray output;
+      QVERIFY(decoder.init(StreamDecoder::Gzip));
+      QVERIFY(!decoder.decode(compressed, &output, 1024 * 1024));
+      QVERIFY(output.size() <= 1024 * 1024 + 1);
+      QVERIFY(decoder.errorString().contains("too large"));
+
+      bool ok = false;
+      QVERIFY(StreamDecoder::decodeAll(compressed, StreamDecoder::Gzip, data.size() - 1, &ok).isEmpty());
+      QVERIFY(!ok);
+      QCOMPARE(StreamDecoder::decodeAll(compressed, StreamDecoder::Gzip, data.size(), &ok), data);
+      QVERIFY(ok);
+   }
+};
+
+#endif
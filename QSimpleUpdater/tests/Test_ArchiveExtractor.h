@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_ARCHIVEEXTRACTOR_H
+#define TEST_ARCHIVEEXTRACTOR_H
+
+#include <QtTest>
+#include <ArchiveExtractor.h>
+
+class Test_ArchiveExtractor : public QObject
+{
+   Q_OBJECT
+
+private:
+   /* Ustar entry with a regular file (or a directory) and its padding */
+   static QByteArray tarEntry(const QByteArray &name, const QByteArray &data, const char type = '0')
+   {
+      QByteArray header(512, 0);
+      header.replace(0, name.size(), name);
+      header.replace(100, 8, QByteArray("0000644") + '\0');
+      header.replace(124, 12, QByteArray::number(data.size(), 8).rightJustified(11, '0') + '\0');
+      header.replace(136, 12, QByteArray("00000000000") + '\0');
+      header[156] = type;
+      header.replace(257, 8, QByteArray("ustar") + '\0' + "00");
+
+      /* The checksum field counts as spaces */
+      header.replace(148, 8, QByteArray(8, ' '));
+      qint64 sum = 0;
+      for (int i = 0; i < header.size(); ++i)
+         sum += uchar(header.at(i));
+
+      header.replace(148, 8, QByteArray::number(sum, 8).rightJustified(6, '0') + '\0' + ' ');
+
+      QByteArray entry = header + data;
+      entry.append(QByteArray((512 - data.size() % 512) % 512, 0));
+      return entry;
+   }
+
+   static QByteArray tarEnd()
+   {
+      return QByteArray(1024, 0);
+   }
+
+   static bool extract(const QByteArray &archive, const QString &directory, ArchiveExtractor *extractor)
+   {
+      if (!extractor->open(ArchiveExtractor::Tar, directory))
+         return false;
+
+      return extractor->write(archive.constData(), archive.size()) && extractor->finish();
+   }
+
+private slots:
+   void extractsEntries()
+   {
+      QTemporaryDir dir;
+      ArchiveExtractor extractor;
+      QByteArray archive = tarEntry("app/", QByteArray(), '5') + tarEntry("app/bin/tool", "binary")
+                           + tarEntry("./app/./readme.txt", "text") + tarEnd();
+
+      QVERIFY(extract(archive, dir.filePath("out"), &extractor));
+
+      QFile tool(dir.filePath("out/app/bin/tool"));
+      QVERIFY(tool.open(QFile::ReadOnly));
+      QCOMPARE(tool.readAll(), QByteArray("binary"));
+
+      QFile readme(dir.filePath("out/app/readme.txt"));
+      QVERIFY(readme.open(QFile::ReadOnly));
+      QCOMPARE(readme.readAll(), QByteArray("text"));
+   }
+
+   void extractsArchivesInPieces()
+   {
+      QTemporaryDir dir;
+      ArchiveExtractor extractor;
+      QByteArray archive = tarEntry("file", QByteArray(1500, 'x')) + tarEnd();
+
+      QVERIFY(extractor.open(ArchiveExtractor::Tar, dir.filePath("out")));
+      for (int i = 0; i < archive.size(); i += 100)
+         QVERIFY(extractor.write(archive.constData() + i, qMin(100, archive.size() - i)));
+
+      QVERIFY(extractor.finish());
+      QCOMPARE(QFileInfo(dir.filePath("out/file")).size(), qint64(1500));
+   }
+
+   void rejectsParentPaths()
+   {
+      QTemporaryDir dir;
+      ArchiveExtractor extractor;
+
+      QVERIFY(!extract(tarEntry("../evil", "data") + tarEnd(), dir.filePath("out"), &extractor));
+      QVERIFY(!QFile::exists(dir.filePath("evil")));
+
+      QVERIFY(!extract(tarEntry("app/../../evil", "data") + tarEnd(), dir.filePath("out"), &extractor));
+      QVERIFY(!QFile::exists(dir.filePath("evil")));
+   }
+
+   void rejectsAbsolutePaths()
+   {
+      QTemporaryDir dir;
+      ArchiveExtractor extractor;
+
+      QByteArray absolute = QDir::fromNativeSeparators(dir.filePath("evil")).toUtf8();
+      QVERIFY(!extract(tarEntry(absolute, "data") + tarEnd(), dir.filePath("out"), &extractor));
+      QVERIFY(!extract(tarEntry("C:\\evil", "data") + tarEnd(), dir.filePath("out"), &extractor));
+      QVERIFY(!QFile::exists(dir.filePath("evil")));
+   }
+
+   void rejectsTruncatedArchives()
+   {
+      QTemporaryDir dir;
+      ArchiveExtractor extractor;
+      QByteArray archive = tarEntry("file", QByteArray(1500, 'x'));
+      archive.chop(600);
+
+      QVERIFY(!extract(archive, dir.filePath("out"), &extractor));
+   }
+};
+
+#endif
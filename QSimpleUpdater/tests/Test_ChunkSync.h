@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_CHUNKSYNC_H
+#define TEST_CHUNKSYNC_H
+
+#include <QtTest>
+#include <ChunkSync.h>
+
+class Test_ChunkSync : public QObject
+{
+   Q_OBJECT
+
+private:
+   static QByteArray randomData(const int size, const quint32 seed)
+   {
+      QRandomGenerator generator(seed);
+      QByteArray data(size, 0);
+      for (int i = 0; i < size; ++i)
+         data[i] = char(generator.bounded(256));
+
+      return data;
+   }
+
+   static QVector<ChunkSync::Chunk> chunks(QByteArray data)
+   {
+      QBuffer buffer(&data);
+      buffer.open(QBuffer::ReadOnly);
+      return ChunkSync::chunkData(&buffer, 1024, 4096, 16384);
+   }
+
+private slots:
+   void chunksCoverTheData()
+   {
+      QByteArray data = randomData(1024 * 1024, 1);
+
+      qint64 offset = 0;
+      QVector<ChunkSync::Chunk> list = chunks(data);
+      for (int i = 0; i < list.count(); ++i)
+      {
+         const ChunkSync::Chunk &chunk = list.at(i);
+         QCOMPARE(chunk.offset, offset);
+         QVERIFY(chunk.length <= 16384);
+         QVERIFY(chunk.length >= 1024 || i == list.count() - 1);
+         QCOMPARE(chunk.hash, QCryptographicHash::hash(data.mid(int(chunk.offset), int(chunk.length)),
+                                                       QCryptographicHash::Sha256));
+         offset += chunk.length;
+      }
+
+      QCOMPARE(offset, qint64(data.size()));
+   }
+
+   void chunksFollowTheContent()
+   {
+      QByteArray data = randomData(512 * 1024, 2);
+      QByteArray shifted = "inserted" + data;
+
+      QSet<QByteArray> hashes;
+      foreach (const ChunkSync::Chunk &chunk, chunks(data))
+         hashes.insert(chunk.hash);
+
+      /* Only the chunks around the insertion change */
+      int shared = 0;
+      QVector<ChunkSync::Chunk> list = chunks(shifted);
+      foreach (const ChunkSync::Chunk &chunk, list)
+         shared += hashes.contains(chunk.hash) ? 1 : 0;
+
+      QVERIFY(shared >= list.count() - 4);
+   }
+
+   void parsesCreatedManifest()
+   {
+      QTemporaryDir dir;
+      QByteArray data = randomData(256 * 1024, 3);
+
+      QFile file(dir.filePath("file"));
+      QVERIFY(file.open(QFile::WriteOnly));
+      QCOMPARE(file.write(data), qint64(data.size()));
+      file.close();
+
+      ChunkSync::Manifest manifest;
+      QVERIFY(ChunkSync::parseManifest(ChunkSync::createManifest(dir.filePath("file"), 4096), &manifest));
+      QCOMPARE(manifest.size, qint64(data.size()));
+      QCOMPARE(manifest.avgSize, 4096);
+      QCOMPARE(manifest.sha256, QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+      QCOMPARE(manifest.chunks.count(), chunks(data).count());
+   }
+
+   void rejectsInvalidManifests()
+   {
+      ChunkSync::Manifest manifest;
+      QByteArray chunk = "[\"" + QByteArray(64, 'a') + "\", 10]";
+
+      /* The chunks must add up to the size of the file */
+      QVERIFY(ChunkSync::parseManifest("{\"size\": 10, \"sha256\": \"ab\", \"min\": 1, \"avg\": 2, \"max\": 4, "
+                                       "\"chunks\": [" + chunk + "]}", &manifest));
+      QVERIFY(!ChunkSync::parseManifest("{\"size\": 11, \"sha256\": \"ab\", \"min\": 1, \"avg\": 2, \"max\": 4, "
+                                        "\"chunks\": [" + chunk + "]}", &manifest));
+
+      /* The chunk sizes must be ordered */
+      QVERIFY(!ChunkSync::parseManifest("{\"size\": 10, \"sha256\": \"ab\", \"min\": 4, \"avg\": 2, \"max\": 4, "
+                                        "\"chunks\": [" + chunk + "]}", &manifest));
+
+      /* The file checksum is required */
+      QVERIFY(!ChunkSync::parseManifest("{\"size\": 10, \"min\": 1, \"avg\": 2, \"max\": 4, "
+                                        "\"chunks\": [" + chunk + "]}", &manifest));
+
+      QVERIFY(!ChunkSync::parseManifest("not a manifest", &manifest));
+   }
+};
+
+#endif
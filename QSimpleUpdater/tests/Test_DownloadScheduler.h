@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_DOWNLOADSCHEDULER_H
+#define TEST_DOWNLOADSCHEDULER_H
+
+#include <QtTest>
+#include <DownloadScheduler.h>
+
+/**
+ * Stands for a transfer, counts how many times the scheduler starts it
+ */
+class Test_SchedulerClient : public QObject
+{
+   Q_OBJECT
+
+public:
+   Test_SchedulerClient()
+      : starts(0)
+   {
+   }
+
+   int starts;
+
+public slots:
+   void begin() { ++starts; }
+};
+
+class Test_DownloadScheduler : public QObject
+{
+   Q_OBJECT
+
+private:
+   int m_connections;
+   int m_hostConnections;
+
+   static DownloadScheduler *scheduler() { return DownloadScheduler::getInstance(); }
+
+   static void enqueue(Test_SchedulerClient *client, const QString &host,
+                       const DownloadScheduler::Priority priority = DownloadScheduler::Foreground)
+   {
+      scheduler()->enqueue(client, QUrl("https://" + host + "/file"), priority, "begin");
+   }
+
+private slots:
+   void initTestCase()
+   {
+      m_connections = scheduler()->maxConnections();
+      m_hostConnections = scheduler()->maxHostConnections();
+   }
+
+   void cleanup()
+   {
+      scheduler()->setMaxConnections(m_connections);
+      scheduler()->setMaxHostConnections(m_hostConnections);
+   }
+
+   void limitsTheConnections()
+   {
+      scheduler()->setMaxConnections(2);
+      scheduler()->setMaxHostConnections(2);
+
+      Test_SchedulerClient a, b, c;
+      enqueue(&a, "a.example.com");
+      enqueue(&b, "b.example.com");
+      enqueue(&c, "c.example.com");
+
+      QTRY_COMPARE(a.starts + b.starts, 2);
+      QVERIFY(scheduler()->isActive(&a));
+      QVERIFY(scheduler()->isActive(&b));
+      QVERIFY(scheduler()->isQueued(&c));
+
+      /* A finished transfer makes room for the next one */
+      scheduler()->release(&a);
+      QVERIFY(!scheduler()->isActive(&a));
+      QVERIFY(scheduler()->isActive(&c));
+      QTRY_COMPARE(c.starts, 1);
+
+      scheduler()->release(&b);
+      scheduler()->release(&c);
+      QCOMPARE(a.starts, 1);
+      QCOMPARE(b.starts, 1);
+   }
+
+   void limitsTheConnectionsPerHost()
+   {
+      scheduler()->setMaxConnections(4);
+      scheduler()->setMaxHostConnections(1);
+
+      Test_SchedulerClient a, b, c;
+      enqueue(&a, "a.example.com");
+      enqueue(&b, "A.example.com");
+      enqueue(&c, "c.example.com");
+
+      /* The busy host does not block the transfers to other hosts */
+      QVERIFY(scheduler()->isActive(&a));
+      QVERIFY(scheduler()->isQueued(&b));
+      QVERIFY(scheduler()->isActive(&c));
+
+      scheduler()->release(&a);
+      QVERIFY(scheduler()->isActive(&b));
+
+      scheduler()->release(&b);
+      scheduler()->release(&c);
+   }
+
+   void raisingTheLimitStartsWaitingTransfers()
+   {
+      scheduler()->setMaxConnections(1);
+
+      Test_SchedulerClient a, b;
+      enqueue(&a, "a.example.com");
+      enqueue(&b, "b.example.com");
+      QVERIFY(scheduler()->isQueued(&b));
+
+      scheduler()->setMaxConnections(2);
+      QVERIFY(scheduler()->isActive(&b));
+      QTRY_COMPARE(b.starts, 1);
+
+      scheduler()->release(&a);
+      scheduler()->release(&b);
+   }
+
+   void startsHigherPrioritiesFirst()
+   {
+      scheduler()->setMaxConnections(1);
+
+      Test_SchedulerClient a, b, c;
+      enqueue(&a, "a.example.com", DownloadScheduler::Background);
+      enqueue(&b, "b.example.com", DownloadScheduler::Background);
+      enqueue(&c, "c.example.com", DownloadScheduler::Mandatory);
+      QVERIFY(scheduler()->isActive(&a));
+
+      scheduler()->release(&a);
+      QVERIFY(scheduler()->isActive(&c));
+      QVERIFY(scheduler()->isQueued(&b));
+
+      /* A waiting transfer moves in the queue when its priority changes */
+      Test_SchedulerClient d;
+      enqueue(&d, "d.example.com", DownloadScheduler::Background);
+      scheduler()->setPriority(&d, DownloadScheduler::Foreground);
+      scheduler()->release(&c);
+      QVERIFY(scheduler()->isActive(&d));
+      QVERIFY(scheduler()->isQueued(&b));
+
+      scheduler()->release(&d);
+      QVERIFY(scheduler()->isActive(&b));
+      scheduler()->release(&b);
+   }
+
+   void capsTheConnectionsOfATransfer()
+   {
+      scheduler()->setMaxConnections(4);
+      scheduler()->setMaxHostConnections(3);
+
+      Test_SchedulerClient a, b;
+      QCOMPARE(scheduler()->acquireConnections(&a, 4), 0);
+
+      enqueue(&a, "a.example.com");
+      QCOMPARE(scheduler()->acquireConnections(&a, 8), 3);
+
+      enqueue(&b, "b.example.com");
+      QVERIFY(scheduler()->isActive(&b));
+      QCOMPARE(scheduler()->acquireConnections(&b, 4), 1);
+
+      /* Giving connections back lets the other transfer open more */
+      QCOMPARE(scheduler()->acquireConnections(&a, 1), 1);
+      QCOMPARE(scheduler()->acquireConnections(&b, 4), 3);
+
+      scheduler()->release(&a);
+      scheduler()->release(&b);
+   }
+
+   void forgetsDeletedClients()
+   {
+      scheduler()->setMaxConnections(1);
+
+      Test_SchedulerClient b;
+      Test_SchedulerClient *a = new Test_SchedulerClient;
+      enqueue(a, "a.example.com");
+      enqueue(&b, "b.example.com");
+      QVERIFY(scheduler()->isQueued(&b));
+
+      delete a;
+      QVERIFY(scheduler()->isActive(&b));
+      scheduler()->release(&b);
+   }
+};
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_DOWNLOADTASK_H
+#define TEST_DOWNLOADTASK_H
+
+#include <QtTest>
+#include <functional>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkAccessManager>
+#include <DownloadTask.h>
+
+/**
+ * Minimal HTTP server that answers every request with the response built by
+ * its handler, so that the tests can check the requests of a download
+ */
+class TestServer : public QTcpServer
+{
+public:
+   typedef std::function<QByteArray(const QByteArray &request)> Handler;
+
+   explicit TestServer(const Handler &handler)
+      : m_handler(handler)
+   {
+      listen(QHostAddress::LocalHost);
+      connect(this, &QTcpServer::newConnection, this, [this]() {
+         while (hasPendingConnections())
+            serve(nextPendingConnection());
+      });
+   }
+
+   QUrl url(const QString &path) const
+   {
+      return QUrl(QString("http://127.0.0.1:%1/%2").arg(serverPort()).arg(path));
+   }
+
+   QList<QByteArray> requests;
+
+private:
+   void serve(QTcpSocket *socket)
+   {
+      QByteArray *request = new QByteArray;
+      connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+      connect(socket, &QObject::destroyed, socket, [request]() { delete request; });
+      connect(socket, &QTcpSocket::readyRead, socket, [this, socket, request]() {
+         request->append(socket->readAll());
+         if (!request->contains("\r\n\r\n"))
+            return;
+
+         requests.append(*request);
+         socket->write(m_handler(*request));
+         socket->disconnectFromHost();
+      });
+   }
+
+   Handler m_handler;
+};
+
+class Test_DownloadTask : public QObject
+{
+   Q_OBJECT
+
+private:
+   static QByteArray fileData()
+   {
+      QByteArray data;
+      for (int i = 0; data.size() < 64 * 1024; ++i)
+         data.append(QByteArray::number(i)).append('\n');
+
+      return data;
+   }
+
+   static QByteArray response(const QByteArray &status, const QByteArray &body, const QByteArray &headers,
+                              const int sent = -1)
+   {
+      return "HTTP/1.1 " + status + "\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\n" + headers
+             + "Connection: close\r\n\r\n" + (sent < 0 ? body : body.left(sent));
+   }
+
+   /* Answers range requests with the validator "v1" and everything else with
+    * the whole file */
+   static QByteArray serveRanges(const QByteArray &request)
+   {
+      QByteArray data = fileData();
+      QByteArray etag = "ETag: \"v1\"\r\n";
+
+      QRegularExpression range("Range: bytes=(\\d+)-\r\n");
+      QRegularExpressionMatch match = range.match(QString::fromLatin1(request));
+      if (!match.hasMatch() || !request.contains("If-Range: \"v1\"\r\n"))
+         return response("200 OK", data, etag);
+
+      int offset = match.captured(1).toInt();
+      if (offset >= data.size())
+         return response("416 Range Not Satisfiable", QByteArray(),
+                         "Content-Range: bytes */" + QByteArray::number(data.size()) + "\r\n");
+
+      return response("206 Partial Content", data.mid(offset),
+                      "Content-Range: bytes " + QByteArray::number(offset) + "-" + QByteArray::number(data.size() - 1)
+                         + "/" + QByteArray::number(data.size()) + "\r\n" + etag);
+   }
+
+   static void writePartialFile(const QString &path, const QByteArray &data, const QUrl &url)
+   {
+      QFile file(path + ".part");
+      QVERIFY(file.open(QFile::WriteOnly));
+      QCOMPARE(file.write(data), qint64(data.size()));
+      file.close();
+
+      QSettings info(path + ".part.info", QSettings::IniFormat);
+      info.setValue("url", url.toString());
+      info.setValue("etag", QByteArray("\"v1\""));
+      info.sync();
+   }
+
+   static QByteArray readFile(const QString &path)
+   {
+      QFile file(path);
+      return file.open(QFile::ReadOnly) ? file.readAll() : QByteArray();
+   }
+
+private slots:
+   void resumesPartialDownloads()
+   {
+      QTemporaryDir dir;
+      TestServer server(&serveRanges);
+      QNetworkAccessManager manager;
+      QUrl url = server.url("file.bin");
+      writePartialFile(dir.filePath("file.bin"), fileData().left(20000), url);
+
+      DownloadTask task(&manager);
+      task.setDownloadDir(dir.path());
+      task.setFileName("file.bin");
+      QSignalSpy finished(&task, SIGNAL(finished(QString)));
+      task.start(url);
+
+      QVERIFY(finished.wait(5000));
+      QCOMPARE(readFile(dir.filePath("file.bin")), fileData());
+      QVERIFY(!QFile::exists(dir.filePath("file.bin.part")));
+      QVERIFY(!QFile::exists(dir.filePath("file.bin.part.info")));
+
+      /* Only the missing part was requested, and only if it did not change */
+      QCOMPARE(server.requests.count(), 1);
+      QVERIFY(server.requests.first().contains("Range: bytes=20000-\r\n"));
+      QVERIFY(server.requests.first().contains("If-Range: \"v1\"\r\n"));
+   }
+
+   void restartsWhenTheRangeIsNotSatisfiable()
+   {
+      QTemporaryDir dir;
+      TestServer server(&serveRanges);
+      QNetworkAccessManager manager;
+      QUrl url = server.url("file.bin");
+
+      /* The partial file is larger than the remote file */
+      writePartialFile(dir.filePath("file.bin"), fileData() + "stale", url);
+
+      DownloadTask task(&manager);
+      task.setDownloadDir(dir.path());
+      task.setFileName("file.bin");
+      QSignalSpy finished(&task, SIGNAL(finished(QString)));
+      task.start(url);
+
+      QVERIFY(finished.wait(5000));
+      QCOMPARE(readFile(dir.filePath("file.bin")), fileData());
+      QCOMPARE(server.requests.count(), 2);
+      QVERIFY(server.requests.first().contains("Range: bytes="));
+      QVERIFY(!server.requests.last().contains("Range: bytes="));
+   }
+
+   void storesValidatorsOfInterruptedDownloads()
+   {
+      QTemporaryDir dir;
+      QNetworkAccessManager manager;
+
+      /* The connection is closed in the middle of the file */
+      TestServer broken([](const QByteArray &) {
+         return response("200 OK", fileData(), "ETag: \"v1\"\r\n", 30000);
+      });
+
+      QUrl url = broken.url("file.bin");
+      DownloadTask task(&manager);
+      task.setDownloadDir(dir.path());
+      task.setFileName("file.bin");
+      QSignalSpy states(&task, SIGNAL(stateChanged(int, int)));
+      task.start(url);
+
+      QTRY_VERIFY_WITH_TIMEOUT(!states.isEmpty() && states.last().at(0).toInt() == DownloadTask::Failed, 5000);
+      QCOMPARE(states.last().at(1).toInt(), int(DownloadTask::NetworkError));
+
+      /* The data that was received is kept with its validators */
+      QByteArray part = readFile(dir.filePath("file.bin.part"));
+      QVERIFY(!part.isEmpty());
+      QVERIFY(fileData().startsWith(part));
+
+      QSettings info(dir.filePath("file.bin.part.info"), QSettings::IniFormat);
+      QCOMPARE(info.value("url").toString(), url.toString());
+      QCOMPARE(info.value("etag").toByteArray(), QByteArray("\"v1\""));
+      QCOMPARE(info.value("committed", part.size()).toLongLong(), qint64(part.size()));
+   }
+};
+
+#endif
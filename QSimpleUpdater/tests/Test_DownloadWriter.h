@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_DOWNLOADWRITER_H
+#define TEST_DOWNLOADWRITER_H
+
+#include <QtTest>
+#include <DownloadWriter.h>
+
+class Test_DownloadWriter : public QObject
+{
+   Q_OBJECT
+
+private:
+   static QByteArray fileData(const int size)
+   {
+      QByteArray data(size, 0);
+      for (int i = 0; i < size; ++i)
+         data[i] = char((i * 7 + i / 256) & 0xff);
+
+      return data;
+   }
+
+   static QByteArray readFile(const QString &path)
+   {
+      QFile file(path);
+      return file.open(QFile::ReadOnly) ? file.readAll() : QByteArray();
+   }
+
+   static void writeFile(const QString &path, const QByteArray &data)
+   {
+      QFile file(path);
+      QVERIFY(file.open(QFile::WriteOnly));
+      QCOMPARE(file.write(data), qint64(data.size()));
+   }
+
+private slots:
+   void appendsSmallBuffers()
+   {
+      QTemporaryDir dir;
+      QString path = dir.filePath("file");
+      QByteArray data = fileData(3 * 1024 * 1024);
+
+      DownloadWriter writer;
+      writer.setHashEnabled(true);
+      QSignalSpy closed(&writer, SIGNAL(closed(bool)));
+      QVERIFY(writer.open(path, false));
+
+      /* Many small buffers, as a socket delivers them */
+      for (int i = 0; i < data.size(); i += 1000)
+         writer.append(data.mid(i, 1000));
+
+      writer.finish();
+      QTRY_COMPARE_WITH_TIMEOUT(closed.count(), 1, 5000);
+      QVERIFY(closed.first().at(0).toBool());
+      QVERIFY(!writer.isOpen());
+      QCOMPARE(readFile(path), data);
+      QCOMPARE(writer.checksum(), QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+   }
+
+   void reportsWhenTheQueueDrains()
+   {
+      QTemporaryDir dir;
+      DownloadWriter writer;
+      writer.setCapacity(0);
+      QSignalSpy drained(&writer, SIGNAL(drained()));
+      QSignalSpy closed(&writer, SIGNAL(closed(bool)));
+      QVERIFY(writer.open(dir.filePath("file"), false));
+
+      /* The producer must stop once the queue is full */
+      QByteArray data = fileData(64 * 1024);
+      int appended = 0;
+      while (!writer.isFull())
+      {
+         writer.append(data);
+         ++appended;
+      }
+
+      QTRY_VERIFY_WITH_TIMEOUT(!writer.isFull(), 5000);
+      QTRY_VERIFY(drained.count() > 0);
+
+      writer.finish();
+      QTRY_COMPARE_WITH_TIMEOUT(closed.count(), 1, 5000);
+      QCOMPARE(QFileInfo(dir.filePath("file")).size(), qint64(appended) * data.size());
+   }
+
+   void hashesResumedFiles()
+   {
+      QTemporaryDir dir;
+      QString path = dir.filePath("file");
+      QByteArray data = fileData(2 * 1024 * 1024);
+      writeFile(path, data.left(700 * 1024));
+
+      DownloadWriter writer;
+      writer.setHashEnabled(true);
+      QSignalSpy closed(&writer, SIGNAL(closed(bool)));
+      QVERIFY(writer.open(path, true, data.size()));
+      QVERIFY(writer.isPreallocated());
+
+      writer.append(data.mid(700 * 1024));
+      writer.finish();
+      QTRY_COMPARE_WITH_TIMEOUT(closed.count(), 1, 5000);
+      QVERIFY(closed.first().at(0).toBool());
+      QCOMPARE(readFile(path), data);
+      QCOMPARE(writer.checksum(), QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+   }
+
+   void writesAtOffsets()
+   {
+      QTemporaryDir dir;
+      QString path = dir.filePath("file");
+      QByteArray data = fileData(1024 * 1024);
+
+      DownloadWriter writer;
+      writer.setHashEnabled(true);
+      QSignalSpy closed(&writer, SIGNAL(closed(bool)));
+      QVERIFY(writer.open(path, false, data.size()));
+      QCOMPARE(QFileInfo(path).size(), qint64(data.size()));
+
+      /* Segments arrive out of order, the hash reads the gaps back */
+      const int segment = 256 * 1024;
+      for (int offset = data.size() - segment; offset >= 0; offset -= segment)
+         writer.write(offset, data.mid(offset, segment));
+
+      writer.finish();
+      QTRY_COMPARE_WITH_TIMEOUT(closed.count(), 1, 5000);
+      QVERIFY(closed.first().at(0).toBool());
+      QCOMPARE(readFile(path), data);
+      QCOMPARE(writer.checksum(), QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+   }
+
+   void truncatesToTheCommittedData()
+   {
+      QTemporaryDir dir;
+      QString path = dir.filePath("file");
+      QByteArray data = fileData(100 * 1000);
+
+      DownloadWriter writer;
+      QSignalSpy closed(&writer, SIGNAL(closed(bool)));
+      QVERIFY(writer.open(path, false, data.size()));
+
+      /* The data after the gap cannot be resumed, it is dropped */
+      writer.write(0, data.left(30000));
+      writer.write(60000, data.mid(60000, 10000));
+      writer.finish();
+      QTRY_COMPARE_WITH_TIMEOUT(closed.count(), 1, 5000);
+      QCOMPARE(readFile(path), data.left(30000));
+   }
+
+   void abortKeepsTheResumedData()
+   {
+      QTemporaryDir dir;
+      QString path = dir.filePath("file");
+      QByteArray data = fileData(100 * 1000);
+      writeFile(path, data.left(20000));
+
+      /* Nothing was received, the allocated space is released */
+      DownloadWriter writer;
+      QSignalSpy closed(&writer, SIGNAL(closed(bool)));
+      QVERIFY(writer.open(path, true, data.size()));
+      QCOMPARE(QFileInfo(path).size(), qint64(data.size()));
+
+      writer.abort();
+      QVERIFY(!writer.isOpen());
+      QCOMPARE(readFile(path), data.left(20000));
+      QCOMPARE(closed.count(), 0);
+   }
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_PATCHENGINE_H
+#define TEST_PATCHENGINE_H
+
+#include <QtTest>
+#include <PatchEngine.h>
+
+class Test_PatchEngine : public QObject
+{
+   Q_OBJECT
+
+private:
+   /* Offsets are stored as little-endian sign-magnitude integers */
+   static QByteArray offset(const qint64 value)
+   {
+      QByteArray data(8, 0);
+      quint64 magnitude = quint64(qAbs(value));
+      for (int i = 0; i < 8; ++i)
+         data[i] = char((magnitude >> (i * 8)) & 0xFF);
+
+      if (value < 0)
+         data[7] = char(data.at(7) | 0x80);
+
+      return data;
+   }
+
+   /* Patch with a single control triple */
+   static QByteArray patch(const QByteArray &diff, const QByteArray &extra, const qint64 newSize,
+                           const qint64 seek = 0)
+   {
+      QByteArray data = PatchEngine::magic() + offset(newSize);
+      data += offset(diff.size()) + offset(extra.size()) + offset(seek);
+      data += diff + extra;
+      return data;
+   }
+
+   static bool writeFile(const QString &path, const QByteArray &data)
+   {
+      QFile file(path);
+      return file.open(QFile::WriteOnly) && file.write(data) == data.size();
+   }
+
+   static QByteArray readFile(const QString &path)
+   {
+      QFile file(path);
+      return file.open(QFile::ReadOnly) ? file.readAll() : QByteArray();
+   }
+
+private slots:
+   void appliesDiffAndExtraBytes()
+   {
+      QTemporaryDir dir;
+      QByteArray oldData("hello world");
+      QByteArray newData("jello there!!");
+
+      /* The diff bytes are added to the old bytes */
+      QByteArray diff(6, 0);
+      for (int i = 0; i < diff.size(); ++i)
+         diff[i] = char(newData.at(i) - oldData.at(i));
+
+      QVERIFY(writeFile(dir.filePath("old"), oldData));
+      QVERIFY(writeFile(dir.filePath("patch"), patch(diff, newData.mid(6), newData.size())));
+
+      QByteArray checksum;
+      QVERIFY(PatchEngine::applyPatch(dir.filePath("old"), dir.filePath("patch"), dir.filePath("new"), &checksum));
+      QCOMPARE(readFile(dir.filePath("new")), newData);
+      QCOMPARE(checksum, QCryptographicHash::hash(newData, QCryptographicHash::Sha256));
+   }
+
+   void rejectsForeignMagic()
+   {
+      QTemporaryDir dir;
+      QByteArray data = patch(QByteArray(), "new", 3);
+      data.replace(0, PatchEngine::magic().size(), "ENDSLEY/BSDIFF43");
+
+      QVERIFY(writeFile(dir.filePath("old"), "old"));
+      QVERIFY(writeFile(dir.filePath("patch"), data));
+      QVERIFY(!PatchEngine::applyPatch(dir.filePath("old"), dir.filePath("patch"), dir.filePath("new")));
+   }
+
+   void rejectsTruncatedPatch()
+   {
+      QTemporaryDir dir;
+      QByteArray data = patch(QByteArray(3, 0), "extra", 8);
+      data.chop(2);
+
+      QVERIFY(writeFile(dir.filePath("old"), "old"));
+      QVERIFY(writeFile(dir.filePath("patch"), data));
+      QVERIFY(!PatchEngine::applyPatch(dir.filePath("old"), dir.filePath("patch"), dir.filePath("new")));
+   }
+
+   void rejectsControlPastTheEnd()
+   {
+      QTemporaryDir dir;
+      QVERIFY(writeFile(dir.filePath("old"), "old"));
+      QVERIFY(writeFile(dir.filePath("patch"), patch(QByteArray(), "too long", 4)));
+      QVERIFY(!PatchEngine::applyPatch(dir.filePath("old"), dir.filePath("patch"), dir.filePath("new")));
+   }
+
+   void rejectsOverflowingControlValues()
+   {
+      QTemporaryDir dir;
+      QVERIFY(writeFile(dir.filePath("old"), "old data"));
+
+      /* Lengths that wrap around once they are added to the position */
+      QByteArray data = PatchEngine::magic() + offset(4);
+      data += offset(Q_INT64_C(0x7fffffffffffffff)) + offset(Q_INT64_C(0x7fffffffffffffff)) + offset(0);
+      QVERIFY(writeFile(dir.filePath("patch"), data + "data"));
+      QVERIFY(!PatchEngine::applyPatch(dir.filePath("old"), dir.filePath("patch"), dir.filePath("new")));
+
+      /* Diff bytes past the end of the old file */
+      QVERIFY(writeFile(dir.filePath("patch"), patch(QByteArray(12, 0), QByteArray(), 12)));
+      QVERIFY(!PatchEngine::applyPatch(dir.filePath("old"), dir.filePath("patch"), dir.filePath("new")));
+
+      /* A seek before the start of the old file */
+      QVERIFY(writeFile(dir.filePath("patch"), patch(QByteArray(2, 0), "xx", 4, -100)));
+      QVERIFY(!PatchEngine::applyPatch(dir.filePath("old"), dir.filePath("patch"), dir.filePath("new")));
+   }
+};
+
+#endif
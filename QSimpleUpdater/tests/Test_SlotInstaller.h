@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_SLOTINSTALLER_H
+#define TEST_SLOTINSTALLER_H
+
+#include <QtTest>
+#include <SlotInstaller.h>
+
+class Test_SlotInstaller : public QObject
+{
+   Q_OBJECT
+
+private:
+   static QByteArray readFile(const QString &path)
+   {
+      QFile file(path);
+      return file.open(QFile::ReadOnly) ? file.readAll() : QByteArray();
+   }
+
+   static bool writeFile(const QString &path, const QByteArray &data, const bool executable = false)
+   {
+      QFile file(path);
+      if (!file.open(QFile::WriteOnly) || file.write(data) != data.size())
+         return false;
+
+      file.close();
+      if (executable)
+         return file.setPermissions(file.permissions() | QFile::ExeOwner);
+
+      return true;
+   }
+
+   /**
+    * Creates the files of an update with the given \a version in \a directory
+    */
+   static bool createUpdate(const QString &directory, const QByteArray &version)
+   {
+      return QDir().mkpath(directory + "/lib") && writeFile(directory + "/app", "#!/bin/sh\n", true)
+             && writeFile(directory + "/lib/version", version) && QFile::link("lib/version", directory + "/VERSION");
+   }
+
+private slots:
+   void initTestCase()
+   {
+      if (!SlotInstaller::isSupported())
+         QSKIP("Slot installs are not supported on this system");
+   }
+
+   void installsIntoTheOtherSlot()
+   {
+      QTemporaryDir dir;
+      SlotInstaller installer(dir.filePath("root"));
+      QVERIFY(installer.currentSlot().isEmpty());
+      QVERIFY(installer.runningSlot().isEmpty());
+
+      QVERIFY(createUpdate(dir.filePath("1.0"), "1.0"));
+      QVERIFY2(installer.install(dir.filePath("1.0"), "app"), qPrintable(installer.errorString()));
+      QCOMPARE(installer.currentSlot(), installer.root() + "/slot-a");
+      QVERIFY(installer.previousSlot().isEmpty());
+      QVERIFY(!QFileInfo::exists(dir.filePath("1.0")));
+
+      QVERIFY(createUpdate(dir.filePath("1.1"), "1.1"));
+      QVERIFY2(installer.install(dir.filePath("1.1"), "app"), qPrintable(installer.errorString()));
+      QCOMPARE(installer.currentSlot(), installer.root() + "/slot-b");
+      QCOMPARE(installer.previousSlot(), installer.root() + "/slot-a");
+
+      /* The application is restarted through the current link */
+      QCOMPARE(readFile(installer.currentLink() + "/VERSION"), QByteArray("1.1"));
+      QVERIFY(QFileInfo(installer.currentLink() + "/app").isExecutable());
+      QCOMPARE(readFile(installer.previousSlot() + "/VERSION"), QByteArray("1.0"));
+
+      /* The oldest version is replaced, since nothing runs from it */
+      QVERIFY(createUpdate(dir.filePath("1.2"), "1.2"));
+      QVERIFY2(installer.install(dir.filePath("1.2"), "app"), qPrintable(installer.errorString()));
+      QCOMPARE(installer.currentSlot(), installer.root() + "/slot-a");
+      QCOMPARE(installer.previousSlot(), installer.root() + "/slot-b");
+      QCOMPARE(readFile(installer.currentLink() + "/VERSION"), QByteArray("1.2"));
+   }
+
+   void installsTheTopLevelDirectory()
+   {
+      QTemporaryDir dir;
+      SlotInstaller installer(dir.filePath("root"));
+
+      QVERIFY(createUpdate(dir.filePath("extracted/app-1.0"), "1.0"));
+      QVERIFY2(installer.install(dir.filePath("extracted"), "app"), qPrintable(installer.errorString()));
+      QCOMPARE(readFile(installer.currentLink() + "/VERSION"), QByteArray("1.0"));
+   }
+
+   void rollsBack()
+   {
+      QTemporaryDir dir;
+      SlotInstaller installer(dir.filePath("root"));
+      QVERIFY(!installer.rollback());
+
+      QVERIFY(createUpdate(dir.filePath("1.0"), "1.0"));
+      QVERIFY(createUpdate(dir.filePath("1.1"), "1.1"));
+      QVERIFY(installer.install(dir.filePath("1.0"), "app"));
+      QVERIFY(!installer.rollback());
+      QVERIFY(installer.install(dir.filePath("1.1"), "app"));
+
+      QVERIFY2(installer.rollback(), qPrintable(installer.errorString()));
+      QCOMPARE(readFile(installer.currentLink() + "/VERSION"), QByteArray("1.0"));
+      QCOMPARE(installer.previousSlot(), installer.root() + "/slot-b");
+
+      /* A second rollback undoes the first one */
+      QVERIFY2(installer.rollback(), qPrintable(installer.errorString()));
+      QCOMPARE(readFile(installer.currentLink() + "/VERSION"), QByteArray("1.1"));
+   }
+
+   void rejectsUpdatesWithoutTheEntryPoint()
+   {
+      QTemporaryDir dir;
+      SlotInstaller installer(dir.filePath("root"));
+      QVERIFY(createUpdate(dir.filePath("1.0"), "1.0"));
+      QVERIFY(installer.install(dir.filePath("1.0"), "app"));
+
+      QVERIFY(createUpdate(dir.filePath("1.1"), "1.1"));
+      QVERIFY(!installer.install(dir.filePath("1.1"), "bin/app"));
+      QVERIFY(installer.errorString().contains("bin/app"));
+
+      /* The current version stays active and the staged files are removed */
+      QCOMPARE(installer.currentSlot(), installer.root() + "/slot-a");
+      QCOMPARE(readFile(installer.currentLink() + "/VERSION"), QByteArray("1.0"));
+      QVERIFY(!QFileInfo::exists(installer.root() + "/slot-b"));
+
+      QVERIFY(createUpdate(dir.filePath("1.2"), "1.2"));
+      QVERIFY(!installer.install(dir.filePath("1.2"), "lib/version"));
+      QVERIFY(installer.errorString().contains("not executable"));
+      QCOMPARE(installer.currentSlot(), installer.root() + "/slot-a");
+   }
+
+   void rejectsLinksOutOfTheUpdate()
+   {
+      QTemporaryDir dir;
+      SlotInstaller installer(dir.filePath("root"));
+      QVERIFY(writeFile(dir.filePath("outside"), "#!/bin/sh\n", true));
+
+      QVERIFY(createUpdate(dir.filePath("1.0"), "1.0"));
+      QVERIFY(QFile::link("../../outside", dir.filePath("1.0/lib/outside")));
+      QVERIFY(!installer.install(dir.filePath("1.0"), "app"));
+      QVERIFY(installer.errorString().contains("links outside"));
+      QVERIFY(installer.currentSlot().isEmpty());
+
+      /* The entry point must not lead out of the slot either */
+      QVERIFY(createUpdate(dir.filePath("1.1"), "1.1"));
+      QVERIFY(QFile::link(dir.filePath("outside"), dir.filePath("1.1/run")));
+      QVERIFY(!installer.install(dir.filePath("1.1"), "run"));
+      QVERIFY(installer.currentSlot().isEmpty());
+   }
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TEST_THROUGHPUTESTIMATOR_H
+#define TEST_THROUGHPUTESTIMATOR_H
+
+#include <QtTest>
+#include <ThroughputEstimator.h>
+
+class Test_ThroughputEstimator : public QObject
+{
+   Q_OBJECT
+
+private slots:
+   void startsEmpty()
+   {
+      ThroughputEstimator estimator;
+      QVERIFY(!estimator.isValid());
+      QCOMPARE(estimator.total(), qint64(-1));
+      QCOMPARE(estimator.received(), qint64(0));
+      QCOMPARE(estimator.currentRate(), qreal(0));
+      QCOMPARE(estimator.remainingTime(), qint64(-1));
+   }
+
+   void firstUpdateIsTheStartingPoint()
+   {
+      ThroughputEstimator estimator;
+      estimator.update(1000, 5000);
+      QVERIFY(estimator.isValid());
+      QCOMPARE(estimator.received(), qint64(1000));
+      QCOMPARE(estimator.total(), qint64(5000));
+
+      /* Unknown sizes are reported as -1 */
+      estimator.update(1000, 0);
+      QCOMPARE(estimator.total(), qint64(-1));
+      QCOMPARE(estimator.remainingTime(), qint64(-1));
+   }
+
+   void estimatesRateAndRemainingTime()
+   {
+      ThroughputEstimator estimator;
+      estimator.update(0, 1000000);
+      QThread::msleep(300);
+      estimator.update(30000, 1000000);
+
+      QVERIFY(estimator.currentRate() > 0);
+      QVERIFY(estimator.averageRate() > 0);
+      QVERIFY(estimator.remainingTime() > 0);
+
+      /* The rate decays while no data is received */
+      qreal rate = estimator.currentRate();
+      QThread::msleep(600);
+      QVERIFY(estimator.currentRate() < rate);
+   }
+
+   void resetForgetsTheTransfer()
+   {
+      ThroughputEstimator estimator;
+      estimator.update(0, 100);
+      estimator.update(50, 100);
+      estimator.reset();
+
+      QVERIFY(!estimator.isValid());
+      QCOMPARE(estimator.received(), qint64(0));
+      QCOMPARE(estimator.total(), qint64(-1));
+   }
+};
+
+#endif
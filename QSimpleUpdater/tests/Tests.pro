@@ -31,6 +31,15 @@ SOURCES += \
     $$PWD/main.cpp
 
 HEADERS += \
+    $$PWD/Test_AppcastReader.h \
+    $$PWD/Test_ArchiveExtractor.h \
+    $$PWD/Test_ChunkSync.h \
     $$PWD/Test_Downloader.h \
+    $$PWD/Test_DownloadScheduler.h \
+    $$PWD/Test_DownloadTask.h \
+    $$PWD/Test_DownloadWriter.h \
+    $$PWD/Test_PatchEngine.h \
     $$PWD/Test_QSimpleUpdater.h \
+    $$PWD/Test_SlotInstaller.h \
+    $$PWD/Test_ThroughputEstimator.h \
     $$PWD/Test_Updater.h
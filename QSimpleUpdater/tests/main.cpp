@@ -23,6 +23,15 @@
 #include "Test_Updater.h"
 #include "Test_Downloader.h"
 #include "Test_QSimpleUpdater.h"
+#include "Test_DownloadTask.h"
+#include "Test_DownloadWriter.h"
+#include "Test_PatchEngine.h"
+#include "Test_ChunkSync.h"
+#include "Test_DownloadScheduler.h"
+#include "Test_ThroughputEstimator.h"
+#include "Test_ArchiveExtractor.h"
+#include "Test_SlotInstaller.h"
+#include "Test_AppcastReader.h"
 
 int main(int argc, char *argv[])
 {
@@ -34,6 +43,15 @@ int main(int argc, char *argv[])
    QTest::qExec(new Test_Updater, argc, argv);
    QTest::qExec(new Test_Downloader, argc, argv);
    QTest::qExec(new Test_QSimpleUpdater, argc, argv);
+   QTest::qExec(new Test_DownloadTask, argc, argv);
+   QTest::qExec(new Test_DownloadWriter, argc, argv);
+   QTest::qExec(new Test_PatchEngine, argc, argv);
+   QTest::qExec(new Test_ChunkSync, argc, argv);
+   QTest::qExec(new Test_DownloadScheduler, argc, argv);
+   QTest::qExec(new Test_ThroughputEstimator, argc, argv);
+   QTest::qExec(new Test_ArchiveExtractor, argc, argv);
+   QTest::qExec(new Test_SlotInstaller, argc, argv);
+   QTest::qExec(new Test_AppcastReader, argc, argv);
 
    QTimer::singleShot(1000, Qt::PreciseTimer, qApp, SLOT(quit()));
 
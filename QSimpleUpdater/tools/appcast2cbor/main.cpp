@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <QFile>
+#include <QCborMap>
+#include <QFileInfo>
+#include <QJsonValue>
+#include <QTextStream>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "AppcastReader.h"
+#include "AppcastParser.h"
+
+/* Number of times that each appcast is read by the benchmark */
+static const int ITERATIONS = 1000;
+
+/* Platform keys used by the Updater */
+static const char *PLATFORMS[] = { "windows", "osx", "linux", "android", "ios" };
+static const int PLATFORM_COUNT = 5;
+
+/**
+ * Reads every platform of every module of the appcast \a data by building
+ * the whole JSON document, as the updater used to. Returns the average time
+ * in nanoseconds.
+ */
+static qint64 benchDocument(const QByteArray &data)
+{
+   QElapsedTimer timer;
+   timer.start();
+
+   for (int i = 0; i < ITERATIONS; ++i)
+   {
+      QJsonObject root = QJsonDocument::fromJson(data).object();
+
+      QList<QJsonObject> modules;
+      if (root.value("modules").isObject())
+      {
+         foreach (const QJsonValue &module, root.value("modules").toObject())
+            modules.append(module.toObject());
+      }
+      else
+         modules.append(root);
+
+      foreach (const QJsonObject &module, modules)
+      {
+         QJsonObject updates = module.value("updates").toObject();
+         for (int j = 0; j < PLATFORM_COUNT; ++j)
+            updates.value(PLATFORMS[j]).toObject().value("latest-version").toString();
+      }
+   }
+
+   return timer.nsecsElapsed() / ITERATIONS;
+}
+
+/**
+ * Reads every platform of every module of the appcast \a data (JSON or CBOR)
+ * the way the updater does. Returns the average time in nanoseconds.
+ */
+static qint64 benchSelective(const QByteArray &data)
+{
+   QElapsedTimer timer;
+   timer.start();
+
+   for (int i = 0; i < ITERATIONS; ++i)
+   {
+      QHash<QString, AppcastParser::Span> modules;
+      AppcastParser::Span root = AppcastParser::document(data);
+      AppcastParser::Span catalog;
+      if (AppcastParser::findValue(data, root, "modules", &catalog) && AppcastParser::isObject(data, catalog))
+         AppcastParser::members(data, catalog, &modules);
+      else
+         modules.insert(QString(), root);
+
+      foreach (const AppcastParser::Span &module, modules)
+      {
+         for (int j = 0; j < PLATFORM_COUNT; ++j)
+            AppcastReader::parse(data, module, PLATFORMS[j], QString());
+      }
+   }
+
+   return timer.nsecsElapsed() / ITERATIONS;
+}
+
+/**
+ * Converts the JSON appcast at \a path to CBOR and writes it to the same
+ * directory (or to \a outputDir), with the \c .cbor suffix
+ */
+static bool convert(const QString &path, const QString &outputDir, const bool bench, QTextStream &out,
+                    QTextStream &err)
+{
+   QFile input(path);
+   if (!input.open(QFile::ReadOnly))
+   {
+      err << path << ": " << input.errorString() << Qt::endl;
+      return false;
+   }
+
+   const QByteArray json = input.readAll();
+   input.close();
+
+   QJsonParseError error;
+   QJsonDocument document = QJsonDocument::fromJson(json, &error);
+   if (!document.isObject())
+   {
+      err << path << ": " << (document.isNull() ? error.errorString() : "not an appcast") << Qt::endl;
+      return false;
+   }
+
+   const QByteArray cbor = QCborMap::fromJsonObject(document.object()).toCborValue().toCbor();
+
+   QFileInfo info(path);
+   QString directory = outputDir.isEmpty() ? info.absolutePath() : outputDir;
+   QFile output(directory + "/" + info.completeBaseName() + ".cbor");
+   if (!output.open(QFile::WriteOnly | QFile::Truncate) || output.write(cbor) != cbor.size())
+   {
+      err << output.fileName() << ": " << output.errorString() << Qt::endl;
+      return false;
+   }
+
+   output.close();
+   out << path << " -> " << output.fileName() << Qt::endl;
+
+   if (bench)
+   {
+      out << "   size:              " << json.size() << " bytes (JSON), " << cbor.size() << " bytes (CBOR, "
+          << QString::number(100.0 * cbor.size() / qMax(json.size(), 1), 'f', 1) << "%)" << Qt::endl;
+      out << "   JSON document:     " << benchDocument(json) / 1000.0 << " us" << Qt::endl;
+      out << "   JSON selective:    " << benchSelective(json) / 1000.0 << " us" << Qt::endl;
+      out << "   CBOR selective:    " << benchSelective(cbor) / 1000.0 << " us" << Qt::endl;
+   }
+
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   QCoreApplication app(argc, argv);
+   app.setApplicationName("appcast2cbor");
+
+   QCommandLineParser parser;
+   parser.setApplicationDescription("Converts JSON appcasts to the CBOR encoding read by QSimpleUpdater");
+   parser.addHelpOption();
+   parser.addOption(QCommandLineOption("bench", "Compare the size and the read time of both encodings."));
+   parser.addOption(QCommandLineOption(QStringList() << "o" << "output-dir",
+                                       "Write the CBOR files to <directory>.", "directory"));
+   parser.addPositionalArgument("files", "JSON appcasts to convert.", "<file.json...>");
+   parser.process(app);
+
+   if (parser.positionalArguments().isEmpty())
+      parser.showHelp(1);
+
+   QTextStream out(stdout);
+   QTextStream err(stderr);
+
+   bool ok = true;
+   foreach (const QString &path, parser.positionalArguments())
+   {
+      if (!convert(path, parser.value("output-dir"), parser.isSet("bench"), out, err))
+         ok = false;
+   }
+
+   return ok ? 0 : 1;
+}
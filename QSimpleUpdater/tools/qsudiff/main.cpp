@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2014-2021 Alex Spataru <https://github.com/alex-spataru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <QDir>
+#include <QFile>
+#include <QVector>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+
+#include "PatchEngine.h"
+
+/*
+ * The patches are created with the bsdiff algorithm by Colin Percival
+ * (suffix sorting by Larsson and Sadakane), written in the layout that
+ * PatchEngine reads: the magic string, the size of the new file, and the
+ * control triples, each followed by its diff and extra bytes.
+ */
+
+/**
+ * Encodes a bsdiff integer (little endian, sign in the most significant bit)
+ */
+static void writeOffset(qint64 value, QByteArray *output)
+{
+   const bool negative = value < 0;
+   if (negative)
+      value = -value;
+
+   char buffer[8];
+   for (int i = 0; i < 8; ++i)
+   {
+      buffer[i] = char(value & 0xFF);
+      value >>= 8;
+   }
+
+   if (negative)
+      buffer[7] = char(buffer[7] | 0x80);
+
+   output->append(buffer, 8);
+}
+
+/**
+ * Sorts the suffixes between \a start and \a start + \a length by the group
+ * of the suffix that starts \a h bytes later (ternary split)
+ */
+static void split(qint64 *I, qint64 *V, const qint64 start, const qint64 length, const qint64 h)
+{
+   qint64 i, j, k, x, jj, kk;
+
+   if (length < 16)
+   {
+      for (k = start; k < start + length; k += j)
+      {
+         j = 1;
+         x = V[I[k] + h];
+         for (i = 1; k + i < start + length; ++i)
+         {
+            if (V[I[k + i] + h] < x)
+            {
+               x = V[I[k + i] + h];
+               j = 0;
+            }
+
+            if (V[I[k + i] + h] == x)
+            {
+               qSwap(I[k + j], I[k + i]);
+               ++j;
+            }
+         }
+
+         for (i = 0; i < j; ++i)
+            V[I[k + i]] = k + j - 1;
+
+         if (j == 1)
+            I[k] = -1;
+      }
+
+      return;
+   }
+
+   x = V[I[start + length / 2] + h];
+   jj = 0;
+   kk = 0;
+   for (i = start; i < start + length; ++i)
+   {
+      if (V[I[i] + h] < x)
+         ++jj;
+      if (V[I[i] + h] == x)
+         ++kk;
+   }
+
+   jj += start;
+   kk += jj;
+
+   i = start;
+   j = 0;
+   k = 0;
+   while (i < jj)
+   {
+      if (V[I[i] + h] < x)
+         ++i;
+
+      else if (V[I[i] + h] == x)
+      {
+         qSwap(I[i], I[jj + j]);
+         ++j;
+      }
+
+      else
+      {
+         qSwap(I[i], I[kk + k]);
+         ++k;
+      }
+   }
+
+   while (jj + j < kk)
+   {
+      if (V[I[jj + j] + h] == x)
+         ++j;
+
+      else
+      {
+         qSwap(I[jj + j], I[kk + k]);
+         ++k;
+      }
+   }
+
+   if (jj > start)
+      split(I, V, start, jj - start, h);
+
+   for (i = 0; i < kk - jj; ++i)
+      V[I[jj + i]] = kk - 1;
+
+   if (jj == kk - 1)
+      I[jj] = -1;
+
+   if (start + length > kk)
+      split(I, V, kk, start + length - kk, h);
+}
+
+/**
+ * Fills \a I with the suffix array of \a old (\a size + 1 entries)
+ */
+static void suffixSort(qint64 *I, qint64 *V, const uchar *old, const qint64 size)
+{
+   qint64 buckets[256];
+   qint64 i, h, length;
+
+   for (i = 0; i < 256; ++i)
+      buckets[i] = 0;
+   for (i = 0; i < size; ++i)
+      buckets[old[i]]++;
+   for (i = 1; i < 256; ++i)
+      buckets[i] += buckets[i - 1];
+   for (i = 255; i > 0; --i)
+      buckets[i] = buckets[i - 1];
+   buckets[0] = 0;
+
+   for (i = 0; i < size; ++i)
+      I[++buckets[old[i]]] = i;
+   I[0] = size;
+
+   for (i = 0; i < size; ++i)
+      V[i] = buckets[old[i]];
+   V[size] = 0;
+
+   for (i = 1; i < 256; ++i)
+   {
+      if (buckets[i] == buckets[i - 1] + 1)
+         I[buckets[i]] = -1;
+   }
+   I[0] = -1;
+
+   for (h = 1; I[0] != -(size + 1); h += h)
+   {
+      length = 0;
+      for (i = 0; i < size + 1;)
+      {
+         if (I[i] < 0)
+         {
+            length -= I[i];
+            i -= I[i];
+         }
+
+         else
+         {
+            if (length)
+               I[i - length] = -length;
+
+            length = V[I[i]] + 1 - i;
+            split(I, V, i, length, h);
+            i += length;
+            length = 0;
+         }
+      }
+
+      if (length)
+         I[i - length] = -length;
+   }
+
+   for (i = 0; i < size + 1; ++i)
+      I[V[i]] = i;
+}
+
+/**
+ * Returns the number of equal bytes at the start of both buffers
+ */
+static qint64 matchLength(const uchar *a, const qint64 aSize, const uchar *b, const qint64 bSize)
+{
+   qint64 i = 0;
+   while (i < aSize && i < bSize && a[i] == b[i])
+      ++i;
+
+   return i;
+}
+
+/**
+ * Finds the longest match of \a next in \a old with a binary search in the
+ * suffix array \a I
+ */
+static qint64 search(const qint64 *I, const uchar *old, const qint64 oldSize, const uchar *next,
+                     const qint64 nextSize, const qint64 start, const qint64 end, qint64 *pos)
+{
+   if (end - start < 2)
+   {
+      qint64 x = matchLength(old + I[start], oldSize - I[start], next, nextSize);
+      qint64 y = matchLength(old + I[end], oldSize - I[end], next, nextSize);
+      if (x > y)
+      {
+         *pos = I[start];
+         return x;
+      }
+
+      *pos = I[end];
+      return y;
+   }
+
+   qint64 middle = start + (end - start) / 2;
+   if (memcmp(old + I[middle], next, size_t(qMin(oldSize - I[middle], nextSize))) < 0)
+      return search(I, old, oldSize, next, nextSize, middle, end, pos);
+
+   return search(I, old, oldSize, next, nextSize, start, middle, pos);
+}
+
+/**
+ * Creates the patch that turns \a oldData into \a newData
+ */
+static QByteArray createPatch(const QByteArray &oldData, const QByteArray &newData)
+{
+   const uchar *old = reinterpret_cast<const uchar *>(oldData.constData());
+   const uchar *next = reinterpret_cast<const uchar *>(newData.constData());
+   const qint64 oldSize = oldData.size();
+   const qint64 newSize = newData.size();
+
+   QVector<qint64> I(int(oldSize + 1));
+   QVector<qint64> V(int(oldSize + 1));
+   suffixSort(I.data(), V.data(), old, oldSize);
+   V.clear();
+
+   QByteArray patch = PatchEngine::magic();
+   writeOffset(newSize, &patch);
+
+   qint64 scan = 0;
+   qint64 length = 0;
+   qint64 pos = 0;
+   qint64 lastScan = 0;
+   qint64 lastPos = 0;
+   qint64 lastOffset = 0;
+
+   while (scan < newSize)
+   {
+      qint64 oldScore = 0;
+      qint64 scsc;
+      for (scsc = scan += length; scan < newSize; ++scan)
+      {
+         length = search(I.constData(), old, oldSize, next + scan, newSize - scan, 0, oldSize, &pos);
+
+         for (; scsc < scan + length; ++scsc)
+         {
+            if (scsc + lastOffset < oldSize && old[scsc + lastOffset] == next[scsc])
+               ++oldScore;
+         }
+
+         if ((length == oldScore && length != 0) || length > oldScore + 8)
+            break;
+
+         if (scan + lastOffset < oldSize && old[scan + lastOffset] == next[scan])
+            --oldScore;
+      }
+
+      if (length == oldScore && scan != newSize)
+         continue;
+
+      /* Extend the previous match forwards */
+      qint64 s = 0;
+      qint64 best = 0;
+      qint64 forward = 0;
+      for (qint64 i = 0; lastScan + i < scan && lastPos + i < oldSize;)
+      {
+         if (old[lastPos + i] == next[lastScan + i])
+            ++s;
+
+         ++i;
+         if (s * 2 - i > best * 2 - forward)
+         {
+            best = s;
+            forward = i;
+         }
+      }
+
+      /* Extend the current match backwards */
+      qint64 backward = 0;
+      if (scan < newSize)
+      {
+         s = 0;
+         best = 0;
+         for (qint64 i = 1; scan >= lastScan + i && pos >= i; ++i)
+         {
+            if (old[pos - i] == next[scan - i])
+               ++s;
+
+            if (s * 2 - i > best * 2 - backward)
+            {
+               best = s;
+               backward = i;
+            }
+         }
+      }
+
+      /* Split the overlap between both extensions */
+      if (lastScan + forward > scan - backward)
+      {
+         qint64 overlap = (lastScan + forward) - (scan - backward);
+         qint64 shift = 0;
+         s = 0;
+         best = 0;
+         for (qint64 i = 0; i < overlap; ++i)
+         {
+            if (next[lastScan + forward - overlap + i] == old[lastPos + forward - overlap + i])
+               ++s;
+            if (next[scan - backward + i] == old[pos - backward + i])
+               --s;
+
+            if (s > best)
+            {
+               best = s;
+               shift = i + 1;
+            }
+         }
+
+         forward += shift - overlap;
+         backward -= shift;
+      }
+
+      const qint64 extra = (scan - backward) - (lastScan + forward);
+      writeOffset(forward, &patch);
+      writeOffset(extra, &patch);
+      writeOffset((pos - backward) - (lastPos + forward), &patch);
+
+      for (qint64 i = 0; i < forward; ++i)
+         patch.append(char(next[lastScan + i] - old[lastPos + i]));
+
+      patch.append(reinterpret_cast<const char *>(next + lastScan + forward), int(extra));
+
+      lastScan = scan - backward;
+      lastPos = pos - backward;
+      lastOffset = pos - scan;
+   }
+
+   return patch;
+}
+
+/**
+ * Returns the contents of the file at \a path
+ */
+static bool readFile(const QString &path, QByteArray *data, QTextStream &err)
+{
+   QFile file(path);
+   if (!file.open(QFile::ReadOnly))
+   {
+      err << path << ": " << file.errorString() << Qt::endl;
+      return false;
+   }
+
+   *data = file.readAll();
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   QCoreApplication app(argc, argv);
+   app.setApplicationName("qsudiff");
+
+   QCommandLineParser parser;
+   parser.setApplicationDescription("Creates the binary patches applied by QSimpleUpdater");
+   parser.addHelpOption();
+   parser.addPositionalArgument("old", "Previous version of the file.");
+   parser.addPositionalArgument("new", "New version of the file.");
+   parser.addPositionalArgument("patch", "Patch to write.");
+   parser.process(app);
+
+   if (parser.positionalArguments().count() != 3)
+      parser.showHelp(1);
+
+   QTextStream out(stdout);
+   QTextStream err(stderr);
+
+   const QString oldPath = parser.positionalArguments().at(0);
+   const QString newPath = parser.positionalArguments().at(1);
+   const QString patchPath = parser.positionalArguments().at(2);
+
+   QByteArray oldData;
+   QByteArray newData;
+   if (!readFile(oldPath, &oldData, err) || !readFile(newPath, &newData, err))
+      return 1;
+
+   const QByteArray patch = createPatch(oldData, newData);
+
+   QFile output(patchPath);
+   if (!output.open(QFile::WriteOnly | QFile::Truncate) || output.write(patch) != patch.size())
+   {
+      err << patchPath << ": " << output.errorString() << Qt::endl;
+      return 1;
+   }
+
+   output.close();
+
+   /* Make sure that the updater rebuilds the new file from the patch */
+   QByteArray checksum;
+   QString rebuilt = patchPath + ".check";
+   bool valid = PatchEngine::applyPatch(oldPath, patchPath, rebuilt, &checksum)
+                && checksum == QCryptographicHash::hash(newData, QCryptographicHash::Sha256);
+   QFile::remove(rebuilt);
+
+   if (!valid)
+   {
+      err << patchPath << ": the patch does not rebuild " << newPath << Qt::endl;
+      return 1;
+   }
+
+   /* The values of the patch entry of the appcast */
+   out << patchPath << ": " << patch.size() << " bytes (" << newData.size() << " bytes for the new file)" << Qt::endl;
+   out << "sha256: " << QCryptographicHash::hash(patch, QCryptographicHash::Sha256).toHex() << Qt::endl;
+   out << "size:   " << patch.size() << Qt::endl;
+   return 0;
+}
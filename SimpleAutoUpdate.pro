@@ -8,6 +8,7 @@ QT += quick
 VERSION = 1.0.0.1
 SOURCES += \
         AppUpdateController.cpp \
+        DownloadProgress.cpp \
         main.cpp
 
 RESOURCES += qml.qrc
@@ -26,4 +27,5 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 include($$PWD/QSimpleUpdater/QSimpleUpdater.pri)
 
 HEADERS += \
-    AppUpdateController.h
+    AppUpdateController.h \
+    DownloadProgress.h
@@ -7,7 +7,7 @@ import AppUpdateController 1.0
 Window {
     id: root
     property int space: 10
-    property real progressValue: 0
+    property real progressValue: updater.progress.value
     width: 600
     height: 400
 
@@ -20,6 +20,14 @@ Window {
         color: "gray"
     }
 
+    function formatSize(bytes) {
+        if (bytes < 1024)
+            return Math.round(bytes) + " B"
+        if (bytes < 1048576)
+            return (bytes / 1024).toFixed(1) + " KB"
+        return (bytes / 1048576).toFixed(1) + " MB"
+    }
+
     Column {
         anchors.horizontalCenter: parent.horizontalCenter
         spacing: 10
@@ -74,6 +82,48 @@ Window {
             }
         }
 
+        GroupBox {
+
+            title: qsTr("Download")
+            visible: updater.progress.state !== DownloadProgress.Idle
+            Column {
+                spacing: 5
+
+                ProgressBar {
+                    width: 300
+                    value: root.progressValue
+                    indeterminate: updater.progress.state === DownloadProgress.Patching
+                                   || (updater.progress.state === DownloadProgress.Downloading
+                                       && updater.progress.total <= 0)
+                }
+                Label {
+                    text: {
+                        var p = updater.progress
+                        if (p.state === DownloadProgress.Waiting)
+                            return qsTr("Waiting for other downloads...")
+                        if (p.state === DownloadProgress.Patching)
+                            return qsTr("Applying update patch...")
+                        if (p.state === DownloadProgress.Completed)
+                            return qsTr("Download completed!")
+                        if (p.state === DownloadProgress.Failed)
+                            return qsTr("Download failed")
+                        if (p.state === DownloadProgress.Canceled)
+                            return qsTr("Download canceled")
+                        if (p.state === DownloadProgress.Paused)
+                            return qsTr("Download paused")
+
+                        var text = formatSize(p.bytes)
+                        if (p.total > 0)
+                            text += " / " + formatSize(p.total)
+                        text += "  " + formatSize(p.rate) + "/s"
+                        if (p.eta >= 0)
+                            text += "  " + qsTr("%1 s left").arg(p.eta)
+                        return text
+                    }
+                }
+            }
+        }
+
         GroupBox {
 
             title: qsTr("Change Log")
@@ -9,6 +9,8 @@ int main(int argc, char *argv[])
 #endif
     QApplication app(argc, argv);
     qmlRegisterType<AppUpdateController>("AppUpdateController", 1, 0, "AppUpdateController");
+    qmlRegisterUncreatableType<DownloadProgress>("AppUpdateController", 1, 0, "DownloadProgress",
+                                                 "DownloadProgress is provided by AppUpdateController");
     qInfo()<<qApp->applicationVersion();
     QQmlApplicationEngine engine;
     const QUrl url(QStringLiteral("qrc:/main.qml"));